@@ -0,0 +1,76 @@
+#include "allocationcounter.h"
+
+#include <atomic>
+#include <cstddef>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *pointer, size_t size);
+}
+
+namespace {
+
+std::atomic<quint64> allocations(0);
+
+} // namespace
+
+// Definitions in the executable take precedence over the C library, the
+// originals are still available under their internal names
+extern "C" {
+
+void *malloc(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(pointer, size);
+}
+
+} // extern "C"
+#endif
+
+// -----------------------------------------------------------------------------
+// -- Other Methods ------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+bool AllocationCounter::isSupported() {
+#ifdef __GLIBC__
+    return true;
+#else
+    return false;
+#endif
+}
+
+quint64 AllocationCounter::numAllocations() {
+#ifdef __GLIBC__
+    return allocations.load(std::memory_order_relaxed);
+#else
+    return 0;
+#endif
+}
+
+AllocationCounter::HeapUsage AllocationCounter::heapUsage() {
+    HeapUsage usage = {0, 0};
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+    const struct mallinfo2 info = mallinfo2();
+    usage.inUse = info.uordblks + info.hblkhd;
+    usage.free = info.fordblks;
+#elif defined(__GLIBC__)
+    // Wraps around above 4 GB
+    const struct mallinfo info = mallinfo();
+    usage.inUse = static_cast<unsigned>(info.uordblks) + static_cast<unsigned>(info.hblkhd);
+    usage.free = static_cast<unsigned>(info.fordblks);
+#endif
+    return usage;
+}
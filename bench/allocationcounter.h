@@ -0,0 +1,44 @@
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+#include <QtGlobal>
+
+/*!
+ * \brief The AllocationCounter class
+ *
+ * Counts the heap allocations of the whole process, Qt included, by
+ * replacing malloc, calloc and realloc of the C library. Only supported on
+ * glibc, elsewhere isSupported() is false and all counts are zero.
+ */
+class AllocationCounter
+{
+
+    // =========================================================================
+    // -- Enums and types ------------------------------------------------------
+    // =========================================================================
+
+public:
+
+    struct HeapUsage {
+        /// Bytes handed out by the allocator, including its own overhead
+        quint64 inUse;
+        /// Bytes held by the allocator but not in use, the fragmentation
+        quint64 free;
+    };
+
+    // =========================================================================
+    // -- Other methods --------------------------------------------------------
+    // =========================================================================
+
+public:
+
+    static bool isSupported();
+
+    /// Calls of malloc, calloc and realloc since the start of the process
+    static quint64 numAllocations();
+
+    static HeapUsage heapUsage();
+
+};
+
+#endif // ALLOCATIONCOUNTER_H
@@ -0,0 +1,28 @@
+#-------------------------------------------------
+#
+# Microbenchmarks for the importer, geometry and CPU tessellation
+#
+# Results are machine readable through the QTest output options, e.g.
+#   ./bench -o results.xml,xml    or    ./bench -csv
+#
+#-------------------------------------------------
+
+QT       += core gui testlib
+
+TARGET = bench
+TEMPLATE = app
+
+CONFIG += console
+CONFIG -= app_bundle
+
+DEFINES += QT_DEPRECATED_WARNINGS
+DEFINES += SCENE_DIR=\\\"$$PWD/../scenes/bezier\\\"
+
+include(../core.pri)
+
+SOURCES += allocationcounter.cpp \
+    corebenchmark.cpp \
+    syntheticscene.cpp
+
+HEADERS += allocationcounter.h \
+    syntheticscene.h
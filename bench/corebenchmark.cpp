@@ -0,0 +1,808 @@
+#include "allocationcounter.h"
+#include "syntheticscene.h"
+
+#include <geom/beziertriangle.h>
+#include <geom/beziertriangletessellator.h>
+#include <geom/paralleltessellator.h>
+#include <geom/patchculler.h>
+#include <geom/patchedgetable.h>
+#include <geom/patchinvariants.h>
+#include <geom/patchlod.h>
+#include <geom/patchsubdivision.h>
+#include <geom/powerbasis.h>
+#include <util/beziersceneimporter.h>
+#include <util/bezierscenetokenizer.h>
+
+#include <QDir>
+#include <QtTest>
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+/*!
+ * \brief The CoreBenchmark class
+ *
+ * QBENCHMARK suite for the hot paths of the importer and the geometry code.
+ * Synthetic scenes are generated once in the temp directory. Their maximum
+ * size is set with the CADRENDER_BENCH_MAX_PATCHES environment variable
+ * (default 10^6, use 10^7 for the full range).
+ */
+class CoreBenchmark : public QObject
+{
+    Q_OBJECT
+
+private slots:
+
+    void initTestCase();
+
+    // --- Importer ------------------------------------------------------------
+
+    void importScene_data();
+    void importScene();
+
+    void parseScene_data();
+    void parseScene();
+
+    void countScene_data();
+    void countScene();
+
+    void importAllocations_data();
+    void importAllocations();
+
+    void parseHeapUsage_data();
+    void parseHeapUsage();
+
+    void parseVertex();
+
+    void parsePatch();
+
+    void tokenizerToFloat();
+
+    // --- Geometry ------------------------------------------------------------
+
+    void interpolateTriCenterPoint();
+
+    void boundingBox_data();
+    void boundingBox();
+
+    void patchFlatness_data();
+    void patchFlatness();
+
+    void subdivideScene();
+
+    void patchInvariants();
+
+    void powerBasis();
+
+    void buildEdgeTable_data();
+    void buildEdgeTable();
+
+    // --- Tessellation --------------------------------------------------------
+
+    void evaluateTriangle();
+
+    void evaluatePowerBasis();
+
+    void tessellateTriangle_data();
+    void tessellateTriangle();
+
+    void tessellateScene_data();
+    void tessellateScene();
+
+    void tessellateSceneParallel_data();
+    void tessellateSceneParallel();
+
+    // --- Spatial queries -----------------------------------------------------
+
+    void buildBVH_data();
+    void buildBVH();
+
+    void buildLOD_data();
+    void buildLOD();
+
+    void pickPatch_data();
+    void pickPatch();
+
+    void cullScene_data();
+    void cullScene();
+
+    void cullSceneLod_data();
+    void cullSceneLod();
+
+private:
+
+    void addSceneRows(bool includeBinary);
+
+    QList<int> _syntheticSizes;
+
+    /// Control points of all patches of the largest bundled scene
+    QVector<QVector4D> _controlPoints;
+
+};
+
+Q_DECLARE_METATYPE(BezierSceneImporter::ParseMode)
+
+namespace {
+
+struct ModeRow {
+    const char *name;
+    BezierSceneImporter::ParseMode mode;
+};
+
+const ModeRow PARSE_MODES[] = {
+    {"text", BezierSceneImporter::TextStream},
+    {"mapped", BezierSceneImporter::MemoryMapped},
+    {"parallel", BezierSceneImporter::ParallelMemoryMapped}
+};
+
+/// Patches of the scenes of importAllocations, ten times apart
+const int ALLOCATION_SMALL_SCENE = 10000;
+const int ALLOCATION_LARGE_SCENE = 100000;
+
+/// Allocations of a chunk of the parallel parse: its arrays and its task
+const quint64 MAX_CHUNK_ALLOCATIONS = 16;
+
+QStringList bundledScenes() {
+    return QDir(SCENE_DIR).entryList(QStringList() << "*.bezier", QDir::Files, QDir::Name);
+}
+
+} // namespace
+
+// -----------------------------------------------------------------------------
+// -- Setup --------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+void CoreBenchmark::initTestCase() {
+    bool ok = false;
+    int maxPatches = qEnvironmentVariableIntValue("CADRENDER_BENCH_MAX_PATCHES", &ok);
+    if (!ok) {
+        maxPatches = 1000000;
+    }
+    for (int size = 10000; size <= maxPatches && size <= 10000000; size *= 10) {
+        _syntheticSizes << size;
+    }
+
+    BezierSceneData data;
+    BezierSceneImporter importer;
+    QVERIFY(importer.importBezierSceneData(QDir(SCENE_DIR).filePath("teapot.bezier"), data));
+    data.patches.forEachTriangle([this](int, const QVector4D *controlPoints) {
+        for (int i = 0; i < BezierTriangle::NUM_CONTROL_POINTS; ++i) {
+            _controlPoints += controlPoints[i];
+        }
+    });
+}
+
+void CoreBenchmark::addSceneRows(bool includeBinary) {
+    QTest::addColumn<QString>("fileName");
+    QTest::addColumn<BezierSceneImporter::ParseMode>("mode");
+
+    for (const QString &scene : bundledScenes()) {
+        for (const ModeRow &mode : PARSE_MODES) {
+            QTest::newRow(qPrintable(scene + ":" + mode.name))
+                    << QDir(SCENE_DIR).filePath(scene) << mode.mode;
+        }
+    }
+    for (int size : _syntheticSizes) {
+        for (const ModeRow &mode : PARSE_MODES) {
+            QTest::newRow(qPrintable(QString("synthetic_%1:%2").arg(size).arg(mode.name)))
+                    << SyntheticScene::cachedScene(size) << mode.mode;
+        }
+        if (includeBinary) {
+            QTest::newRow(qPrintable(QString("synthetic_%1:binary").arg(size)))
+                    << SyntheticScene::cachedScene(size, true)
+                    << BezierSceneImporter::MemoryMapped;
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+// -- Importer -----------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+void CoreBenchmark::importScene_data() {
+    addSceneRows(true);
+}
+
+void CoreBenchmark::importScene() {
+    QFETCH(QString, fileName);
+    QFETCH(BezierSceneImporter::ParseMode, mode);
+    QVERIFY(!fileName.isEmpty());
+
+    QBENCHMARK {
+        BezierSceneData data;
+        BezierSceneImporter importer;
+        QVERIFY(importer.importBezierSceneData(fileName, data, mode));
+    }
+}
+
+void CoreBenchmark::parseScene_data() {
+    QTest::addColumn<QString>("fileName");
+    for (const QString &scene : bundledScenes()) {
+        QTest::newRow(qPrintable(scene)) << QDir(SCENE_DIR).filePath(scene);
+    }
+    for (int size : _syntheticSizes) {
+        QTest::newRow(qPrintable(QString("synthetic_%1").arg(size)))
+                << SyntheticScene::cachedScene(size);
+    }
+}
+
+void CoreBenchmark::parseScene() {
+    QFETCH(QString, fileName);
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::ReadOnly | QIODevice::Text));
+
+    // Parse only, without opening the file or creating patches
+    QBENCHMARK {
+        file.seek(0);
+        QTextStream in(&file);
+        BezierSceneData data;
+        BezierSceneImporter importer;
+        importer.parseScene(in, data);
+    }
+}
+
+void CoreBenchmark::countScene_data() {
+    parseScene_data();
+}
+
+void CoreBenchmark::countScene() {
+    QFETCH(QString, fileName);
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    const uchar *mapped = file.map(0, file.size());
+    QVERIFY(mapped);
+    const char *begin = reinterpret_cast<const char *>(mapped);
+
+    // The first pass of the mapped importers, which sizes the arrays
+    BezierSceneImporter::SceneCounts counts;
+    QBENCHMARK {
+        counts = BezierSceneImporter::countScene(begin, begin + file.size());
+    }
+    QVERIFY(counts.numVertices > 0);
+}
+
+void CoreBenchmark::importAllocations_data() {
+    QTest::addColumn<BezierSceneImporter::ParseMode>("mode");
+    QTest::newRow("mapped") << BezierSceneImporter::MemoryMapped;
+    QTest::newRow("parallel") << BezierSceneImporter::ParallelMemoryMapped;
+}
+
+void CoreBenchmark::importAllocations() {
+    QFETCH(BezierSceneImporter::ParseMode, mode);
+    if (!AllocationCounter::isSupported()) {
+        QSKIP("Allocations are only counted with glibc");
+    }
+
+    // Only the parse, like parseHeapUsage, the patches, hierarchy and edge
+    // table of an import allocate per patch
+    QFile files[2];
+    quint64 numAllocations[2];
+    const int sizes[] = {ALLOCATION_SMALL_SCENE, ALLOCATION_LARGE_SCENE};
+    for (int i = 0; i < 2; ++i) {
+        files[i].setFileName(SyntheticScene::cachedScene(sizes[i]));
+        QVERIFY(files[i].open(QIODevice::ReadOnly));
+        const uchar *mapped = files[i].map(0, files[i].size());
+        QVERIFY(mapped);
+        const char *begin = reinterpret_cast<const char *>(mapped);
+        const char *end = begin + files[i].size();
+
+        // The first parse also starts the pool threads
+        if (i == 0) {
+            BezierSceneData data;
+            BezierSceneImporter().parseParallelScene(begin, end, data);
+        }
+
+        const quint64 before = AllocationCounter::numAllocations();
+        {
+            BezierSceneData data;
+            BezierSceneImporter importer;
+            if (mode == BezierSceneImporter::ParallelMemoryMapped) {
+                importer.parseParallelScene(begin, end, data);
+            } else {
+                importer.parseMappedScene(begin, end, data);
+            }
+            QCOMPARE(data.indices.size(), 10 * sizes[i]);
+        }
+        numAllocations[i] = AllocationCounter::numAllocations() - before;
+    }
+    qInfo() << sizes[0] << "patches:" << numAllocations[0] << "allocations,"
+            << sizes[1] << "patches:" << numAllocations[1] << "allocations";
+
+    // The parallel parse splits larger files into more chunks, up to four
+    // per thread, each allocates its own arrays
+    if (mode == BezierSceneImporter::ParallelMemoryMapped) {
+        const quint64 maxChunks = 4 * std::max(1, QThread::idealThreadCount());
+        QVERIFY(numAllocations[1] <= numAllocations[0] +
+                maxChunks * MAX_CHUNK_ALLOCATIONS);
+    } else {
+        QCOMPARE(numAllocations[1], numAllocations[0]);
+    }
+    QTest::setBenchmarkResult(numAllocations[1], QTest::Events);
+}
+
+void CoreBenchmark::parseHeapUsage_data() {
+    addSceneRows(false);
+}
+
+void CoreBenchmark::parseHeapUsage() {
+    QFETCH(QString, fileName);
+    QFETCH(BezierSceneImporter::ParseMode, mode);
+    if (!AllocationCounter::isSupported()) {
+        QSKIP("Heap usage is only measured with glibc");
+    }
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    const uchar *mapped = file.map(0, file.size());
+    QVERIFY(mapped);
+    const char *begin = reinterpret_cast<const char *>(mapped);
+    const char *end = begin + file.size();
+
+    // Overhead is everything the parsed arrays keep on the heap beyond their
+    // contents: spare capacity, allocator headers and leftovers of the parse
+    BezierSceneData data;
+    BezierSceneImporter importer;
+    const AllocationCounter::HeapUsage before = AllocationCounter::heapUsage();
+    if (mode == BezierSceneImporter::TextStream) {
+        QTextStream in(&file);
+        importer.parseScene(in, data);
+    } else if (mode == BezierSceneImporter::ParallelMemoryMapped) {
+        importer.parseParallelScene(begin, end, data);
+    } else {
+        importer.parseMappedScene(begin, end, data);
+    }
+    const AllocationCounter::HeapUsage after = AllocationCounter::heapUsage();
+
+    const qint64 payload = data.vertices.size() * sizeof(QVector4D) +
+            (data.indices.size() + data.quadIndices.size() +
+             data.centerPoints.size()) * sizeof(unsigned);
+    QVERIFY(payload > 0);
+    const qint64 overhead = static_cast<qint64>(after.inUse - before.inUse) - payload;
+    qInfo() << "Payload:" << payload << "bytes, overhead:" << overhead
+            << "bytes, free heap:" << after.free << "bytes";
+    QTest::setBenchmarkResult(std::max<qint64>(overhead, 0), QTest::BytesAllocated);
+}
+
+void CoreBenchmark::parseVertex() {
+    const QString line("v 1.2345678 -0.5 12.75 0.70710678");
+    const QVector<QStringRef> tokens = line.splitRef(' ');
+    QVector<QVector4D> vertices;
+    vertices.reserve(1000);
+    BezierSceneImporter importer;
+
+    QBENCHMARK {
+        vertices.resize(0);
+        for (int i = 0; i < 1000; ++i) {
+            importer.parseVertex(tokens, vertices);
+        }
+    }
+}
+
+void CoreBenchmark::parsePatch() {
+    const QString line("p 0 1 2 3 4 5 6 7 8");
+    const QVector<QStringRef> tokens = line.splitRef(' ');
+    BezierSceneData data;
+    data.vertices.fill(QVector4D(1, 1, 1, 1), 9);
+    BezierSceneImporter importer;
+
+    QBENCHMARK {
+        data.vertices.resize(9);
+        data.indices.resize(0);
+        data.centerPoints.resize(0);
+        for (int i = 0; i < 1000; ++i) {
+            importer.parsePatch(tokens, data);
+        }
+    }
+}
+
+void CoreBenchmark::tokenizerToFloat() {
+    const QByteArray line("v 1.2345678 -0.5 12.75 0.70710678\n");
+    float sum = 0.0f;
+
+    QBENCHMARK {
+        for (int i = 0; i < 1000; ++i) {
+            BezierSceneTokenizer tokenizer(line.constData(), line.constData() + line.size());
+            tokenizer.nextLine();
+            for (int t = 1; t < 5; ++t) {
+                sum += BezierSceneTokenizer::toFloat(tokenizer.token(t));
+            }
+        }
+    }
+    QVERIFY(sum != 0.0f);
+}
+
+// -----------------------------------------------------------------------------
+// -- Geometry -----------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+void CoreBenchmark::interpolateTriCenterPoint() {
+    const int numPatches = _controlPoints.size() / BezierTriangle::NUM_CONTROL_POINTS;
+    BezierSceneImporter importer;
+    QVector4D sum;
+
+    QBENCHMARK {
+        for (int patch = 0; patch < numPatches; ++patch) {
+            sum += importer.interpolateTriCenterPoint(
+                        _controlPoints.constData() + patch * BezierTriangle::NUM_CONTROL_POINTS);
+        }
+    }
+    QVERIFY(!sum.isNull());
+}
+
+void CoreBenchmark::boundingBox_data() {
+    QTest::addColumn<int>("numPoints");
+    for (int size : QList<int>() << 10000 << 100000 << 1000000) {
+        QTest::newRow(qPrintable(QString::number(size))) << size;
+    }
+}
+
+void CoreBenchmark::boundingBox() {
+    QFETCH(int, numPoints);
+    QVector<QVector3D> points(numPoints);
+    for (int i = 0; i < numPoints; ++i) {
+        points[i] = QVector3D(std::sin(i * 0.1f), std::cos(i * 0.3f), i * 1e-6f);
+    }
+    QMatrix4x4 modelMatrix;
+
+    QBENCHMARK {
+        BezierSceneImporter importer;
+        for (const QVector3D &point : points) {
+            importer.checkMinMax(point);
+        }
+        modelMatrix = importer.calculateModelMatrix();
+    }
+    QVERIFY(!modelMatrix.isIdentity());
+}
+
+void CoreBenchmark::patchFlatness_data() {
+    QTest::addColumn<bool>("useLanes");
+    QTest::newRow("scalar") << false;
+    QTest::newRow("lanes") << true;
+}
+
+void CoreBenchmark::patchFlatness() {
+    QFETCH(bool, useLanes);
+    QVector<unsigned> indices(_controlPoints.size());
+    std::iota(indices.begin(), indices.end(), 0u);
+    const PatchStore patches(_controlPoints, indices);
+    float maxFlatness = 0.0f;
+
+    QBENCHMARK {
+        if (useLanes) {
+            const QVector<float> flatness = PatchSubdivision::relativeFlatness(patches);
+            maxFlatness = *std::max_element(flatness.begin(), flatness.end());
+        } else {
+            patches.forEachTriangle([&maxFlatness](int, const QVector4D *controlPoints) {
+                maxFlatness = std::max(maxFlatness,
+                                       PatchSubdivision::relativeFlatness(controlPoints));
+            });
+        }
+    }
+    QVERIFY(maxFlatness > 0.0f);
+}
+
+void CoreBenchmark::subdivideScene() {
+    BezierSceneData data;
+    BezierSceneImporter importer;
+    QVERIFY(importer.importBezierSceneData(
+                QDir(SCENE_DIR).filePath("extremecurvature.bezier"), data));
+    PatchStore subdivided;
+
+    QBENCHMARK {
+        subdivided = PatchSubdivision::subdivide(data.patches, 0.1f, 5);
+    }
+    QVERIFY(subdivided.size() > data.patches.size());
+}
+
+void CoreBenchmark::patchInvariants() {
+    QVector<unsigned> indices(_controlPoints.size());
+    std::iota(indices.begin(), indices.end(), 0u);
+    const PatchStore patches(_controlPoints, indices);
+    QVector<PatchInvariants> invariants;
+
+    QBENCHMARK {
+        invariants = PatchInvariants::fromPatches(patches);
+    }
+    QCOMPARE(invariants.size(), patches.size());
+}
+
+void CoreBenchmark::powerBasis() {
+    QVector<unsigned> indices(_controlPoints.size());
+    std::iota(indices.begin(), indices.end(), 0u);
+    const PatchStore patches(_controlPoints, indices);
+    QVector<QVector4D> coefficients;
+
+    QBENCHMARK {
+        coefficients = PowerBasis::fromPatches(patches, BezierPatch::TriPatch);
+    }
+    QCOMPARE(coefficients.size(), _controlPoints.size());
+}
+
+void CoreBenchmark::buildEdgeTable_data() {
+    buildBVH_data();
+}
+
+void CoreBenchmark::buildEdgeTable() {
+    QFETCH(QString, fileName);
+    BezierSceneData data;
+    BezierSceneImporter importer;
+    QVERIFY(importer.importBezierSceneData(fileName, data));
+
+    PatchEdgeTable edgeTable;
+    QBENCHMARK {
+        edgeTable.build(data.patches);
+    }
+    QCOMPARE(edgeTable.patchEdges(BezierPatch::TriPatch).size(),
+             3 * data.patches.numPatches(BezierPatch::TriPatch));
+}
+
+// -----------------------------------------------------------------------------
+// -- Tessellation -------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+void CoreBenchmark::evaluateTriangle() {
+    const QVector4D *controlPoints = _controlPoints.constData();
+    QVector3D sum;
+
+    QBENCHMARK {
+        for (int i = 0; i <= 32; ++i) {
+            for (int j = 0; i + j <= 32; ++j) {
+                const QVector3D uvw(i / 32.0f, j / 32.0f, 1.0f - (i + j) / 32.0f);
+                QVector3D normal;
+                sum += BezierTriangleTessellator::evaluate(controlPoints, uvw, &normal);
+            }
+        }
+    }
+    QVERIFY(!sum.isNull());
+}
+
+void CoreBenchmark::evaluatePowerBasis() {
+    QVector4D coefficients[BezierTriangle::NUM_CONTROL_POINTS];
+    PowerBasis::fromTriangle(_controlPoints.constData(), coefficients);
+    QVector4D sum;
+
+    // Same samples as evaluateTriangle
+    QBENCHMARK {
+        for (int i = 0; i <= 32; ++i) {
+            for (int j = 0; i + j <= 32; ++j) {
+                sum += PowerBasis::evaluate(BezierPatch::TriPatch, coefficients,
+                                            i / 32.0f, j / 32.0f);
+            }
+        }
+    }
+    QVERIFY(!sum.isNull());
+}
+
+void CoreBenchmark::tessellateTriangle_data() {
+    QTest::addColumn<int>("level");
+    for (int level : QList<int>() << 1 << 4 << 8 << 16 << 32 << 64) {
+        QTest::newRow(qPrintable(QString("level_%1").arg(level))) << level;
+    }
+}
+
+void CoreBenchmark::tessellateTriangle() {
+    QFETCH(int, level);
+    BezierTriangleTessellator tessellator;
+    BezierTriangleTessellator::Mesh mesh;
+    const BezierTriangleTessellator::Levels levels(level);
+
+    QBENCHMARK {
+        mesh.clear();
+        tessellator.tessellate(_controlPoints.constData(), levels, mesh);
+    }
+    QVERIFY(mesh.numTriangles() > 0);
+}
+
+void CoreBenchmark::tessellateScene_data() {
+    QTest::addColumn<QString>("fileName");
+    QTest::addColumn<int>("level");
+    for (int size : _syntheticSizes) {
+        // Keep the mesh within a few GB
+        if (size > 1000000) continue;
+        for (int level : QList<int>() << 4 << 8) {
+            QTest::newRow(qPrintable(QString("synthetic_%1:level_%2").arg(size).arg(level)))
+                    << SyntheticScene::cachedScene(size, true) << level;
+        }
+    }
+}
+
+void CoreBenchmark::tessellateScene() {
+    QFETCH(QString, fileName);
+    QFETCH(int, level);
+    BezierSceneData data;
+    BezierSceneImporter importer;
+    QVERIFY(importer.importBezierSceneData(fileName, data));
+
+    BezierTriangleTessellator tessellator;
+    BezierTriangleTessellator::Mesh mesh;
+    QBENCHMARK {
+        mesh.clear();
+        tessellator.tessellate(data.patches, BezierTriangleTessellator::Levels(level), mesh);
+    }
+    QVERIFY(mesh.numTriangles() > 0);
+}
+
+void CoreBenchmark::tessellateSceneParallel_data() {
+    QTest::addColumn<QString>("fileName");
+    QTest::addColumn<int>("numWorkers");
+    const int maxWorkers = QThreadPool::globalInstance()->maxThreadCount();
+    for (int size : _syntheticSizes) {
+        if (size > 1000000) continue;
+        for (int workers = 1; workers < 2 * maxWorkers; workers *= 2) {
+            const int numWorkers = std::min(workers, maxWorkers);
+            QTest::newRow(qPrintable(QString("synthetic_%1:workers_%2").arg(size).arg(numWorkers)))
+                    << SyntheticScene::cachedScene(size, true) << numWorkers;
+        }
+    }
+}
+
+void CoreBenchmark::tessellateSceneParallel() {
+    QFETCH(QString, fileName);
+    QFETCH(int, numWorkers);
+    BezierSceneData data;
+    BezierSceneImporter importer;
+    QVERIFY(importer.importBezierSceneData(fileName, data));
+
+    // Curvature levels range from 1 to the maximum, an uneven load
+    TessellationHeuristic::Settings settings;
+    settings.edgeHeuristic = TessellationHeuristic::Curvature;
+    settings.faceHeuristic = TessellationHeuristic::Curvature;
+    settings.maxLevel = 16;
+    const TessellationHeuristic heuristic(settings);
+    ParallelTessellator tessellator(heuristic);
+    tessellator.setNumWorkers(numWorkers);
+
+    BezierTriangleTessellator::Mesh mesh;
+    QBENCHMARK {
+        tessellator.tessellate(data.patches, mesh);
+    }
+    QVERIFY(mesh.numTriangles() > 0);
+}
+
+// -----------------------------------------------------------------------------
+// -- Spatial queries ----------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+void CoreBenchmark::buildBVH_data() {
+    QTest::addColumn<QString>("fileName");
+    for (int size : _syntheticSizes) {
+        QTest::newRow(qPrintable(QString("synthetic_%1").arg(size)))
+                << SyntheticScene::cachedScene(size, true);
+    }
+}
+
+void CoreBenchmark::buildBVH() {
+    QFETCH(QString, fileName);
+    BezierSceneData data;
+    BezierSceneImporter importer;
+    QVERIFY(importer.importBezierSceneData(fileName, data));
+
+    PatchBVH bvh;
+    QBENCHMARK {
+        bvh.build(data.patchBounds);
+    }
+    QCOMPARE(bvh.numPatches(), data.patches.size());
+}
+
+void CoreBenchmark::buildLOD_data() {
+    buildBVH_data();
+}
+
+void CoreBenchmark::buildLOD() {
+    QFETCH(QString, fileName);
+    BezierSceneData data;
+    BezierSceneImporter importer;
+    QVERIFY(importer.importBezierSceneData(fileName, data));
+
+    PatchLOD lod;
+    QBENCHMARK {
+        lod.build(data.patches, data.bvh);
+    }
+    QVERIFY(!lod.isEmpty());
+}
+
+void CoreBenchmark::pickPatch_data() {
+    buildBVH_data();
+}
+
+void CoreBenchmark::pickPatch() {
+    QFETCH(QString, fileName);
+    BezierSceneData data;
+    BezierSceneImporter importer;
+    QVERIFY(importer.importBezierSceneData(fileName, data));
+
+    // Straight down onto the middle of the synthetic grid
+    const QVector3D center = 0.5f * (data.minValues + data.maxValues);
+    const QVector3D origin(center.x() + 0.3f, center.y() + 0.2f, 10.0f);
+    const QVector3D direction(0.0f, 0.0f, -1.0f);
+
+    int patch = -1;
+    QBENCHMARK {
+        patch = data.bvh.pick(data.patches, origin, direction);
+    }
+    QVERIFY(patch >= 0);
+}
+
+void CoreBenchmark::cullScene_data() {
+    QTest::addColumn<QString>("fileName");
+    QTest::addColumn<bool>("useBVH");
+    for (int size : _syntheticSizes) {
+        const QString fileName = SyntheticScene::cachedScene(size, true);
+        QTest::newRow(qPrintable(QString("synthetic_%1:linear").arg(size))) << fileName << false;
+        QTest::newRow(qPrintable(QString("synthetic_%1:bvh").arg(size))) << fileName << true;
+    }
+}
+
+void CoreBenchmark::cullScene() {
+    QFETCH(QString, fileName);
+    QFETCH(bool, useBVH);
+    BezierSceneData data;
+    BezierSceneImporter importer;
+    QVERIFY(importer.importBezierSceneData(fileName, data));
+
+    // Zoomed in on a corner of the grid, most patches are off screen
+    QMatrix4x4 modelView, projection;
+    modelView.lookAt(QVector3D(data.minValues.x() + 10, data.minValues.y() + 10, 8),
+                     QVector3D(data.minValues.x() + 10, data.minValues.y() + 10, 0),
+                     QVector3D(0, 1, 0));
+    projection.perspective(60, 4.0f / 3.0f, 0.1f, 100.0f);
+
+    PatchCuller culler;
+    culler.setFlags(PatchCuller::CullFrustum | PatchCuller::CullBackPatches);
+    culler.setView(modelView, projection);
+    QVector<PatchCuller::Run> runs;
+    int numVisible = 0;
+    QBENCHMARK {
+        numVisible = useBVH ?
+                    culler.cull(data.bvh, data.patchBounds, runs) :
+                    culler.cull(data.patchBounds, runs);
+    }
+    QVERIFY(numVisible > 0);
+}
+
+void CoreBenchmark::cullSceneLod_data() {
+    QTest::addColumn<QString>("fileName");
+    QTest::addColumn<bool>("useLod");
+    for (int size : _syntheticSizes) {
+        const QString fileName = SyntheticScene::cachedScene(size, true);
+        QTest::newRow(qPrintable(QString("synthetic_%1:patches").arg(size))) << fileName << false;
+        QTest::newRow(qPrintable(QString("synthetic_%1:lod").arg(size))) << fileName << true;
+    }
+}
+
+void CoreBenchmark::cullSceneLod() {
+    QFETCH(QString, fileName);
+    QFETCH(bool, useLod);
+    BezierSceneData data;
+    BezierSceneImporter importer;
+    QVERIFY(importer.importBezierSceneData(fileName, data));
+
+    // The whole grid in view, the far side is small on screen
+    const QVector3D center = 0.5f * (data.minValues + data.maxValues);
+    const QVector3D extent = data.maxValues - data.minValues;
+    QMatrix4x4 modelView, projection;
+    modelView.lookAt(QVector3D(center.x(), data.minValues.y() - 0.5f * extent.y(),
+                               0.5f * extent.x()),
+                     center, QVector3D(0, 0, 1));
+    projection.perspective(60, 4.0f / 3.0f, 0.1f, 100.0f);
+
+    PatchCuller culler;
+    culler.setView(modelView, projection);
+    culler.setLod(&data.lod, 1.0f, 768);
+    QVector<PatchCuller::Run> runs;
+    QVector<int> proxies;
+    int numVisible = 0;
+    QBENCHMARK {
+        numVisible = culler.cull(data.bvh, data.patchBounds, runs,
+                                 useLod ? &proxies : nullptr);
+    }
+    QVERIFY(numVisible > 0 || !proxies.isEmpty());
+    if (useLod) {
+        qInfo() << numVisible << "patches and" << proxies.size() << "proxies";
+    }
+}
+
+
+QTEST_GUILESS_MAIN(CoreBenchmark)
+
+#include "corebenchmark.moc"
@@ -0,0 +1,108 @@
+#include "syntheticscene.h"
+
+#include <util/beziersceneimporter.h>
+#include <util/binarysceneformat.h>
+
+#include <QByteArray>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QtDebug>
+
+#include <cmath>
+#include <cstdio>
+
+namespace {
+
+/// Barycentric exponents (u, v, w) of the nine stored control points
+const int CONTROL_POINTS[9][3] = {
+    {0, 0, 3}, {1, 0, 2}, {2, 0, 1}, {3, 0, 0}, {2, 1, 0},
+    {1, 2, 0}, {0, 3, 0}, {0, 2, 1}, {0, 1, 2}
+};
+
+} // namespace
+
+// -----------------------------------------------------------------------------
+// -- Other Methods ------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+// --- Public ------------------------------------------------------------------
+
+bool SyntheticScene::write(const QString &fileName, int numPatches)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Could not open" << fileName << "for writing";
+        return false;
+    }
+
+    const int columns = std::max(1, static_cast<int>(std::sqrt(numPatches / 2.0)));
+    QByteArray block;
+    block.reserve(1 << 21);
+    block.append("# Synthetic benchmark scene\n");
+    char line[160];
+
+    for (int patch = 0; patch < numPatches; ++patch) {
+        // Two triangles per grid cell, the second one is flipped
+        const int cell = patch / 2;
+        const bool flipped = patch % 2 == 1;
+        const float x0 = cell % columns;
+        const float y0 = cell / columns;
+
+        for (const int *exponents : CONTROL_POINTS) {
+            const float u = exponents[0] / 3.0f;
+            const float v = exponents[1] / 3.0f;
+            const float x = flipped ? x0 + 1.0f - v : x0 + u;
+            const float y = flipped ? y0 + 1.0f - u : y0 + v;
+            const float z = 0.25f * std::sin(x * 0.7f) * std::cos(y * 0.9f);
+            // Inner edge points are rational
+            const bool isCorner = exponents[0] == 3 || exponents[1] == 3 || exponents[2] == 3;
+            const float w = isCorner ? 1.0f : 0.8f;
+            const int size = std::snprintf(line, sizeof(line), "v %.6f %.6f %.6f %.6f\n",
+                                           x * w, y * w, z * w, w);
+            block.append(line, size);
+        }
+        const unsigned first = patch * 9;
+        const int size = std::snprintf(line, sizeof(line), "p %u %u %u %u %u %u %u %u %u\n",
+                                       first, first + 1, first + 2, first + 3, first + 4,
+                                       first + 5, first + 6, first + 7, first + 8);
+        block.append(line, size);
+
+        if (block.size() > (1 << 20)) {
+            if (file.write(block) != block.size()) return false;
+            block.resize(0);
+        }
+    }
+    return file.write(block) == block.size();
+}
+
+QString SyntheticScene::cachedScene(int numPatches, bool binary)
+{
+    QDir dir(QDir::temp().filePath("cadrender-bench"));
+    if (!dir.exists() && !QDir::temp().mkpath("cadrender-bench")) {
+        return QString();
+    }
+    const QString textName = dir.filePath(QString("synthetic_%1.bezier").arg(numPatches));
+    if (!QFileInfo(textName).exists()) {
+        qInfo() << "Generating" << textName;
+        if (!write(textName, numPatches)) {
+            QFile::remove(textName);
+            return QString();
+        }
+    }
+    if (!binary) {
+        return textName;
+    }
+
+    const QString binaryName = dir.filePath(QString("synthetic_%1.bezierbin").arg(numPatches));
+    if (!QFileInfo(binaryName).exists()) {
+        BezierSceneData data;
+        BezierSceneImporter importer;
+        if (!importer.importBezierSceneData(textName, data,
+                                            BezierSceneImporter::ParallelMemoryMapped) ||
+                !BinarySceneFormat::write(binaryName, data)) {
+            return QString();
+        }
+    }
+    return binaryName;
+}
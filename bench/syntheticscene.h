@@ -0,0 +1,30 @@
+#ifndef SYNTHETICSCENE_H
+#define SYNTHETICSCENE_H
+
+#include <QString>
+
+/*!
+ * \brief The SyntheticScene class
+ *
+ * Generates .bezier scenes of arbitrary size for benchmarking. The patches
+ * form a wavy grid of rational triangles without center points, so the
+ * importer also has to interpolate B111 for every patch.
+ */
+class SyntheticScene
+{
+
+    // =========================================================================
+    // -- Other methods --------------------------------------------------------
+    // =========================================================================
+
+public:
+
+    /// Writes a scene with numPatches triangles, returns false on failure
+    static bool write(const QString &fileName, int numPatches);
+
+    /// Path of a cached scene in the temp directory, generated if needed
+    static QString cachedScene(int numPatches, bool binary = false);
+
+};
+
+#endif // SYNTHETICSCENE_H
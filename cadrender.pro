@@ -22,26 +22,20 @@ DEFINES += QT_DEPRECATED_WARNINGS
 # You can also select to disable deprecated APIs only up to a certain version of Qt.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
+include(core.pri)
+
 SOURCES += main.cpp \
     ui/mainwindow.cpp \
-    geom/bezierpatch.cpp \
     ui/mainview.cpp \
-    geom/beziertriangle.cpp \
-    gl/bezierscene.cpp \
-    util/beziersceneimporter.cpp
+    ui/profileroverlay.cpp
 
 
 HEADERS += ui/mainwindow.h \
-    geom/bezierpatch.h \
     ui/mainview.h \
-    geom/beziertriangle.h \
-    gl/bezierscene.h \
-    util/beziersceneimporter.h
+    ui/profileroverlay.h
 
 
 FORMS += ui/mainwindow.ui
 
 RESOURCES += \
     resources.qrc
-
-INCLUDEPATH += $$PWD/
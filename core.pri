@@ -0,0 +1,65 @@
+# Scene, geometry and OpenGL sources shared by the cadrender application
+# and the command line tools in tools/
+
+QT += core gui concurrent
+
+INCLUDEPATH += $$PWD/
+
+SOURCES += \
+    $$PWD/geom/bezierpatch.cpp \
+    $$PWD/geom/bezierquad.cpp \
+    $$PWD/geom/beziertriangle.cpp \
+    $$PWD/geom/beziertriangletessellator.cpp \
+    $$PWD/geom/paralleltessellator.cpp \
+    $$PWD/geom/patchbounds.cpp \
+    $$PWD/geom/patchbvh.cpp \
+    $$PWD/geom/patchculler.cpp \
+    $$PWD/geom/patchedgetable.cpp \
+    $$PWD/geom/patchinvariants.cpp \
+    $$PWD/geom/patchlod.cpp \
+    $$PWD/geom/patchstore.cpp \
+    $$PWD/geom/patchsubdivision.cpp \
+    $$PWD/geom/powerbasis.cpp \
+    $$PWD/geom/tessellationheuristic.cpp \
+    $$PWD/gl/bezierscene.cpp \
+    $$PWD/gl/gpuqueryring.cpp \
+    $$PWD/gl/scenepager.cpp \
+    $$PWD/gl/shadersource.cpp \
+    $$PWD/util/beziersceneimporter.cpp \
+    $$PWD/util/bezierscenetokenizer.cpp \
+    $$PWD/util/binarysceneformat.cpp \
+    $$PWD/util/dirtyrangetracker.cpp \
+    $$PWD/util/meshwriter.cpp \
+    $$PWD/util/pagedsceneformat.cpp \
+    $$PWD/util/profiler.cpp
+
+HEADERS += \
+    $$PWD/geom/bezierpatch.h \
+    $$PWD/geom/bezierquad.h \
+    $$PWD/geom/beziertriangle.h \
+    $$PWD/geom/beziertriangletessellator.h \
+    $$PWD/geom/parallelfor.h \
+    $$PWD/geom/paralleltessellator.h \
+    $$PWD/geom/patchbounds.h \
+    $$PWD/geom/patchbvh.h \
+    $$PWD/geom/patchculler.h \
+    $$PWD/geom/patchedgetable.h \
+    $$PWD/geom/patchinvariants.h \
+    $$PWD/geom/patchlod.h \
+    $$PWD/geom/patchstore.h \
+    $$PWD/geom/patchsubdivision.h \
+    $$PWD/geom/powerbasis.h \
+    $$PWD/geom/simdlane.h \
+    $$PWD/geom/tessellationheuristic.h \
+    $$PWD/gl/bezierscene.h \
+    $$PWD/gl/gpuqueryring.h \
+    $$PWD/gl/scenepager.h \
+    $$PWD/gl/shadersource.h \
+    $$PWD/util/bezierscenedata.h \
+    $$PWD/util/beziersceneimporter.h \
+    $$PWD/util/bezierscenetokenizer.h \
+    $$PWD/util/binarysceneformat.h \
+    $$PWD/util/dirtyrangetracker.h \
+    $$PWD/util/meshwriter.h \
+    $$PWD/util/pagedsceneformat.h \
+    $$PWD/util/profiler.h
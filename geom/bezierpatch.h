@@ -20,7 +20,8 @@ public:
 
     enum Type {
         TriPatch,
-        QuadPatch
+        QuadPatch,
+        NUM_PATCH_TYPES
     };
 
     // =========================================================================
@@ -0,0 +1,28 @@
+#include <geom/bezierquad.h>
+
+BezierQuad::BezierQuad(const QVector<QVector4D> &controlPoints) {
+    Q_ASSERT(controlPoints.length() == NUM_CONTROL_POINTS);
+    _controlPoints = controlPoints;
+}
+
+BezierQuad::~BezierQuad() {
+
+}
+
+QVector3D BezierQuad::evaluate(const QVector4D *controlPoints, float u, float v) {
+    const float s = 1.0f - u;
+    const float t = 1.0f - v;
+    const float bu[4] = { s * s * s, 3.0f * u * s * s, 3.0f * u * u * s, u * u * u };
+    const float bv[4] = { t * t * t, 3.0f * v * t * t, 3.0f * v * v * t, v * v * v };
+
+    // Homogeneous sum, the weights are part of the control points
+    QVector4D point;
+    for (int j = 0; j < 4; ++j) {
+        QVector4D row;
+        for (int i = 0; i < 4; ++i) {
+            row += bu[i] * controlPoints[index(i, j)];
+        }
+        point += bv[j] * row;
+    }
+    return point.toVector3D() / point.w();
+}
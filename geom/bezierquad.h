@@ -0,0 +1,66 @@
+#ifndef BEZIERQUAD_H
+#define BEZIERQUAD_H
+
+#include <geom/bezierpatch.h>
+
+#include <QVector3D>
+
+/*!
+ * \brief The BezierQuad class
+ *
+ * Rational bicubic tensor product patch. Control points are stored row by
+ * row, B_ij at index 4 * j + i, with i along u and j along v.
+ */
+class BezierQuad : public BezierPatch
+{
+public:
+
+    // =========================================================================
+    // -- Enums ----------------------------------------------------------------
+    // =========================================================================
+
+    enum ControlPoints {
+        B00 = 0,
+        B30 = 3,
+        B03 = 12,
+        B33 = 15,
+        NUM_CONTROL_POINTS = 16
+    };
+
+    // =========================================================================
+    // -- Constructors and destructor ------------------------------------------
+    // =========================================================================
+
+public:
+
+    BezierQuad(const QVector<QVector4D> &controlPoints);
+
+    virtual ~BezierQuad();
+
+    // =========================================================================
+    // -- Other methods --------------------------------------------------------
+    // =========================================================================
+
+public:
+
+    virtual unsigned getNumControlPoints() const override {
+        return NUM_CONTROL_POINTS;
+    }
+
+    virtual const QVector<QVector4D> &getControlPoints() const override {
+        return _controlPoints;
+    }
+
+    virtual Type getPatchType() const override {
+        return QuadPatch;
+    }
+
+    static int index(int i, int j) {
+        return 4 * j + i;
+    }
+
+    /// Point at (u, v), in the same domain as quad_tess_eval.glsl
+    static QVector3D evaluate(const QVector4D *controlPoints, float u, float v);
+};
+
+#endif // BEZIERQUAD_H
@@ -8,3 +8,23 @@ BezierTriangle::BezierTriangle(const QVector<QVector4D> &controlPoints) {
 BezierTriangle::~BezierTriangle() {
 
 }
+
+const QVector4D BezierTriangle::interpolateCenterPoint(const QVector4D *controlPoints) {
+    const QVector4D UV003 = controlPoints[B003];
+    const QVector4D UV102 = controlPoints[B102];
+    const QVector4D UV201 = controlPoints[B201];
+    const QVector4D UV300 = controlPoints[B300];
+    const QVector4D UV210 = controlPoints[B210];
+    const QVector4D UV120 = controlPoints[B120];
+    const QVector4D UV030 = controlPoints[B030];
+    const QVector4D UV021 = controlPoints[B021];
+    const QVector4D UV012 = controlPoints[B012];
+
+    // Midpoints are interpolated using: G. Farin
+    // Curves and Surfaces for CAGD, p. 342
+    const QVector4D UV111 =
+            1.0/4.0 * (UV201 + UV102 + UV021 + UV012 + UV210 + UV120)
+            -  1.0/6.0 * (UV300 + UV030 + UV003);
+
+    return UV111;
+}
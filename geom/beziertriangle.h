@@ -52,6 +52,20 @@ public:
     virtual Type getPatchType() const override {
         return TriPatch;
     }
+
+    /// Control point with u exponent i and v exponent j, -1 if i + j > 3
+    static int index(int i, int j) {
+        static const int INDEX[4][4] = {
+            { B003, B012, B021, B030 },
+            { B102, B111, B120, -1 },
+            { B201, B210, -1, -1 },
+            { B300, -1, -1, -1 }
+        };
+        return INDEX[i][j];
+    }
+
+    /// Interpolates B111 from the other nine control points
+    static const QVector4D interpolateCenterPoint(const QVector4D *controlPoints);
 };
 
 #endif // BEZIERTRIANGLE_H
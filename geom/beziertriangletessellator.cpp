@@ -0,0 +1,444 @@
+#include <geom/beziertriangletessellator.h>
+#include <geom/simdlane.h>
+
+#include <QtAlgorithms>
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+using namespace SimdLane;
+
+// --- Quadratic sub triangles -------------------------------------------------
+
+/// Quadratic Bernstein polynomials u^2, v^2, w^2, 2uv, 2uw, 2vw
+const int NUM_QUADRATIC = 6;
+
+/// The last de Casteljau step interpolates the quadratic triangles a, b and c.
+/// Their control points are the cubic control points with a w, u or v
+/// exponent of at least one, listed in the order of the quadratic basis.
+const int SUB_TRIANGLES[3][NUM_QUADRATIC] = {
+    // a: w >= 1
+    {BezierTriangle::B201, BezierTriangle::B021, BezierTriangle::B003,
+     BezierTriangle::B111, BezierTriangle::B102, BezierTriangle::B012},
+    // b: u >= 1
+    {BezierTriangle::B300, BezierTriangle::B120, BezierTriangle::B102,
+     BezierTriangle::B210, BezierTriangle::B201, BezierTriangle::B111},
+    // c: v >= 1
+    {BezierTriangle::B210, BezierTriangle::B030, BezierTriangle::B012,
+     BezierTriangle::B120, BezierTriangle::B111, BezierTriangle::B021}
+};
+
+/// Interpolate three 4D points with barycentric coordinates uvw
+inline QVector4D interpolate4DUVW(
+        const QVector3D &uvw,
+        const QVector4D &v0,
+        const QVector4D &v1,
+        const QVector4D &v2) {
+    return uvw.z() * v0 + uvw.x() * v1 + uvw.y() * v2;
+}
+
+inline QVector3D projectTo3D(const QVector4D &v) {
+    return v.toVector3D() / v.w();
+}
+
+inline QVector4D mix(const QVector4D &a, const QVector4D &b, float t) {
+    return a + (b - a) * t;
+}
+
+/// Float array with SIMD alignment
+class AlignedFloats
+{
+public:
+    AlignedFloats() : _data(nullptr), _size(0) {}
+
+    void resize(int size) {
+        _storage.fill(0.0f, size + SIMD_ALIGNMENT / sizeof(float));
+        const quintptr address = reinterpret_cast<quintptr>(_storage.data());
+        const quintptr offset = (SIMD_ALIGNMENT - address % SIMD_ALIGNMENT) % SIMD_ALIGNMENT;
+        _data = _storage.data() + offset / sizeof(float);
+        _size = size;
+    }
+
+    float *data() { return _data; }
+    const float *data() const { return _data; }
+    float &operator[](int i) { return _data[i]; }
+    float operator[](int i) const { return _data[i]; }
+    int size() const { return _size; }
+
+private:
+    Q_DISABLE_COPY(AlignedFloats)
+
+    QVector<float> _storage;
+    float *_data;
+    int _size;
+};
+
+} // namespace
+
+/// Sample positions and triangles for one set of (rounded) levels
+struct BezierTriangleTessellator::Pattern
+{
+    int numVertices;
+
+    /// Number of samples rounded up to the SIMD width
+    int numPadded;
+
+    AlignedFloats u, v, w;
+
+    /// Quadratic basis per sample, NUM_QUADRATIC arrays of numPadded floats
+    AlignedFloats basis;
+
+    QVector<unsigned> indices;
+};
+
+// -----------------------------------------------------------------------------
+// -- Constructors and destructor ----------------------------------------------
+// -----------------------------------------------------------------------------
+
+BezierTriangleTessellator::BezierTriangleTessellator()
+{
+
+}
+
+BezierTriangleTessellator::~BezierTriangleTessellator() {
+    qDeleteAll(_patterns);
+}
+
+// -----------------------------------------------------------------------------
+// -- Other Methods ------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+// --- Public ------------------------------------------------------------------
+
+void BezierTriangleTessellator::Mesh::clear() {
+    vertices.clear();
+    normals.clear();
+    indices.clear();
+}
+
+void BezierTriangleTessellator::tessellate(
+        const QVector4D *controlPoints,
+        const Levels &levels,
+        Mesh &mesh)
+{
+    const Pattern &p = pattern(levels);
+
+    const int firstVertex = mesh.vertices.size();
+    mesh.vertices.resize(firstVertex + p.numVertices);
+    mesh.normals.resize(firstVertex + p.numVertices);
+    QVector3D *vertices = mesh.vertices.data() + firstVertex;
+    QVector3D *normals = mesh.normals.data() + firstVertex;
+
+    const int firstIndex = mesh.indices.size();
+    mesh.indices.resize(firstIndex + p.indices.size());
+    unsigned *indices = mesh.indices.data() + firstIndex;
+    for (int i = 0; i < p.indices.size(); ++i) {
+        indices[i] = p.indices[i] + firstVertex;
+    }
+
+    if (isDegenerate(controlPoints)) {
+        // The cone branch of the shader does not vectorize, evaluate per sample
+        for (int i = 0; i < p.numVertices; ++i) {
+            const QVector3D uvw(p.u[i], p.v[i], p.w[i]);
+            vertices[i] = evaluate(controlPoints, uvw, &normals[i]);
+        }
+        return;
+    }
+
+    // Control points of the three quadratic sub triangles, broadcast to lanes
+    Lane control[3][NUM_QUADRATIC][4];
+    for (int t = 0; t < 3; ++t) {
+        for (int k = 0; k < NUM_QUADRATIC; ++k) {
+            const QVector4D &point = controlPoints[SUB_TRIANGLES[t][k]];
+            for (int c = 0; c < 4; ++c) {
+                control[t][k][c] = set1(point[c]);
+            }
+        }
+    }
+
+    alignas(SIMD_ALIGNMENT) float out[6][LANES];
+    const Lane zero = set1(0.0f);
+
+    for (int s = 0; s < p.numPadded; s += LANES) {
+        // Quadratic triangles a, b and c in homogeneous coordinates
+        Lane quadratic[3][4];
+        for (int t = 0; t < 3; ++t) {
+            for (int c = 0; c < 4; ++c) {
+                quadratic[t][c] = zero;
+            }
+        }
+        for (int k = 0; k < NUM_QUADRATIC; ++k) {
+            const Lane weight = load(p.basis.data() + k * p.numPadded + s);
+            for (int t = 0; t < 3; ++t) {
+                for (int c = 0; c < 4; ++c) {
+                    quadratic[t][c] = add(quadratic[t][c], mul(weight, control[t][k][c]));
+                }
+            }
+        }
+
+        // Final linear step: w * a + u * b + v * c
+        const Lane u = load(p.u.data() + s);
+        const Lane v = load(p.v.data() + s);
+        const Lane w = load(p.w.data() + s);
+        Lane position[4];
+        for (int c = 0; c < 4; ++c) {
+            position[c] = add(add(mul(w, quadratic[0][c]), mul(u, quadratic[1][c])),
+                              mul(v, quadratic[2][c]));
+        }
+
+        // Normal of the projected linear triangle
+        Lane projected[3][3];
+        for (int t = 0; t < 3; ++t) {
+            for (int c = 0; c < 3; ++c) {
+                projected[t][c] = div(quadratic[t][c], quadratic[t][3]);
+            }
+        }
+        Lane ab[3], ac[3];
+        for (int c = 0; c < 3; ++c) {
+            ab[c] = sub(projected[1][c], projected[0][c]);
+            ac[c] = sub(projected[2][c], projected[0][c]);
+        }
+        Lane normal[3];
+        normal[0] = sub(mul(ab[1], ac[2]), mul(ab[2], ac[1]));
+        normal[1] = sub(mul(ab[2], ac[0]), mul(ab[0], ac[2]));
+        normal[2] = sub(mul(ab[0], ac[1]), mul(ab[1], ac[0]));
+        const Lane length = sqrt(add(add(mul(normal[0], normal[0]),
+                                         mul(normal[1], normal[1])),
+                                     mul(normal[2], normal[2])));
+
+        for (int c = 0; c < 3; ++c) {
+            store(out[c], div(position[c], position[3]));
+            store(out[3 + c], div(normal[c], length));
+        }
+
+        const int count = std::min(LANES, p.numVertices - s);
+        for (int lane = 0; lane < count; ++lane) {
+            vertices[s + lane] = QVector3D(out[0][lane], out[1][lane], out[2][lane]);
+            normals[s + lane] = QVector3D(out[3][lane], out[4][lane], out[5][lane]);
+        }
+    }
+}
+
+void BezierTriangleTessellator::tessellate(
+        const BezierTriangle &patch,
+        const Levels &levels,
+        Mesh &mesh)
+{
+    tessellate(patch.getControlPoints().constData(), levels, mesh);
+}
+
+void BezierTriangleTessellator::tessellate(
+        const PatchStore &patches,
+        const Levels &levels,
+        Mesh &mesh)
+{
+    const Pattern &p = pattern(levels);
+    const int numPatches = patches.numPatches(BezierPatch::TriPatch);
+    mesh.vertices.reserve(mesh.vertices.size() + numPatches * p.numVertices);
+    mesh.normals.reserve(mesh.normals.size() + numPatches * p.numVertices);
+    mesh.indices.reserve(mesh.indices.size() + numPatches * p.indices.size());
+
+    patches.forEachTriangle([&](int, const QVector4D *controlPoints) {
+        tessellate(controlPoints, levels, mesh);
+    });
+}
+
+int BezierTriangleTessellator::numVertices(const Levels &levels) {
+    return pattern(levels).numVertices;
+}
+
+int BezierTriangleTessellator::numTriangles(const Levels &levels) {
+    return pattern(levels).indices.size() / 3;
+}
+
+QVector3D BezierTriangleTessellator::evaluate(
+        const QVector4D *cp,
+        const QVector3D &uvw,
+        QVector3D *normal)
+{
+    if (isDegenerate(cp)) {
+        // Triangle contains singularity (cones)
+        const float u = qBound(0.0f, uvw.x() / (1.0f - uvw.y()), 1.0f);
+
+        const QVector3D top = projectTo3D(cp[BezierTriangle::B030]);
+        const QVector3D left = projectTo3D(cp[BezierTriangle::B003]);
+        const QVector3D leftTangent = projectTo3D(cp[BezierTriangle::B102]);
+        const QVector3D right = projectTo3D(cp[BezierTriangle::B300]);
+        const QVector3D rightTangent = projectTo3D(cp[BezierTriangle::B201]);
+
+        // Determine point on the bottom of the cone
+        const QVector4D A = mix(cp[BezierTriangle::B003], cp[BezierTriangle::B102], u);
+        const QVector4D B = mix(cp[BezierTriangle::B102], cp[BezierTriangle::B201], u);
+        const QVector4D C = mix(cp[BezierTriangle::B201], cp[BezierTriangle::B300], u);
+        const QVector4D bottomPoint = mix(mix(A, B, u), mix(B, C, u), u);
+        const QVector4D resultPoint = mix(bottomPoint, cp[BezierTriangle::B030], uvw.y());
+
+        if (normal) {
+            const QVector3D lto = (top - left).normalized();
+            const QVector3D lta = (leftTangent - left).normalized();
+            const QVector3D leftNormal = QVector3D::crossProduct(lta, lto).normalized();
+            const QVector3D rto = (top - right).normalized();
+            const QVector3D rta = (rightTangent - right).normalized();
+            const QVector3D rightNormal = QVector3D::crossProduct(rto, rta).normalized();
+            *normal = (leftNormal + (rightNormal - leftNormal) * u).normalized();
+        }
+        return projectTo3D(resultPoint);
+    }
+
+    // Cubic to quadratic triangle
+    const QVector4D A = interpolate4DUVW(uvw, cp[BezierTriangle::B003],
+            cp[BezierTriangle::B102], cp[BezierTriangle::B012]);
+    const QVector4D B = interpolate4DUVW(uvw, cp[BezierTriangle::B102],
+            cp[BezierTriangle::B201], cp[BezierTriangle::B111]);
+    const QVector4D C = interpolate4DUVW(uvw, cp[BezierTriangle::B201],
+            cp[BezierTriangle::B300], cp[BezierTriangle::B210]);
+    const QVector4D D = interpolate4DUVW(uvw, cp[BezierTriangle::B012],
+            cp[BezierTriangle::B111], cp[BezierTriangle::B021]);
+    const QVector4D E = interpolate4DUVW(uvw, cp[BezierTriangle::B111],
+            cp[BezierTriangle::B210], cp[BezierTriangle::B120]);
+    const QVector4D F = interpolate4DUVW(uvw, cp[BezierTriangle::B021],
+            cp[BezierTriangle::B120], cp[BezierTriangle::B030]);
+
+    // Quadratic to linear triangle
+    const QVector4D a = interpolate4DUVW(uvw, A, B, D);
+    const QVector4D b = interpolate4DUVW(uvw, B, C, E);
+    const QVector4D c = interpolate4DUVW(uvw, D, E, F);
+
+    if (normal) {
+        const QVector3D aw = projectTo3D(a);
+        const QVector3D ab = (projectTo3D(b) - aw).normalized();
+        const QVector3D ac = (projectTo3D(c) - aw).normalized();
+        *normal = QVector3D::crossProduct(ab, ac).normalized();
+    }
+    return projectTo3D(interpolate4DUVW(uvw, a, b, c));
+}
+
+bool BezierTriangleTessellator::isDegenerate(const QVector4D *controlPoints) {
+    return (controlPoints[BezierTriangle::B030] -
+            controlPoints[BezierTriangle::B111]).length() < 0.00001f;
+}
+
+// --- Private -----------------------------------------------------------------
+
+const BezierTriangleTessellator::Pattern &BezierTriangleTessellator::pattern(
+        const Levels &levels)
+{
+    const int edgeLevels[3] = {
+        roundLevel(levels.outer[0]),
+        roundLevel(levels.outer[1]),
+        roundLevel(levels.outer[2])
+    };
+    const int n = std::max(std::max(roundLevel(levels.inner), edgeLevels[0]),
+                           std::max(edgeLevels[1], edgeLevels[2]));
+
+    // Levels are at most 64, seven bits each
+    const quint32 key = quint32(n) | quint32(edgeLevels[0]) << 7 |
+            quint32(edgeLevels[1]) << 14 | quint32(edgeLevels[2]) << 21;
+    Pattern *&cached = _patterns[key];
+    if (cached) {
+        return *cached;
+    }
+    cached = new Pattern();
+    Pattern &p = *cached;
+
+    QVector<float> us, vs;
+    auto addVertex = [&us, &vs](float u, float v) -> unsigned {
+        us.push_back(u);
+        vs.push_back(v);
+        return us.size() - 1;
+    };
+    // Vertices on the edges u = 0 (along v), v = 0 (along u), w = 0 (along u)
+    QVector<int> edges[3];
+    for (int e = 0; e < 3; ++e) {
+        edges[e].fill(-1, edgeLevels[e] + 1);
+    }
+    const unsigned cornerW = addVertex(0.0f, 0.0f);
+    const unsigned cornerU = addVertex(1.0f, 0.0f);
+    const unsigned cornerV = addVertex(0.0f, 1.0f);
+    edges[0].first() = cornerW;
+    edges[0].last() = cornerV;
+    edges[1].first() = cornerW;
+    edges[1].last() = cornerU;
+    edges[2].first() = cornerV;
+    edges[2].last() = cornerU;
+
+    auto edgeVertex = [&](int edge, int gridIndex) -> unsigned {
+        const int m = edgeLevels[edge];
+        const int snapped = (2 * gridIndex * m + n) / (2 * n);
+        int &index = edges[edge][snapped];
+        if (index < 0) {
+            const float t = static_cast<float>(snapped) / m;
+            index = edge == 0 ? addVertex(0.0f, t) :
+                    edge == 1 ? addVertex(t, 0.0f) :
+                                addVertex(t, 1.0f - t);
+        }
+        return index;
+    };
+
+    // Grid vertex (i, j) has u = i / n and v = j / n
+    QVector<unsigned> grid((n + 1) * (n + 1));
+    for (int j = 0; j <= n; ++j) {
+        for (int i = 0; i + j <= n; ++i) {
+            unsigned index;
+            if (i == 0) {
+                index = edgeVertex(0, j);
+            } else if (j == 0) {
+                index = edgeVertex(1, i);
+            } else if (i + j == n) {
+                index = edgeVertex(2, i);
+            } else {
+                index = addVertex(static_cast<float>(i) / n,
+                                  static_cast<float>(j) / n);
+            }
+            grid[j * (n + 1) + i] = index;
+        }
+    }
+
+    auto addTriangle = [&p](unsigned a, unsigned b, unsigned c) {
+        // Snapping to a lower edge level collapses triangles on the border
+        if (a == b || b == c || a == c) return;
+        p.indices << a << b << c;
+    };
+    for (int j = 0; j < n; ++j) {
+        for (int i = 0; i + j < n; ++i) {
+            const unsigned v00 = grid[j * (n + 1) + i];
+            const unsigned v10 = grid[j * (n + 1) + i + 1];
+            const unsigned v01 = grid[(j + 1) * (n + 1) + i];
+            addTriangle(v00, v10, v01);
+            if (i + j + 1 < n) {
+                addTriangle(v10, grid[(j + 1) * (n + 1) + i + 1], v01);
+            }
+        }
+    }
+
+    p.numVertices = us.size();
+    p.numPadded = (p.numVertices + LANES - 1) / LANES * LANES;
+    p.u.resize(p.numPadded);
+    p.v.resize(p.numPadded);
+    p.w.resize(p.numPadded);
+    p.basis.resize(NUM_QUADRATIC * p.numPadded);
+    for (int i = 0; i < p.numPadded; ++i) {
+        // Padding samples evaluate the B003 corner, which is always valid
+        const float u = i < p.numVertices ? us[i] : 0.0f;
+        const float v = i < p.numVertices ? vs[i] : 0.0f;
+        const float w = std::max(0.0f, 1.0f - u - v);
+        p.u[i] = u;
+        p.v[i] = v;
+        p.w[i] = w;
+        p.basis[0 * p.numPadded + i] = u * u;
+        p.basis[1 * p.numPadded + i] = v * v;
+        p.basis[2 * p.numPadded + i] = w * w;
+        p.basis[3 * p.numPadded + i] = 2.0f * u * v;
+        p.basis[4 * p.numPadded + i] = 2.0f * u * w;
+        p.basis[5 * p.numPadded + i] = 2.0f * v * w;
+    }
+    return p;
+}
+
+int BezierTriangleTessellator::roundLevel(float level) {
+    // equal_spacing rounds up to the next integer
+    const int rounded = static_cast<int>(std::ceil(level));
+    return qBound(1, rounded, static_cast<int>(MAX_TESS_LEVEL));
+}
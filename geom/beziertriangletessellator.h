@@ -0,0 +1,132 @@
+#ifndef BEZIERTRIANGLETESSELLATOR_H
+#define BEZIERTRIANGLETESSELLATOR_H
+
+#include <geom/bezierpatch.h>
+#include <geom/beziertriangle.h>
+#include <geom/patchstore.h>
+
+#include <QHash>
+#include <QVector>
+#include <QVector3D>
+#include <QVector4D>
+
+/*!
+ * \brief The BezierTriangleTessellator class
+ *
+ * CPU reference implementation of the tessellation shaders. Rational cubic
+ * triangles are evaluated in the same (u, v, w) domain as tess_eval.glsl,
+ * B003 at w = 1, B300 at u = 1 and B030 at v = 1.
+ *
+ * A patch is sampled on a uniform grid of the highest of its levels. The
+ * vertices on an edge are snapped to the level of that edge, so patches that
+ * agree on their edge levels produce a crack free mesh. The triangle pattern
+ * inside a patch differs from the one the GPU generates, the evaluated
+ * surface points and normals are the same.
+ *
+ * Samples are evaluated with SSE or AVX, depending on the compiler flags.
+ * Tessellation patterns are cached per instance, so use one tessellator per
+ * thread.
+ */
+class BezierTriangleTessellator
+{
+
+    // =========================================================================
+    // -- Enums and types ------------------------------------------------------
+    // =========================================================================
+
+public:
+
+    enum {
+        /// Same as the minimum value of GL_MAX_TESS_GEN_LEVEL
+        MAX_TESS_LEVEL = 64
+    };
+
+    /// Tessellation levels with the same meaning as in tess_control.glsl
+    struct Levels {
+        Levels(float level = 1.0f) :
+            inner(level) {
+            outer[0] = outer[1] = outer[2] = level;
+        }
+
+        /// Levels of the edges u = 0, v = 0 and w = 0
+        float outer[3];
+        float inner;
+    };
+
+    struct Mesh {
+        QVector<QVector3D> vertices;
+        QVector<QVector3D> normals;
+        QVector<unsigned> indices;
+
+        int numTriangles() const {
+            return indices.size() / 3;
+        }
+
+        void clear();
+    };
+
+private:
+
+    struct Pattern;
+
+    // =========================================================================
+    // -- Constructors and destructor ------------------------------------------
+    // =========================================================================
+
+public:
+
+    BezierTriangleTessellator();
+
+    ~BezierTriangleTessellator();
+
+    // =========================================================================
+    // -- Other methods --------------------------------------------------------
+    // =========================================================================
+
+public:
+
+    /// Appends the tessellated patch to the mesh
+    void tessellate(const QVector4D *controlPoints,
+                    const Levels &levels,
+                    Mesh &mesh);
+
+    void tessellate(const BezierTriangle &patch,
+                    const Levels &levels,
+                    Mesh &mesh);
+
+    /// Tessellates all triangle patches with the same levels
+    void tessellate(const PatchStore &patches,
+                    const Levels &levels,
+                    Mesh &mesh);
+
+    /// Number of vertices tessellate() appends for the levels
+    int numVertices(const Levels &levels);
+
+    /// Number of triangles tessellate() appends for the levels
+    int numTriangles(const Levels &levels);
+
+    /// Scalar de Casteljau evaluation, identical to tess_eval.glsl
+    static QVector3D evaluate(const QVector4D *controlPoints,
+                              const QVector3D &uvw,
+                              QVector3D *normal = nullptr);
+
+    /// True if the patch has a singularity at B030 (cones)
+    static bool isDegenerate(const QVector4D *controlPoints);
+
+private:
+
+    const Pattern &pattern(const Levels &levels);
+
+    static int roundLevel(float level);
+
+    // =========================================================================
+    // -- Data members ---------------------------------------------------------
+    // =========================================================================
+
+private:
+
+    QHash<quint32, Pattern *> _patterns;
+
+};
+
+#endif // BEZIERTRIANGLETESSELLATOR_H
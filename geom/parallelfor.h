@@ -0,0 +1,145 @@
+#ifndef PARALLELFOR_H
+#define PARALLELFOR_H
+
+#include <QAtomicInteger>
+#include <QThreadPool>
+#include <QVector>
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <memory>
+#include <numeric>
+
+namespace Parallel {
+
+struct IndexRange {
+    int begin;
+    int end;
+};
+
+/// Calls f(i) for i in [0, count) on the global thread pool, grain indices
+/// per task
+template<typename F>
+void parallelFor(int count, int grain, F f) {
+    QVector<IndexRange> ranges;
+    for (int begin = 0; begin < count; begin += grain) {
+        ranges.push_back({begin, std::min(begin + grain, count)});
+    }
+    QtConcurrent::blockingMap(ranges, [&f](const IndexRange &range) {
+        for (int i = range.begin; i < range.end; ++i) {
+            f(i);
+        }
+    });
+}
+
+/// Range of indices owned by a worker, begin and end packed in one word so
+/// the owner and the thieves can both update it with a single CAS
+struct StealableRange {
+    QAtomicInteger<quint64> bounds;
+    /// Keeps the ranges of different workers on different cache lines
+    char padding[64 - sizeof(QAtomicInteger<quint64>)];
+
+    static quint64 pack(int begin, int end) {
+        return (quint64(quint32(begin)) << 32) | quint32(end);
+    }
+    static int begin(quint64 bounds) {
+        return int(bounds >> 32);
+    }
+    static int end(quint64 bounds) {
+        return int(bounds & 0xffffffffu);
+    }
+
+    /// Takes up to grain indices from the front, false if the range is empty
+    bool take(int grain, int &takenBegin, int &takenEnd) {
+        quint64 current = bounds.loadAcquire();
+        for (;;) {
+            const int b = begin(current), e = end(current);
+            if (b >= e) return false;
+            const int taken = std::min(b + grain, e);
+            if (bounds.testAndSetOrdered(current, pack(taken, e), current)) {
+                takenBegin = b;
+                takenEnd = taken;
+                return true;
+            }
+        }
+    }
+
+    /// Takes the back half from the front, false if the range is empty
+    bool steal(int &stolenBegin, int &stolenEnd) {
+        quint64 current = bounds.loadAcquire();
+        for (;;) {
+            const int b = begin(current), e = end(current);
+            if (b >= e) return false;
+            const int middle = b + (e - b) / 2;
+            if (bounds.testAndSetOrdered(current, pack(b, middle), current)) {
+                stolenBegin = middle;
+                stolenEnd = e;
+                return true;
+            }
+        }
+    }
+
+    int size() const {
+        const quint64 current = bounds.loadAcquire();
+        return std::max(0, end(current) - begin(current));
+    }
+};
+
+/*!
+ * Calls f(i, worker) for i in [0, count) with work stealing, for loops of
+ * which the cost per index varies a lot. Every worker starts with an equal
+ * part of the range and takes grain indices at a time from its front. An
+ * idle worker steals the back half of the largest remaining range. The
+ * worker number in [0, numWorkers) selects per thread state, numWorkers
+ * defaults to the size of the global thread pool.
+ */
+template<typename F>
+void workStealingFor(int count, int grain, F f, int numWorkers = 0) {
+    if (count <= 0) return;
+    if (numWorkers <= 0) {
+        numWorkers = QThreadPool::globalInstance()->maxThreadCount();
+    }
+    numWorkers = std::max(1, std::min(numWorkers, count));
+
+    std::unique_ptr<StealableRange[]> ranges(new StealableRange[numWorkers]);
+    for (int worker = 0; worker < numWorkers; ++worker) {
+        const int begin = int(qint64(count) * worker / numWorkers);
+        const int end = int(qint64(count) * (worker + 1) / numWorkers);
+        ranges[worker].bounds.storeRelease(StealableRange::pack(begin, end));
+    }
+
+    // Workers that only start when the others are done find their range
+    // stolen, so more workers than threads costs nothing
+    QVector<int> workers(numWorkers);
+    std::iota(workers.begin(), workers.end(), 0);
+    StealableRange *shared = ranges.get();
+    QtConcurrent::blockingMap(workers, [&f, shared, numWorkers, grain](int worker) {
+        StealableRange &own = shared[worker];
+        int begin = 0, end = 0;
+        for (;;) {
+            while (own.take(grain, begin, end)) {
+                for (int i = begin; i < end; ++i) {
+                    f(i, worker);
+                }
+            }
+            // Ranges only shrink, once every range is empty the loop is done
+            int victim = -1, victimSize = 0;
+            for (int other = 0; other < numWorkers; ++other) {
+                const int size = shared[other].size();
+                if (size > victimSize) {
+                    victim = other;
+                    victimSize = size;
+                }
+            }
+            if (victim < 0) return;
+            if (shared[victim].steal(begin, end)) {
+                // Nobody steals from an empty range, so a plain store is safe
+                own.bounds.storeRelease(StealableRange::pack(begin, end));
+            }
+        }
+    });
+}
+
+} // namespace Parallel
+
+#endif // PARALLELFOR_H
@@ -0,0 +1,185 @@
+#include <geom/paralleltessellator.h>
+#include <geom/parallelfor.h>
+
+#include <QtDebug>
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+
+namespace {
+
+/// Chunks copied per task when merging
+const int MERGE_GRAIN = 16;
+
+/// Chunks in memory per worker when streaming
+const int STREAM_CHUNKS_PER_WORKER = 4;
+
+/// Room for the header of a Qt 5 array allocation
+const qint64 ARRAY_HEADER_SIZE = 64;
+
+/// Qt 5 limits an allocation, header included, to INT_MAX bytes
+bool fitsInVector(qint64 count, qint64 elementSize) {
+    return count <= (std::numeric_limits<int>::max() - ARRAY_HEADER_SIZE) / elementSize;
+}
+
+} // namespace
+
+// -----------------------------------------------------------------------------
+// -- Constructors and destructor ----------------------------------------------
+// -----------------------------------------------------------------------------
+
+ParallelTessellator::ParallelTessellator(const TessellationHeuristic &heuristic) :
+    _heuristic(heuristic),
+    _numWorkers(0)
+{
+
+}
+
+// -----------------------------------------------------------------------------
+// -- Other Methods ------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+// --- Public ------------------------------------------------------------------
+
+void ParallelTessellator::tessellate(const PatchStore &patches,
+                                     BezierTriangleTessellator::Mesh &mesh) const
+{
+    mesh.clear();
+    const int numPatches = patches.numPatches(BezierPatch::TriPatch);
+    const int numChunks = (numPatches + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    if (numChunks == 0) return;
+
+    // Tessellators cache their patterns, one per worker
+    const int workers = numWorkers(numChunks);
+    std::unique_ptr<BezierTriangleTessellator[]> tessellators(
+                new BezierTriangleTessellator[workers]);
+    QVector<BezierTriangleTessellator::Mesh> chunks(numChunks);
+    tessellateChunks(patches, 0, chunks, tessellators.get(), workers);
+    merge(chunks, mesh);
+}
+
+bool ParallelTessellator::tessellate(const PatchStore &patches, const ChunkSink &sink) const
+{
+    const int numPatches = patches.numPatches(BezierPatch::TriPatch);
+    const int numChunks = (numPatches + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    if (numChunks == 0) return true;
+
+    const int workers = numWorkers(numChunks);
+    std::unique_ptr<BezierTriangleTessellator[]> tessellators(
+                new BezierTriangleTessellator[workers]);
+    const int batchSize = workers * STREAM_CHUNKS_PER_WORKER;
+    QVector<BezierTriangleTessellator::Mesh> chunks;
+    for (int first = 0; first < numChunks; first += batchSize) {
+        chunks.resize(std::min(batchSize, numChunks - first));
+        tessellateChunks(patches, first, chunks, tessellators.get(), workers);
+        for (BezierTriangleTessellator::Mesh &chunkMesh : chunks) {
+            if (!sink(chunkMesh)) {
+                return false;
+            }
+            chunkMesh = BezierTriangleTessellator::Mesh();
+        }
+    }
+    return true;
+}
+
+void ParallelTessellator::count(const PatchStore &patches,
+                                qint64 &numVertices,
+                                qint64 &numTriangles) const
+{
+    numVertices = numTriangles = 0;
+    const int numPatches = patches.numPatches(BezierPatch::TriPatch);
+    const int numChunks = (numPatches + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    if (numChunks == 0) return;
+
+    const int workers = numWorkers(numChunks);
+    std::unique_ptr<BezierTriangleTessellator[]> tessellators(
+                new BezierTriangleTessellator[workers]);
+    QVector<qint64> chunkVertices(numChunks, 0);
+    QVector<qint64> chunkTriangles(numChunks, 0);
+
+    Parallel::workStealingFor(numChunks, 1, [&](int chunk, int worker) {
+        BezierTriangleTessellator &tessellator = tessellators[worker];
+        QVector4D controlPoints[BezierTriangle::NUM_CONTROL_POINTS];
+        const int end = std::min((chunk + 1) * int(CHUNK_SIZE), numPatches);
+        for (int patch = chunk * CHUNK_SIZE; patch < end; ++patch) {
+            patches.gatherControlPoints(BezierPatch::TriPatch, patch, controlPoints);
+            const BezierTriangleTessellator::Levels levels = _heuristic.levels(controlPoints);
+            chunkVertices[chunk] += tessellator.numVertices(levels);
+            chunkTriangles[chunk] += tessellator.numTriangles(levels);
+        }
+    }, workers);
+
+    for (int chunk = 0; chunk < numChunks; ++chunk) {
+        numVertices += chunkVertices[chunk];
+        numTriangles += chunkTriangles[chunk];
+    }
+}
+
+// --- Private -----------------------------------------------------------------
+
+int ParallelTessellator::numWorkers(int numChunks) const {
+    const int numWorkers = _numWorkers > 0 ?
+                _numWorkers : QThreadPool::globalInstance()->maxThreadCount();
+    return std::max(1, std::min(numWorkers, numChunks));
+}
+
+void ParallelTessellator::tessellateChunks(const PatchStore &patches,
+                                           int first,
+                                           QVector<BezierTriangleTessellator::Mesh> &chunks,
+                                           BezierTriangleTessellator *tessellators,
+                                           int numWorkers) const
+{
+    const int numPatches = patches.numPatches(BezierPatch::TriPatch);
+    Parallel::workStealingFor(chunks.size(), 1, [&](int chunk, int worker) {
+        BezierTriangleTessellator &tessellator = tessellators[worker];
+        BezierTriangleTessellator::Mesh &chunkMesh = chunks[chunk];
+        QVector4D controlPoints[BezierTriangle::NUM_CONTROL_POINTS];
+        const int begin = (first + chunk) * CHUNK_SIZE;
+        const int end = std::min(begin + int(CHUNK_SIZE), numPatches);
+        for (int patch = begin; patch < end; ++patch) {
+            patches.gatherControlPoints(BezierPatch::TriPatch, patch, controlPoints);
+            tessellator.tessellate(controlPoints, _heuristic.levels(controlPoints), chunkMesh);
+        }
+    }, numWorkers);
+}
+
+void ParallelTessellator::merge(QVector<BezierTriangleTessellator::Mesh> &chunks,
+                                BezierTriangleTessellator::Mesh &mesh)
+{
+    const int numChunks = chunks.size();
+    QVector<qint64> firstVertex(numChunks + 1, 0);
+    QVector<qint64> firstIndex(numChunks + 1, 0);
+    for (int chunk = 0; chunk < numChunks; ++chunk) {
+        firstVertex[chunk + 1] = firstVertex[chunk] + chunks[chunk].vertices.size();
+        firstIndex[chunk + 1] = firstIndex[chunk] + chunks[chunk].indices.size();
+    }
+    if (!fitsInVector(firstVertex[numChunks], sizeof(QVector3D)) ||
+            !fitsInVector(firstIndex[numChunks], sizeof(unsigned))) {
+        qWarning() << "ParallelTessellator: mesh of" << firstVertex[numChunks] << "vertices and"
+                   << firstIndex[numChunks] / 3 << "triangles does not fit,"
+                   << "stream it or lower the tessellation levels";
+        chunks.clear();
+        return;
+    }
+    mesh.vertices.resize(firstVertex[numChunks]);
+    mesh.normals.resize(firstVertex[numChunks]);
+    mesh.indices.resize(firstIndex[numChunks]);
+
+    QVector3D *vertices = mesh.vertices.data();
+    QVector3D *normals = mesh.normals.data();
+    unsigned *indices = mesh.indices.data();
+    Parallel::parallelFor(numChunks, MERGE_GRAIN, [&](int chunk) {
+        BezierTriangleTessellator::Mesh &chunkMesh = chunks[chunk];
+        std::copy(chunkMesh.vertices.constBegin(), chunkMesh.vertices.constEnd(),
+                  vertices + firstVertex[chunk]);
+        std::copy(chunkMesh.normals.constBegin(), chunkMesh.normals.constEnd(),
+                  normals + firstVertex[chunk]);
+        const unsigned offset = firstVertex[chunk];
+        unsigned *out = indices + firstIndex[chunk];
+        for (unsigned index : chunkMesh.indices) {
+            *out++ = index + offset;
+        }
+        chunkMesh = BezierTriangleTessellator::Mesh();
+    });
+}
@@ -0,0 +1,99 @@
+#ifndef PARALLELTESSELLATOR_H
+#define PARALLELTESSELLATOR_H
+
+#include <geom/beziertriangletessellator.h>
+#include <geom/patchstore.h>
+#include <geom/tessellationheuristic.h>
+
+#include <functional>
+
+/*!
+ * \brief The ParallelTessellator class
+ *
+ * Tessellates every triangle patch of a scene with the levels picked by a
+ * TessellationHeuristic, on the global thread pool. The cost of a patch
+ * ranges from one triangle to MAX_TESS_LEVEL squared, so the patches are
+ * scheduled with Parallel::workStealingFor instead of fixed ranges. Chunks
+ * of patches are tessellated into their own meshes, which are merged in
+ * patch order, the result does not depend on the number of threads.
+ *
+ * Meshes that do not fit in one QVector are streamed instead: the chunks
+ * are handed to a ChunkSink in patch order, a few per worker at a time.
+ */
+class ParallelTessellator
+{
+
+    // =========================================================================
+    // -- Enums and types ------------------------------------------------------
+    // =========================================================================
+
+public:
+
+    enum {
+        /// Patches per chunk mesh, and per steal of a worker
+        CHUNK_SIZE = 64
+    };
+
+    /// Receives the chunk meshes in patch order, with indices relative to
+    /// the chunk. Returning false stops the tessellation.
+    typedef std::function<bool(const BezierTriangleTessellator::Mesh &)> ChunkSink;
+
+    // =========================================================================
+    // -- Constructors and destructor ------------------------------------------
+    // =========================================================================
+
+public:
+
+    explicit ParallelTessellator(const TessellationHeuristic &heuristic);
+
+    // =========================================================================
+    // -- Other methods --------------------------------------------------------
+    // =========================================================================
+
+public:
+
+    /// Defaults to the size of the global thread pool
+    void setNumWorkers(int numWorkers) {
+        _numWorkers = numWorkers;
+    }
+
+    /// Replaces the mesh by the tessellation of all triangle patches
+    void tessellate(const PatchStore &patches,
+                    BezierTriangleTessellator::Mesh &mesh) const;
+
+    /// Tessellates all triangle patches into the sink without holding the
+    /// whole mesh, returns false if the sink stopped
+    bool tessellate(const PatchStore &patches, const ChunkSink &sink) const;
+
+    /// Number of vertices and triangles of the tessellation, without
+    /// evaluating any patch
+    void count(const PatchStore &patches, qint64 &numVertices, qint64 &numTriangles) const;
+
+private:
+
+    int numWorkers(int numChunks) const;
+
+    /// Tessellates the chunks [first, first + chunks.size())
+    void tessellateChunks(const PatchStore &patches,
+                          int first,
+                          QVector<BezierTriangleTessellator::Mesh> &chunks,
+                          BezierTriangleTessellator *tessellators,
+                          int numWorkers) const;
+
+    /// Concatenates the chunk meshes, freeing them along the way
+    static void merge(QVector<BezierTriangleTessellator::Mesh> &chunks,
+                      BezierTriangleTessellator::Mesh &mesh);
+
+    // =========================================================================
+    // -- Data members ---------------------------------------------------------
+    // =========================================================================
+
+private:
+
+    const TessellationHeuristic &_heuristic;
+
+    int _numWorkers;
+
+};
+
+#endif // PARALLELTESSELLATOR_H
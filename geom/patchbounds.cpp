@@ -0,0 +1,161 @@
+#include <geom/patchbounds.h>
+
+#include <geom/bezierquad.h>
+#include <geom/beziertriangle.h>
+
+#include <cmath>
+
+namespace {
+
+/// Relative difference under which weights count as equal
+const float WEIGHT_EPSILON = 1e-6f;
+
+/// Generators shorter than this do not contribute to the normal cone
+const float MIN_NORMAL_LENGTH = 1e-12f;
+
+/// Cross products of the 12 by 12 derivative control points of a quad
+const int MAX_CONE_GENERATORS = 144;
+
+/// Projects the control points and sets the box, false if a weight is not
+/// positive. isPolynomial is set if all weights are equal.
+bool fitBox(const QVector4D *cp, int count, QVector3D *points,
+            PatchBounds &bounds, bool &isPolynomial) {
+    isPolynomial = true;
+    for (int i = 0; i < count; ++i) {
+        const float w = cp[i].w();
+        if (w <= 0.0f) {
+            return false;
+        }
+        if (std::abs(w - cp[0].w()) > WEIGHT_EPSILON * cp[0].w()) {
+            isPolynomial = false;
+        }
+        points[i] = cp[i].toVector3D() / w;
+    }
+
+    bounds.minValues = bounds.maxValues = points[0];
+    for (int i = 1; i < count; ++i) {
+        bounds.minValues.setX(std::min(bounds.minValues.x(), points[i].x()));
+        bounds.minValues.setY(std::min(bounds.minValues.y(), points[i].y()));
+        bounds.minValues.setZ(std::min(bounds.minValues.z(), points[i].z()));
+        bounds.maxValues.setX(std::max(bounds.maxValues.x(), points[i].x()));
+        bounds.maxValues.setY(std::max(bounds.maxValues.y(), points[i].y()));
+        bounds.maxValues.setZ(std::max(bounds.maxValues.z(), points[i].z()));
+    }
+    return true;
+}
+
+/// Fits the cone around the pairwise cross products of the control points
+/// of the two derivative patches
+void fitCone(const QVector3D *du, int numDu, const QVector3D *dv, int numDv,
+             PatchBounds &bounds) {
+    Q_ASSERT(numDu * numDv <= MAX_CONE_GENERATORS);
+    QVector3D normals[MAX_CONE_GENERATORS];
+    int numNormals = 0;
+    QVector3D axis;
+    for (int a = 0; a < numDu; ++a) {
+        for (int b = 0; b < numDv; ++b) {
+            const QVector3D normal = QVector3D::crossProduct(du[a], dv[b]);
+            if (normal.lengthSquared() < MIN_NORMAL_LENGTH) continue;
+            normals[numNormals] = normal.normalized();
+            axis += normals[numNormals];
+            ++numNormals;
+        }
+    }
+    if (numNormals == 0 || axis.lengthSquared() < MIN_NORMAL_LENGTH) {
+        return;
+    }
+
+    bounds.coneAxis = axis.normalized();
+    bounds.coneCutoff = 1.0f;
+    for (int i = 0; i < numNormals; ++i) {
+        bounds.coneCutoff = std::min(
+                    bounds.coneCutoff,
+                    QVector3D::dotProduct(bounds.coneAxis, normals[i]));
+    }
+}
+
+} // namespace
+
+PatchBounds::PatchBounds() :
+    coneCutoff(-1.0f),
+    isBounded(false)
+{
+
+}
+
+PatchBounds PatchBounds::fromTriangle(const QVector4D *cp)
+{
+    PatchBounds bounds;
+
+    QVector3D points[BezierTriangle::NUM_CONTROL_POINTS];
+    bool isPolynomial;
+    bounds.isBounded = fitBox(cp, BezierTriangle::NUM_CONTROL_POINTS,
+                              points, bounds, isPolynomial);
+
+    // The cone below only holds for polynomial patches, the derivatives of
+    // rational patches also depend on the derivatives of the weight
+    if (!bounds.isBounded || !isPolynomial) {
+        return bounds;
+    }
+
+    // Control points of the derivative patches towards B300 and B030. The
+    // normal is a positive combination of all their pairwise cross products.
+    QVector3D du[6], dv[6];
+    int n = 0;
+    for (int i = 0; i <= 2; ++i) {
+        for (int j = 0; i + j <= 2; ++j) {
+            const QVector3D &origin = points[BezierTriangle::index(i, j)];
+            du[n] = points[BezierTriangle::index(i + 1, j)] - origin;
+            dv[n] = points[BezierTriangle::index(i, j + 1)] - origin;
+            ++n;
+        }
+    }
+    fitCone(du, 6, dv, 6, bounds);
+    return bounds;
+}
+
+PatchBounds PatchBounds::fromQuad(const QVector4D *cp)
+{
+    PatchBounds bounds;
+
+    QVector3D points[BezierQuad::NUM_CONTROL_POINTS];
+    bool isPolynomial;
+    bounds.isBounded = fitBox(cp, BezierQuad::NUM_CONTROL_POINTS,
+                              points, bounds, isPolynomial);
+    if (!bounds.isBounded || !isPolynomial) {
+        return bounds;
+    }
+
+    // The derivative patches are bi-quadratic by bicubic and bicubic by
+    // bi-quadratic, with the differences of the control points as nets
+    QVector3D du[12], dv[12];
+    int n = 0;
+    for (int j = 0; j < 4; ++j) {
+        for (int i = 0; i < 3; ++i) {
+            du[n] = points[BezierQuad::index(i + 1, j)] - points[BezierQuad::index(i, j)];
+            dv[n] = points[BezierQuad::index(j, i + 1)] - points[BezierQuad::index(j, i)];
+            ++n;
+        }
+    }
+    fitCone(du, 12, dv, 12, bounds);
+    return bounds;
+}
+
+PatchBounds PatchBounds::fromPatch(BezierPatch::Type type, const QVector4D *controlPoints)
+{
+    return type == BezierPatch::TriPatch ?
+                fromTriangle(controlPoints) : fromQuad(controlPoints);
+}
+
+QVector<PatchBounds> PatchBounds::fromPatches(const PatchStore &patches)
+{
+    QVector<PatchBounds> bounds(patches.size());
+    patches.forEachTriangle([&bounds](int patch, const QVector4D *controlPoints) {
+        bounds[patch] = fromTriangle(controlPoints);
+    });
+    const int firstQuad = patches.firstPatch(BezierPatch::QuadPatch);
+    patches.forEachQuad([&bounds, firstQuad](int patch, const QVector4D *controlPoints) {
+        bounds[firstQuad + patch] = fromQuad(controlPoints);
+    });
+    return bounds;
+}
@@ -0,0 +1,57 @@
+#ifndef PATCHBOUNDS_H
+#define PATCHBOUNDS_H
+
+#include <geom/patchstore.h>
+
+#include <QVector>
+#include <QVector3D>
+#include <QVector4D>
+
+/*!
+ * \brief The PatchBounds struct
+ *
+ * Conservative bounds of a single patch: the axis aligned box of the convex
+ * hull of the control points and a cone that contains every surface normal.
+ * Normals follow the orientation of the tessellation shaders, the cross
+ * product of the derivatives towards B300 and B030 for triangles and along
+ * u and v for quads.
+ */
+struct PatchBounds
+{
+    PatchBounds();
+
+    /// Box of the projected control points
+    QVector3D minValues, maxValues;
+
+    /// Normalised cone axis
+    QVector3D coneAxis;
+
+    /// Cosine of the half opening angle, <= 0 if there is no usable cone
+    float coneCutoff;
+
+    /// False if the hull property does not hold (non positive weights)
+    bool isBounded;
+
+    bool hasCone() const {
+        return coneCutoff > 0.0f;
+    }
+
+    QVector3D center() const {
+        return 0.5f * (minValues + maxValues);
+    }
+
+    float radius() const {
+        return 0.5f * (maxValues - minValues).length();
+    }
+
+    static PatchBounds fromTriangle(const QVector4D *controlPoints);
+
+    static PatchBounds fromQuad(const QVector4D *controlPoints);
+
+    static PatchBounds fromPatch(BezierPatch::Type type, const QVector4D *controlPoints);
+
+    /// Bounds of all patches in the store, by global patch number
+    static QVector<PatchBounds> fromPatches(const PatchStore &patches);
+};
+
+#endif // PATCHBOUNDS_H
@@ -0,0 +1,392 @@
+#include <geom/patchbvh.h>
+
+#include <geom/bezierquad.h>
+#include <geom/beziertriangle.h>
+#include <geom/beziertriangletessellator.h>
+#include <geom/parallelfor.h>
+
+#include <QtAlgorithms>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+/// Patches per task in the parallel build steps
+const int BUILD_GRAIN = 4096;
+
+/// Tessellation level of the ray test in pick()
+const int PICK_LEVEL = 8;
+
+const int MAX_STACK_DEPTH = 128;
+
+/// Spreads the lower 10 bits of v over 30 bits, two zeros between each bit
+quint32 expandBits(quint32 v) {
+    v = (v * 0x00010001u) & 0xFF0000FFu;
+    v = (v * 0x00000101u) & 0x0F00F00Fu;
+    v = (v * 0x00000011u) & 0xC30C30C3u;
+    v = (v * 0x00000005u) & 0x49249249u;
+    return v;
+}
+
+/// Point in the unit cube to a 30 bit Morton code
+quint32 mortonCode(const QVector3D &p) {
+    const auto quantize = [](float f) {
+        return static_cast<quint32>(qBound(0.0f, f * 1024.0f, 1023.0f));
+    };
+    return expandBits(quantize(p.x())) << 2 |
+            expandBits(quantize(p.y())) << 1 |
+            expandBits(quantize(p.z()));
+}
+
+/// Slab test, returns the entry distance or infinity on a miss
+float intersectBox(const PatchBVH::Node &node,
+                   const QVector3D &origin,
+                   const QVector3D &inverseDirection,
+                   float maxDistance) {
+    float tMin = 0.0f;
+    float tMax = maxDistance;
+    for (int axis = 0; axis < 3; ++axis) {
+        float t0 = (node.minValues[axis] - origin[axis]) * inverseDirection[axis];
+        float t1 = (node.maxValues[axis] - origin[axis]) * inverseDirection[axis];
+        if (t0 > t1) std::swap(t0, t1);
+        // NaN (0 * inf) leaves the bounds unchanged
+        tMin = t0 > tMin ? t0 : tMin;
+        tMax = t1 < tMax ? t1 : tMax;
+        if (tMin > tMax) {
+            return std::numeric_limits<float>::infinity();
+        }
+    }
+    return tMin;
+}
+
+/// Möller-Trumbore, both sides, returns infinity on a miss
+float intersectTriangle(const QVector3D &origin, const QVector3D &direction,
+                        const QVector3D &a, const QVector3D &b, const QVector3D &c) {
+    const QVector3D ab = b - a;
+    const QVector3D ac = c - a;
+    const QVector3D p = QVector3D::crossProduct(direction, ac);
+    const float det = QVector3D::dotProduct(ab, p);
+    if (std::abs(det) < 1e-12f) {
+        return std::numeric_limits<float>::infinity();
+    }
+    const float invDet = 1.0f / det;
+    const QVector3D s = origin - a;
+    const float u = QVector3D::dotProduct(s, p) * invDet;
+    if (u < 0.0f || u > 1.0f) {
+        return std::numeric_limits<float>::infinity();
+    }
+    const QVector3D q = QVector3D::crossProduct(s, ab);
+    const float v = QVector3D::dotProduct(direction, q) * invDet;
+    if (v < 0.0f || u + v > 1.0f) {
+        return std::numeric_limits<float>::infinity();
+    }
+    const float t = QVector3D::dotProduct(ac, q) * invDet;
+    return t >= 0.0f ? t : std::numeric_limits<float>::infinity();
+}
+
+/// Index of (i, j) in a triangular grid of the given level, row by row in j
+int gridIndex(int i, int j, int level) {
+    return j * (level + 1) - (j * (j - 1)) / 2 + i;
+}
+
+float intersectTrianglePatch(const QVector4D *controlPoints,
+                             const QVector3D &origin,
+                             const QVector3D &direction) {
+    QVector3D grid[(PICK_LEVEL + 1) * (PICK_LEVEL + 2) / 2];
+    for (int j = 0; j <= PICK_LEVEL; ++j) {
+        for (int i = 0; i + j <= PICK_LEVEL; ++i) {
+            const float u = static_cast<float>(i) / PICK_LEVEL;
+            const float v = static_cast<float>(j) / PICK_LEVEL;
+            grid[gridIndex(i, j, PICK_LEVEL)] = BezierTriangleTessellator::evaluate(
+                        controlPoints, QVector3D(u, v, 1.0f - u - v));
+        }
+    }
+
+    float closest = std::numeric_limits<float>::infinity();
+    for (int j = 0; j < PICK_LEVEL; ++j) {
+        for (int i = 0; i + j < PICK_LEVEL; ++i) {
+            const QVector3D &a = grid[gridIndex(i, j, PICK_LEVEL)];
+            const QVector3D &b = grid[gridIndex(i + 1, j, PICK_LEVEL)];
+            const QVector3D &c = grid[gridIndex(i, j + 1, PICK_LEVEL)];
+            closest = std::min(closest, intersectTriangle(origin, direction, a, b, c));
+            if (i + j + 1 < PICK_LEVEL) {
+                const QVector3D &d = grid[gridIndex(i + 1, j + 1, PICK_LEVEL)];
+                closest = std::min(closest, intersectTriangle(origin, direction, b, d, c));
+            }
+        }
+    }
+    return closest;
+}
+
+float intersectQuadPatch(const QVector4D *controlPoints,
+                         const QVector3D &origin,
+                         const QVector3D &direction) {
+    QVector3D grid[(PICK_LEVEL + 1) * (PICK_LEVEL + 1)];
+    for (int j = 0; j <= PICK_LEVEL; ++j) {
+        for (int i = 0; i <= PICK_LEVEL; ++i) {
+            grid[j * (PICK_LEVEL + 1) + i] = BezierQuad::evaluate(
+                        controlPoints,
+                        static_cast<float>(i) / PICK_LEVEL,
+                        static_cast<float>(j) / PICK_LEVEL);
+        }
+    }
+
+    float closest = std::numeric_limits<float>::infinity();
+    for (int j = 0; j < PICK_LEVEL; ++j) {
+        for (int i = 0; i < PICK_LEVEL; ++i) {
+            const QVector3D &a = grid[j * (PICK_LEVEL + 1) + i];
+            const QVector3D &b = grid[j * (PICK_LEVEL + 1) + i + 1];
+            const QVector3D &c = grid[(j + 1) * (PICK_LEVEL + 1) + i];
+            const QVector3D &d = grid[(j + 1) * (PICK_LEVEL + 1) + i + 1];
+            closest = std::min(closest, intersectTriangle(origin, direction, a, b, c));
+            closest = std::min(closest, intersectTriangle(origin, direction, b, d, c));
+        }
+    }
+    return closest;
+}
+
+} // namespace
+
+// -----------------------------------------------------------------------------
+// -- Constructors and destructor ----------------------------------------------
+// -----------------------------------------------------------------------------
+
+PatchBVH::PatchBVH()
+{
+
+}
+
+// -----------------------------------------------------------------------------
+// -- Other Methods ------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+// --- Public ------------------------------------------------------------------
+
+void PatchBVH::build(const QVector<PatchBounds> &bounds)
+{
+    const int n = bounds.size();
+    _nodes.clear();
+    _codes.clear();
+    _patchOrder.clear();
+    _leafOfPatch.clear();
+    if (n == 0) return;
+
+    // Morton codes of the box centers, relative to the box of all centers
+    QVector3D minCenter(std::numeric_limits<float>::max(),
+                        std::numeric_limits<float>::max(),
+                        std::numeric_limits<float>::max());
+    QVector3D maxCenter = -minCenter;
+    for (const PatchBounds &patch : bounds) {
+        if (!patch.isBounded) continue;
+        const QVector3D center = patch.center();
+        for (int axis = 0; axis < 3; ++axis) {
+            minCenter[axis] = std::min(minCenter[axis], center[axis]);
+            maxCenter[axis] = std::max(maxCenter[axis], center[axis]);
+        }
+    }
+    QVector3D extent = maxCenter - minCenter;
+    for (int axis = 0; axis < 3; ++axis) {
+        extent[axis] = extent[axis] > 0.0f ? 1.0f / extent[axis] : 0.0f;
+    }
+
+    // Code in the upper, patch index in the lower half makes the keys unique
+    QVector<quint64> keys(n);
+    quint64 *keyData = keys.data();
+    Parallel::parallelFor(n, BUILD_GRAIN, [&](int patch) {
+        const quint32 code = bounds[patch].isBounded ?
+                    mortonCode((bounds[patch].center() - minCenter) * extent) : 0;
+        keyData[patch] = static_cast<quint64>(code) << 32 | static_cast<quint32>(patch);
+    });
+    std::sort(keys.begin(), keys.end());
+
+    _codes.resize(n);
+    _patchOrder.resize(n);
+    _leafOfPatch.resize(n);
+    _nodes.resize(2 * n - 1);
+    quint32 *codes = _codes.data();
+    int *patchOrder = _patchOrder.data();
+    int *leafOfPatch = _leafOfPatch.data();
+    Node *nodes = _nodes.data();
+    Parallel::parallelFor(n, BUILD_GRAIN, [&](int i) {
+        codes[i] = static_cast<quint32>(keyData[i] >> 32);
+        patchOrder[i] = static_cast<int>(keyData[i] & 0xFFFFFFFFu);
+        leafOfPatch[patchOrder[i]] = n - 1 + i;
+        nodes[n - 1 + i].left = nodes[n - 1 + i].right = -1;
+    });
+    nodes[0].parent = -1;
+
+    // Every internal node covers a range of leaves that is found from the
+    // common prefixes of its neighbours only
+    Parallel::parallelFor(n - 1, BUILD_GRAIN, [&](int i) {
+        const int d = commonPrefix(i, i + 1) > commonPrefix(i, i - 1) ? 1 : -1;
+
+        const int minPrefix = commonPrefix(i, i - d);
+        int maxLength = 2;
+        while (commonPrefix(i, i + maxLength * d) > minPrefix) {
+            maxLength *= 2;
+        }
+        int length = 0;
+        for (int t = maxLength / 2; t >= 1; t /= 2) {
+            if (commonPrefix(i, i + (length + t) * d) > minPrefix) {
+                length += t;
+            }
+        }
+        const int j = i + length * d;
+
+        const int split = findSplit(std::min(i, j), std::max(i, j));
+        Node &node = nodes[i];
+        node.left = std::min(i, j) == split ? n - 1 + split : split;
+        node.right = std::max(i, j) == split + 1 ? n - 1 + split + 1 : split + 1;
+        nodes[node.left].parent = i;
+        nodes[node.right].parent = i;
+    });
+
+    refit(bounds);
+}
+
+void PatchBVH::refit(const QVector<PatchBounds> &bounds)
+{
+    const int n = numPatches();
+    if (n == 0) return;
+
+    // The second child to arrive at a node computes its box
+    QVector<char> visits(n - 1, 0);
+    for (int i = 0; i < n; ++i) {
+        int node = n - 1 + i;
+        updateNode(node, bounds);
+        node = _nodes[node].parent;
+        while (node >= 0 && ++visits[node] == 2) {
+            updateNode(node, bounds);
+            node = _nodes[node].parent;
+        }
+    }
+}
+
+void PatchBVH::refit(const QVector<PatchBounds> &bounds, const QVector<int> &patches)
+{
+    for (int patch : patches) {
+        int node = _leafOfPatch[patch];
+        while (node >= 0) {
+            const Node previous = _nodes[node];
+            updateNode(node, bounds);
+            if (_nodes[node].minValues == previous.minValues &&
+                    _nodes[node].maxValues == previous.maxValues) {
+                break;
+            }
+            node = _nodes[node].parent;
+        }
+    }
+}
+
+int PatchBVH::pick(const PatchStore &patches,
+                   const QVector3D &origin,
+                   const QVector3D &direction,
+                   float *distance) const
+{
+    if (isEmpty()) return -1;
+
+    const QVector3D inverseDirection(1.0f / direction.x(),
+                                     1.0f / direction.y(),
+                                     1.0f / direction.z());
+    float closest = std::numeric_limits<float>::infinity();
+    int closestPatch = -1;
+    QVector4D controlPoints[BezierQuad::NUM_CONTROL_POINTS];
+
+    int stack[MAX_STACK_DEPTH];
+    int stackSize = 0;
+    if (intersectBox(_nodes[0], origin, inverseDirection, closest) < closest) {
+        stack[stackSize++] = 0;
+    }
+    while (stackSize > 0) {
+        const int node = stack[--stackSize];
+        if (isLeaf(node)) {
+            const int patch = leafPatch(node);
+            const BezierPatch::Type type = patches.patchType(patch);
+            patches.gatherControlPoints(type, patch - patches.firstPatch(type), controlPoints);
+            const float t = type == BezierPatch::TriPatch ?
+                        intersectTrianglePatch(controlPoints, origin, direction) :
+                        intersectQuadPatch(controlPoints, origin, direction);
+            if (t < closest) {
+                closest = t;
+                closestPatch = patch;
+            }
+            continue;
+        }
+
+        // Push the far child first so the near one is visited first
+        int near = _nodes[node].left;
+        int far = _nodes[node].right;
+        float tNear = intersectBox(_nodes[near], origin, inverseDirection, closest);
+        float tFar = intersectBox(_nodes[far], origin, inverseDirection, closest);
+        if (tFar < tNear) {
+            std::swap(near, far);
+            std::swap(tNear, tFar);
+        }
+        if (tFar < closest && stackSize < MAX_STACK_DEPTH) {
+            stack[stackSize++] = far;
+        }
+        if (tNear < closest && stackSize < MAX_STACK_DEPTH) {
+            stack[stackSize++] = near;
+        }
+    }
+
+    if (distance) {
+        *distance = closest;
+    }
+    return closestPatch;
+}
+
+// --- Private -----------------------------------------------------------------
+
+int PatchBVH::findSplit(int first, int last) const
+{
+    const int prefix = commonPrefix(first, last);
+
+    // Binary search for the last leaf that shares more than prefix bits
+    // with the first one
+    int split = first;
+    int step = last - first;
+    do {
+        step = (step + 1) / 2;
+        const int candidate = split + step;
+        if (candidate < last && commonPrefix(first, candidate) > prefix) {
+            split = candidate;
+        }
+    } while (step > 1);
+    return split;
+}
+
+int PatchBVH::commonPrefix(int i, int j) const
+{
+    if (j < 0 || j >= _codes.size()) return -1;
+    if (_codes[i] == _codes[j]) {
+        // Duplicate codes are distinguished by their position
+        return 32 + qCountLeadingZeroBits(static_cast<quint32>(i ^ j));
+    }
+    return qCountLeadingZeroBits(_codes[i] ^ _codes[j]);
+}
+
+void PatchBVH::updateNode(int node, const QVector<PatchBounds> &bounds)
+{
+    Node &current = _nodes[node];
+    if (isLeaf(node)) {
+        const PatchBounds &patch = bounds[leafPatch(node)];
+        if (patch.isBounded) {
+            current.minValues = patch.minValues;
+            current.maxValues = patch.maxValues;
+        } else {
+            const float inf = std::numeric_limits<float>::infinity();
+            current.minValues = QVector3D(-inf, -inf, -inf);
+            current.maxValues = QVector3D(inf, inf, inf);
+        }
+        return;
+    }
+    const Node &left = _nodes[current.left];
+    const Node &right = _nodes[current.right];
+    for (int axis = 0; axis < 3; ++axis) {
+        current.minValues[axis] = std::min(left.minValues[axis], right.minValues[axis]);
+        current.maxValues[axis] = std::max(left.maxValues[axis], right.maxValues[axis]);
+    }
+}
@@ -0,0 +1,117 @@
+#ifndef PATCHBVH_H
+#define PATCHBVH_H
+
+#include <geom/patchbounds.h>
+#include <geom/patchstore.h>
+
+#include <QVector>
+#include <QVector3D>
+
+/*!
+ * \brief The PatchBVH class
+ *
+ * Bounding volume hierarchy over the boxes of all patches. Built as
+ * a linear BVH (Karras 2012): the patch centers are sorted along a 30 bit
+ * Morton curve and every internal node is found independently, so the build
+ * runs on the global thread pool.
+ *
+ * With n patches, nodes [0, n - 1) are internal and node n - 1 + i is the
+ * leaf holding the i-th patch in Morton order. Node 0 is the root.
+ */
+class PatchBVH
+{
+
+    // =========================================================================
+    // -- Enums and types ------------------------------------------------------
+    // =========================================================================
+
+public:
+
+    struct Node {
+        QVector3D minValues, maxValues;
+        int left, right;
+        int parent;
+    };
+
+    // =========================================================================
+    // -- Constructors and destructor ------------------------------------------
+    // =========================================================================
+
+public:
+
+    PatchBVH();
+
+    // =========================================================================
+    // -- Other methods --------------------------------------------------------
+    // =========================================================================
+
+public:
+
+    void build(const QVector<PatchBounds> &bounds);
+
+    /// Recomputes all node boxes after the patch boxes changed
+    void refit(const QVector<PatchBounds> &bounds);
+
+    /// Only updates the ancestors of the given patches
+    void refit(const QVector<PatchBounds> &bounds, const QVector<int> &patches);
+
+    bool isEmpty() const {
+        return _nodes.isEmpty();
+    }
+
+    int numPatches() const {
+        return _patchOrder.size();
+    }
+
+    const QVector<Node> &nodes() const {
+        return _nodes;
+    }
+
+    bool isLeaf(int node) const {
+        return node >= numPatches() - 1;
+    }
+
+    /// Patch of a leaf node
+    int leafPatch(int node) const {
+        return _patchOrder[node - (numPatches() - 1)];
+    }
+
+    /*!
+     * \brief pick returns the first patch hit by a ray, or -1.
+     *
+     * Patches whose box is hit are tested against a coarse tessellation of
+     * the patch. The ray parameter of the hit is stored in distance.
+     */
+    int pick(const PatchStore &patches,
+             const QVector3D &origin,
+             const QVector3D &direction,
+             float *distance = nullptr) const;
+
+private:
+
+    int findSplit(int first, int last) const;
+
+    int commonPrefix(int i, int j) const;
+
+    void updateNode(int node, const QVector<PatchBounds> &bounds);
+
+    // =========================================================================
+    // -- Data members ---------------------------------------------------------
+    // =========================================================================
+
+private:
+
+    QVector<Node> _nodes;
+
+    /// Morton codes of the patches in sorted order
+    QVector<quint32> _codes;
+
+    /// Patch index for every leaf
+    QVector<int> _patchOrder;
+
+    /// Leaf node index for every patch
+    QVector<int> _leafOfPatch;
+
+};
+
+#endif // PATCHBVH_H
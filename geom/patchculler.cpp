@@ -0,0 +1,209 @@
+#include <geom/patchculler.h>
+
+#include <QPair>
+
+#include <algorithm>
+#include <cmath>
+
+// -----------------------------------------------------------------------------
+// -- Constructors and destructor ----------------------------------------------
+// -----------------------------------------------------------------------------
+
+PatchCuller::PatchCuller() :
+    _flags(CullFrustum),
+    _focalLength(1.0f),
+    _lod(nullptr),
+    _lodTolerance(0.0f),
+    _viewportHeight(0)
+{
+
+}
+
+// -----------------------------------------------------------------------------
+// -- Other Methods ------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+// --- Public ------------------------------------------------------------------
+
+void PatchCuller::setView(const QMatrix4x4 &modelViewMatrix,
+                          const QMatrix4x4 &projectionMatrix)
+{
+    // Gribb and Hartmann: the planes are sums of the rows of the combined
+    // matrix, which puts them in the space the matrix is applied to
+    const QMatrix4x4 m = projectionMatrix * modelViewMatrix;
+    const QVector4D w = m.row(3);
+    for (int i = 0; i < 3; ++i) {
+        _planes[2 * i] = w + m.row(i);
+        _planes[2 * i + 1] = w - m.row(i);
+    }
+    _eye = modelViewMatrix.inverted().map(QVector3D(0, 0, 0));
+    _focalLength = projectionMatrix(1, 1);
+}
+
+void PatchCuller::setLod(const PatchLOD *lod, float tolerance, int viewportHeight)
+{
+    _lod = lod;
+    _lodTolerance = tolerance;
+    _viewportHeight = viewportHeight;
+}
+
+bool PatchCuller::isVisible(const PatchBounds &bounds) const
+{
+    if (!bounds.isBounded) return true;
+    if ((_flags & CullFrustum) && !isInFrustum(bounds)) return false;
+    if ((_flags & CullBackPatches) && isBackFacing(bounds)) return false;
+    return true;
+}
+
+int PatchCuller::cull(const QVector<PatchBounds> &bounds, QVector<Run> &runs) const
+{
+    runs.clear();
+    int numVisible = 0;
+    for (int patch = 0; patch < bounds.size(); ++patch) {
+        if (!isVisible(bounds[patch])) continue;
+
+        if (!runs.isEmpty() && runs.last().first + runs.last().count == patch) {
+            ++runs.last().count;
+        } else {
+            runs.push_back({patch, 1});
+        }
+        ++numVisible;
+    }
+    return numVisible;
+}
+
+int PatchCuller::cull(const PatchBVH &bvh,
+                      const QVector<PatchBounds> &bounds,
+                      QVector<Run> &runs,
+                      QVector<int> *proxies) const
+{
+    runs.clear();
+    if (proxies) {
+        proxies->clear();
+    }
+    if (bvh.isEmpty()) return 0;
+    const bool useLod = proxies && _lod && !_lod->isEmpty() && _lodTolerance > 0.0f;
+
+    const QVector<PatchBVH::Node> &nodes = bvh.nodes();
+    QVector<int> visible;
+
+    // Node and whether it is known to be inside the frustum
+    QVector<QPair<int, bool>> stack;
+    stack.push_back(qMakePair(0, !(_flags & CullFrustum)));
+    while (!stack.isEmpty()) {
+        const QPair<int, bool> entry = stack.takeLast();
+        const int node = entry.first;
+        bool isInside = entry.second;
+        if (!isInside) {
+            const Containment containment =
+                    classify(nodes[node].minValues, nodes[node].maxValues);
+            if (containment == Outside) continue;
+            isInside = containment == Inside;
+        }
+
+        if (useLod && !bvh.isLeaf(node)) {
+            const int proxy = selectProxy(node, nodes[node].minValues, nodes[node].maxValues);
+            if (proxy >= 0) {
+                proxies->push_back(proxy);
+                continue;
+            }
+        }
+
+        if (bvh.isLeaf(node)) {
+            const int patch = bvh.leafPatch(node);
+            if (!(_flags & CullBackPatches) || !isBackFacing(bounds[patch])) {
+                visible.push_back(patch);
+            }
+        } else {
+            stack.push_back(qMakePair(nodes[node].left, isInside));
+            stack.push_back(qMakePair(nodes[node].right, isInside));
+        }
+    }
+
+    // Leaves are in Morton order, runs need the order of the index buffer
+    std::sort(visible.begin(), visible.end());
+    for (int patch : visible) {
+        if (!runs.isEmpty() && runs.last().first + runs.last().count == patch) {
+            ++runs.last().count;
+        } else {
+            runs.push_back({patch, 1});
+        }
+    }
+    return visible.size();
+}
+
+// --- Private -----------------------------------------------------------------
+
+PatchCuller::Containment PatchCuller::classify(const QVector3D &minValues,
+                                               const QVector3D &maxValues) const
+{
+    Containment result = Inside;
+    for (const QVector4D &plane : _planes) {
+        // Corners of the box furthest along and against the plane normal
+        const QVector4D positive(
+                    plane.x() >= 0.0f ? maxValues.x() : minValues.x(),
+                    plane.y() >= 0.0f ? maxValues.y() : minValues.y(),
+                    plane.z() >= 0.0f ? maxValues.z() : minValues.z(),
+                    1.0f);
+        if (QVector4D::dotProduct(plane, positive) < 0.0f) {
+            return Outside;
+        }
+        const QVector4D negative(
+                    plane.x() >= 0.0f ? minValues.x() : maxValues.x(),
+                    plane.y() >= 0.0f ? minValues.y() : maxValues.y(),
+                    plane.z() >= 0.0f ? minValues.z() : maxValues.z(),
+                    1.0f);
+        if (QVector4D::dotProduct(plane, negative) < 0.0f) {
+            result = Intersecting;
+        }
+    }
+    return result;
+}
+
+bool PatchCuller::isInFrustum(const PatchBounds &bounds) const
+{
+    return classify(bounds.minValues, bounds.maxValues) != Outside;
+}
+
+bool PatchCuller::isBackFacing(const PatchBounds &bounds) const
+{
+    if (!bounds.hasCone()) return false;
+
+    // Back facing if every direction from the eye to the bounding sphere
+    // makes an angle below 90 degrees with every normal in the cone
+    const QVector3D toCenter = bounds.center() - _eye;
+    const float distance = toCenter.length();
+    const float radius = bounds.radius();
+    if (distance <= radius) return false;
+
+    const float sinSphere = radius / distance;
+    const float cosSphere = std::sqrt(1.0f - sinSphere * sinSphere);
+    const float cosCone = bounds.coneCutoff;
+    const float sinCone = std::sqrt(std::max(0.0f, 1.0f - cosCone * cosCone));
+
+    // cos and sin of the sum of both half angles
+    if (cosCone * cosSphere - sinCone * sinSphere <= 0.0f) return false;
+    const float sinSum = sinCone * cosSphere + cosCone * sinSphere;
+
+    return QVector3D::dotProduct(bounds.coneAxis, toCenter / distance) > sinSum;
+}
+
+int PatchCuller::selectProxy(int node,
+                             const QVector3D &minValues,
+                             const QVector3D &maxValues) const
+{
+    const int proxy = _lod->proxyOfNode(node);
+    if (proxy < 0) return -1;
+
+    // Closest point of the box, the error projects largest there
+    const QVector3D closest(qBound(minValues.x(), _eye.x(), maxValues.x()),
+                            qBound(minValues.y(), _eye.y(), maxValues.y()),
+                            qBound(minValues.z(), _eye.z(), maxValues.z()));
+    const float distance = (closest - _eye).length();
+    if (distance <= 0.0f) return -1;
+
+    // Model and view space only differ by a uniform scale, which cancels
+    const float pixels = _lod->proxies()[proxy].error / distance *
+            _focalLength * 0.5f * _viewportHeight;
+    return pixels <= _lodTolerance ? proxy : -1;
+}
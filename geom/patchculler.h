@@ -0,0 +1,137 @@
+#ifndef PATCHCULLER_H
+#define PATCHCULLER_H
+
+#include <geom/patchbounds.h>
+#include <geom/patchbvh.h>
+#include <geom/patchlod.h>
+
+#include <QMatrix4x4>
+#include <QVector>
+#include <QVector3D>
+#include <QVector4D>
+
+/*!
+ * \brief The PatchCuller class
+ *
+ * Rejects patches before they reach the tessellation shaders. Patches are
+ * tested in model space: their boxes against the view frustum and their
+ * normal cones against the eye position. Surviving patches are returned as
+ * runs of consecutive patches, so they can be drawn from the unmodified
+ * index buffer with a single multi draw call.
+ */
+class PatchCuller
+{
+
+    // =========================================================================
+    // -- Enums and types ------------------------------------------------------
+    // =========================================================================
+
+public:
+
+    enum CullFlag {
+        CullFrustum = 0x1,
+        /// Only valid for closed, consistently oriented surfaces
+        CullBackPatches = 0x2
+    };
+
+    /// Consecutive visible patches
+    struct Run {
+        int first;
+        int count;
+    };
+
+    // =========================================================================
+    // -- Constructors and destructor ------------------------------------------
+    // =========================================================================
+
+public:
+
+    PatchCuller();
+
+    // =========================================================================
+    // -- Other methods --------------------------------------------------------
+    // =========================================================================
+
+public:
+
+    int getFlags() const {
+        return _flags;
+    }
+
+    void setFlags(int flags) {
+        _flags = flags;
+    }
+
+    void setView(const QMatrix4x4 &modelViewMatrix,
+                 const QMatrix4x4 &projectionMatrix);
+
+    /*!
+     * \brief setLod lets the hierarchy traversal draw proxies.
+     *
+     * A node is replaced by its proxy once the error of the proxy projects
+     * to at most tolerance pixels, the same unit as the ProjectionTolerance
+     * of the heuristics. A null lod or a tolerance of 0 disables proxies.
+     */
+    void setLod(const PatchLOD *lod, float tolerance, int viewportHeight);
+
+    bool isVisible(const PatchBounds &bounds) const;
+
+    /// Fills runs with the visible patches, returns the number of patches
+    int cull(const QVector<PatchBounds> &bounds, QVector<Run> &runs) const;
+
+    /// Same as above, but only visits the nodes of the hierarchy that
+    /// intersect the frustum. Nodes drawn as their proxy (see setLod) are
+    /// added to proxies instead, if given.
+    int cull(const PatchBVH &bvh,
+             const QVector<PatchBounds> &bounds,
+             QVector<Run> &runs,
+             QVector<int> *proxies = nullptr) const;
+
+private:
+
+    enum Containment {
+        Outside,
+        Intersecting,
+        Inside
+    };
+
+    Containment classify(const QVector3D &minValues,
+                         const QVector3D &maxValues) const;
+
+    bool isInFrustum(const PatchBounds &bounds) const;
+
+    bool isBackFacing(const PatchBounds &bounds) const;
+
+    /// Proxy that may replace a node from the eye position, or -1
+    int selectProxy(int node,
+                    const QVector3D &minValues,
+                    const QVector3D &maxValues) const;
+
+    // =========================================================================
+    // -- Data members ---------------------------------------------------------
+    // =========================================================================
+
+private:
+
+    int _flags;
+
+    /// Frustum planes in model space, inside if dot(plane, (p, 1)) >= 0
+    QVector4D _planes[6];
+
+    /// Eye position in model space
+    QVector3D _eye;
+
+    /// Element (1, 1) of the projection matrix, the cotangent of half the
+    /// vertical field of view
+    float _focalLength;
+
+    const PatchLOD *_lod;
+
+    /// In pixels
+    float _lodTolerance;
+
+    int _viewportHeight;
+
+};
+
+#endif // PATCHCULLER_H
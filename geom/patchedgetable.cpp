@@ -0,0 +1,142 @@
+#include <geom/patchedgetable.h>
+
+#include <geom/bezierquad.h>
+#include <geom/beziertriangle.h>
+
+#include <QtAlgorithms>
+
+#include <algorithm>
+
+namespace {
+
+/// Control points of the triangle edges u = 0, v = 0 and w = 0
+const int TRIANGLE_EDGES[3][PatchEdgeTable::EDGE_SIZE] = {
+    {BezierTriangle::B003, BezierTriangle::B012, BezierTriangle::B021, BezierTriangle::B030},
+    {BezierTriangle::B003, BezierTriangle::B102, BezierTriangle::B201, BezierTriangle::B300},
+    {BezierTriangle::B300, BezierTriangle::B210, BezierTriangle::B120, BezierTriangle::B030}
+};
+
+/// Patch edge with its control point indices in a canonical direction
+struct EdgeKey {
+    unsigned vertices[PatchEdgeTable::EDGE_SIZE];
+    /// Global patch number
+    int patch;
+    /// Position in the patch edge arrays
+    int type;
+    int patchEdge;
+
+    bool sameEdge(const EdgeKey &other) const {
+        return std::equal(vertices, vertices + PatchEdgeTable::EDGE_SIZE, other.vertices);
+    }
+
+    bool operator<(const EdgeKey &other) const {
+        return std::lexicographical_compare(
+                    vertices, vertices + PatchEdgeTable::EDGE_SIZE,
+                    other.vertices, other.vertices + PatchEdgeTable::EDGE_SIZE);
+    }
+};
+
+} // namespace
+
+// -----------------------------------------------------------------------------
+// -- Constructors and destructor ----------------------------------------------
+// -----------------------------------------------------------------------------
+
+PatchEdgeTable::PatchEdgeTable()
+{
+
+}
+
+// -----------------------------------------------------------------------------
+// -- Other Methods ------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+int PatchEdgeTable::edgeControlPoint(BezierPatch::Type type, int edge, int k)
+{
+    if (type == BezierPatch::TriPatch) {
+        return TRIANGLE_EDGES[edge][k];
+    }
+    // Same as edgePoint in quad_tess_control.glsl
+    switch (edge) {
+    case 0:
+        return BezierQuad::index(0, k);
+    case 1:
+        return BezierQuad::index(k, 0);
+    case 2:
+        return BezierQuad::index(3, k);
+    default:
+        return BezierQuad::index(k, 3);
+    }
+}
+
+void PatchEdgeTable::build(const PatchStore &patches)
+{
+    clear();
+
+    QVector<EdgeKey> keys;
+    for (int type = 0; type < BezierPatch::NUM_PATCH_TYPES; ++type) {
+        const BezierPatch::Type patchType = static_cast<BezierPatch::Type>(type);
+        const int edgesPerPatch = numEdges(patchType);
+        const int numPatches = patches.numPatches(patchType);
+        const int firstPatch = patches.firstPatch(patchType);
+        _patchEdges[type].resize(numPatches * edgesPerPatch);
+        keys.reserve(keys.size() + _patchEdges[type].size());
+
+        for (int patch = 0; patch < numPatches; ++patch) {
+            const unsigned *indices = patches.patchIndices(patchType, patch);
+            for (int edge = 0; edge < edgesPerPatch; ++edge) {
+                EdgeKey key;
+                for (int k = 0; k < EDGE_SIZE; ++k) {
+                    key.vertices[k] = indices[edgeControlPoint(patchType, edge, k)];
+                }
+                // Neighbours run along the edge in opposite directions
+                if (std::lexicographical_compare(
+                            std::reverse_iterator<unsigned *>(key.vertices + EDGE_SIZE),
+                            std::reverse_iterator<unsigned *>(key.vertices),
+                            key.vertices, key.vertices + EDGE_SIZE)) {
+                    std::reverse(key.vertices, key.vertices + EDGE_SIZE);
+                }
+                key.patch = firstPatch + patch;
+                key.type = type;
+                key.patchEdge = patch * edgesPerPatch + edge;
+                keys.push_back(key);
+            }
+        }
+    }
+
+    // Sorting keeps the table independent of hashing and thread timing
+    std::sort(keys.begin(), keys.end());
+    for (int i = 0; i < keys.size(); ++i) {
+        const EdgeKey &key = keys[i];
+        if (i == 0 || !key.sameEdge(keys[i - 1])) {
+            for (int k = 0; k < EDGE_SIZE; ++k) {
+                _edgeVertices.push_back(key.vertices[k]);
+            }
+            _edgePatches.push_back(key.patch);
+            _edgePatches.push_back(NO_PATCH);
+        } else if (_edgePatches.last() == NO_PATCH) {
+            _edgePatches.last() = key.patch;
+        }
+        _patchEdges[key.type][key.patchEdge] = size() - 1;
+    }
+}
+
+void PatchEdgeTable::clear()
+{
+    _edgeVertices.clear();
+    for (int type = 0; type < BezierPatch::NUM_PATCH_TYPES; ++type) {
+        _patchEdges[type].clear();
+    }
+    _edgePatches.clear();
+}
+
+int PatchEdgeTable::numBorderEdges() const
+{
+    int count = 0;
+    for (int edge = 0; edge < size(); ++edge) {
+        if (_edgePatches[2 * edge + 1] == NO_PATCH) {
+            ++count;
+        }
+    }
+    return count;
+}
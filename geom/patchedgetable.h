@@ -0,0 +1,106 @@
+#ifndef PATCHEDGETABLE_H
+#define PATCHEDGETABLE_H
+
+#include <geom/bezierpatch.h>
+#include <geom/patchstore.h>
+
+#include <QVector>
+
+/*!
+ * \brief The PatchEdgeTable class
+ *
+ * Unique boundary curves of the patches of a scene. Two patch edges are the
+ * same edge when they use the same four control point indices, in either
+ * direction, so shared edges are only found if the scene shares its
+ * vertices. Edge levels computed once per unique edge are the same for both
+ * patches by construction, whatever the heuristic does with the floating
+ * point arithmetic.
+ *
+ * Patch edges are in the order of gl_TessLevelOuter: u = 0, v = 0 and w = 0
+ * for triangles, u = 0, v = 0, u = 1 and v = 1 for quads.
+ */
+class PatchEdgeTable
+{
+
+    // =========================================================================
+    // -- Enums ----------------------------------------------------------------
+    // =========================================================================
+
+public:
+
+    enum {
+        /// Control points per edge
+        EDGE_SIZE = 4,
+        /// Second patch of a border edge
+        NO_PATCH = -1
+    };
+
+    // =========================================================================
+    // -- Constructors and destructor ------------------------------------------
+    // =========================================================================
+
+public:
+
+    PatchEdgeTable();
+
+    // =========================================================================
+    // -- Other methods --------------------------------------------------------
+    // =========================================================================
+
+public:
+
+    static int numEdges(BezierPatch::Type type) {
+        return type == BezierPatch::TriPatch ? 3 : 4;
+    }
+
+    /// Patch control point k of an edge, from corner to corner
+    static int edgeControlPoint(BezierPatch::Type type, int edge, int k);
+
+    void build(const PatchStore &patches);
+
+    void clear();
+
+    /// Number of unique edges
+    int size() const {
+        return _edgeVertices.size() / EDGE_SIZE;
+    }
+
+    bool isEmpty() const {
+        return _edgeVertices.isEmpty();
+    }
+
+    /// Four control point indices per unique edge
+    const QVector<unsigned> &edgeVertices() const {
+        return _edgeVertices;
+    }
+
+    /// Unique edge of every patch edge, numEdges(type) entries per patch of
+    /// the type
+    const QVector<unsigned> &patchEdges(BezierPatch::Type type) const {
+        return _patchEdges[type];
+    }
+
+    /// Two global patch numbers per unique edge, the second is NO_PATCH on
+    /// the border. Further patches of non manifold edges are left out.
+    const QVector<int> &edgePatches() const {
+        return _edgePatches;
+    }
+
+    /// Edges with a single patch
+    int numBorderEdges() const;
+
+    // =========================================================================
+    // -- Data members ---------------------------------------------------------
+    // =========================================================================
+
+private:
+
+    QVector<unsigned> _edgeVertices;
+
+    QVector<unsigned> _patchEdges[BezierPatch::NUM_PATCH_TYPES];
+
+    QVector<int> _edgePatches;
+
+};
+
+#endif // PATCHEDGETABLE_H
@@ -0,0 +1,183 @@
+#include <geom/patchinvariants.h>
+
+#include <geom/bezierquad.h>
+#include <geom/beziertriangle.h>
+#include <geom/parallelfor.h>
+#include <geom/patchedgetable.h>
+#include <geom/tessellationheuristic.h>
+
+#include <algorithm>
+
+static_assert(sizeof(PatchInvariants) == 12 * sizeof(float),
+              "PatchInvariants must match the std430 layout of the shaders");
+static_assert(sizeof(EdgeInvariants) == 2 * sizeof(float),
+              "EdgeInvariants must match the std430 layout of edge_levels.glsl");
+
+namespace {
+
+/// Patches per task
+const int GRAIN = 1024;
+
+inline QVector3D stripWeight(const QVector4D &homogeneous) {
+    return homogeneous.toVector3D() / homogeneous.w();
+}
+
+inline QVector4D mix(const QVector4D &a, const QVector4D &b, float t) {
+    return a + (b - a) * t;
+}
+
+/// Fills the edge invariants of a patch
+void setEdgeInvariants(BezierPatch::Type type, const QVector4D *cp, PatchInvariants &invariants) {
+    for (int e = 0; e < PatchEdgeTable::numEdges(type); ++e) {
+        const QVector4D &v0 = cp[PatchEdgeTable::edgeControlPoint(type, e, 0)];
+        const QVector4D &e0 = cp[PatchEdgeTable::edgeControlPoint(type, e, 1)];
+        const QVector4D &e1 = cp[PatchEdgeTable::edgeControlPoint(type, e, 2)];
+        const QVector4D &v1 = cp[PatchEdgeTable::edgeControlPoint(type, e, 3)];
+        invariants.edgeCurvature[e] = TessellationHeuristic::edgeCurvature(v0, e0, e1, v1);
+        invariants.edgeDeviation[e] = TessellationHeuristic::edgeDeviation(v0, e0, e1, v1);
+    }
+}
+
+QVector4D evaluateCubic(float t, const QVector4D &p0, const QVector4D &p1,
+                        const QVector4D &p2, const QVector4D &p3) {
+    const QVector4D A = mix(p0, p1, t);
+    const QVector4D B = mix(p1, p2, t);
+    const QVector4D C = mix(p2, p3, t);
+    return mix(mix(A, B, t), mix(B, C, t), t);
+}
+
+/// Same as interpolateNormal in quad_tess_control.glsl
+QVector3D interpolateQuadNormal(const QVector4D *cp, float u, float v) {
+    QVector4D left[4], right[4], bottom[4], top[4];
+    for (int k = 0; k < 4; ++k) {
+        const QVector4D *row = cp + BezierQuad::index(0, k);
+        const QVector4D A = mix(row[0], row[1], u);
+        const QVector4D B = mix(row[1], row[2], u);
+        const QVector4D C = mix(row[2], row[3], u);
+        left[k] = mix(A, B, u);
+        right[k] = mix(B, C, u);
+
+        const QVector4D D = mix(cp[BezierQuad::index(k, 0)], cp[BezierQuad::index(k, 1)], v);
+        const QVector4D E = mix(cp[BezierQuad::index(k, 1)], cp[BezierQuad::index(k, 2)], v);
+        const QVector4D F = mix(cp[BezierQuad::index(k, 2)], cp[BezierQuad::index(k, 3)], v);
+        bottom[k] = mix(D, E, v);
+        top[k] = mix(E, F, v);
+    }
+    const QVector3D du = stripWeight(evaluateCubic(v, right[0], right[1], right[2], right[3])) -
+            stripWeight(evaluateCubic(v, left[0], left[1], left[2], left[3]));
+    const QVector3D dv = stripWeight(evaluateCubic(u, top[0], top[1], top[2], top[3])) -
+            stripWeight(evaluateCubic(u, bottom[0], bottom[1], bottom[2], bottom[3]));
+    return QVector3D::crossProduct(du, dv).normalized();
+}
+
+} // namespace
+
+// -----------------------------------------------------------------------------
+// -- Constructors and destructor ----------------------------------------------
+// -----------------------------------------------------------------------------
+
+PatchInvariants::PatchInvariants() :
+    edgeCurvature{1.0f, 1.0f, 1.0f, 1.0f},
+    edgeDeviation{0.0f, 0.0f, 0.0f, 0.0f},
+    curvature(1.0f),
+    padding{0.0f, 0.0f, 0.0f}
+{
+
+}
+
+EdgeInvariants::EdgeInvariants() :
+    curvature(1.0f),
+    deviation(0.0f)
+{
+
+}
+
+// -----------------------------------------------------------------------------
+// -- Other Methods ------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+PatchInvariants PatchInvariants::fromTriangle(const QVector4D *controlPoints)
+{
+    PatchInvariants invariants;
+    setEdgeInvariants(BezierPatch::TriPatch, controlPoints, invariants);
+
+    // Normal of the flat triangle, like tess_control.glsl
+    const QVector3D v0 = stripWeight(controlPoints[BezierTriangle::B003]);
+    const QVector3D v1 = stripWeight(controlPoints[BezierTriangle::B300]);
+    const QVector3D v2 = stripWeight(controlPoints[BezierTriangle::B030]);
+    const QVector3D N = QVector3D::crossProduct(
+                (v1 - v0).normalized(), (v2 - v0).normalized()).normalized();
+    invariants.curvature = TessellationHeuristic::calculateCurvature(controlPoints, N);
+    return invariants;
+}
+
+PatchInvariants PatchInvariants::fromQuad(const QVector4D *controlPoints)
+{
+    PatchInvariants invariants;
+    setEdgeInvariants(BezierPatch::QuadPatch, controlPoints, invariants);
+
+    // Normal of the flat quad from its diagonals, like quad_tess_control.glsl
+    const QVector3D v00 = stripWeight(controlPoints[BezierQuad::B00]);
+    const QVector3D v30 = stripWeight(controlPoints[BezierQuad::B30]);
+    const QVector3D v03 = stripWeight(controlPoints[BezierQuad::B03]);
+    const QVector3D v33 = stripWeight(controlPoints[BezierQuad::B33]);
+    const QVector3D N = QVector3D::crossProduct(v33 - v00, v03 - v30).normalized();
+
+    // Corners, center and edge midpoints
+    const float samples[9][2] = {
+        {0.0f, 0.0f}, {1.0f, 0.0f}, {0.0f, 1.0f}, {1.0f, 1.0f}, {0.5f, 0.5f},
+        {0.0f, 0.5f}, {0.5f, 0.0f}, {1.0f, 0.5f}, {0.5f, 1.0f}
+    };
+    float f = 1.0f;
+    for (int i = 0; i < 9; ++i) {
+        f = std::min(QVector3D::dotProduct(
+                         interpolateQuadNormal(controlPoints, samples[i][0], samples[i][1]), N), f);
+    }
+    invariants.curvature = f;
+    return invariants;
+}
+
+PatchInvariants PatchInvariants::fromPatch(BezierPatch::Type type, const QVector4D *controlPoints)
+{
+    if (type == BezierPatch::TriPatch) {
+        return fromTriangle(controlPoints);
+    }
+    return fromQuad(controlPoints);
+}
+
+QVector<PatchInvariants> PatchInvariants::fromPatches(const PatchStore &patches)
+{
+    QVector<PatchInvariants> invariants(patches.size());
+    PatchInvariants *out = invariants.data();
+    Parallel::parallelFor(patches.size(), GRAIN, [&patches, out](int patch) {
+        const BezierPatch::Type type = patches.patchType(patch);
+        QVector4D controlPoints[BezierQuad::NUM_CONTROL_POINTS];
+        patches.gatherControlPoints(type, patch - patches.firstPatch(type), controlPoints);
+        out[patch] = fromPatch(type, controlPoints);
+    });
+    return invariants;
+}
+
+EdgeInvariants EdgeInvariants::fromEdge(const QVector4D &v0, const QVector4D &e0,
+                                        const QVector4D &e1, const QVector4D &v1)
+{
+    EdgeInvariants invariants;
+    invariants.curvature = TessellationHeuristic::edgeCurvature(v0, e0, e1, v1);
+    invariants.deviation = TessellationHeuristic::edgeDeviation(v0, e0, e1, v1);
+    return invariants;
+}
+
+QVector<EdgeInvariants> EdgeInvariants::fromEdges(const PatchEdgeTable &edges,
+                                                  const QVector<QVector4D> &controlPoints)
+{
+    QVector<EdgeInvariants> invariants(edges.size());
+    EdgeInvariants *out = invariants.data();
+    const unsigned *indices = edges.edgeVertices().constData();
+    const QVector4D *points = controlPoints.constData();
+    Parallel::parallelFor(edges.size(), GRAIN, [indices, points, out](int edge) {
+        const unsigned *edgeIndices = indices + edge * PatchEdgeTable::EDGE_SIZE;
+        out[edge] = fromEdge(points[edgeIndices[0]], points[edgeIndices[1]],
+                points[edgeIndices[2]], points[edgeIndices[3]]);
+    });
+    return invariants;
+}
@@ -0,0 +1,77 @@
+#ifndef PATCHINVARIANTS_H
+#define PATCHINVARIANTS_H
+
+#include <geom/bezierpatch.h>
+#include <geom/patchedgetable.h>
+#include <geom/patchstore.h>
+
+#include <QVector>
+#include <QVector4D>
+
+/*!
+ * \brief The PatchInvariants struct
+ *
+ * View independent inputs of the tessellation heuristics of a single patch,
+ * computed once per scene instead of in every frame by the tessellation
+ * control shaders. The model view matrix only rotates, translates and
+ * scales uniformly, so the cosines below do not change with the view and
+ * the deviations only scale with the matrix.
+ *
+ * The layout is the std430 PatchInvariants struct in the control shaders.
+ * Edges are in the order of gl_TessLevelOuter, triangles leave the fourth
+ * edge unused.
+ */
+struct PatchInvariants
+{
+    PatchInvariants();
+
+    /// Smallest cosine between the tangents of an edge and its chord
+    float edgeCurvature[4];
+
+    /// Largest distance of the inner control points of an edge from its
+    /// chord, in model coordinates
+    float edgeDeviation[4];
+
+    /// Smallest cosine between the surface normals and the flat normal
+    float curvature;
+
+    float padding[3];
+
+    static PatchInvariants fromTriangle(const QVector4D *controlPoints);
+
+    static PatchInvariants fromQuad(const QVector4D *controlPoints);
+
+    static PatchInvariants fromPatch(BezierPatch::Type type, const QVector4D *controlPoints);
+
+    /// Invariants of all patches by global patch number, computed on the
+    /// global thread pool
+    static QVector<PatchInvariants> fromPatches(const PatchStore &patches);
+};
+
+/*!
+ * \brief The EdgeInvariants struct
+ *
+ * View independent heuristic inputs of a unique edge of a PatchEdgeTable,
+ * the same values as in the PatchInvariants of both of its patches. The
+ * layout is the std430 EdgeInvariants struct in edge_levels.glsl.
+ */
+struct EdgeInvariants
+{
+    EdgeInvariants();
+
+    /// See PatchInvariants::edgeCurvature
+    float curvature;
+
+    /// See PatchInvariants::edgeDeviation
+    float deviation;
+
+    static EdgeInvariants fromEdge(const QVector4D &v0, const QVector4D &e0,
+                                   const QVector4D &e1, const QVector4D &v1);
+
+    /// Invariants of every edge of the table, computed on the global thread
+    /// pool
+    static QVector<EdgeInvariants> fromEdges(const PatchEdgeTable &edges,
+                                             const QVector<QVector4D> &controlPoints);
+};
+
+#endif // PATCHINVARIANTS_H
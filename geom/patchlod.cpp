@@ -0,0 +1,314 @@
+#include <geom/patchlod.h>
+
+#include <geom/bezierquad.h>
+#include <geom/beziertriangletessellator.h>
+#include <geom/parallelfor.h>
+#include <geom/patchinvariants.h>
+
+#include <QAtomicInt>
+#include <QHash>
+#include <QSet>
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+
+namespace {
+
+/// Grid level of the patches in the input of the lowest proxies
+const int PATCH_LEVEL = 2;
+
+/// A proxy is only kept if it has at most this many triangles per patch,
+/// otherwise drawing the patches is not much slower
+const float MAX_TRIANGLES_PER_PATCH = 0.5f;
+
+/// Positions and triangles before and after clustering
+struct Mesh {
+    QVector<QVector3D> positions;
+    QVector<QVector3D> normals;
+    QVector<unsigned> indices;
+    float error;
+};
+
+/// Index of (i, j) in a triangular grid of the given level, row by row in j
+int gridIndex(int i, int j, int level) {
+    return j * (level + 1) - (j * (j - 1)) / 2 + i;
+}
+
+/// Distance between a patch and its PATCH_LEVEL grid, estimated from the
+/// edge deviations. The deviation of a segment from its chord shrinks with
+/// the square of the number of segments.
+float gridError(BezierPatch::Type type, const QVector4D *controlPoints) {
+    const PatchInvariants invariants = PatchInvariants::fromPatch(type, controlPoints);
+    const float deviation = *std::max_element(invariants.edgeDeviation,
+                                              invariants.edgeDeviation + 4);
+    return deviation / (PATCH_LEVEL * PATCH_LEVEL);
+}
+
+/// Appends the PATCH_LEVEL grid of a patch, returns its gridError()
+float appendPatch(const PatchStore &patches, int patch, Mesh &mesh) {
+    QVector4D controlPoints[BezierQuad::NUM_CONTROL_POINTS];
+    const BezierPatch::Type type = patches.patchType(patch);
+    patches.gatherControlPoints(type, patch - patches.firstPatch(type), controlPoints);
+    const unsigned base = mesh.positions.size();
+
+    if (type == BezierPatch::TriPatch) {
+        for (int j = 0; j <= PATCH_LEVEL; ++j) {
+            for (int i = 0; i + j <= PATCH_LEVEL; ++i) {
+                const float u = static_cast<float>(i) / PATCH_LEVEL;
+                const float v = static_cast<float>(j) / PATCH_LEVEL;
+                mesh.positions.push_back(BezierTriangleTessellator::evaluate(
+                                             controlPoints, QVector3D(u, v, 1.0f - u - v)));
+            }
+        }
+        for (int j = 0; j < PATCH_LEVEL; ++j) {
+            for (int i = 0; i + j < PATCH_LEVEL; ++i) {
+                const unsigned a = base + gridIndex(i, j, PATCH_LEVEL);
+                const unsigned b = base + gridIndex(i + 1, j, PATCH_LEVEL);
+                const unsigned c = base + gridIndex(i, j + 1, PATCH_LEVEL);
+                mesh.indices << a << b << c;
+                if (i + j + 1 < PATCH_LEVEL) {
+                    const unsigned d = base + gridIndex(i + 1, j + 1, PATCH_LEVEL);
+                    mesh.indices << b << d << c;
+                }
+            }
+        }
+    } else {
+        for (int j = 0; j <= PATCH_LEVEL; ++j) {
+            for (int i = 0; i <= PATCH_LEVEL; ++i) {
+                mesh.positions.push_back(BezierQuad::evaluate(
+                                             controlPoints,
+                                             static_cast<float>(i) / PATCH_LEVEL,
+                                             static_cast<float>(j) / PATCH_LEVEL));
+            }
+        }
+        for (int j = 0; j < PATCH_LEVEL; ++j) {
+            for (int i = 0; i < PATCH_LEVEL; ++i) {
+                const unsigned a = base + j * (PATCH_LEVEL + 1) + i;
+                const unsigned c = a + PATCH_LEVEL + 1;
+                mesh.indices << a << a + 1 << c;
+                mesh.indices << a + 1 << c + 1 << c;
+            }
+        }
+    }
+    return gridError(type, controlPoints);
+}
+
+/// Appends the patches below a node without a proxy, returns the largest
+/// error of their grids
+float appendSubtree(const PatchStore &patches, const PatchBVH &bvh, int node, Mesh &mesh) {
+    const QVector<PatchBVH::Node> &nodes = bvh.nodes();
+    QVector<int> stack;
+    stack.push_back(node);
+    float error = 0.0f;
+    while (!stack.isEmpty()) {
+        const int current = stack.takeLast();
+        if (bvh.isLeaf(current)) {
+            error = std::max(error, appendPatch(patches, bvh.leafPatch(current), mesh));
+        } else {
+            stack.push_back(nodes[current].left);
+            stack.push_back(nodes[current].right);
+        }
+    }
+    return error;
+}
+
+void appendMesh(const Mesh &source, Mesh &mesh) {
+    const unsigned base = mesh.positions.size();
+    mesh.positions += source.positions;
+    for (unsigned index : source.indices) {
+        mesh.indices.push_back(base + index);
+    }
+}
+
+/*!
+ * Merges the vertices in the same cell of a GRID_SIZE^3 grid over the box
+ * into their average, then drops the triangles that collapsed and the
+ * duplicates. Normals are area weighted over the remaining triangles.
+ */
+Mesh cluster(const Mesh &input, const QVector3D &minValues, const QVector3D &maxValues) {
+    const QVector3D extent = maxValues - minValues;
+    const float cellSize = std::max(
+                std::max(std::max(extent.x(), extent.y()), extent.z()) / PatchLOD::GRID_SIZE,
+                std::numeric_limits<float>::min());
+
+    QHash<int, unsigned> clusterOfCell;
+    QVector<unsigned> clusterOfVertex(input.positions.size());
+    QVector<int> counts;
+    Mesh mesh;
+    for (int vertex = 0; vertex < input.positions.size(); ++vertex) {
+        const QVector3D cell = (input.positions[vertex] - minValues) / cellSize;
+        const auto clamp = [](float f) {
+            return qBound(0, static_cast<int>(f), PatchLOD::GRID_SIZE - 1);
+        };
+        const int key = (clamp(cell.x()) * PatchLOD::GRID_SIZE + clamp(cell.y())) *
+                PatchLOD::GRID_SIZE + clamp(cell.z());
+        auto it = clusterOfCell.find(key);
+        if (it == clusterOfCell.end()) {
+            it = clusterOfCell.insert(key, mesh.positions.size());
+            mesh.positions.push_back(QVector3D());
+            counts.push_back(0);
+        }
+        mesh.positions[*it] += input.positions[vertex];
+        ++counts[*it];
+        clusterOfVertex[vertex] = *it;
+    }
+    for (int i = 0; i < mesh.positions.size(); ++i) {
+        mesh.positions[i] /= counts[i];
+    }
+
+    // Furthest any vertex moved, at most the cell diagonal
+    float moved = 0.0f;
+    for (int vertex = 0; vertex < input.positions.size(); ++vertex) {
+        moved = std::max(moved, (mesh.positions[clusterOfVertex[vertex]] -
+                                 input.positions[vertex]).length());
+    }
+    mesh.error = input.error + moved;
+
+    // Fewer than 2^21 clusters, so a sorted triangle fits in 64 bits
+    QSet<quint64> triangles;
+    mesh.normals.fill(QVector3D(), mesh.positions.size());
+    for (int i = 0; i + 2 < input.indices.size(); i += 3) {
+        const unsigned a = clusterOfVertex[input.indices[i]];
+        const unsigned b = clusterOfVertex[input.indices[i + 1]];
+        const unsigned c = clusterOfVertex[input.indices[i + 2]];
+        if (a == b || b == c || a == c) continue;
+
+        quint64 sorted[3] = {a, b, c};
+        std::sort(sorted, sorted + 3);
+        const quint64 key = sorted[0] << 42 | sorted[1] << 21 | sorted[2];
+        if (triangles.contains(key)) continue;
+        triangles.insert(key);
+
+        mesh.indices << a << b << c;
+        const QVector3D normal = QVector3D::crossProduct(
+                    mesh.positions[b] - mesh.positions[a],
+                    mesh.positions[c] - mesh.positions[a]);
+        mesh.normals[a] += normal;
+        mesh.normals[b] += normal;
+        mesh.normals[c] += normal;
+    }
+    for (QVector3D &normal : mesh.normals) {
+        normal.normalize();
+    }
+    return mesh;
+}
+
+} // namespace
+
+// -----------------------------------------------------------------------------
+// -- Constructors and destructor ----------------------------------------------
+// -----------------------------------------------------------------------------
+
+PatchLOD::PatchLOD()
+{
+
+}
+
+// -----------------------------------------------------------------------------
+// -- Other Methods ------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+void PatchLOD::build(const PatchStore &patches, const PatchBVH &bvh)
+{
+    clear();
+    const int n = bvh.numPatches();
+    if (n < MIN_PATCHES || n != patches.size()) return;
+    const QVector<PatchBVH::Node> &nodes = bvh.nodes();
+
+    // Patches below every internal node, the second child to arrive at a
+    // node computes it like in PatchBVH::refit
+    QVector<int> leafCounts(n - 1, 0);
+    {
+        QVector<char> visits(n - 1, 0);
+        const auto leafCount = [&](int node) {
+            return bvh.isLeaf(node) ? 1 : leafCounts[node];
+        };
+        for (int i = 0; i < n; ++i) {
+            int node = nodes[n - 1 + i].parent;
+            while (node >= 0 && ++visits[node] == 2) {
+                leafCounts[node] = leafCount(nodes[node].left) + leafCount(nodes[node].right);
+                node = nodes[node].parent;
+            }
+        }
+    }
+
+    // Nodes with a proxy form the top of the tree: the parent of such a
+    // node has even more patches below it
+    QVector<int> lodNodes;
+    QVector<int> slotOfNode(n - 1, -1);
+    for (int node = 0; node < n - 1; ++node) {
+        if (leafCounts[node] >= MIN_PATCHES) {
+            slotOfNode[node] = lodNodes.size();
+            lodNodes.push_back(node);
+        }
+    }
+    const auto hasProxy = [&](int node) {
+        return !bvh.isLeaf(node) && slotOfNode[node] >= 0;
+    };
+
+    // A node is built by the last of its children with a proxy to finish,
+    // starting at the nodes without such children
+    std::unique_ptr<QAtomicInt[]> pending(new QAtomicInt[lodNodes.size()]);
+    QVector<int> firstNodes;
+    for (int slot = 0; slot < lodNodes.size(); ++slot) {
+        const PatchBVH::Node &node = nodes[lodNodes[slot]];
+        const int numChildren = int(hasProxy(node.left)) + int(hasProxy(node.right));
+        pending[slot].storeRelaxed(numChildren);
+        if (numChildren == 0) {
+            firstNodes.push_back(lodNodes[slot]);
+        }
+    }
+
+    QVector<Mesh> meshes(lodNodes.size());
+    Mesh *built = meshes.data();
+    QAtomicInt *counters = pending.get();
+    Parallel::parallelFor(firstNodes.size(), 1, [&](int i) {
+        int node = firstNodes[i];
+        for (;;) {
+            Mesh input;
+            input.error = 0.0f;
+            for (const int child : {nodes[node].left, nodes[node].right}) {
+                if (hasProxy(child)) {
+                    const Mesh &proxy = built[slotOfNode[child]];
+                    appendMesh(proxy, input);
+                    input.error = std::max(input.error, proxy.error);
+                } else {
+                    input.error = std::max(input.error,
+                                           appendSubtree(patches, bvh, child, input));
+                }
+            }
+            built[slotOfNode[node]] = cluster(input, nodes[node].minValues, nodes[node].maxValues);
+
+            node = nodes[node].parent;
+            if (node < 0 || counters[slotOfNode[node]].fetchAndAddOrdered(-1) != 1) break;
+        }
+    });
+
+    _nodeProxies.fill(-1, n - 1);
+    for (int slot = 0; slot < lodNodes.size(); ++slot) {
+        const Mesh &mesh = meshes[slot];
+        const int numTriangles = mesh.indices.size() / 3;
+        if (numTriangles == 0 ||
+                numTriangles > MAX_TRIANGLES_PER_PATCH * leafCounts[lodNodes[slot]]) {
+            continue;
+        }
+        _nodeProxies[lodNodes[slot]] = _proxies.size();
+        _proxies.push_back({_indices.size(), mesh.indices.size(), _vertices.size(), mesh.error});
+        for (int i = 0; i < mesh.positions.size(); ++i) {
+            _vertices.push_back({mesh.positions[i], mesh.normals[i]});
+        }
+        _indices += mesh.indices;
+    }
+    if (_proxies.isEmpty()) {
+        _nodeProxies.clear();
+    }
+}
+
+void PatchLOD::clear()
+{
+    _nodeProxies.clear();
+    _proxies.clear();
+    _vertices.clear();
+    _indices.clear();
+}
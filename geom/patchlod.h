@@ -0,0 +1,114 @@
+#ifndef PATCHLOD_H
+#define PATCHLOD_H
+
+#include <geom/patchbvh.h>
+#include <geom/patchstore.h>
+
+#include <QVector>
+#include <QVector3D>
+
+/*!
+ * \brief The PatchLOD class
+ *
+ * Simplified triangle meshes (proxies) for the large nodes of a PatchBVH.
+ * A distant sub-assembly is drawn as the proxy of its node, instead of
+ * culling, tessellating and shading every one of its patches.
+ *
+ * Proxies are built bottom up by vertex clustering: the input of a node is
+ * the proxy of a child, or a coarse grid of every patch below a child that
+ * is too small for a proxy. The clusters are the cells of a GRID_SIZE^3
+ * grid over the box of the node. The error of a proxy is the furthest any
+ * vertex moved to its cluster, plus the error of its input. The error of a
+ * patch grid is estimated from the edge deviations of its PatchInvariants.
+ */
+class PatchLOD
+{
+
+    // =========================================================================
+    // -- Enums and types ------------------------------------------------------
+    // =========================================================================
+
+public:
+
+    /// Smallest number of patches below a node with a proxy
+    static const int MIN_PATCHES = 1024;
+
+    /// Cells per axis of the clustering grid
+    static const int GRID_SIZE = 16;
+
+    /// The attributes of shaders/lod/vertex.glsl
+    struct Vertex {
+        QVector3D position;
+        QVector3D normal;
+    };
+
+    struct Proxy {
+        /// Range in indices(), relative to baseVertex
+        int firstIndex;
+        int numIndices;
+        int baseVertex;
+        /// Distance between the proxy and the patches, in model coordinates
+        float error;
+    };
+
+    // =========================================================================
+    // -- Constructors and destructor ------------------------------------------
+    // =========================================================================
+
+public:
+
+    PatchLOD();
+
+    // =========================================================================
+    // -- Other methods --------------------------------------------------------
+    // =========================================================================
+
+public:
+
+    /// Builds the proxies of a hierarchy over the patches on the global
+    /// thread pool, scenes below MIN_PATCHES get none
+    void build(const PatchStore &patches, const PatchBVH &bvh);
+
+    void clear();
+
+    bool isEmpty() const {
+        return _proxies.isEmpty();
+    }
+
+    /// Proxy of a node of the hierarchy, or -1
+    int proxyOfNode(int node) const {
+        return node < _nodeProxies.size() ? _nodeProxies[node] : -1;
+    }
+
+    const QVector<Proxy> &proxies() const {
+        return _proxies;
+    }
+
+    /// Vertices of all proxies
+    const QVector<Vertex> &vertices() const {
+        return _vertices;
+    }
+
+    /// Triangles of all proxies
+    const QVector<unsigned> &indices() const {
+        return _indices;
+    }
+
+    // =========================================================================
+    // -- Data members ---------------------------------------------------------
+    // =========================================================================
+
+private:
+
+    /// Proxy per internal node, empty without proxies
+    QVector<int> _nodeProxies;
+
+    QVector<Proxy> _proxies;
+
+    QVector<Vertex> _vertices;
+
+    QVector<unsigned> _indices;
+
+};
+
+#endif // PATCHLOD_H
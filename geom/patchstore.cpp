@@ -0,0 +1,54 @@
+#include <geom/patchstore.h>
+
+// -----------------------------------------------------------------------------
+// -- Constructors and destructor ----------------------------------------------
+// -----------------------------------------------------------------------------
+
+PatchStore::PatchStore()
+{
+
+}
+
+PatchStore::PatchStore(
+        const QVector<QVector4D> &controlPoints,
+        const QVector<unsigned> &triangleIndices,
+        const QVector<unsigned> &quadIndices) :
+    _controlPoints(controlPoints)
+{
+    Q_ASSERT(triangleIndices.size() % BezierTriangle::NUM_CONTROL_POINTS == 0);
+    Q_ASSERT(quadIndices.size() % BezierQuad::NUM_CONTROL_POINTS == 0);
+    _indices[BezierPatch::TriPatch] = triangleIndices;
+    _indices[BezierPatch::QuadPatch] = quadIndices;
+}
+
+// -----------------------------------------------------------------------------
+// -- Other Methods ------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+// --- Public ------------------------------------------------------------------
+
+int PatchStore::size() const {
+    return numPatches(BezierPatch::TriPatch) + numPatches(BezierPatch::QuadPatch);
+}
+
+void PatchStore::addTriangle(const QVector4D *controlPoints) {
+    QVector<unsigned> &indices = _indices[BezierPatch::TriPatch];
+    for (int i = 0; i < BezierTriangle::NUM_CONTROL_POINTS; ++i) {
+        indices.push_back(_controlPoints.size());
+        _controlPoints.push_back(controlPoints[i]);
+    }
+}
+
+void PatchStore::addQuad(const QVector4D *controlPoints) {
+    QVector<unsigned> &indices = _indices[BezierPatch::QuadPatch];
+    for (int i = 0; i < BezierQuad::NUM_CONTROL_POINTS; ++i) {
+        indices.push_back(_controlPoints.size());
+        _controlPoints.push_back(controlPoints[i]);
+    }
+}
+
+void PatchStore::clear() {
+    _controlPoints.clear();
+    _indices[BezierPatch::TriPatch].clear();
+    _indices[BezierPatch::QuadPatch].clear();
+}
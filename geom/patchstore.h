@@ -0,0 +1,141 @@
+#ifndef PATCHSTORE_H
+#define PATCHSTORE_H
+
+#include <geom/bezierpatch.h>
+#include <geom/bezierquad.h>
+#include <geom/beziertriangle.h>
+
+#include <QVector>
+#include <QVector4D>
+
+/*!
+ * \brief The PatchStore class
+ *
+ * Flat storage of all patches of a scene. Control points live once in a
+ * shared array, patches are stored as contiguous index arrays, one per patch
+ * type, in the same layout as the index buffers on the GPU.
+ *
+ * Patches are also numbered globally, triangles first and quads after them.
+ * Bounds, culling and picking use the global numbers.
+ *
+ * The arrays are implicitly shared with the BezierSceneData they are created
+ * from, so wrapping imported data does not copy it.
+ */
+class PatchStore
+{
+
+    // =========================================================================
+    // -- Constructors and destructor ------------------------------------------
+    // =========================================================================
+
+public:
+
+    PatchStore();
+
+    PatchStore(const QVector<QVector4D> &controlPoints,
+               const QVector<unsigned> &triangleIndices,
+               const QVector<unsigned> &quadIndices = QVector<unsigned>());
+
+    // =========================================================================
+    // -- Other methods --------------------------------------------------------
+    // =========================================================================
+
+public:
+
+    static int numControlPoints(BezierPatch::Type type) {
+        if (type == BezierPatch::TriPatch) {
+            return BezierTriangle::NUM_CONTROL_POINTS;
+        }
+        return BezierQuad::NUM_CONTROL_POINTS;
+    }
+
+    /// Number of patches of all types
+    int size() const;
+
+    bool isEmpty() const {
+        return size() == 0;
+    }
+
+    int numPatches(BezierPatch::Type type) const {
+        return _indices[type].size() / numControlPoints(type);
+    }
+
+    /// Global number of the first patch of a type
+    int firstPatch(BezierPatch::Type type) const {
+        return type == BezierPatch::TriPatch ? 0 : numPatches(BezierPatch::TriPatch);
+    }
+
+    BezierPatch::Type patchType(int patch) const {
+        return patch < numPatches(BezierPatch::TriPatch) ?
+                    BezierPatch::TriPatch : BezierPatch::QuadPatch;
+    }
+
+    const QVector<QVector4D> &controlPoints() const {
+        return _controlPoints;
+    }
+
+    const QVector<unsigned> &indices(BezierPatch::Type type) const {
+        return _indices[type];
+    }
+
+    const unsigned *patchIndices(BezierPatch::Type type, int patch) const {
+        return _indices[type].constData() + patch * numControlPoints(type);
+    }
+
+    /// Copies the control points of the patch-th patch of a type to out
+    void gatherControlPoints(BezierPatch::Type type, int patch, QVector4D *out) const {
+        const unsigned *indices = patchIndices(type, patch);
+        const QVector4D *points = _controlPoints.constData();
+        for (int i = 0; i < numControlPoints(type); ++i) {
+            out[i] = points[indices[i]];
+        }
+    }
+
+    /// Calls f(patch, controlPoints) for every triangle patch
+    template<typename F>
+    void forEachTriangle(F f) const {
+        QVector4D controlPoints[BezierTriangle::NUM_CONTROL_POINTS];
+        const int count = numPatches(BezierPatch::TriPatch);
+        for (int patch = 0; patch < count; ++patch) {
+            gatherControlPoints(BezierPatch::TriPatch, patch, controlPoints);
+            f(patch, static_cast<const QVector4D *>(controlPoints));
+        }
+    }
+
+    /// Calls f(patch, controlPoints) for every quad patch
+    template<typename F>
+    void forEachQuad(F f) const {
+        QVector4D controlPoints[BezierQuad::NUM_CONTROL_POINTS];
+        const int count = numPatches(BezierPatch::QuadPatch);
+        for (int patch = 0; patch < count; ++patch) {
+            gatherControlPoints(BezierPatch::QuadPatch, patch, controlPoints);
+            f(patch, static_cast<const QVector4D *>(controlPoints));
+        }
+    }
+
+    /// Appends a triangle with its own control points
+    void addTriangle(const QVector4D *controlPoints);
+
+    /// Appends a quad with its own control points
+    void addQuad(const QVector4D *controlPoints);
+
+    void setControlPoint(unsigned index, const QVector4D &point) {
+        _controlPoints[index] = point;
+    }
+
+    void clear();
+
+    // =========================================================================
+    // -- Data members ---------------------------------------------------------
+    // =========================================================================
+
+private:
+
+    QVector<QVector4D> _controlPoints;
+
+    /// Indices into _controlPoints, indexed by BezierPatch::Type
+    QVector<unsigned> _indices[BezierPatch::NUM_PATCH_TYPES];
+
+};
+
+#endif // PATCHSTORE_H
@@ -0,0 +1,474 @@
+#include <geom/patchsubdivision.h>
+#include <geom/simdlane.h>
+
+#include <QHash>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+using namespace SimdLane;
+
+const int NUM_CONTROL_POINTS = BezierTriangle::NUM_CONTROL_POINTS;
+
+/// Corners of the domain, in (u, v, w)
+const QVector3D CORNER_U(1.0f, 0.0f, 0.0f);
+const QVector3D CORNER_V(0.0f, 1.0f, 0.0f);
+const QVector3D CORNER_W(0.0f, 0.0f, 1.0f);
+
+/// Edge lengths below this count as a degenerate patch
+const float MIN_EDGE_LENGTH = 1e-12f;
+
+/// Control points of sub patches closer than this, relative to the size of
+/// the scene, are the same point
+const float WELD_TOLERANCE = 1e-5f;
+
+/// u and v exponents of the control points, in BezierTriangle order
+const int EXPONENTS[NUM_CONTROL_POINTS][2] = {
+    {0, 0}, {1, 0}, {2, 0}, {3, 0}, {2, 1}, {1, 2}, {0, 3}, {0, 2}, {0, 1}, {1, 1}
+};
+
+inline QVector3D projectTo3D(const QVector4D &v) {
+    return v.toVector3D() / v.w();
+}
+
+/// Least squares inverse of the degree elevation, (E^T E)^-1 E^T
+struct ReductionMatrix
+{
+    ReductionMatrix() {
+        double elevation[PatchSubdivision::NUM_QUARTIC_CONTROL_POINTS][NUM_CONTROL_POINTS] = {};
+        for (int j = 0; j <= 4; ++j) {
+            for (int i = 0; i + j <= 4; ++i) {
+                const int k = 4 - i - j;
+                double *row = elevation[PatchSubdivision::quarticIndex(i, j)];
+                if (i > 0) row[BezierTriangle::index(i - 1, j)] += i / 4.0;
+                if (j > 0) row[BezierTriangle::index(i, j - 1)] += j / 4.0;
+                if (k > 0) row[BezierTriangle::index(i, j)] += k / 4.0;
+            }
+        }
+
+        // Gauss-Jordan on [E^T E | E^T], the normal matrix is positive definite
+        const int columns = NUM_CONTROL_POINTS + PatchSubdivision::NUM_QUARTIC_CONTROL_POINTS;
+        double system[NUM_CONTROL_POINTS][columns] = {};
+        for (int r = 0; r < NUM_CONTROL_POINTS; ++r) {
+            for (int q = 0; q < PatchSubdivision::NUM_QUARTIC_CONTROL_POINTS; ++q) {
+                for (int c = 0; c < NUM_CONTROL_POINTS; ++c) {
+                    system[r][c] += elevation[q][r] * elevation[q][c];
+                }
+                system[r][NUM_CONTROL_POINTS + q] = elevation[q][r];
+            }
+        }
+        for (int pivot = 0; pivot < NUM_CONTROL_POINTS; ++pivot) {
+            const double scale = 1.0 / system[pivot][pivot];
+            for (int c = 0; c < columns; ++c) {
+                system[pivot][c] *= scale;
+            }
+            for (int r = 0; r < NUM_CONTROL_POINTS; ++r) {
+                const double factor = system[r][pivot];
+                if (r == pivot || factor == 0.0) {
+                    continue;
+                }
+                for (int c = 0; c < columns; ++c) {
+                    system[r][c] -= factor * system[pivot][c];
+                }
+            }
+        }
+        for (int r = 0; r < NUM_CONTROL_POINTS; ++r) {
+            for (int q = 0; q < PatchSubdivision::NUM_QUARTIC_CONTROL_POINTS; ++q) {
+                weights[r][q] = float(system[r][NUM_CONTROL_POINTS + q]);
+            }
+        }
+    }
+
+    float weights[NUM_CONTROL_POINTS][PatchSubdivision::NUM_QUARTIC_CONTROL_POINTS];
+};
+
+/*!
+ * Shares the control points of sub patches that are the same up to rounding.
+ *
+ * Neighbouring leaves compute their common boundary from different blossoms
+ * (and neighbouring input patches from different control point orders), so
+ * the results only agree within a few ulps. Points are hashed on a grid of
+ * tolerance sized cells, a lookup checks the surrounding cells as well.
+ */
+class PointWelder
+{
+public:
+    PointWelder(QVector<QVector4D> &points, float tolerance) :
+        _points(points),
+        _tolerance(std::max(tolerance, std::numeric_limits<float>::min())) {
+    }
+
+    /// Makes an existing point available for welding
+    void insert(unsigned index) {
+        const QVector3D point = projectTo3D(_points[index]);
+        QVector<unsigned> &cell = _cells[key(cellOf(point))];
+        if (!cell.contains(index)) {
+            cell.append(index);
+        }
+    }
+
+    /// Index of a point within the tolerance, appends the point if there is
+    /// none
+    unsigned weld(const QVector4D &point) {
+        const QVector3D position = projectTo3D(point);
+        const Cell center = cellOf(position);
+        for (int dx = -1; dx <= 1; ++dx) {
+            for (int dy = -1; dy <= 1; ++dy) {
+                for (int dz = -1; dz <= 1; ++dz) {
+                    const Cell cell = {{center.c[0] + dx, center.c[1] + dy, center.c[2] + dz}};
+                    const auto it = _cells.constFind(key(cell));
+                    if (it == _cells.constEnd()) {
+                        continue;
+                    }
+                    for (unsigned index : *it) {
+                        if (isSame(_points[index], point, position)) {
+                            return index;
+                        }
+                    }
+                }
+            }
+        }
+        const unsigned index = unsigned(_points.size());
+        _points.append(point);
+        _cells[key(center)].append(index);
+        return index;
+    }
+
+private:
+    struct Cell {
+        qint64 c[3];
+    };
+
+    Cell cellOf(const QVector3D &point) const {
+        Cell cell;
+        for (int axis = 0; axis < 3; ++axis) {
+            cell.c[axis] = static_cast<qint64>(std::floor(point[axis] / _tolerance));
+        }
+        return cell;
+    }
+
+    /// 21 bits per axis, cells that wrap around are told apart by isSame
+    static quint64 key(const Cell &cell) {
+        const quint64 mask = (quint64(1) << 21) - 1;
+        return (quint64(cell.c[0]) & mask) << 42 |
+                (quint64(cell.c[1]) & mask) << 21 |
+                (quint64(cell.c[2]) & mask);
+    }
+
+    bool isSame(const QVector4D &a, const QVector4D &b, const QVector3D &bPosition) const {
+        const float weight = std::max(std::fabs(a.w()), std::fabs(b.w()));
+        return (projectTo3D(a) - bPosition).length() <= _tolerance &&
+                std::fabs(a.w() - b.w()) <= WELD_TOLERANCE * weight;
+    }
+
+    QVector<QVector4D> &_points;
+    float _tolerance;
+    QHash<quint64, QVector<unsigned>> _cells;
+};
+
+/// Largest extent of the bounding box of the control points
+float sceneSize(const QVector<QVector4D> &points) {
+    QVector3D minValues(std::numeric_limits<float>::max(),
+                        std::numeric_limits<float>::max(),
+                        std::numeric_limits<float>::max());
+    QVector3D maxValues = -minValues;
+    for (const QVector4D &point : points) {
+        const QVector3D position = projectTo3D(point);
+        for (int axis = 0; axis < 3; ++axis) {
+            minValues[axis] = std::min(minValues[axis], position[axis]);
+            maxValues[axis] = std::max(maxValues[axis], position[axis]);
+        }
+    }
+    const QVector3D extent = maxValues - minValues;
+    return std::max(std::max(extent.x(), extent.y()), extent.z());
+}
+
+/// Splits a triangle in four until it is flat enough, appends the leaves
+void subdivideRecursive(const QVector4D *controlPoints,
+                        float tolerance,
+                        int depth,
+                        PointWelder &welder,
+                        QVector<unsigned> &indices,
+                        int &numLeaves) {
+    if (depth <= 0 || PatchSubdivision::relativeFlatness(controlPoints) <= tolerance) {
+        for (int i = 0; i < NUM_CONTROL_POINTS; ++i) {
+            indices.append(welder.weld(controlPoints[i]));
+        }
+        ++numLeaves;
+        return;
+    }
+    QVector4D children[4 * NUM_CONTROL_POINTS];
+    PatchSubdivision::splitIn4(controlPoints, children);
+    for (int child = 0; child < 4; ++child) {
+        subdivideRecursive(children + child * NUM_CONTROL_POINTS,
+                           tolerance, depth - 1, welder, indices, numLeaves);
+    }
+}
+
+} // namespace
+
+// -----------------------------------------------------------------------------
+// -- Subdivision --------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+QVector4D PatchSubdivision::blossom(
+        const QVector4D *controlPoints,
+        const QVector3D &a,
+        const QVector3D &b,
+        const QVector3D &c) {
+    // de Casteljau, with a different argument in every step
+    QVector4D level[4][4];
+    for (int j = 0; j <= 3; ++j) {
+        for (int i = 0; i + j <= 3; ++i) {
+            level[i][j] = controlPoints[BezierTriangle::index(i, j)];
+        }
+    }
+    const QVector3D *arguments[3] = {&a, &b, &c};
+    for (int step = 0; step < 3; ++step) {
+        const QVector3D &uvw = *arguments[step];
+        const int degree = 2 - step;
+        for (int j = 0; j <= degree; ++j) {
+            for (int i = 0; i + j <= degree; ++i) {
+                level[i][j] = uvw.x() * level[i + 1][j] +
+                        uvw.y() * level[i][j + 1] +
+                        uvw.z() * level[i][j];
+            }
+        }
+    }
+    return level[0][0];
+}
+
+void PatchSubdivision::subPatch(
+        const QVector4D *controlPoints,
+        const QVector3D &a,
+        const QVector3D &b,
+        const QVector3D &c,
+        QVector4D *out) {
+    // b_ijk of the sub patch is the blossom at (b^i, c^j, a^k)
+    for (int cp = 0; cp < NUM_CONTROL_POINTS; ++cp) {
+        const int i = EXPONENTS[cp][0];
+        const int j = EXPONENTS[cp][1];
+        const QVector3D *arguments[3];
+        int n = 0;
+        for (int e = 0; e < i; ++e) arguments[n++] = &b;
+        for (int e = 0; e < j; ++e) arguments[n++] = &c;
+        while (n < 3) arguments[n++] = &a;
+        out[cp] = blossom(controlPoints, *arguments[0], *arguments[1], *arguments[2]);
+    }
+}
+
+void PatchSubdivision::splitAtPoint(
+        const QVector4D *controlPoints,
+        const QVector3D &uvw,
+        QVector4D *out) {
+    subPatch(controlPoints, CORNER_W, CORNER_U, uvw, out);
+    subPatch(controlPoints, CORNER_U, CORNER_V, uvw, out + NUM_CONTROL_POINTS);
+    subPatch(controlPoints, CORNER_V, CORNER_W, uvw, out + 2 * NUM_CONTROL_POINTS);
+}
+
+void PatchSubdivision::splitEdge(
+        const QVector4D *controlPoints,
+        Edge edge,
+        float t,
+        QVector4D *out) {
+    // The opposite corner, followed by the edge, counter clockwise
+    const QVector3D *corners[3][3] = {
+        {&CORNER_U, &CORNER_V, &CORNER_W},
+        {&CORNER_V, &CORNER_W, &CORNER_U},
+        {&CORNER_W, &CORNER_U, &CORNER_V}
+    };
+    const QVector3D &opposite = *corners[edge][0];
+    const QVector3D &start = *corners[edge][1];
+    const QVector3D &end = *corners[edge][2];
+    const QVector3D split = (1.0f - t) * start + t * end;
+    subPatch(controlPoints, opposite, start, split, out);
+    subPatch(controlPoints, opposite, split, end, out + NUM_CONTROL_POINTS);
+}
+
+void PatchSubdivision::splitIn4(const QVector4D *controlPoints, QVector4D *out) {
+    const QVector3D uv = 0.5f * (CORNER_U + CORNER_V);
+    const QVector3D vw = 0.5f * (CORNER_V + CORNER_W);
+    const QVector3D uw = 0.5f * (CORNER_U + CORNER_W);
+    subPatch(controlPoints, CORNER_W, uw, vw, out);
+    subPatch(controlPoints, uw, CORNER_U, uv, out + NUM_CONTROL_POINTS);
+    subPatch(controlPoints, vw, uv, CORNER_V, out + 2 * NUM_CONTROL_POINTS);
+    subPatch(controlPoints, uv, vw, uw, out + 3 * NUM_CONTROL_POINTS);
+}
+
+// -----------------------------------------------------------------------------
+// -- Degree elevation and reduction -------------------------------------------
+// -----------------------------------------------------------------------------
+
+void PatchSubdivision::elevateDegree(const QVector4D *controlPoints, QVector4D *quartic) {
+    for (int j = 0; j <= 4; ++j) {
+        for (int i = 0; i + j <= 4; ++i) {
+            const int k = 4 - i - j;
+            QVector4D point;
+            if (i > 0) point += i * controlPoints[BezierTriangle::index(i - 1, j)];
+            if (j > 0) point += j * controlPoints[BezierTriangle::index(i, j - 1)];
+            if (k > 0) point += k * controlPoints[BezierTriangle::index(i, j)];
+            quartic[quarticIndex(i, j)] = point / 4.0f;
+        }
+    }
+}
+
+void PatchSubdivision::reduceDegree(const QVector4D *quartic, QVector4D *controlPoints) {
+    static const ReductionMatrix reduction;
+    for (int cp = 0; cp < NUM_CONTROL_POINTS; ++cp) {
+        QVector4D point;
+        for (int q = 0; q < NUM_QUARTIC_CONTROL_POINTS; ++q) {
+            point += reduction.weights[cp][q] * quartic[q];
+        }
+        controlPoints[cp] = point;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// -- Flatness -----------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+float PatchSubdivision::flatness(const QVector4D *controlPoints) {
+    const QVector3D p003 = projectTo3D(controlPoints[BezierTriangle::B003]);
+    const QVector3D p300 = projectTo3D(controlPoints[BezierTriangle::B300]);
+    const QVector3D p030 = projectTo3D(controlPoints[BezierTriangle::B030]);
+    float maxDistance = 0.0f;
+    for (int cp = 0; cp < NUM_CONTROL_POINTS; ++cp) {
+        const int i = EXPONENTS[cp][0];
+        const int j = EXPONENTS[cp][1];
+        const QVector3D flat = (i * p300 + j * p030 + (3 - i - j) * p003) / 3.0f;
+        const float distance = (projectTo3D(controlPoints[cp]) - flat).length();
+        maxDistance = std::max(maxDistance, distance);
+    }
+    return maxDistance;
+}
+
+float PatchSubdivision::relativeFlatness(const QVector4D *controlPoints) {
+    const QVector3D p003 = projectTo3D(controlPoints[BezierTriangle::B003]);
+    const QVector3D p300 = projectTo3D(controlPoints[BezierTriangle::B300]);
+    const QVector3D p030 = projectTo3D(controlPoints[BezierTriangle::B030]);
+    const float edgeLength = std::max(std::max(
+            (p300 - p003).length(), (p030 - p300).length()), (p003 - p030).length());
+    return flatness(controlPoints) / std::max(edgeLength, MIN_EDGE_LENGTH);
+}
+
+QVector<float> PatchSubdivision::relativeFlatness(const PatchStore &patches) {
+    const int numPatches = patches.numPatches(BezierPatch::TriPatch);
+    QVector<float> result(numPatches);
+
+    // Structure of arrays of LANES patches, padded with the last patch
+    alignas(SIMD_ALIGNMENT) float x[NUM_CONTROL_POINTS][LANES];
+    alignas(SIMD_ALIGNMENT) float y[NUM_CONTROL_POINTS][LANES];
+    alignas(SIMD_ALIGNMENT) float z[NUM_CONTROL_POINTS][LANES];
+    alignas(SIMD_ALIGNMENT) float out[LANES];
+    QVector4D controlPoints[NUM_CONTROL_POINTS];
+
+    for (int first = 0; first < numPatches; first += LANES) {
+        const int count = std::min(LANES, numPatches - first);
+        for (int lane = 0; lane < LANES; ++lane) {
+            patches.gatherControlPoints(BezierPatch::TriPatch,
+                                        first + std::min(lane, count - 1),
+                                        controlPoints);
+            for (int cp = 0; cp < NUM_CONTROL_POINTS; ++cp) {
+                const QVector3D point = projectTo3D(controlPoints[cp]);
+                x[cp][lane] = point.x();
+                y[cp][lane] = point.y();
+                z[cp][lane] = point.z();
+            }
+        }
+
+        const Lane third = set1(1.0f / 3.0f);
+        const Lane x003 = load(x[BezierTriangle::B003]);
+        const Lane y003 = load(y[BezierTriangle::B003]);
+        const Lane z003 = load(z[BezierTriangle::B003]);
+        // Edge vectors towards B300 and B030, divided by three
+        const Lane xu = mul(sub(load(x[BezierTriangle::B300]), x003), third);
+        const Lane yu = mul(sub(load(y[BezierTriangle::B300]), y003), third);
+        const Lane zu = mul(sub(load(z[BezierTriangle::B300]), z003), third);
+        const Lane xv = mul(sub(load(x[BezierTriangle::B030]), x003), third);
+        const Lane yv = mul(sub(load(y[BezierTriangle::B030]), y003), third);
+        const Lane zv = mul(sub(load(z[BezierTriangle::B030]), z003), third);
+
+        Lane maxDistance = set1(0.0f);
+        for (int cp = 0; cp < NUM_CONTROL_POINTS; ++cp) {
+            const Lane i = set1(float(EXPONENTS[cp][0]));
+            const Lane j = set1(float(EXPONENTS[cp][1]));
+            const Lane dx = sub(load(x[cp]), add(x003, add(mul(i, xu), mul(j, xv))));
+            const Lane dy = sub(load(y[cp]), add(y003, add(mul(i, yu), mul(j, yv))));
+            const Lane dz = sub(load(z[cp]), add(z003, add(mul(i, zu), mul(j, zv))));
+            maxDistance = max(maxDistance, add(mul(dx, dx), add(mul(dy, dy), mul(dz, dz))));
+        }
+
+        const Lane xw = sub(xv, xu);
+        const Lane yw = sub(yv, yu);
+        const Lane zw = sub(zv, zu);
+        Lane maxEdge = add(mul(xu, xu), add(mul(yu, yu), mul(zu, zu)));
+        maxEdge = max(maxEdge, add(mul(xv, xv), add(mul(yv, yv), mul(zv, zv))));
+        maxEdge = max(maxEdge, add(mul(xw, xw), add(mul(yw, yw), mul(zw, zw))));
+        // The edges were divided by three
+        maxEdge = max(mul(maxEdge, set1(9.0f)), set1(MIN_EDGE_LENGTH * MIN_EDGE_LENGTH));
+
+        store(out, sqrt(div(maxDistance, maxEdge)));
+        std::copy(out, out + count, result.begin() + first);
+    }
+    return result;
+}
+
+// -----------------------------------------------------------------------------
+// -- Adaptive subdivision -----------------------------------------------------
+// -----------------------------------------------------------------------------
+
+PatchStore PatchSubdivision::subdivide(
+        const PatchStore &patches,
+        float tolerance,
+        int maxDepth,
+        QVector<int> *sources) {
+    const QVector<float> flatness = relativeFlatness(patches);
+    const int numTriangles = flatness.size();
+    const int numQuads = patches.numPatches(BezierPatch::QuadPatch);
+
+    // Flat triangles keep their (shared) control points
+    QVector<QVector4D> points = patches.controlPoints();
+    PointWelder welder(points, WELD_TOLERANCE * sceneSize(points));
+    QVector<unsigned> indices;
+    indices.reserve(patches.indices(BezierPatch::TriPatch).size());
+    if (sources) {
+        sources->clear();
+    }
+
+    QVector4D controlPoints[NUM_CONTROL_POINTS];
+    for (int patch = 0; patch < numTriangles; ++patch) {
+        int numLeaves = 1;
+        if (flatness[patch] <= tolerance || maxDepth <= 0) {
+            const unsigned *patchIndices = patches.patchIndices(BezierPatch::TriPatch, patch);
+            for (int i = 0; i < NUM_CONTROL_POINTS; ++i) {
+                indices.append(patchIndices[i]);
+            }
+        } else {
+            numLeaves = 0;
+            // The corners of the leaves on the patch boundary end up on the
+            // shared control points of the input
+            const unsigned *patchIndices = patches.patchIndices(BezierPatch::TriPatch, patch);
+            for (int i = 0; i < NUM_CONTROL_POINTS; ++i) {
+                welder.insert(patchIndices[i]);
+            }
+            patches.gatherControlPoints(BezierPatch::TriPatch, patch, controlPoints);
+            subdivideRecursive(controlPoints, tolerance, maxDepth,
+                               welder, indices, numLeaves);
+        }
+        if (sources) {
+            for (int leaf = 0; leaf < numLeaves; ++leaf) {
+                sources->append(patch);
+            }
+        }
+    }
+    if (sources) {
+        const int firstQuad = patches.firstPatch(BezierPatch::QuadPatch);
+        for (int quad = 0; quad < numQuads; ++quad) {
+            sources->append(firstQuad + quad);
+        }
+    }
+    return PatchStore(points, indices, patches.indices(BezierPatch::QuadPatch));
+}
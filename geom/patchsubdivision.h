@@ -0,0 +1,125 @@
+#ifndef PATCHSUBDIVISION_H
+#define PATCHSUBDIVISION_H
+
+#include <geom/beziertriangle.h>
+#include <geom/patchstore.h>
+
+#include <QVector>
+#include <QVector3D>
+#include <QVector4D>
+
+/*!
+ * \brief The PatchSubdivision class
+ *
+ * Subdivision, degree elevation and degree reduction of cubic triangle
+ * patches. All operations work on the homogeneous control points (w * P, w),
+ * so they are exact for rational patches as well.
+ *
+ * Domain points are barycentric (u, v, w), like in the tessellator. A sub
+ * patch over the domain triangle (a, b, c) has its B003 at a, B300 at b and
+ * B030 at c, so a counter clockwise domain triangle keeps the orientation.
+ *
+ * Quartic patches store their 15 control points row by row along v, see
+ * quarticIndex().
+ */
+class PatchSubdivision
+{
+
+    // =========================================================================
+    // -- Enums ----------------------------------------------------------------
+    // =========================================================================
+
+public:
+
+    enum {
+        NUM_QUARTIC_CONTROL_POINTS = 15
+    };
+
+    /// Edges are named after the coordinate that is zero on them
+    enum Edge {
+        EdgeU = 0,
+        EdgeV,
+        EdgeW
+    };
+
+    // =========================================================================
+    // -- Other methods --------------------------------------------------------
+    // =========================================================================
+
+public:
+
+    /// Quartic control point with u exponent i and v exponent j
+    static int quarticIndex(int i, int j) {
+        return 5 * j - j * (j - 1) / 2 + i;
+    }
+
+    /// Blossom of the cubic patch, symmetric in a, b and c
+    static QVector4D blossom(const QVector4D *controlPoints,
+                             const QVector3D &a,
+                             const QVector3D &b,
+                             const QVector3D &c);
+
+    /// Homogeneous point at uvw
+    static QVector4D evaluate(const QVector4D *controlPoints, const QVector3D &uvw) {
+        return blossom(controlPoints, uvw, uvw, uvw);
+    }
+
+    /// The part of the patch over the domain triangle (a, b, c)
+    static void subPatch(const QVector4D *controlPoints,
+                         const QVector3D &a,
+                         const QVector3D &b,
+                         const QVector3D &c,
+                         QVector4D *out);
+
+    /// Three patches that meet at uvw, out holds 30 control points
+    static void splitAtPoint(const QVector4D *controlPoints,
+                             const QVector3D &uvw,
+                             QVector4D *out);
+
+    /// Two patches split at t along an edge, counter clockwise, the first
+    /// one holds the start of the edge, out holds 20 control points
+    static void splitEdge(const QVector4D *controlPoints,
+                          Edge edge,
+                          float t,
+                          QVector4D *out);
+
+    /// Four patches split at the edge midpoints, the middle one last, out
+    /// holds 40 control points
+    static void splitIn4(const QVector4D *controlPoints, QVector4D *out);
+
+    /// The same patch as a quartic
+    static void elevateDegree(const QVector4D *controlPoints, QVector4D *quartic);
+
+    /// Least squares cubic of a quartic, exact for elevated cubics
+    static void reduceDegree(const QVector4D *quartic, QVector4D *controlPoints);
+
+    /// Largest distance of the projected control points from the flat
+    /// triangle through the corners. Polynomial patches stay within this
+    /// distance of that triangle.
+    static float flatness(const QVector4D *controlPoints);
+
+    /// Flatness divided by the longest edge of the corner triangle, a scale
+    /// independent measure of how strongly the patch bends
+    static float relativeFlatness(const QVector4D *controlPoints);
+
+    /// Relative flatness of all triangle patches, computed for several
+    /// patches at a time in SIMD lanes
+    static QVector<float> relativeFlatness(const PatchStore &patches);
+
+    /// Splits triangles in four until their relative flatness is at most
+    /// tolerance or they were split maxDepth times. Quads and flat triangles
+    /// keep their control points. If sources is given, it receives the
+    /// global number of the input patch of every output patch.
+    ///
+    /// Sub patches share the control points they have in common, with each
+    /// other and with split neighbours, so PatchEdgeTable finds their edges.
+    /// Neighbours split to a different depth still meet in T-junctions,
+    /// those edges can crack whatever the tessellation levels are.
+    static PatchStore subdivide(const PatchStore &patches,
+                                float tolerance,
+                                int maxDepth,
+                                QVector<int> *sources = nullptr);
+
+};
+
+#endif // PATCHSUBDIVISION_H
@@ -0,0 +1,127 @@
+#include <geom/powerbasis.h>
+
+#include <geom/bezierquad.h>
+#include <geom/beziertriangle.h>
+#include <geom/parallelfor.h>
+
+namespace {
+
+/// Patches per task
+const int GRAIN = 1024;
+
+/// Exponents of u, v and w of the triangle control points
+const int TRIANGLE_EXPONENTS[BezierTriangle::NUM_CONTROL_POINTS][3] = {
+    {0, 0, 3}, // B003
+    {1, 0, 2}, // B102
+    {2, 0, 1}, // B201
+    {3, 0, 0}, // B300
+    {2, 1, 0}, // B210
+    {1, 2, 0}, // B120
+    {0, 3, 0}, // B030
+    {0, 2, 1}, // B021
+    {0, 1, 2}, // B012
+    {1, 1, 1}  // B111
+};
+
+/// Cubic Bernstein polynomial i has coefficient CUBIC_POWER[a][i] for t^a
+const float CUBIC_POWER[4][4] = {
+    { 1.0f,  0.0f,  0.0f, 0.0f},
+    {-3.0f,  3.0f,  0.0f, 0.0f},
+    { 3.0f, -6.0f,  3.0f, 0.0f},
+    {-1.0f,  3.0f, -3.0f, 1.0f}
+};
+
+const int BINOMIAL[4][4] = {
+    {1, 0, 0, 0},
+    {1, 1, 0, 0},
+    {1, 2, 1, 0},
+    {1, 3, 3, 1}
+};
+
+const int FACTORIAL[4] = {1, 1, 2, 6};
+
+} // namespace
+
+// -----------------------------------------------------------------------------
+// -- Other Methods ------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+void PowerBasis::fromTriangle(const QVector4D *controlPoints, QVector4D *coefficients)
+{
+    for (int i = 0; i < BezierTriangle::NUM_CONTROL_POINTS; ++i) {
+        coefficients[i] = QVector4D();
+    }
+    // 3! / (i! j! k!) u^i v^j w^k with w^k = sum C(k, m) (-1)^m (u + v)^m
+    for (int point = 0; point < BezierTriangle::NUM_CONTROL_POINTS; ++point) {
+        const int i = TRIANGLE_EXPONENTS[point][0];
+        const int j = TRIANGLE_EXPONENTS[point][1];
+        const int k = TRIANGLE_EXPONENTS[point][2];
+        const float multinomial = float(FACTORIAL[3]) /
+                (FACTORIAL[i] * FACTORIAL[j] * FACTORIAL[k]);
+        for (int m = 0; m <= k; ++m) {
+            const float sign = (m % 2 == 0) ? 1.0f : -1.0f;
+            for (int p = 0; p <= m; ++p) {
+                const float weight = multinomial * sign * BINOMIAL[k][m] * BINOMIAL[m][p];
+                coefficients[index(BezierPatch::TriPatch, i + p, j + m - p)] +=
+                        weight * controlPoints[point];
+            }
+        }
+    }
+}
+
+void PowerBasis::fromQuad(const QVector4D *controlPoints, QVector4D *coefficients)
+{
+    // Control point B_ij is at 4 j + i, like the coefficients
+    for (int b = 0; b < 4; ++b) {
+        for (int a = 0; a < 4; ++a) {
+            QVector4D sum;
+            for (int j = 0; j <= b; ++j) {
+                for (int i = 0; i <= a; ++i) {
+                    sum += CUBIC_POWER[a][i] * CUBIC_POWER[b][j] * controlPoints[4 * j + i];
+                }
+            }
+            coefficients[index(BezierPatch::QuadPatch, a, b)] = sum;
+        }
+    }
+}
+
+void PowerBasis::fromPatch(BezierPatch::Type type,
+                           const QVector4D *controlPoints,
+                           QVector4D *coefficients)
+{
+    if (type == BezierPatch::TriPatch) {
+        fromTriangle(controlPoints, coefficients);
+    } else {
+        fromQuad(controlPoints, coefficients);
+    }
+}
+
+QVector<QVector4D> PowerBasis::fromPatches(const PatchStore &patches, BezierPatch::Type type)
+{
+    const int stride = numCoefficients(type);
+    QVector<QVector4D> coefficients(patches.numPatches(type) * stride);
+    QVector4D *out = coefficients.data();
+    Parallel::parallelFor(patches.numPatches(type), GRAIN, [&patches, type, stride, out](int patch) {
+        QVector4D controlPoints[BezierQuad::NUM_CONTROL_POINTS];
+        patches.gatherControlPoints(type, patch, controlPoints);
+        fromPatch(type, controlPoints, out + patch * stride);
+    });
+    return coefficients;
+}
+
+QVector4D PowerBasis::evaluate(BezierPatch::Type type,
+                               const QVector4D *coefficients,
+                               float u, float v)
+{
+    // Horner in u per row, then in v over the rows
+    QVector4D result;
+    for (int b = 3; b >= 0; --b) {
+        const int maxA = type == BezierPatch::TriPatch ? 3 - b : 3;
+        QVector4D row;
+        for (int a = maxA; a >= 0; --a) {
+            row = row * u + coefficients[index(type, a, b)];
+        }
+        result = result * v + row;
+    }
+    return result;
+}
@@ -0,0 +1,61 @@
+#ifndef POWERBASIS_H
+#define POWERBASIS_H
+
+#include <geom/bezierpatch.h>
+#include <geom/patchstore.h>
+
+#include <QVector>
+#include <QVector4D>
+
+/*!
+ * \brief The PowerBasis class
+ *
+ * Converts the homogeneous control points of a patch to the coefficients of
+ * the same polynomial in u and v, for the POWER_BASIS variant of
+ * fragment.glsl. Evaluating those with Horner's rule takes fewer operations
+ * than de Casteljau and gives the derivatives almost for free. The
+ * coefficients are in model coordinates, they do not change with the view.
+ *
+ * The coefficient of u^a v^b is stored at index(type, a, b). Triangles
+ * (with w = 1 - u - v) use rows of 4, 3, 2 and 1 coefficients, quads rows
+ * of 4 in the same layout as their control points.
+ */
+class PowerBasis
+{
+
+    // =========================================================================
+    // -- Other methods --------------------------------------------------------
+    // =========================================================================
+
+public:
+
+    /// Same as the number of control points
+    static int numCoefficients(BezierPatch::Type type) {
+        return PatchStore::numControlPoints(type);
+    }
+
+    static int index(BezierPatch::Type type, int a, int b) {
+        static const int TRIANGLE_ROWS[4] = {0, 4, 7, 9};
+        return type == BezierPatch::TriPatch ? TRIANGLE_ROWS[b] + a : 4 * b + a;
+    }
+
+    static void fromTriangle(const QVector4D *controlPoints, QVector4D *coefficients);
+
+    static void fromQuad(const QVector4D *controlPoints, QVector4D *coefficients);
+
+    static void fromPatch(BezierPatch::Type type,
+                          const QVector4D *controlPoints,
+                          QVector4D *coefficients);
+
+    /// Coefficients of the patches of one type, numCoefficients() per patch,
+    /// computed on the global thread pool
+    static QVector<QVector4D> fromPatches(const PatchStore &patches, BezierPatch::Type type);
+
+    /// Homogeneous point at (u, v), the same Horner scheme as fragment.glsl
+    static QVector4D evaluate(BezierPatch::Type type,
+                              const QVector4D *coefficients,
+                              float u, float v);
+
+};
+
+#endif // POWERBASIS_H
@@ -0,0 +1,71 @@
+#ifndef SIMDLANE_H
+#define SIMDLANE_H
+
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+/*!
+ * Thin wrappers around the widest float vector the compiler targets, so
+ * kernels are written once for AVX, SSE2 and plain floats. Loads and stores
+ * need SIMD_ALIGNMENT aligned pointers.
+ */
+namespace SimdLane {
+
+#if defined(__AVX__)
+
+const int LANES = 8;
+typedef __m256 Lane;
+
+inline Lane load(const float *p) { return _mm256_load_ps(p); }
+inline void store(float *p, Lane a) { _mm256_store_ps(p, a); }
+inline Lane set1(float a) { return _mm256_set1_ps(a); }
+inline Lane add(Lane a, Lane b) { return _mm256_add_ps(a, b); }
+inline Lane sub(Lane a, Lane b) { return _mm256_sub_ps(a, b); }
+inline Lane mul(Lane a, Lane b) { return _mm256_mul_ps(a, b); }
+inline Lane div(Lane a, Lane b) { return _mm256_div_ps(a, b); }
+inline Lane max(Lane a, Lane b) { return _mm256_max_ps(a, b); }
+inline Lane sqrt(Lane a) { return _mm256_sqrt_ps(a); }
+
+#elif defined(__SSE2__) || defined(_M_X64)
+
+const int LANES = 4;
+typedef __m128 Lane;
+
+inline Lane load(const float *p) { return _mm_load_ps(p); }
+inline void store(float *p, Lane a) { _mm_store_ps(p, a); }
+inline Lane set1(float a) { return _mm_set1_ps(a); }
+inline Lane add(Lane a, Lane b) { return _mm_add_ps(a, b); }
+inline Lane sub(Lane a, Lane b) { return _mm_sub_ps(a, b); }
+inline Lane mul(Lane a, Lane b) { return _mm_mul_ps(a, b); }
+inline Lane div(Lane a, Lane b) { return _mm_div_ps(a, b); }
+inline Lane max(Lane a, Lane b) { return _mm_max_ps(a, b); }
+inline Lane sqrt(Lane a) { return _mm_sqrt_ps(a); }
+
+#else
+
+const int LANES = 1;
+typedef float Lane;
+
+inline Lane load(const float *p) { return *p; }
+inline void store(float *p, Lane a) { *p = a; }
+inline Lane set1(float a) { return a; }
+inline Lane add(Lane a, Lane b) { return a + b; }
+inline Lane sub(Lane a, Lane b) { return a - b; }
+inline Lane mul(Lane a, Lane b) { return a * b; }
+inline Lane div(Lane a, Lane b) { return a / b; }
+inline Lane max(Lane a, Lane b) { return a > b ? a : b; }
+inline Lane sqrt(Lane a) { return std::sqrt(a); }
+
+#endif
+
+/// Alignment of arrays that are loaded into lanes, enough for AVX
+const int SIMD_ALIGNMENT = 32;
+
+} // namespace SimdLane
+
+#endif // SIMDLANE_H
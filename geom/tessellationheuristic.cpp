@@ -0,0 +1,374 @@
+#include <geom/tessellationheuristic.h>
+
+#include <geom/beziertriangle.h>
+
+#include <QVector2D>
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const char *const HEURISTIC_NAMES[TessellationHeuristic::NUM_HEURISTICS] = {
+    "FixedLevels",
+    "ScreenSpaceNormal",
+    "ScreenProjection",
+    "Curvature",
+    "MaxDeviation",
+    "MinProjectionCurvature"
+};
+
+inline QVector3D stripWeight(const QVector4D &homogeneous) {
+    return homogeneous.toVector3D() / homogeneous.w();
+}
+
+inline float sumSqr3(const QVector3D &v) {
+    return v.x() * v.x() + v.y() * v.y() + v.z() * v.z();
+}
+
+inline float mix(float a, float b, float t) {
+    return a + (b - a) * t;
+}
+
+inline QVector4D mix(const QVector4D &a, const QVector4D &b, float t) {
+    return a + (b - a) * t;
+}
+
+inline QVector4D interpolate4DUVW(
+        const QVector3D &uvw,
+        const QVector4D &v0,
+        const QVector4D &v1,
+        const QVector4D &v2) {
+    return uvw.z() * v0 + uvw.x() * v1 + uvw.y() * v2;
+}
+
+/// Determines maximum deviation from the edge
+float maxEdgeDeviation(
+        const QVector3D &v0,
+        const QVector3D &v1,
+        const QVector3D &v2,
+        const QVector3D &v3) {
+    const QVector3D dxyz = v3 - v0;
+    const float U0NormSqr = 1.0f / sumSqr3(dxyz);
+    const float d1Sqr = sumSqr3(QVector3D::crossProduct(dxyz, v1 - v0));
+    const float d2Sqr = sumSqr3(QVector3D::crossProduct(dxyz, v2 - v0));
+    return std::sqrt(std::max(d1Sqr, d2Sqr) * U0NormSqr);
+}
+
+/// Interpolate tangent at the given t
+QVector3D interpolateTangent(
+        float t,
+        const QVector4D &v0,
+        const QVector4D &e0,
+        const QVector4D &e1,
+        const QVector4D &v1) {
+    const QVector4D A = mix(v0, e0, t);
+    const QVector4D B = mix(e0, e1, t);
+    const QVector4D C = mix(e1, v1, t);
+    return (stripWeight(mix(B, C, t)) - stripWeight(mix(A, B, t))).normalized();
+}
+
+/// Interpolate normal at the given barycentric coordinate
+QVector3D interpolateNormal(const QVector4D *cp, const QVector3D &uvw) {
+    // Cubic to quadratic triangle
+    const QVector4D A = interpolate4DUVW(uvw, cp[BezierTriangle::B003],
+            cp[BezierTriangle::B102], cp[BezierTriangle::B012]);
+    const QVector4D B = interpolate4DUVW(uvw, cp[BezierTriangle::B102],
+            cp[BezierTriangle::B201], cp[BezierTriangle::B111]);
+    const QVector4D C = interpolate4DUVW(uvw, cp[BezierTriangle::B201],
+            cp[BezierTriangle::B300], cp[BezierTriangle::B210]);
+    const QVector4D D = interpolate4DUVW(uvw, cp[BezierTriangle::B012],
+            cp[BezierTriangle::B111], cp[BezierTriangle::B021]);
+    const QVector4D E = interpolate4DUVW(uvw, cp[BezierTriangle::B111],
+            cp[BezierTriangle::B210], cp[BezierTriangle::B120]);
+    const QVector4D F = interpolate4DUVW(uvw, cp[BezierTriangle::B021],
+            cp[BezierTriangle::B120], cp[BezierTriangle::B030]);
+
+    // Quadratic to linear triangle
+    const QVector3D aw = stripWeight(interpolate4DUVW(uvw, A, B, D));
+    const QVector3D bw = stripWeight(interpolate4DUVW(uvw, B, C, E));
+    const QVector3D cw = stripWeight(interpolate4DUVW(uvw, D, E, F));
+    return QVector3D::crossProduct((bw - aw).normalized(),
+                                   (cw - aw).normalized()).normalized();
+}
+
+/// Cubic root of the normal deviation is used for a faster curve
+float curvatureFactor(float deviation) {
+    return std::pow(1.0f - qBound(0.0f, deviation, 1.0f), 1.0f / 3.0f);
+}
+
+} // namespace
+
+// -----------------------------------------------------------------------------
+// -- Constructors and destructor ----------------------------------------------
+// -----------------------------------------------------------------------------
+
+TessellationHeuristic::Settings::Settings() :
+    edgeHeuristic(FixedLevels),
+    faceHeuristic(FixedLevels),
+    minLevel(1),
+    maxLevel(8),
+    projectionTolerance(1.0f),
+    deviationTolerance(1.0f),
+    width(1024),
+    height(768)
+{
+
+}
+
+TessellationHeuristic::TessellationHeuristic(const Settings &settings) :
+    _settings(settings)
+{
+
+}
+
+// -----------------------------------------------------------------------------
+// -- Other Methods ------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+// --- Public ------------------------------------------------------------------
+
+BezierTriangleTessellator::Levels TessellationHeuristic::levels(
+        const QVector4D *controlPoints) const
+{
+    QVector4D cp[BezierTriangle::NUM_CONTROL_POINTS];
+    for (int i = 0; i < BezierTriangle::NUM_CONTROL_POINTS; ++i) {
+        cp[i] = toViewSpace(controlPoints[i]);
+    }
+
+    // Edges u = 0, v = 0 and w = 0, in the same order as gl_TessLevelOuter
+    const QVector4D edges[3][4] = {
+        {cp[BezierTriangle::B003], cp[BezierTriangle::B012],
+         cp[BezierTriangle::B021], cp[BezierTriangle::B030]},
+        {cp[BezierTriangle::B003], cp[BezierTriangle::B102],
+         cp[BezierTriangle::B201], cp[BezierTriangle::B300]},
+        {cp[BezierTriangle::B300], cp[BezierTriangle::B210],
+         cp[BezierTriangle::B120], cp[BezierTriangle::B030]}
+    };
+
+    // Normal of the flat triangle
+    const QVector3D v0 = stripWeight(cp[BezierTriangle::B003]);
+    const QVector3D v1 = stripWeight(cp[BezierTriangle::B300]);
+    const QVector3D v2 = stripWeight(cp[BezierTriangle::B030]);
+    const QVector3D N = QVector3D::crossProduct(
+                (v1 - v0).normalized(), (v2 - v0).normalized()).normalized();
+
+    const float maxLevel = _settings.maxLevel;
+    BezierTriangleTessellator::Levels result(maxLevel);
+
+    for (int e = 0; e < 3; ++e) {
+        const QVector4D *edge = edges[e];
+        switch (_settings.edgeHeuristic) {
+        case FixedLevels:
+            result.outer[e] = maxLevel;
+            break;
+        case ScreenSpaceNormal:
+            // Face only heuristic, see edgeHeuristicLevel in heuristics.glsl
+            result.outer[e] = 1.0f;
+            break;
+        case ScreenProjection:
+            result.outer[e] = std::floor(
+                        screenProjectionEdge(edge[0], edge[1], edge[2], edge[3]));
+            break;
+        case Curvature:
+            result.outer[e] = std::floor(
+                        curvatureEdge(edge[0], edge[1], edge[2], edge[3]));
+            break;
+        case MaxDeviation:
+            result.outer[e] = std::floor(
+                        maxDeviationEdge(edge[0], edge[1], edge[2], edge[3]));
+            break;
+        case MinProjectionCurvature:
+            result.outer[e] = std::min(
+                        std::floor(curvatureEdge(edge[0], edge[1], edge[2], edge[3])),
+                        std::floor(screenProjectionEdge(edge[0], edge[1], edge[2], edge[3])));
+            break;
+        default:
+            break;
+        }
+    }
+
+    switch (_settings.faceHeuristic) {
+    case FixedLevels:
+        result.inner = maxLevel;
+        break;
+    case ScreenSpaceNormal:
+        result.inner = std::floor(screenSpaceNormalFace(cp));
+        break;
+    case ScreenProjection:
+        result.inner = std::floor(screenProjectionFace(cp));
+        break;
+    case Curvature:
+        result.inner = std::floor(curvatureFace(calculateCurvature(cp, N)));
+        break;
+    case MaxDeviation:
+        // Edge only heuristic, see faceHeuristicLevel in heuristics.glsl
+        result.inner = 1.0f;
+        break;
+    case MinProjectionCurvature:
+        result.inner = std::min(
+                    std::floor(screenProjectionFace(cp)),
+                    std::floor(curvatureFace(calculateCurvature(cp, N))));
+        break;
+    default:
+        break;
+    }
+    return result;
+}
+
+QString TessellationHeuristic::name(Heuristic heuristic) {
+    if (heuristic < 0 || heuristic >= NUM_HEURISTICS) {
+        return QString();
+    }
+    return HEURISTIC_NAMES[heuristic];
+}
+
+TessellationHeuristic::Heuristic TessellationHeuristic::fromName(
+        const QString &name, bool *ok)
+{
+    bool isNumber = false;
+    const int number = name.toInt(&isNumber);
+    for (int i = 0; i < NUM_HEURISTICS; ++i) {
+        if ((isNumber && number == i) ||
+                name.compare(HEURISTIC_NAMES[i], Qt::CaseInsensitive) == 0) {
+            if (ok) *ok = true;
+            return static_cast<Heuristic>(i);
+        }
+    }
+    if (ok) *ok = false;
+    return FixedLevels;
+}
+
+float TessellationHeuristic::calculateCurvature(const QVector4D *cp, const QVector3D &N) {
+    // Normals at the corners, the center and center of edges
+    const QVector3D samples[7] = {
+        QVector3D(0.0f, 0.0f, 1.0f), // B003
+        QVector3D(1.0f, 0.0f, 0.0f), // B300
+        QVector3D(0.0f, 1.0f, 0.0f), // B030
+        QVector3D(1.0f / 3.0f, 1.0f / 3.0f, 1.0f / 3.0f), // B111
+        QVector3D(0.5f, 0.0f, 0.5f), // V0
+        QVector3D(0.5f, 0.5f, 0.0f), // W0
+        QVector3D(0.0f, 0.5f, 0.5f)  // U0
+    };
+
+    // Determine maximum deviation of the normal
+    float f = QVector3D::dotProduct(interpolateNormal(cp, samples[0]), N);
+    for (int i = 1; i < 7; ++i) {
+        f = std::min(QVector3D::dotProduct(interpolateNormal(cp, samples[i]), N), f);
+    }
+    return f;
+}
+
+float TessellationHeuristic::edgeCurvature(
+        const QVector4D &v0,
+        const QVector4D &e0,
+        const QVector4D &e1,
+        const QVector4D &v1)
+{
+    // Calculate tangent of the whole edge
+    const QVector3D T = (stripWeight(v1) - stripWeight(v0)).normalized();
+
+    // Find the most divergent tangent
+    const float samples[5] = {0.0f, 2.0f / 6.0f, 3.0f / 6.0f, 4.0f / 6.0f, 1.0f};
+    float f = QVector3D::dotProduct(interpolateTangent(samples[0], v0, e0, e1, v1), T);
+    for (int i = 1; i < 5; ++i) {
+        f = std::min(QVector3D::dotProduct(
+                         interpolateTangent(samples[i], v0, e0, e1, v1), T), f);
+    }
+    return f;
+}
+
+float TessellationHeuristic::edgeDeviation(
+        const QVector4D &v0,
+        const QVector4D &e0,
+        const QVector4D &e1,
+        const QVector4D &v1)
+{
+    return maxEdgeDeviation(
+                stripWeight(v0), stripWeight(e0), stripWeight(e1), stripWeight(v1));
+}
+
+// --- Private -----------------------------------------------------------------
+
+QVector4D TessellationHeuristic::toViewSpace(const QVector4D &point) const {
+    const float weight = point.w();
+    const QVector4D transformed = _settings.modelViewMatrix *
+            QVector4D(point.toVector3D() / weight, 1.0f);
+    return QVector4D(transformed.toVector3D() / transformed.w() * weight, weight);
+}
+
+float TessellationHeuristic::curvatureEdge(
+        const QVector4D &v0,
+        const QVector4D &e0,
+        const QVector4D &e1,
+        const QVector4D &v1) const
+{
+    return mix(_settings.minLevel, _settings.maxLevel,
+               curvatureFactor(edgeCurvature(v0, e0, e1, v1)));
+}
+
+float TessellationHeuristic::curvatureFace(float curvature) const {
+    return mix(_settings.minLevel, _settings.maxLevel, curvatureFactor(curvature));
+}
+
+float TessellationHeuristic::maxDeviationEdge(
+        const QVector4D &v0,
+        const QVector4D &e0,
+        const QVector4D &e1,
+        const QVector4D &v1) const
+{
+    return qBound(static_cast<float>(_settings.minLevel),
+                  edgeDeviation(v0, e0, e1, v1) / _settings.deviationTolerance,
+                  static_cast<float>(_settings.maxLevel));
+}
+
+float TessellationHeuristic::screenProjectionEdge(
+        const QVector4D &v0,
+        const QVector4D &e0,
+        const QVector4D &e1,
+        const QVector4D &v1) const
+{
+    const QVector2D WH(_settings.width, _settings.height);
+    auto project = [this, &WH](const QVector4D &point) {
+        const QVector4D projected = _settings.projectionMatrix *
+                QVector4D(stripWeight(point), 1.0f);
+        return QVector2D(projected.x() / projected.w() * WH.x(),
+                         projected.y() / projected.w() * WH.y());
+    };
+    const QVector2D vn0 = project(v0);
+    const QVector2D en0 = project(e0);
+    const QVector2D en1 = project(e1);
+    const QVector2D vn1 = project(v1);
+
+    // Sum the distance
+    const float d = (en0 - vn0).length() + (en1 - en0).length() + (vn1 - en1).length();
+
+    // Divide by 2 since the distance is doubled
+    return qBound(static_cast<float>(_settings.minLevel),
+                  d / (2.0f * _settings.projectionTolerance),
+                  static_cast<float>(_settings.maxLevel));
+}
+
+float TessellationHeuristic::screenProjectionFace(const QVector4D *cp) const {
+    const float d0 = screenProjectionEdge(
+                cp[BezierTriangle::B003], cp[BezierTriangle::B012],
+                cp[BezierTriangle::B021], cp[BezierTriangle::B030]);
+    const float d1 = screenProjectionEdge(
+                cp[BezierTriangle::B003], cp[BezierTriangle::B102],
+                cp[BezierTriangle::B201], cp[BezierTriangle::B300]);
+    const float d2 = screenProjectionEdge(
+                cp[BezierTriangle::B300], cp[BezierTriangle::B210],
+                cp[BezierTriangle::B120], cp[BezierTriangle::B030]);
+    return std::floor(std::max(std::max(d0, d1), d2));
+}
+
+float TessellationHeuristic::screenSpaceNormalFace(const QVector4D *cp) const {
+    const QVector3D v0 = stripWeight(cp[BezierTriangle::B003]);
+    const QVector3D v1 = stripWeight(cp[BezierTriangle::B300]);
+    const QVector3D v2 = stripWeight(cp[BezierTriangle::B030]);
+
+    const QVector3D vc = (v0 + v1 + v2) / 3.0f;
+    const QVector3D vn = (-vc).normalized();
+
+    return curvatureFace(calculateCurvature(cp, vn));
+}
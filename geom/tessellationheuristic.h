@@ -0,0 +1,123 @@
+#ifndef TESSELLATIONHEURISTIC_H
+#define TESSELLATIONHEURISTIC_H
+
+#include <geom/beziertriangletessellator.h>
+
+#include <QMatrix4x4>
+#include <QString>
+#include <QVector3D>
+#include <QVector4D>
+
+/*!
+ * \brief The TessellationHeuristic class
+ *
+ * CPU port of the tessellation level heuristics in heuristics.glsl. The
+ * control points are transformed to view space first, like vertex.glsl does,
+ * so the levels match the ones the GPU would pick for the same camera.
+ */
+class TessellationHeuristic
+{
+
+    // =========================================================================
+    // -- Enums and types ------------------------------------------------------
+    // =========================================================================
+
+public:
+
+    /// Should be the same as the defines in heuristics.glsl!
+    enum Heuristic {
+        FixedLevels = 0,
+        ScreenSpaceNormal,
+        ScreenProjection,
+        Curvature,
+        MaxDeviation,
+        // Combined methods
+        MinProjectionCurvature,
+        NUM_HEURISTICS
+    };
+
+    /// Uniforms of the tessellation control shader
+    struct Settings {
+        Settings();
+
+        Heuristic edgeHeuristic;
+        Heuristic faceHeuristic;
+
+        int minLevel, maxLevel;
+
+        float projectionTolerance;
+        float deviationTolerance;
+
+        QMatrix4x4 modelViewMatrix;
+        QMatrix4x4 projectionMatrix;
+        int width, height;
+    };
+
+    // =========================================================================
+    // -- Constructors and destructor ------------------------------------------
+    // =========================================================================
+
+public:
+
+    explicit TessellationHeuristic(const Settings &settings);
+
+    // =========================================================================
+    // -- Other methods --------------------------------------------------------
+    // =========================================================================
+
+public:
+
+    const Settings &getSettings() const {
+        return _settings;
+    }
+
+    /// Tessellation levels of a triangle patch in model coordinates
+    BezierTriangleTessellator::Levels levels(const QVector4D *controlPoints) const;
+
+    static QString name(Heuristic heuristic);
+
+    /// Accepts the name (case insensitive) or the number of a heuristic
+    static Heuristic fromName(const QString &name, bool *ok = nullptr);
+
+    /// Smallest cosine between the surface normals and N
+    static float calculateCurvature(const QVector4D *cp, const QVector3D &N);
+
+    /// Smallest cosine between the tangents of an edge and its chord
+    static float edgeCurvature(const QVector4D &v0, const QVector4D &e0,
+                               const QVector4D &e1, const QVector4D &v1);
+
+    /// Largest distance of the inner edge control points from the chord
+    static float edgeDeviation(const QVector4D &v0, const QVector4D &e0,
+                               const QVector4D &e1, const QVector4D &v1);
+
+private:
+
+    /// Same as vertex.glsl, keeps the weight
+    QVector4D toViewSpace(const QVector4D &point) const;
+
+    float curvatureEdge(const QVector4D &v0, const QVector4D &e0,
+                        const QVector4D &e1, const QVector4D &v1) const;
+
+    float curvatureFace(float curvature) const;
+
+    float maxDeviationEdge(const QVector4D &v0, const QVector4D &e0,
+                           const QVector4D &e1, const QVector4D &v1) const;
+
+    float screenProjectionEdge(const QVector4D &v0, const QVector4D &e0,
+                               const QVector4D &e1, const QVector4D &v1) const;
+
+    float screenProjectionFace(const QVector4D *cp) const;
+
+    float screenSpaceNormalFace(const QVector4D *cp) const;
+
+    // =========================================================================
+    // -- Data members ---------------------------------------------------------
+    // =========================================================================
+
+private:
+
+    Settings _settings;
+
+};
+
+#endif // TESSELLATIONHEURISTIC_H
@@ -1,25 +1,166 @@
 #include <gl/bezierscene.h>
 
+#include <geom/powerbasis.h>
+#include <util/profiler.h>
+
 #include <QThread>
+#include <QtDebug>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <numeric>
+
+namespace {
+
+/// Timeout per glClientWaitSync call in nanoseconds
+const GLuint64 FENCE_TIMEOUT = 1000000;
+
+/// Stride of the patches in the adjacency entries
+const int ADJACENCY_STRIDE = BezierQuad::NUM_CONTROL_POINTS;
+
+/// Flags of BezierScene::_patchEdits
+const quint8 PATCH_MOVED = 1;
+/// The interpolated center point follows the moved points
+const quint8 CENTER_MOVED = 2;
+
+// Shader storage bindings, same as the control and edge level shaders
+const GLuint INVARIANT_BINDING = 0;
+const GLuint PATCH_EDGE_BINDING = 1;
+const GLuint EDGE_LEVEL_BINDING = 2;
+const GLuint EDGE_BINDING = 3;
+const GLuint EDGE_INVARIANT_BINDING = 4;
+const GLuint CONTROL_POINT_BINDING = 5;
+const GLuint COMPUTED_VERTEX_BINDING = 6;
+const GLuint PATCH_INDEX_BINDING = 7;
+const GLuint COMPUTED_PATCH_BINDING = 8;
+const GLuint COMPUTE_COUNTER_BINDING = 9;
+const GLuint COMPUTED_INDEX_BINDING = 10;
+const GLuint POWER_BASIS_BINDING = 11;
+
+/// Same as local_size_x in edge_levels.glsl
+const int EDGE_LEVEL_GROUP_SIZE = 64;
+
+/// Same as local_size_x in compute_levels.glsl and compute_evaluate.glsl
+const int COMPUTE_GROUP_SIZE = 64;
+
+/// Grid level limit of the compute tessellation, the tessellation stages
+/// stop at GL_MAX_TESS_GEN_LEVEL (usually 64)
+const int COMPUTE_MAX_LEVEL = 256;
+
+/// Level the compute buffers are sized for initially, they grow as needed
+const int INITIAL_COMPUTE_LEVEL = 8;
+
+/// Minimum value of GL_MAX_COMPUTE_WORK_GROUP_COUNT
+const GLuint MAX_WORK_GROUPS = 65535;
+
+/// Level the tessellation cache is sized for initially, it grows as needed
+const int INITIAL_CACHE_LEVEL = 8;
+
+/// Bytes of captured vertices per patch type, larger tessellations are
+/// drawn directly
+const GLint64 CACHE_BUDGET = GLint64(256) << 20;
+
+// Attribute locations of cached_vertex.glsl
+const GLuint CACHE_COORD = 0;
+const GLuint CACHE_NORMAL = 1;
+const GLuint CACHE_BARYCENTER = 2;
+const GLuint CACHE_LEVELS = 3;
+const GLuint CACHE_PATCH_NUMBER = 4;
+
+/// Vertices and indices of a uniform grid of the given level
+GLuint gridVertices(BezierPatch::Type type, GLuint level) {
+    return type == BezierPatch::TriPatch ?
+                (level + 1) * (level + 2) / 2 : (level + 1) * (level + 1);
+}
+
+GLuint gridIndices(BezierPatch::Type type, GLuint level) {
+    return (type == BezierPatch::TriPatch ? 3 : 6) * level * level;
+}
+
+} // namespace
 
 // -----------------------------------------------------------------------------
 // -- Constructors and destructor ----------------------------------------------
 // -----------------------------------------------------------------------------
 
 BezierScene::BezierScene() :
-    _isInit(false)
+    _isCulled(false),
+    _drawCommandsChanged(false),
+    _lodTolerance(0.0f),
+    _viewportHeight(0),
+    _lodDrawCommandsChanged(false),
+    _isInit(false),
+    _bufferMode(StaticBuffers),
+    _mappedVertices(nullptr),
+    _editRegion(0),
+    _editRegionStride(0)
 {
+    static_assert(sizeof(ComputedPatch) == 8 * sizeof(GLuint),
+                  "ComputedPatch must match the std430 layout of the compute shaders");
+    static_assert(sizeof(ComputedVertex) == 12 * sizeof(GLuint),
+                  "ComputedVertex must match the std430 layout of the compute shaders");
+    static_assert(sizeof(ComputeCounters) == 8 * sizeof(GLuint),
+                  "ComputeCounters must match the std430 layout of the compute shaders");
+    static_assert(sizeof(CachedVertex) == 13 * sizeof(GLuint),
+                  "CachedVertex must match the interleaved transform feedback varyings");
 
+    for (int type = 0; type < BezierPatch::NUM_PATCH_TYPES; ++type) {
+        _vertexCapacity[type] = 0;
+        _indexCapacity[type] = 0;
+        _computeFence[type] = 0;
+        _isComputed[type] = false;
+        _cacheCapacity[type] = 0;
+        _cacheState[type] = CacheStale;
+    }
+    for (int region = 0; region < NUM_EDIT_REGIONS; ++region) {
+        _renderFence[region] = 0;
+    }
 }
 
 BezierScene::~BezierScene() {
+    if (!_isInit) return;
+
+    for (GLsync fence : _renderFence) {
+        if (fence) {
+            glDeleteSync(fence);
+        }
+    }
+    for (GLsync fence : _computeFence) {
+        if (fence) {
+            glDeleteSync(fence);
+        }
+    }
+    if (_mappedVertices) {
+        glUnmapNamedBuffer(_sceneBO);
+    }
     glBindVertexArray(0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
     glDeleteVertexArrays(1, &_sceneVAO);
     glDeleteBuffers(1, &_sceneBO);
-    glDeleteBuffers(1, &_patchIBO);
+    glDeleteBuffers(BezierPatch::NUM_PATCH_TYPES, _patchIBO);
+    glDeleteBuffers(1, &_patchBaseBO);
+    glDeleteBuffers(BezierPatch::NUM_PATCH_TYPES, _invariantSSBO);
+    glDeleteBuffers(BezierPatch::NUM_PATCH_TYPES, _powerBasisSSBO);
+    glDeleteBuffers(BezierPatch::NUM_PATCH_TYPES, _drawCommandBO);
+    glDeleteVertexArrays(1, &_lodVAO);
+    glDeleteBuffers(1, &_lodBO);
+    glDeleteBuffers(1, &_lodIBO);
+    glDeleteBuffers(1, &_lodDrawCommandBO);
+    glDeleteBuffers(1, &_edgeSSBO);
+    glDeleteBuffers(1, &_edgeInvariantSSBO);
+    glDeleteBuffers(1, &_edgeLevelSSBO);
+    glDeleteBuffers(BezierPatch::NUM_PATCH_TYPES, _patchEdgeSSBO);
+    glDeleteBuffers(BezierPatch::NUM_PATCH_TYPES, _computedPatchBO);
+    glDeleteBuffers(BezierPatch::NUM_PATCH_TYPES, _computedVertexBO);
+    glDeleteBuffers(BezierPatch::NUM_PATCH_TYPES, _computedIndexBO);
+    glDeleteBuffers(BezierPatch::NUM_PATCH_TYPES, _computeCounterBO);
+    glDeleteVertexArrays(BezierPatch::NUM_PATCH_TYPES, _cacheVAO);
+    glDeleteBuffers(BezierPatch::NUM_PATCH_TYPES, _cacheBO);
+    glDeleteTransformFeedbacks(BezierPatch::NUM_PATCH_TYPES, _cacheTFO);
+    glDeleteQueries(BezierPatch::NUM_PATCH_TYPES, _cacheQuery);
 }
 
 // -----------------------------------------------------------------------------
@@ -28,41 +169,574 @@ BezierScene::~BezierScene() {
 
 // --- Public ------------------------------------------------------------------
 
-void BezierScene::render(const QOpenGLShaderProgram &program)
+void BezierScene::render(const QOpenGLShaderProgram &program, BezierPatch::Type type)
 {
+    Q_UNUSED(program);
+    if (isPaged()) {
+        _pager.render(type);
+        return;
+    }
     if (!_isInit) {
         initialize();
     }
+    if (_patches.numPatches(type) == 0 || (_isCulled && _drawCommands[type].isEmpty())) {
+        return;
+    }
 
-    //program.bind();
+    drawPatches(type);
+    fenceEditRegion();
+}
+
+bool BezierScene::updateTessellationCache(const QOpenGLShaderProgram &captureProgram,
+                                          BezierPatch::Type type,
+                                          const QByteArray &key)
+{
+    ScopedTimer timer("Tessellation cache");
+    Q_UNUSED(captureProgram);
+    if (!_isInit || _patches.numPatches(type) == 0) {
+        return false;
+    }
+    if (_cacheKey[type] != key) {
+        // The view is moving, a capture would only cost time
+        _cacheKey[type] = key;
+        _cacheState[type] = CacheStale;
+        return false;
+    }
 
+    switch (_cacheState[type]) {
+    case CacheStale:
+        captureTessellation(type);
+        return false;
+    case CachePending:
+        readCacheQuery(type);
+        return _cacheState[type] == CacheValid;
+    case CacheValid:
+        return true;
+    case CacheTooLarge:
+        return false;
+    }
+    return false;
+}
+
+void BezierScene::renderCached(const QOpenGLShaderProgram &program, BezierPatch::Type type)
+{
+    Q_UNUSED(program);
+    if (!_isInit || _cacheState[type] != CacheValid) {
+        return;
+    }
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INVARIANT_BINDING, _invariantSSBO[type]);
+    bindControlPoints();
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PATCH_INDEX_BINDING, _patchIBO[type]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, POWER_BASIS_BINDING, _powerBasisSSBO[type]);
+
+    glBindVertexArray(_cacheVAO[type]);
+    glDrawTransformFeedback(GL_TRIANGLES, _cacheTFO[type]);
+    glBindVertexArray(0);
+
+    fenceEditRegion();
+}
+
+void BezierScene::drawPatches(BezierPatch::Type type)
+{
+    if (!_dirtyVertices[_editRegion].isEmpty()) {
+        uploadDirtyRanges();
+    }
+    if (!_dirtyInvariants.isEmpty()) {
+        uploadDirtyInvariants();
+    }
+    if (_drawCommandsChanged) {
+        for (int t = 0; t < BezierPatch::NUM_PATCH_TYPES; ++t) {
+            glNamedBufferData(_drawCommandBO[t],
+                              sizeof(DrawCommand) * _drawCommands[t].size(),
+                              _drawCommands[t].constData(),
+                              GL_STREAM_DRAW);
+        }
+        _drawCommandsChanged = false;
+    }
+
+    glPatchParameteri(GL_PATCH_VERTICES, PatchStore::numControlPoints(type));
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INVARIANT_BINDING, _invariantSSBO[type]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PATCH_EDGE_BINDING, _patchEdgeSSBO[type]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, EDGE_LEVEL_BINDING, _edgeLevelSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, POWER_BASIS_BINDING, _powerBasisSSBO[type]);
     glBindVertexArray(_sceneVAO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _patchIBO);
-    glDrawElements(GL_PATCHES, _patches.size() * 10 , GL_UNSIGNED_INT, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _patchIBO[type]);
+    if (_isCulled) {
+        // The base instance of every run selects its first patch
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _drawCommandBO[type]);
+        glMultiDrawElementsIndirect(GL_PATCHES, GL_UNSIGNED_INT, 0,
+                                    _drawCommands[type].size(), 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    } else {
+        glDrawElements(GL_PATCHES, _patches.indices(type).size(), GL_UNSIGNED_INT, 0);
+    }
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
+}
+
+void BezierScene::computeEdgeLevels(const QOpenGLShaderProgram &program)
+{
+    ScopedTimer timer("Compute edge levels");
+    Q_UNUSED(program);
+    if (!_isInit || _edgeTable.isEmpty()) {
+        return;
+    }
+    if (!_dirtyVertices[_editRegion].isEmpty()) {
+        uploadDirtyRanges();
+    }
+    if (!_dirtyEdgeInvariants.isEmpty()) {
+        for (const DirtyRangeTracker::Range &range : _dirtyEdgeInvariants.takeRanges()) {
+            glNamedBufferSubData(_edgeInvariantSSBO,
+                                 sizeof(EdgeInvariants) * range.begin,
+                                 sizeof(EdgeInvariants) * (range.end - range.begin),
+                                 _edgeInvariants.constData() + range.begin);
+        }
+    }
 
+    bindControlPoints();
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, EDGE_BINDING, _edgeSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, EDGE_INVARIANT_BINDING, _edgeInvariantSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, EDGE_LEVEL_BINDING, _edgeLevelSSBO);
+    const int numEdges = _edgeTable.size();
+    glDispatchCompute((numEdges + EDGE_LEVEL_GROUP_SIZE - 1) / EDGE_LEVEL_GROUP_SIZE, 1, 1);
+    // The control shaders read the levels as shader storage as well
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+bool BezierScene::computeTessellation(QOpenGLShaderProgram &levelProgram,
+                                      QOpenGLShaderProgram &evaluateProgram,
+                                      BezierPatch::Type type,
+                                      const QByteArray &key)
+{
+    ScopedTimer timer("Compute tessellation");
+    const GLuint numPatches = _patches.numPatches(type);
+    if (!_isInit || numPatches == 0) {
+        return false;
+    }
+    readComputeCounters(type);
+    if (_isComputed[type] && _computeKey[type] == key) {
+        return false;
+    }
+
+    if (_vertexCapacity[type] == 0) {
+        resizeComputeBuffers(type,
+                             numPatches * gridVertices(type, INITIAL_COMPUTE_LEVEL),
+                             numPatches * gridIndices(type, INITIAL_COMPUTE_LEVEL));
+    }
+    if (!_dirtyVertices[_editRegion].isEmpty()) {
+        uploadDirtyRanges();
+    }
+    if (!_dirtyInvariants.isEmpty()) {
+        uploadDirtyInvariants();
+    }
 
+    // The command is completed by the evaluate program
+    const ComputeCounters reset = {{0, 1, 0, 0, 0}, 0, 0, 0};
+    glNamedBufferSubData(_computeCounterBO[type], 0, sizeof(ComputeCounters), &reset);
 
-    //program.release();
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INVARIANT_BINDING, _invariantSSBO[type]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PATCH_EDGE_BINDING, _patchEdgeSSBO[type]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, EDGE_LEVEL_BINDING, _edgeLevelSSBO);
+    bindControlPoints();
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMPUTED_VERTEX_BINDING, _computedVertexBO[type]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PATCH_INDEX_BINDING, _patchIBO[type]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMPUTED_PATCH_BINDING, _computedPatchBO[type]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMPUTE_COUNTER_BINDING, _computeCounterBO[type]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMPUTED_INDEX_BINDING, _computedIndexBO[type]);
+
+    levelProgram.bind();
+    levelProgram.setUniformValue("NumPatches", numPatches);
+    levelProgram.setUniformValue("MaxComputeLevel", COMPUTE_MAX_LEVEL);
+    glDispatchCompute((numPatches + COMPUTE_GROUP_SIZE - 1) / COMPUTE_GROUP_SIZE, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+    // One work group per patch, in two dimensions for large scenes
+    evaluateProgram.bind();
+    evaluateProgram.setUniformValue("NumPatches", numPatches);
+    evaluateProgram.setUniformValue("VertexCapacity", _vertexCapacity[type]);
+    evaluateProgram.setUniformValue("IndexCapacity", _indexCapacity[type]);
+    evaluateProgram.setUniformValue("MaxComputeLevel", COMPUTE_MAX_LEVEL);
+    const GLuint groupsX = std::min(numPatches, MAX_WORK_GROUPS);
+    glDispatchCompute(groupsX, (numPatches + groupsX - 1) / groupsX, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT |
+                    GL_ELEMENT_ARRAY_BARRIER_BIT |
+                    GL_COMMAND_BARRIER_BIT |
+                    GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    if (_computeFence[type]) {
+        glDeleteSync(_computeFence[type]);
+    }
+    _computeFence[type] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    _computeKey[type] = key;
+    _isComputed[type] = true;
+    return true;
+}
+
+void BezierScene::renderComputed(const QOpenGLShaderProgram &program, BezierPatch::Type type)
+{
+    Q_UNUSED(program);
+    if (!_isInit || !_isComputed[type]) {
+        return;
+    }
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INVARIANT_BINDING, _invariantSSBO[type]);
+    bindControlPoints();
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMPUTED_VERTEX_BINDING, _computedVertexBO[type]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PATCH_INDEX_BINDING, _patchIBO[type]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMPUTED_PATCH_BINDING, _computedPatchBO[type]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, POWER_BASIS_BINDING, _powerBasisSSBO[type]);
+
+    // Vertices are pulled from the buffers, the attributes are not used
+    glBindVertexArray(_sceneVAO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _computedIndexBO[type]);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _computeCounterBO[type]);
+    glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+
+    fenceEditRegion();
+}
+
+bool BezierScene::readComputed(BezierPatch::Type type,
+                               BezierTriangleTessellator::Mesh &mesh,
+                               QVector<unsigned> *patchNumbers)
+{
+    mesh.clear();
+    if (patchNumbers) {
+        patchNumbers->clear();
+    }
+    if (!_isInit || !_isComputed[type]) {
+        return false;
+    }
+    glFinish();
+
+    ComputeCounters counters;
+    glGetNamedBufferSubData(_computeCounterBO[type], 0, sizeof(ComputeCounters), &counters);
+    if (counters.requestedVertices > _vertexCapacity[type] ||
+            counters.requestedIndices > _indexCapacity[type]) {
+        return false;
+    }
+
+    QVector<ComputedVertex> vertices(counters.requestedVertices);
+    glGetNamedBufferSubData(_computedVertexBO[type], 0,
+                            sizeof(ComputedVertex) * vertices.size(), vertices.data());
+    mesh.vertices.reserve(vertices.size());
+    mesh.normals.reserve(vertices.size());
+    if (patchNumbers) {
+        patchNumbers->reserve(vertices.size());
+    }
+    for (const ComputedVertex &vertex : vertices) {
+        mesh.vertices.append(QVector3D(vertex.position[0], vertex.position[1],
+                                       vertex.position[2]));
+        mesh.normals.append(QVector3D(vertex.normal[0], vertex.normal[1], vertex.normal[2]));
+        if (patchNumbers) {
+            patchNumbers->append(vertex.patchNumber);
+        }
+    }
+
+    mesh.indices.resize(counters.command.count);
+    glGetNamedBufferSubData(_computedIndexBO[type], 0,
+                            sizeof(GLuint) * mesh.indices.size(), mesh.indices.data());
+    return true;
 }
 
 const QMatrix4x4 BezierScene::getModelMatrix() {
     return _modelMatrix;
 }
 
+int BezierScene::cull(const QMatrix4x4 &modelViewMatrix,
+                      const QMatrix4x4 &projectionMatrix,
+                      int flags)
+{
+    ScopedTimer timer("Cull");
+    if (isPaged()) {
+        // Pages are culled by their boxes, the patches in them are not
+        _culler.setFlags(flags);
+        _culler.setView(modelViewMatrix, projectionMatrix);
+        return _pager.update(_culler, modelViewMatrix.inverted().map(QVector3D()));
+    }
+    const int numPatches = _patches.size();
+    const bool hasBVH = _bvh.numPatches() == numPatches;
+    const bool useLod = _lodTolerance > 0.0f && !_lod.isEmpty() && hasBVH;
+    _isCulled = (flags != 0 || useLod) && _patchBounds.size() == numPatches;
+    if (!_lodDrawCommands.isEmpty()) {
+        _visibleProxies.clear();
+        _lodDrawCommands.clear();
+        _lodDrawCommandsChanged = true;
+    }
+    if (!_isCulled) {
+        return numPatches;
+    }
+
+    _culler.setFlags(flags);
+    _culler.setView(modelViewMatrix, projectionMatrix);
+    _culler.setLod(useLod ? &_lod : nullptr, _lodTolerance, _viewportHeight);
+    const int numVisible = hasBVH ?
+                _culler.cull(_bvh, _patchBounds, _visibleRuns,
+                             useLod ? &_visibleProxies : nullptr) :
+                _culler.cull(_patchBounds, _visibleRuns);
+
+    for (int proxy : _visibleProxies) {
+        const PatchLOD::Proxy &lodProxy = _lod.proxies()[proxy];
+        const DrawCommand command = {
+            GLuint(lodProxy.numIndices), 1, GLuint(lodProxy.firstIndex), lodProxy.baseVertex, 0
+        };
+        _lodDrawCommands.push_back(command);
+    }
+    _lodDrawCommandsChanged = true;
+
+    for (int type = 0; type < BezierPatch::NUM_PATCH_TYPES; ++type) {
+        _drawCommands[type].clear();
+    }
+    // Runs are in global patch numbers, a run can span both index buffers
+    for (const PatchCuller::Run &run : _visibleRuns) {
+        int first = run.first;
+        const int last = run.first + run.count;
+        while (first < last) {
+            const BezierPatch::Type type = _patches.patchType(first);
+            const int typeEnd = type == BezierPatch::TriPatch ?
+                        _patches.firstPatch(BezierPatch::QuadPatch) : numPatches;
+            const int count = std::min(last, typeEnd) - first;
+            const int indicesPerPatch = PatchStore::numControlPoints(type);
+            const GLuint firstPatch = first - _patches.firstPatch(type);
+            const DrawCommand command = {
+                GLuint(count * indicesPerPatch), 1, firstPatch * indicesPerPatch, 0, firstPatch
+            };
+            _drawCommands[type].push_back(command);
+            first += count;
+        }
+    }
+    _drawCommandsChanged = true;
+    return numVisible;
+}
+
+void BezierScene::setLodTolerance(float tolerance, int viewportHeight)
+{
+    _lodTolerance = tolerance;
+    _viewportHeight = viewportHeight;
+}
+
+void BezierScene::renderLod(const QOpenGLShaderProgram &program)
+{
+    Q_UNUSED(program);
+    if (!_isInit || _lodDrawCommands.isEmpty()) {
+        return;
+    }
+    if (_lodDrawCommandsChanged) {
+        glNamedBufferData(_lodDrawCommandBO,
+                          sizeof(DrawCommand) * _lodDrawCommands.size(),
+                          _lodDrawCommands.constData(),
+                          GL_STREAM_DRAW);
+        _lodDrawCommandsChanged = false;
+    }
+
+    glBindVertexArray(_lodVAO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _lodIBO);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _lodDrawCommandBO);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, 0,
+                                _lodDrawCommands.size(), 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+int BezierScene::pick(const QVector3D &origin,
+                      const QVector3D &direction,
+                      float *distance) const
+{
+    if (_bvh.numPatches() != _patches.size()) {
+        return -1;
+    }
+    return _bvh.pick(_patches, origin, direction, distance);
+}
+
+void BezierScene::renderPatch(const QOpenGLShaderProgram &program, int patch)
+{
+    Q_UNUSED(program);
+    if (!_isInit || patch < 0 || patch >= _patches.size()) {
+        return;
+    }
+    const BezierPatch::Type type = _patches.patchType(patch);
+    const int indicesPerPatch = PatchStore::numControlPoints(type);
+    const int typePatch = patch - _patches.firstPatch(type);
+    glPatchParameteri(GL_PATCH_VERTICES, indicesPerPatch);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INVARIANT_BINDING, _invariantSSBO[type]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PATCH_EDGE_BINDING, _patchEdgeSSBO[type]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, EDGE_LEVEL_BINDING, _edgeLevelSSBO);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, POWER_BASIS_BINDING, _powerBasisSSBO[type]);
+    glBindVertexArray(_sceneVAO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _patchIBO[type]);
+    glDrawElementsInstancedBaseInstance(
+                GL_PATCHES, indicesPerPatch, GL_UNSIGNED_INT,
+                reinterpret_cast<const GLvoid *>(sizeof(unsigned) * typePatch * indicesPerPatch),
+                1, typePatch);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+    fenceEditRegion();
+}
+
+void BezierScene::setSceneData(const BezierSceneData &data, BufferMode mode)
+{
+    ScopedTimer timer("Scene upload");
+    _patches = data.patches;
+    _patchBounds = data.patchBounds;
+    _bvh = data.bvh;
+    _lod = data.lod;
+    _isCulled = false;
+    _visibleProxies.clear();
+    _lodDrawCommands.clear();
+    _bufferMode = mode;
+    for (int type = 0; type < BezierPatch::NUM_PATCH_TYPES; ++type) {
+        // Counters of the previous scene are of no use
+        if (_computeFence[type]) {
+            glDeleteSync(_computeFence[type]);
+            _computeFence[type] = 0;
+        }
+        _isComputed[type] = false;
+        _vertexCapacity[type] = 0;
+        _indexCapacity[type] = 0;
+        _cacheKey[type].clear();
+        _cacheState[type] = CacheStale;
+        _cacheCapacity[type] = 0;
+    }
+    setIndexBuffer(BezierPatch::TriPatch, data.indices);
+    setIndexBuffer(BezierPatch::QuadPatch, data.quadIndices);
+    setPatchBuffers(data.patchInvariants.size() == _patches.size() ?
+                        data.patchInvariants : PatchInvariants::fromPatches(_patches));
+    setEdgeBuffers(data.edgeTable, data.edgeInvariants.size() == data.edgeTable.size() ?
+                       data.edgeInvariants :
+                       EdgeInvariants::fromEdges(data.edgeTable, data.vertices));
+    if (mode == PersistentBuffers) {
+        QBitArray isCenterPoint(data.vertices.size());
+        for (unsigned index : data.centerPoints) {
+            isCenterPoint.setBit(index);
+        }
+        const int numPatches = data.indices.size() / 10;
+        _interpolatedCenters = QBitArray(numPatches);
+        for (int patch = 0; patch < numPatches; ++patch) {
+            if (isCenterPoint.testBit(data.indices[patch * 10 + 9])) {
+                _interpolatedCenters.setBit(patch);
+            }
+        }
+        _adjacencyOffsets.clear();
+        _adjacency.clear();
+        _patchEdits.clear();
+        for (DirtyRangeTracker &dirtyVertices : _dirtyVertices) {
+            dirtyVertices.clear();
+        }
+
+        createPersistentVertexBuffer(data.vertices);
+    } else {
+        setVertexBuffer(data.vertices);
+    }
+    setLodBuffers();
+    setModelMatrix(data.modelMatrix);
+    _pager.setPageTable(data.pageTable);
+}
+
+const QVector4D BezierScene::getControlPoint(unsigned index) const
+{
+    Q_ASSERT(isEditable());
+    return _patches.controlPoints()[index];
+}
+
+void BezierScene::setControlPoint(unsigned index, const QVector4D &point)
+{
+    setControlPoints(QVector<unsigned>(1, index), QVector<QVector4D>(1, point));
+}
+
+void BezierScene::setControlPoints(const QVector<unsigned> &indices,
+                                   const QVector<QVector4D> &points)
+{
+    Q_ASSERT(indices.size() == points.size());
+    if (!isEditable()) {
+        qWarning() << "BezierScene::setControlPoints: scene is not editable";
+        return;
+    }
+    if (_adjacencyOffsets.isEmpty()) {
+        createAdjacency();
+    }
+
+    // All points are moved first, so a patch with several moved points is
+    // only updated once
+    const unsigned numControlPoints = getNumControlPoints();
+    QVector<int> movedPatches;
+    for (int i = 0; i < indices.size(); ++i) {
+        const unsigned index = indices[i];
+        if (index >= numControlPoints) {
+            qWarning() << "BezierScene::setControlPoints: index out of range" << index;
+            continue;
+        }
+        _patches.setControlPoint(index, points[i]);
+        for (DirtyRangeTracker &dirtyVertices : _dirtyVertices) {
+            dirtyVertices.markDirty(index);
+        }
+        for (int a = _adjacencyOffsets[index]; a < _adjacencyOffsets[index + 1]; ++a) {
+            const int patch = _adjacency[a] / ADJACENCY_STRIDE;
+            const int controlPoint = _adjacency[a] % ADJACENCY_STRIDE;
+            if (_patchEdits[patch] == 0) {
+                movedPatches.push_back(patch);
+            }
+            _patchEdits[patch] |= PATCH_MOVED;
+            if (_patches.patchType(patch) == BezierPatch::TriPatch &&
+                    controlPoint != BezierTriangle::B111 &&
+                    _interpolatedCenters.testBit(patch)) {
+                _patchEdits[patch] |= CENTER_MOVED;
+            }
+        }
+    }
+    if (movedPatches.isEmpty()) {
+        return;
+    }
+
+    QVector4D controlPoints[BezierQuad::NUM_CONTROL_POINTS];
+    for (int patch : movedPatches) {
+        const BezierPatch::Type type = _patches.patchType(patch);
+        _patches.gatherControlPoints(type, patch - _patches.firstPatch(type), controlPoints);
+
+        if (_patchEdits[patch] & CENTER_MOVED) {
+            const unsigned centerIndex =
+                    _patches.patchIndices(BezierPatch::TriPatch, patch)[BezierTriangle::B111];
+            controlPoints[BezierTriangle::B111] =
+                    BezierTriangle::interpolateCenterPoint(controlPoints);
+            _patches.setControlPoint(centerIndex, controlPoints[BezierTriangle::B111]);
+            for (DirtyRangeTracker &dirtyVertices : _dirtyVertices) {
+                dirtyVertices.markDirty(centerIndex);
+            }
+        }
+        _patchEdits[patch] = 0;
+        if (patch < _patchBounds.size()) {
+            _patchBounds[patch] = PatchBounds::fromPatch(type, controlPoints);
+        }
+        _patchInvariants[patch] = PatchInvariants::fromPatch(type, controlPoints);
+        _dirtyInvariants.markDirty(patch);
+    }
+    updateEdgeInvariants(movedPatches);
+    if (_bvh.numPatches() == _patchBounds.size()) {
+        _bvh.refit(_patchBounds, movedPatches);
+    }
+    invalidateCaches();
+    // Proxies are not rebuilt while editing, the patches are drawn instead
+    _lod.clear();
+}
+
 // --- Protected ---------------------------------------------------------------
 
 void BezierScene::addBezierTriangle(const BezierTriangle &patch)
 {
-    _patches.push_back(QSharedPointer<BezierPatch>(new BezierTriangle(patch)));
+    _patches.addTriangle(patch.getControlPoints().constData());
 }
 
-void BezierScene::setIndexBuffer(const QVector<unsigned> &indices){
+void BezierScene::addBezierQuad(const BezierQuad &patch)
+{
+    _patches.addQuad(patch.getControlPoints().constData());
+}
+
+void BezierScene::setIndexBuffer(BezierPatch::Type type, const QVector<unsigned> &indices){
     if (!_isInit) {
         initialize();
     }
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _patchIBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _patchIBO[type]);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER,
                  sizeof(unsigned) * indices.size(),
                  indices.data(),
@@ -70,6 +744,69 @@ void BezierScene::setIndexBuffer(const QVector<unsigned> &indices){
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
 
+void BezierScene::setPatchBuffers(const QVector<PatchInvariants> &invariants)
+{
+    if (!_isInit) {
+        initialize();
+    }
+    _patchInvariants = invariants;
+    _dirtyInvariants.clear();
+
+    int maxPatches = 0;
+    for (int type = 0; type < BezierPatch::NUM_PATCH_TYPES; ++type) {
+        const BezierPatch::Type patchType = static_cast<BezierPatch::Type>(type);
+        const int numPatches = _patches.numPatches(patchType);
+        glNamedBufferData(_invariantSSBO[type],
+                          sizeof(PatchInvariants) * numPatches,
+                          _patchInvariants.constData() + _patches.firstPatch(patchType),
+                          GL_STATIC_DRAW);
+        const QVector<QVector4D> coefficients = PowerBasis::fromPatches(_patches, patchType);
+        glNamedBufferData(_powerBasisSSBO[type],
+                          sizeof(QVector4D) * coefficients.size(),
+                          coefficients.constData(),
+                          GL_STATIC_DRAW);
+        maxPatches = std::max(maxPatches, numPatches);
+    }
+
+    QVector<GLuint> patchBase(maxPatches);
+    std::iota(patchBase.begin(), patchBase.end(), 0u);
+    glNamedBufferData(_patchBaseBO,
+                      sizeof(GLuint) * patchBase.size(),
+                      patchBase.constData(),
+                      GL_STATIC_DRAW);
+}
+
+void BezierScene::setEdgeBuffers(const PatchEdgeTable &edgeTable,
+                                 const QVector<EdgeInvariants> &invariants)
+{
+    if (!_isInit) {
+        initialize();
+    }
+    _edgeTable = edgeTable;
+    _edgeInvariants = invariants;
+    _dirtyEdgeInvariants.clear();
+
+    const int numEdges = _edgeTable.size();
+    glNamedBufferData(_edgeSSBO,
+                      sizeof(unsigned) * _edgeTable.edgeVertices().size(),
+                      _edgeTable.edgeVertices().constData(),
+                      GL_STATIC_DRAW);
+    glNamedBufferData(_edgeInvariantSSBO,
+                      sizeof(EdgeInvariants) * numEdges,
+                      _edgeInvariants.constData(),
+                      GL_STATIC_DRAW);
+    // Written every frame, read only by the GPU
+    glNamedBufferData(_edgeLevelSSBO, sizeof(GLfloat) * numEdges, nullptr, GL_DYNAMIC_COPY);
+    for (int type = 0; type < BezierPatch::NUM_PATCH_TYPES; ++type) {
+        const QVector<unsigned> &patchEdges =
+                _edgeTable.patchEdges(static_cast<BezierPatch::Type>(type));
+        glNamedBufferData(_patchEdgeSSBO[type],
+                          sizeof(unsigned) * patchEdges.size(),
+                          patchEdges.constData(),
+                          GL_STATIC_DRAW);
+    }
+}
+
 void BezierScene::setModelMatrix(const QMatrix4x4 &modelMatrix) {
     _modelMatrix = QMatrix4x4(modelMatrix);
 }
@@ -79,15 +816,40 @@ void BezierScene::setVertexBuffer(const QVector<QVector4D> &vertices)
     if (!_isInit) {
         initialize();
     }
+    GLint isImmutable = GL_FALSE;
+    glGetNamedBufferParameteriv(_sceneBO, GL_BUFFER_IMMUTABLE_STORAGE, &isImmutable);
+    if (isImmutable) {
+        // Storage of an editable scene can not be resized, a new buffer is
+        // needed for glBufferData
+        if (_mappedVertices) {
+            glUnmapNamedBuffer(_sceneBO);
+            _mappedVertices = nullptr;
+        }
+        glDeleteBuffers(1, &_sceneBO);
+        glCreateBuffers(1, &_sceneBO);
+        _editRegion = 0;
+        bindEditRegion();
+    }
     glBindBuffer(GL_ARRAY_BUFFER, _sceneBO);
     glBufferData(GL_ARRAY_BUFFER,
                  sizeof(QVector4D) * vertices.size(),
                  vertices.data(),
-                 GL_STATIC_DRAW);    glBindBuffer(GL_ARRAY_BUFFER, 0);
+                 GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 // --- Private -----------------------------------------------------------------
 
+void BezierScene::setLodBuffers()
+{
+    const QVector<PatchLOD::Vertex> &vertices = _lod.vertices();
+    const QVector<unsigned> &indices = _lod.indices();
+    glNamedBufferData(_lodBO, sizeof(PatchLOD::Vertex) * vertices.size(),
+                      vertices.constData(), GL_STATIC_DRAW);
+    glNamedBufferData(_lodIBO, sizeof(unsigned) * indices.size(),
+                      indices.constData(), GL_STATIC_DRAW);
+}
+
 void BezierScene::createBuffers() {
     glGenVertexArrays(1, &_sceneVAO);
     glBindVertexArray(_sceneVAO);
@@ -97,7 +859,166 @@ void BezierScene::createBuffers() {
     glEnableVertexAttribArray(LOCATION);
     glVertexAttribPointer(LOCATION, 4, GL_FLOAT, GL_FALSE, 0, 0);
 
-    glGenBuffers(1, &_patchIBO);
+    glGenBuffers(BezierPatch::NUM_PATCH_TYPES, _patchIBO);
+
+    // One value per instance, the base instance of a draw picks the value
+    glGenBuffers(1, &_patchBaseBO);
+    glBindBuffer(GL_ARRAY_BUFFER, _patchBaseBO);
+    glEnableVertexAttribArray(PATCH_BASE);
+    glVertexAttribIPointer(PATCH_BASE, 1, GL_UNSIGNED_INT, 0, 0);
+    glVertexAttribDivisor(PATCH_BASE, 1);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+
+    glGenBuffers(BezierPatch::NUM_PATCH_TYPES, _invariantSSBO);
+    glGenBuffers(BezierPatch::NUM_PATCH_TYPES, _powerBasisSSBO);
+    glGenBuffers(BezierPatch::NUM_PATCH_TYPES, _drawCommandBO);
+
+    glGenVertexArrays(1, &_lodVAO);
+    glGenBuffers(1, &_lodBO);
+    glGenBuffers(1, &_lodIBO);
+    glGenBuffers(1, &_lodDrawCommandBO);
+    glBindVertexArray(_lodVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, _lodBO);
+    glEnableVertexAttribArray(LOCATION);
+    glVertexAttribPointer(LOCATION, 3, GL_FLOAT, GL_FALSE, sizeof(PatchLOD::Vertex),
+                          reinterpret_cast<void *>(offsetof(PatchLOD::Vertex, position)));
+    glEnableVertexAttribArray(NORMALS);
+    glVertexAttribPointer(NORMALS, 3, GL_FLOAT, GL_FALSE, sizeof(PatchLOD::Vertex),
+                          reinterpret_cast<void *>(offsetof(PatchLOD::Vertex, normal)));
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+
+    glGenBuffers(1, &_edgeSSBO);
+    glGenBuffers(1, &_edgeInvariantSSBO);
+    glGenBuffers(1, &_edgeLevelSSBO);
+    glGenBuffers(BezierPatch::NUM_PATCH_TYPES, _patchEdgeSSBO);
+
+    glGenBuffers(BezierPatch::NUM_PATCH_TYPES, _computedPatchBO);
+    glGenBuffers(BezierPatch::NUM_PATCH_TYPES, _computedVertexBO);
+    glGenBuffers(BezierPatch::NUM_PATCH_TYPES, _computedIndexBO);
+    glGenBuffers(BezierPatch::NUM_PATCH_TYPES, _computeCounterBO);
+    for (int type = 0; type < BezierPatch::NUM_PATCH_TYPES; ++type) {
+        glNamedBufferData(_computeCounterBO[type], sizeof(ComputeCounters),
+                          nullptr, GL_DYNAMIC_COPY);
+    }
+
+    glGenVertexArrays(BezierPatch::NUM_PATCH_TYPES, _cacheVAO);
+    glGenBuffers(BezierPatch::NUM_PATCH_TYPES, _cacheBO);
+    glCreateTransformFeedbacks(BezierPatch::NUM_PATCH_TYPES, _cacheTFO);
+    glGenQueries(BezierPatch::NUM_PATCH_TYPES, _cacheQuery);
+    const GLsizei stride = sizeof(CachedVertex);
+    for (int type = 0; type < BezierPatch::NUM_PATCH_TYPES; ++type) {
+        glBindVertexArray(_cacheVAO[type]);
+        glBindBuffer(GL_ARRAY_BUFFER, _cacheBO[type]);
+        glEnableVertexAttribArray(CACHE_COORD);
+        glVertexAttribPointer(CACHE_COORD, 4, GL_FLOAT, GL_FALSE, stride,
+                              reinterpret_cast<void *>(offsetof(CachedVertex, coord)));
+        glEnableVertexAttribArray(CACHE_NORMAL);
+        glVertexAttribPointer(CACHE_NORMAL, 3, GL_FLOAT, GL_FALSE, stride,
+                              reinterpret_cast<void *>(offsetof(CachedVertex, normal)));
+        glEnableVertexAttribArray(CACHE_BARYCENTER);
+        glVertexAttribPointer(CACHE_BARYCENTER, 3, GL_FLOAT, GL_FALSE, stride,
+                              reinterpret_cast<void *>(offsetof(CachedVertex, barycenter)));
+        glEnableVertexAttribArray(CACHE_LEVELS);
+        glVertexAttribPointer(CACHE_LEVELS, 2, GL_FLOAT, GL_FALSE, stride,
+                              reinterpret_cast<void *>(offsetof(CachedVertex, levels)));
+        glEnableVertexAttribArray(CACHE_PATCH_NUMBER);
+        glVertexAttribIPointer(CACHE_PATCH_NUMBER, 1, GL_UNSIGNED_INT, stride,
+                               reinterpret_cast<void *>(offsetof(CachedVertex, patchNumber)));
+
+        // The buffer is bound once, transform feedback objects keep it
+        glTransformFeedbackBufferBase(_cacheTFO[type], 0, _cacheBO[type]);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+void BezierScene::createPersistentVertexBuffer(const QVector<QVector4D> &vertices)
+{
+    if (!_isInit) {
+        initialize();
+    }
+    // Buffer storage is immutable, so the buffer created in createBuffers is
+    // replaced by a new one
+    if (_mappedVertices) {
+        glUnmapNamedBuffer(_sceneBO);
+        _mappedVertices = nullptr;
+    }
+    glDeleteBuffers(1, &_sceneBO);
+    glGenBuffers(1, &_sceneBO);
+    for (GLsync &fence : _renderFence) {
+        if (fence) {
+            glDeleteSync(fence);
+            fence = 0;
+        }
+    }
+
+    // Every region starts at a valid offset for glBindBufferRange
+    GLint alignment = 0;
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    const int alignedVertices = std::max(1, alignment / static_cast<int>(sizeof(QVector4D)));
+    const int numVertices = std::max(vertices.size(), 1);
+    _editRegionStride = (numVertices + alignedVertices - 1) / alignedVertices * alignedVertices;
+    _editRegion = 0;
+
+    const GLbitfield flags = GL_MAP_WRITE_BIT |
+            GL_MAP_PERSISTENT_BIT |
+            GL_MAP_FLUSH_EXPLICIT_BIT;
+    const GLsizeiptr size = sizeof(QVector4D) * GLsizeiptr(_editRegionStride) * NUM_EDIT_REGIONS;
+
+    glBindVertexArray(_sceneVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, _sceneBO);
+    glBufferStorage(GL_ARRAY_BUFFER, size, nullptr, flags);
+    glEnableVertexAttribArray(LOCATION);
+    glVertexAttribPointer(LOCATION, 4, GL_FLOAT, GL_FALSE, 0, 0);
+    glBindVertexArray(0);
+
+    _mappedVertices = static_cast<QVector4D *>(
+                glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags));
+    if (_mappedVertices) {
+        for (int region = 0; region < NUM_EDIT_REGIONS; ++region) {
+            std::memcpy(_mappedVertices + region * _editRegionStride,
+                        vertices.constData(), sizeof(QVector4D) * vertices.size());
+        }
+        glFlushMappedBufferRange(GL_ARRAY_BUFFER, 0, size);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    if (!_mappedVertices) {
+        qWarning() << "Could not map the vertex buffer, scene is not editable";
+        _bufferMode = StaticBuffers;
+        setVertexBuffer(vertices);
+    }
+}
+
+void BezierScene::createAdjacency()
+{
+    _patchEdits.fill(0, _patches.size());
+    const int numVertices = getNumControlPoints();
+    _adjacencyOffsets.fill(0, numVertices + 1);
+    for (int type = 0; type < BezierPatch::NUM_PATCH_TYPES; ++type) {
+        for (unsigned index : _patches.indices(static_cast<BezierPatch::Type>(type))) {
+            ++_adjacencyOffsets[index + 1];
+        }
+    }
+    for (int i = 0; i < numVertices; ++i) {
+        _adjacencyOffsets[i + 1] += _adjacencyOffsets[i];
+    }
+
+    QVector<int> position = _adjacencyOffsets;
+    _adjacency.resize(_adjacencyOffsets[numVertices]);
+    for (int type = 0; type < BezierPatch::NUM_PATCH_TYPES; ++type) {
+        const BezierPatch::Type patchType = static_cast<BezierPatch::Type>(type);
+        const QVector<unsigned> &indices = _patches.indices(patchType);
+        const int indicesPerPatch = PatchStore::numControlPoints(patchType);
+        const int firstPatch = _patches.firstPatch(patchType);
+        for (int i = 0; i < indices.size(); ++i) {
+            const int patch = firstPatch + i / indicesPerPatch;
+            _adjacency[position[indices[i]]++] =
+                    patch * ADJACENCY_STRIDE + i % indicesPerPatch;
+        }
+    }
 }
 
 void BezierScene::initialize() {
@@ -105,3 +1026,265 @@ void BezierScene::initialize() {
     createBuffers();
     _isInit = true;
 }
+
+void BezierScene::uploadDirtyRanges()
+{
+    if (!_mappedVertices) {
+        for (DirtyRangeTracker &dirtyVertices : _dirtyVertices) {
+            dirtyVertices.clear();
+        }
+        return;
+    }
+    // The drawn region and the one before it may still be read by the GPU,
+    // the next one was last drawn two edits ago
+    const int region = (_editRegion + 1) % NUM_EDIT_REGIONS;
+    waitForFence(region);
+
+    const QVector<DirtyRangeTracker::Range> ranges =
+            _dirtyVertices[region].takeRanges(FLUSH_MERGE_GAP);
+    const int regionBegin = region * _editRegionStride;
+
+    glBindBuffer(GL_ARRAY_BUFFER, _sceneBO);
+    for (const DirtyRangeTracker::Range &range : ranges) {
+        const int count = range.end - range.begin;
+        std::memcpy(_mappedVertices + regionBegin + range.begin,
+                    _patches.controlPoints().constData() + range.begin,
+                    sizeof(QVector4D) * count);
+        glFlushMappedBufferRange(GL_ARRAY_BUFFER,
+                                 sizeof(QVector4D) * GLintptr(regionBegin + range.begin),
+                                 sizeof(QVector4D) * count);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    _editRegion = region;
+    bindEditRegion();
+}
+
+void BezierScene::bindEditRegion()
+{
+    glVertexArrayVertexBuffer(_sceneVAO, LOCATION, _sceneBO,
+                              sizeof(QVector4D) * GLintptr(_editRegion) * _editRegionStride,
+                              sizeof(QVector4D));
+}
+
+void BezierScene::bindControlPoints()
+{
+    if (!_mappedVertices) {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CONTROL_POINT_BINDING, _sceneBO);
+        return;
+    }
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, CONTROL_POINT_BINDING, _sceneBO,
+                      sizeof(QVector4D) * GLintptr(_editRegion) * _editRegionStride,
+                      sizeof(QVector4D) * GLsizeiptr(_editRegionStride));
+}
+
+void BezierScene::uploadDirtyInvariants()
+{
+    const QVector<DirtyRangeTracker::Range> ranges = _dirtyInvariants.takeRanges();
+    for (const DirtyRangeTracker::Range &range : ranges) {
+        // Ranges are in global patch numbers, the buffers are per type
+        for (int type = 0; type < BezierPatch::NUM_PATCH_TYPES; ++type) {
+            const BezierPatch::Type patchType = static_cast<BezierPatch::Type>(type);
+            const int typeBegin = _patches.firstPatch(patchType);
+            const int typeEnd = typeBegin + _patches.numPatches(patchType);
+            const int begin = std::max(range.begin, typeBegin);
+            const int end = std::min(range.end, typeEnd);
+            if (begin >= end) continue;
+            glNamedBufferSubData(_invariantSSBO[type],
+                                 sizeof(PatchInvariants) * (begin - typeBegin),
+                                 sizeof(PatchInvariants) * (end - begin),
+                                 _patchInvariants.constData() + begin);
+
+            // The power basis follows the invariants, edits are small
+            const int stride = PowerBasis::numCoefficients(patchType);
+            QVector<QVector4D> coefficients((end - begin) * stride);
+            QVector4D controlPoints[BezierQuad::NUM_CONTROL_POINTS];
+            for (int patch = begin; patch < end; ++patch) {
+                _patches.gatherControlPoints(patchType, patch - typeBegin, controlPoints);
+                PowerBasis::fromPatch(patchType, controlPoints,
+                                      coefficients.data() + (patch - begin) * stride);
+            }
+            glNamedBufferSubData(_powerBasisSSBO[type],
+                                 sizeof(QVector4D) * stride * (begin - typeBegin),
+                                 sizeof(QVector4D) * coefficients.size(),
+                                 coefficients.constData());
+        }
+    }
+}
+
+void BezierScene::updateEdgeInvariants(const QVector<int> &patches)
+{
+    if (_edgeTable.isEmpty()) return;
+
+    // Edges shared by moved patches are computed once
+    QVector<unsigned> edges;
+    for (int patch : patches) {
+        const BezierPatch::Type type = _patches.patchType(patch);
+        const int numEdges = PatchEdgeTable::numEdges(type);
+        const unsigned *patchEdges = _edgeTable.patchEdges(type).constData() +
+                (patch - _patches.firstPatch(type)) * numEdges;
+        for (int e = 0; e < numEdges; ++e) {
+            edges.push_back(patchEdges[e]);
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+    const QVector4D *points = _patches.controlPoints().constData();
+    for (unsigned edge : edges) {
+        const unsigned *indices = _edgeTable.edgeVertices().constData() +
+                edge * PatchEdgeTable::EDGE_SIZE;
+        _edgeInvariants[edge] = EdgeInvariants::fromEdge(
+                    points[indices[0]], points[indices[1]],
+                    points[indices[2]], points[indices[3]]);
+        _dirtyEdgeInvariants.markDirty(edge);
+    }
+}
+
+void BezierScene::readComputeCounters(BezierPatch::Type type)
+{
+    if (!_computeFence[type]) return;
+
+    // Never waits, the counters are read in a later frame instead
+    const GLenum result = glClientWaitSync(_computeFence[type], 0, 0);
+    if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED) {
+        return;
+    }
+    glDeleteSync(_computeFence[type]);
+    _computeFence[type] = 0;
+
+    ComputeCounters counters;
+    glGetNamedBufferSubData(_computeCounterBO[type], 0, sizeof(ComputeCounters), &counters);
+    if (counters.requestedVertices > _vertexCapacity[type] ||
+            counters.requestedIndices > _indexCapacity[type]) {
+        resizeComputeBuffers(type,
+                             std::max(counters.requestedVertices, _vertexCapacity[type]),
+                             std::max(counters.requestedIndices, _indexCapacity[type]));
+        _isComputed[type] = false;
+    }
+}
+
+void BezierScene::resizeComputeBuffers(BezierPatch::Type type,
+                                       GLuint numVertices,
+                                       GLuint numIndices)
+{
+    // Shader storage blocks are limited, patches that do not fit are dropped
+    GLint64 maxBlockSize = 0;
+    glGetInteger64v(GL_MAX_SHADER_STORAGE_BLOCK_SIZE, &maxBlockSize);
+    const GLint64 maxVertices = maxBlockSize / GLint64(sizeof(ComputedVertex));
+    const GLint64 maxIndices = maxBlockSize / GLint64(sizeof(GLuint));
+    if (numVertices > maxVertices || numIndices > maxIndices) {
+        qWarning() << "BezierScene: compute tessellation does not fit,"
+                   << numVertices << "vertices and" << numIndices << "indices requested";
+    }
+    // Some headroom, so zooming in does not resize every frame
+    _vertexCapacity[type] = GLuint(std::min(GLint64(numVertices) * 5 / 4, maxVertices));
+    _indexCapacity[type] = GLuint(std::min(GLint64(numIndices) * 5 / 4, maxIndices));
+
+    glNamedBufferData(_computedPatchBO[type],
+                      sizeof(ComputedPatch) * _patches.numPatches(type),
+                      nullptr, GL_DYNAMIC_COPY);
+    glNamedBufferData(_computedVertexBO[type],
+                      sizeof(ComputedVertex) * _vertexCapacity[type],
+                      nullptr, GL_DYNAMIC_COPY);
+    glNamedBufferData(_computedIndexBO[type],
+                      sizeof(GLuint) * _indexCapacity[type],
+                      nullptr, GL_DYNAMIC_COPY);
+}
+
+void BezierScene::captureTessellation(BezierPatch::Type type)
+{
+    if (_cacheCapacity[type] == 0) {
+        // Every index of a uniform grid becomes a captured vertex
+        resizeCache(type, _patches.numPatches(type) * gridIndices(type, INITIAL_CACHE_LEVEL));
+    }
+
+    // Only the outputs of the evaluation shader are needed
+    glEnable(GL_RASTERIZER_DISCARD);
+    glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, _cacheTFO[type]);
+    glBeginQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN, _cacheQuery[type]);
+    glBeginTransformFeedback(GL_TRIANGLES);
+    drawPatches(type);
+    glEndTransformFeedback();
+    glEndQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN);
+    glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, 0);
+    glDisable(GL_RASTERIZER_DISCARD);
+
+    _cacheState[type] = CachePending;
+}
+
+void BezierScene::readCacheQuery(BezierPatch::Type type)
+{
+    // Never waits, the query is read in a later frame instead
+    GLuint isAvailable = GL_FALSE;
+    glGetQueryObjectuiv(_cacheQuery[type], GL_QUERY_RESULT_AVAILABLE, &isAvailable);
+    if (isAvailable != GL_TRUE) {
+        return;
+    }
+    GLuint numTriangles = 0;
+    glGetQueryObjectuiv(_cacheQuery[type], GL_QUERY_RESULT, &numTriangles);
+
+    // Transform feedback stops at the end of the buffer, so a full buffer
+    // probably missed triangles
+    if (3 * (GLint64(numTriangles) + 1) <= GLint64(_cacheCapacity[type])) {
+        _cacheState[type] = CacheValid;
+        return;
+    }
+    const GLint64 maxVertices = CACHE_BUDGET / GLint64(sizeof(CachedVertex));
+    if (_cacheCapacity[type] >= maxVertices) {
+        _cacheState[type] = CacheTooLarge;
+        return;
+    }
+    resizeCache(type, GLuint(std::min(2 * GLint64(_cacheCapacity[type]), maxVertices)));
+    _cacheState[type] = CacheStale;
+}
+
+void BezierScene::resizeCache(BezierPatch::Type type, GLuint numVertices)
+{
+    const GLint64 maxVertices = CACHE_BUDGET / GLint64(sizeof(CachedVertex));
+    _cacheCapacity[type] = GLuint(std::min(GLint64(numVertices), maxVertices));
+    glNamedBufferData(_cacheBO[type], sizeof(CachedVertex) * _cacheCapacity[type],
+                      nullptr, GL_DYNAMIC_COPY);
+}
+
+void BezierScene::invalidateCaches()
+{
+    for (int type = 0; type < BezierPatch::NUM_PATCH_TYPES; ++type) {
+        _isComputed[type] = false;
+        _cacheKey[type].clear();
+        _cacheState[type] = CacheStale;
+    }
+}
+
+void BezierScene::fenceEditRegion()
+{
+    if (!isEditable()) return;
+
+    // The region may only be written again once the GPU has consumed this draw
+    GLsync &fence = _renderFence[_editRegion];
+    if (fence) {
+        glDeleteSync(fence);
+    }
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void BezierScene::waitForFence(int region)
+{
+    GLsync &fence = _renderFence[region];
+    if (!fence) return;
+
+    GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+    for (;;) {
+        const GLenum result = glClientWaitSync(fence, flags, FENCE_TIMEOUT);
+        if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED) {
+            break;
+        }
+        if (result == GL_WAIT_FAILED) {
+            qWarning() << "BezierScene: waiting for the render fence failed";
+            break;
+        }
+        flags = 0;
+    }
+    glDeleteSync(fence);
+    fence = 0;
+}
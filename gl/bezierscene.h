@@ -2,20 +2,33 @@
 #define BEZIERSCENE_H
 
 #include <geom/bezierpatch.h>
+#include <geom/bezierquad.h>
 #include <geom/beziertriangle.h>
+#include <geom/beziertriangletessellator.h>
+#include <geom/patchculler.h>
+#include <geom/patchedgetable.h>
+#include <geom/patchinvariants.h>
+#include <geom/patchlod.h>
+#include <geom/patchstore.h>
+#include <gl/scenepager.h>
+#include <util/bezierscenedata.h>
 #include <util/beziersceneimporter.h>
+#include <util/dirtyrangetracker.h>
 
+#include <QBitArray>
+#include <QByteArray>
 #include <QMatrix4x4>
 #include <QOpenGLFunctions_4_5_Core>
 #include <QOpenGLShaderProgram>
 #include <QPair>
-#include <QSharedPointer>
 #include <QVector>
 #include <QVector4D>
 
 class BezierScene : protected QOpenGLFunctions_4_5_Core
 {
     friend class BezierSceneImporter;
+    /// Reads back the edit regions
+    friend class ComputeTest;
 
     // =========================================================================
     // -- Enums ----------------------------------------------------------------
@@ -23,10 +36,85 @@ class BezierScene : protected QOpenGLFunctions_4_5_Core
 
 private:
 
+    enum {
+        /// Copies of the vertices of an editable scene, written in turn so
+        /// an edit only waits for the draws of two edits ago
+        NUM_EDIT_REGIONS = 3,
+        /// Dirty ranges closer than this (in vertices) are flushed as one range
+        FLUSH_MERGE_GAP = 64
+    };
+
     enum AttribArray {
         LOCATION = 0,
         NORMALS = 1,
-        TEXTURE = 2
+        TEXTURE = 2,
+        /// Per instance number of the first patch of a draw
+        PATCH_BASE = 3
+    };
+
+    /// Layout of GL_DRAW_INDIRECT_BUFFER entries for glMultiDrawElementsIndirect
+    struct DrawCommand {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance;
+    };
+
+    /// Layout of the ComputedPatch struct in the compute shaders
+    struct ComputedPatch {
+        GLfloat outerLevels[4];
+        GLuint firstVertex;
+        GLuint firstIndex;
+        GLuint gridLevel;
+        GLfloat innerLevel;
+    };
+
+    /// Layout of the ComputedVertex struct in the compute shaders
+    struct ComputedVertex {
+        GLfloat position[4];
+        GLfloat normal[4];
+        GLfloat parameter[2];
+        GLuint patchNumber;
+        GLuint padding;
+    };
+
+    /// Indirect draw of a computed tessellation, followed by the sizes the
+    /// compute shaders asked for
+    struct ComputeCounters {
+        DrawCommand command;
+        GLuint requestedIndices;
+        GLuint requestedVertices;
+        GLuint padding;
+    };
+
+    /// Tessellation evaluation outputs captured by transform feedback, the
+    /// attributes of cached_vertex.glsl
+    struct CachedVertex {
+        GLfloat coord[4];
+        GLfloat normal[3];
+        GLfloat barycenter[3];
+        GLfloat levels[2];
+        GLuint patchNumber;
+    };
+
+    enum CacheState {
+        /// The key or the patches changed, captured once the key is stable
+        CacheStale = 0,
+        /// Captured, the number of triangles is not read back yet
+        CachePending,
+        CacheValid,
+        /// Larger than the budget, not captured again until the key changes
+        CacheTooLarge
+    };
+
+public:
+
+    enum BufferMode {
+        /// Buffers are uploaded once with glBufferData
+        StaticBuffers,
+        /// Vertex buffer is persistently mapped, control points can be edited
+        PersistentBuffers
     };
 
     // =========================================================================
@@ -45,28 +133,253 @@ public:
 
 public:
 
-    // TODO: add render settings (such as wireframe, faces etc.)
-    void render(const QOpenGLShaderProgram &program);
+    /*!
+     * \brief render draws the patches of one type.
+     *
+     * Triangles and quads need different tessellation programs, the program
+     * of the type should be bound by the caller. The patch base attribute
+     * plus gl_PrimitiveID is the number of a patch within its type, also
+     * for the multi draws of the culled runs.
+     */
+    void render(const QOpenGLShaderProgram &program, BezierPatch::Type type);
+
+    /*!
+     * \brief computeEdgeLevels runs the edge level compute shader.
+     *
+     * Computes the outer tessellation level of every unique edge once, the
+     * control shaders of both neighbours then read the same value. The
+     * program should be bound by the caller, with its view uniforms set.
+     */
+    void computeEdgeLevels(const QOpenGLShaderProgram &program);
+
+    /*!
+     * \brief computeTessellation tessellates the patches of a type with
+     * compute shaders instead of the tessellation stages.
+     *
+     * The level program picks a grid level per patch and reserves its
+     * vertices and indices, the evaluate program fills them. Both programs
+     * need the uniforms of the control shaders. The result is reused while
+     * the key (the caller's uniforms) stays the same and no control points
+     * move. Returns true if the tessellation ran.
+     */
+    bool computeTessellation(QOpenGLShaderProgram &levelProgram,
+                             QOpenGLShaderProgram &evaluateProgram,
+                             BezierPatch::Type type,
+                             const QByteArray &key);
+
+    /// Draws the last computeTessellation() of a type, ignores culling
+    void renderComputed(const QOpenGLShaderProgram &program, BezierPatch::Type type);
+
+    /*!
+     * \brief readComputed reads the last computeTessellation() of a type
+     * back, after waiting for it.
+     *
+     * Vertices and normals are in model coordinates, like the ones of
+     * BezierTriangleTessellator. patchNumbers receives the patch of every
+     * vertex. Returns false if nothing was computed or patches were dropped
+     * for lack of space.
+     */
+    bool readComputed(BezierPatch::Type type,
+                      BezierTriangleTessellator::Mesh &mesh,
+                      QVector<unsigned> *patchNumbers = nullptr);
+
+    /*!
+     * \brief updateTessellationCache captures the tessellation of a patch
+     * type with transform feedback once the view is stable.
+     *
+     * The key holds the caller's view dependent uniforms. A capture starts
+     * in the second frame with the same key, so moving the camera never
+     * pays for it. The capture program is the tessellation program without
+     * geometry and fragment shaders, bound and with its uniforms set like
+     * for render(). Returns true if renderCached() can be used this frame.
+     */
+    bool updateTessellationCache(const QOpenGLShaderProgram &captureProgram,
+                                 BezierPatch::Type type,
+                                 const QByteArray &key);
+
+    /// Draws the captured triangles of a type, without tessellating
+    void renderCached(const QOpenGLShaderProgram &program, BezierPatch::Type type);
+
+    /// False for scenes without an edge table, e.g. built from patches
+    bool hasEdgeTable() const {
+        return !_edgeTable.isEmpty();
+    }
+
+    int getNumEdges() const {
+        return _edgeTable.size();
+    }
 
     const QMatrix4x4 getModelMatrix();
 
+    /*!
+     * \brief cull selects the patches drawn by the following render() calls.
+     *
+     * Takes PatchCuller::CullFlag values, with 0 every patch is drawn.
+     * Returns the number of visible patches.
+     */
+    int cull(const QMatrix4x4 &modelViewMatrix,
+             const QMatrix4x4 &projectionMatrix,
+             int flags = PatchCuller::CullFrustum);
+
+    /*!
+     * \brief setLodTolerance lets cull() replace distant nodes by their
+     * proxy, drawn by renderLod().
+     *
+     * The tolerance is in pixels, like the ProjectionTolerance of the
+     * heuristics, 0 disables the proxies.
+     */
+    void setLodTolerance(float tolerance, int viewportHeight);
+
+    /// False for scenes too small for proxies
+    bool hasLod() const {
+        return !_lod.isEmpty();
+    }
+
+    /// Proxies selected by the last cull()
+    int getNumVisibleProxies() const {
+        return _visibleProxies.size();
+    }
+
+    /// Draws the proxies selected by the last cull(), the program should be
+    /// bound by the caller
+    void renderLod(const QOpenGLShaderProgram &program);
+
+    /// First patch hit by a ray in model coordinates, or -1
+    int pick(const QVector3D &origin,
+             const QVector3D &direction,
+             float *distance = nullptr) const;
+
+    /// Draws a single patch by global number, for highlighting
+    void renderPatch(const QOpenGLShaderProgram &program, int patch);
+
+    /// Of the whole scene, also if it is paged
+    int getNumPatches(BezierPatch::Type type) const {
+        return isPaged() ? _pager.getNumPatches(type) : _patches.numPatches(type);
+    }
+
+    BezierPatch::Type getPatchType(int patch) const {
+        return _patches.patchType(patch);
+    }
+
+    /// Uploads imported data, requires a current OpenGL context
+    void setSceneData(const BezierSceneData &data,
+                      BufferMode mode = StaticBuffers);
+
+    /*!
+     * \brief isPaged is true for scenes streamed in by a ScenePager.
+     *
+     * Only cull() and render() work for these, none of the patches are
+     * on the CPU: there is no picking, editing, level of detail, edge
+     * table, computed tessellation or tessellation cache.
+     */
+    bool isPaged() const {
+        return !_pager.isEmpty();
+    }
+
+    const ScenePager &getPager() const {
+        return _pager;
+    }
+
+    bool isEditable() const {
+        return _bufferMode == PersistentBuffers;
+    }
+
+    int getNumControlPoints() const {
+        return _patches.controlPoints().size();
+    }
+
+    const QVector4D getControlPoint(unsigned index) const;
+
+    /*!
+     * \brief setControlPoint moves a control point of an editable scene.
+     *
+     * Interpolated center points of the adjacent patches are updated as well.
+     * Only the modified ranges are uploaded, in the next call to render().
+     */
+    void setControlPoint(unsigned index, const QVector4D &point);
+
+    /// Moves several control points, every adjacent patch is updated once
+    /// and the hierarchy is refitted once
+    void setControlPoints(const QVector<unsigned> &indices,
+                          const QVector<QVector4D> &points);
+
+    /// Control point indices of a patch by global number
+    const unsigned *getPatchIndices(int patch) const {
+        const BezierPatch::Type type = _patches.patchType(patch);
+        return _patches.patchIndices(type, patch - _patches.firstPatch(type));
+    }
+
 protected:
 
     void addBezierTriangle(const BezierTriangle &patch);
 
-    void setIndexBuffer(const QVector<unsigned> &indices);
+    void addBezierQuad(const BezierQuad &patch);
+
+    void setIndexBuffer(BezierPatch::Type type, const QVector<unsigned> &indices);
+
+    /// Uploads the invariants, the power basis and the patch base attribute
+    void setPatchBuffers(const QVector<PatchInvariants> &invariants);
+
+    /// Uploads the edge table and the invariants of its edges
+    void setEdgeBuffers(const PatchEdgeTable &edgeTable,
+                        const QVector<EdgeInvariants> &invariants);
 
     void setModelMatrix(const QMatrix4x4 &modelMatrix);
 
     void setVertexBuffer(const QVector<QVector4D> &vertices);
 
+    /// Uploads the vertices and triangles of all proxies
+    void setLodBuffers();
 
 private:
 
     void createBuffers();
 
+    void createPersistentVertexBuffer(const QVector<QVector4D> &vertices);
+
+    void createAdjacency();
+
     void initialize();
 
+    /// Writes the edits to the next region and draws from it from now on
+    void uploadDirtyRanges();
+
+    /// Points the vertex attribute at the region that is drawn
+    void bindEditRegion();
+
+    /// Binds the drawn region as the control point storage buffer
+    void bindControlPoints();
+
+    void uploadDirtyInvariants();
+
+    /// Draw calls shared by render() and the cache capture
+    void drawPatches(BezierPatch::Type type);
+
+    void captureTessellation(BezierPatch::Type type);
+
+    /// Checks the triangles written by the last capture, without waiting
+    void readCacheQuery(BezierPatch::Type type);
+
+    void resizeCache(BezierPatch::Type type, GLuint numVertices);
+
+    /// Forgets the computed and captured tessellations after an edit, no
+    /// new capture starts while the patches keep moving
+    void invalidateCaches();
+
+    /// Reads the counters of a finished computeTessellation() and grows
+    /// the output buffers if they were too small
+    void readComputeCounters(BezierPatch::Type type);
+
+    void resizeComputeBuffers(BezierPatch::Type type, GLuint numVertices, GLuint numIndices);
+
+    /// Recomputes the edge invariants of the patches after an edit
+    void updateEdgeInvariants(const QVector<int> &patches);
+
+    /// Called after every draw that reads the control points
+    void fenceEditRegion();
+
+    void waitForFence(int region);
+
     // =========================================================================
     // -- Data members ---------------------------------------------------------
     // =========================================================================
@@ -75,20 +388,181 @@ private:
 
     // --- High level data store -----------------------------------------------
 
-    QVector<QSharedPointer<BezierPatch>> _patches;
+    PatchStore _patches;
 
     QMatrix4x4 _modelMatrix;
 
+    // --- Culling -------------------------------------------------------------
+
+    QVector<PatchBounds> _patchBounds;
+
+    PatchBVH _bvh;
+
+    PatchCuller _culler;
+
+    QVector<PatchCuller::Run> _visibleRuns;
+
+    /// Selects the resident pages of a paged scene instead
+    ScenePager _pager;
+
+    /// False if every patch should be drawn
+    bool _isCulled;
+
+    /// Indirect draws per patch type, one entry per visible run
+    QVector<DrawCommand> _drawCommands[BezierPatch::NUM_PATCH_TYPES];
+
+    /// The draw commands changed since their last upload
+    bool _drawCommandsChanged;
+
+    // --- Level of detail -----------------------------------------------------
+
+    PatchLOD _lod;
+
+    /// In pixels, 0 if the proxies are not used
+    float _lodTolerance;
+
+    int _viewportHeight;
+
+    QVector<int> _visibleProxies;
+
+    /// One indexed draw per visible proxy
+    QVector<DrawCommand> _lodDrawCommands;
+
+    bool _lodDrawCommandsChanged;
+
+    // --- Tessellation heuristics ---------------------------------------------
+
+    /// By global patch number
+    QVector<PatchInvariants> _patchInvariants;
+
+    /// Patches of which the invariants changed since their last upload
+    DirtyRangeTracker _dirtyInvariants;
+
+    PatchEdgeTable _edgeTable;
+
+    /// By unique edge
+    QVector<EdgeInvariants> _edgeInvariants;
+
+    DirtyRangeTracker _dirtyEdgeInvariants;
+
     // --- OpenGL members ------------------------------------------------------
 
     GLuint _sceneVAO;
 
     GLuint _sceneBO;
 
-    GLuint _patchIBO;
+    /// Index buffer per patch type
+    GLuint _patchIBO[BezierPatch::NUM_PATCH_TYPES];
+
+    /// Numbers 0, 1, 2, ... read per instance through the PATCH_BASE
+    /// attribute, so the base instance of a draw becomes its first patch
+    GLuint _patchBaseBO;
+
+    /// Shader storage buffer with the PatchInvariants per patch type
+    GLuint _invariantSSBO[BezierPatch::NUM_PATCH_TYPES];
+
+    /// Shader storage buffer with the PowerBasis coefficients per patch type,
+    /// read by the POWER_BASIS fragment shader
+    GLuint _powerBasisSSBO[BezierPatch::NUM_PATCH_TYPES];
+
+    /// Uploaded _drawCommands per patch type
+    GLuint _drawCommandBO[BezierPatch::NUM_PATCH_TYPES];
+
+    /// PatchLOD::Vertex attributes of the proxies
+    GLuint _lodVAO;
+
+    GLuint _lodBO;
+
+    GLuint _lodIBO;
+
+    /// Uploaded _lodDrawCommands
+    GLuint _lodDrawCommandBO;
+
+    /// Control point indices of the unique edges
+    GLuint _edgeSSBO;
+
+    GLuint _edgeInvariantSSBO;
+
+    /// Written by computeEdgeLevels, read by the control shaders
+    GLuint _edgeLevelSSBO;
+
+    /// Unique edge of every patch edge, per patch type
+    GLuint _patchEdgeSSBO[BezierPatch::NUM_PATCH_TYPES];
+
+    // --- Compute tessellation, per patch type --------------------------------
+
+    GLuint _computedPatchBO[BezierPatch::NUM_PATCH_TYPES];
+
+    GLuint _computedVertexBO[BezierPatch::NUM_PATCH_TYPES];
+
+    GLuint _computedIndexBO[BezierPatch::NUM_PATCH_TYPES];
+
+    /// ComputeCounters, also the GL_DRAW_INDIRECT_BUFFER of renderComputed
+    GLuint _computeCounterBO[BezierPatch::NUM_PATCH_TYPES];
+
+    GLuint _vertexCapacity[BezierPatch::NUM_PATCH_TYPES];
+    GLuint _indexCapacity[BezierPatch::NUM_PATCH_TYPES];
+
+    /// Signalled when the counters of the last tessellation can be read
+    GLsync _computeFence[BezierPatch::NUM_PATCH_TYPES];
+
+    /// Uniforms of the last tessellation
+    QByteArray _computeKey[BezierPatch::NUM_PATCH_TYPES];
+
+    bool _isComputed[BezierPatch::NUM_PATCH_TYPES];
+
+    // --- Tessellation cache, per patch type ----------------------------------
+
+    /// Attributes of the captured vertices
+    GLuint _cacheVAO[BezierPatch::NUM_PATCH_TYPES];
+
+    GLuint _cacheBO[BezierPatch::NUM_PATCH_TYPES];
+
+    /// Keeps the number of captured vertices for glDrawTransformFeedback
+    GLuint _cacheTFO[BezierPatch::NUM_PATCH_TYPES];
+
+    /// GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN of the last capture
+    GLuint _cacheQuery[BezierPatch::NUM_PATCH_TYPES];
+
+    /// In vertices
+    GLuint _cacheCapacity[BezierPatch::NUM_PATCH_TYPES];
+
+    QByteArray _cacheKey[BezierPatch::NUM_PATCH_TYPES];
+
+    CacheState _cacheState[BezierPatch::NUM_PATCH_TYPES];
 
     bool _isInit;
 
+    // --- Editable scenes -----------------------------------------------------
+
+    BufferMode _bufferMode;
+
+    /// Patches of which B111 was interpolated by the importer
+    QBitArray _interpolatedCenters;
+
+    /// Vertex to (patch * 16 + control point) lookup, compressed rows
+    QVector<int> _adjacencyOffsets;
+    QVector<int> _adjacency;
+
+    /// Per patch flags of setControlPoints(), zero between calls
+    QVector<quint8> _patchEdits;
+
+    /// Vertices edited since each region was last written
+    DirtyRangeTracker _dirtyVertices[NUM_EDIT_REGIONS];
+
+    /// Persistent mapping of all regions of _sceneBO
+    QVector4D *_mappedVertices;
+
+    /// Region that is drawn
+    int _editRegion;
+
+    /// Distance between the regions in vertices, aligned for the storage
+    /// buffer binding
+    int _editRegionStride;
+
+    /// Signalled when the GPU is done with the last draw from a region
+    GLsync _renderFence[NUM_EDIT_REGIONS];
+
 
 };
 
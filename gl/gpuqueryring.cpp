@@ -0,0 +1,138 @@
+#include <gl/gpuqueryring.h>
+
+FrameStats::FrameStats() :
+    frame(0)
+{
+    for (int pass = 0; pass < NUM_PASSES; ++pass) {
+        hasPass[pass] = false;
+        numPrimitives[pass] = 0;
+        gpuTime[pass] = 0.0;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// -- Constructors and destructor ----------------------------------------------
+// -----------------------------------------------------------------------------
+
+GpuQueryRing::GpuQueryRing(int numFrames) :
+    _slots(numFrames),
+    _current(-1),
+    _next(0),
+    _frame(0),
+    _isInit(false)
+{
+
+}
+
+// -----------------------------------------------------------------------------
+// -- Other Methods ------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+// --- Public ------------------------------------------------------------------
+
+void GpuQueryRing::initialize()
+{
+    if (_isInit) return;
+    initializeOpenGLFunctions();
+    for (Slot &slot : _slots) {
+        glGenQueries(FrameStats::NUM_PASSES, slot.primitiveQueries);
+        glGenQueries(FrameStats::NUM_PASSES, slot.timeQueries);
+        slot.isPending = false;
+    }
+    _isInit = true;
+}
+
+void GpuQueryRing::destroy()
+{
+    if (!_isInit) return;
+    for (Slot &slot : _slots) {
+        glDeleteQueries(FrameStats::NUM_PASSES, slot.primitiveQueries);
+        glDeleteQueries(FrameStats::NUM_PASSES, slot.timeQueries);
+        slot.isPending = false;
+    }
+    _isInit = false;
+}
+
+void GpuQueryRing::beginFrame(const QString &label)
+{
+    ++_frame;
+    _current = -1;
+    if (!_isInit || _slots[_next].isPending) {
+        // GPU is more than _slots.size() frames behind, skip this frame
+        return;
+    }
+    _current = _next;
+    _next = (_next + 1) % _slots.size();
+
+    Slot &slot = _slots[_current];
+    slot.stats = FrameStats();
+    slot.stats.frame = _frame;
+    slot.stats.label = label;
+}
+
+void GpuQueryRing::beginPass(FrameStats::Pass pass)
+{
+    if (_current < 0) return;
+    Slot &slot = _slots[_current];
+    slot.stats.hasPass[pass] = true;
+    glBeginQuery(GL_PRIMITIVES_GENERATED, slot.primitiveQueries[pass]);
+    glBeginQuery(GL_TIME_ELAPSED, slot.timeQueries[pass]);
+}
+
+void GpuQueryRing::endPass(FrameStats::Pass pass)
+{
+    if (_current < 0 || !_slots[_current].stats.hasPass[pass]) return;
+    glEndQuery(GL_TIME_ELAPSED);
+    glEndQuery(GL_PRIMITIVES_GENERATED);
+}
+
+void GpuQueryRing::endFrame()
+{
+    if (_current < 0) return;
+    _slots[_current].isPending = true;
+    _current = -1;
+}
+
+bool GpuQueryRing::hasPendingFrames() const
+{
+    for (const Slot &slot : _slots) {
+        if (slot.isPending) return true;
+    }
+    return false;
+}
+
+void GpuQueryRing::takeResults(QVector<FrameStats> &results)
+{
+    if (!_isInit) return;
+
+    // Slots finish in submission order, starting at the oldest one
+    for (int i = 0; i < _slots.size(); ++i) {
+        Slot &slot = _slots[(_next + i) % _slots.size()];
+        if (!slot.isPending) continue;
+
+        bool isAvailable = true;
+        for (int pass = 0; pass < FrameStats::NUM_PASSES && isAvailable; ++pass) {
+            if (!slot.stats.hasPass[pass]) continue;
+            GLuint timeAvailable = GL_FALSE;
+            GLuint primitivesAvailable = GL_FALSE;
+            glGetQueryObjectuiv(slot.timeQueries[pass], GL_QUERY_RESULT_AVAILABLE,
+                                &timeAvailable);
+            glGetQueryObjectuiv(slot.primitiveQueries[pass], GL_QUERY_RESULT_AVAILABLE,
+                                &primitivesAvailable);
+            isAvailable = timeAvailable == GL_TRUE && primitivesAvailable == GL_TRUE;
+        }
+        if (!isAvailable) break;
+
+        for (int pass = 0; pass < FrameStats::NUM_PASSES; ++pass) {
+            if (!slot.stats.hasPass[pass]) continue;
+            GLuint primitives = 0;
+            GLuint64 elapsed = 0;
+            glGetQueryObjectuiv(slot.primitiveQueries[pass], GL_QUERY_RESULT, &primitives);
+            glGetQueryObjectui64v(slot.timeQueries[pass], GL_QUERY_RESULT, &elapsed);
+            slot.stats.numPrimitives[pass] = static_cast<int>(primitives);
+            slot.stats.gpuTime[pass] = elapsed * 1e-6;
+        }
+        slot.isPending = false;
+        results.push_back(slot.stats);
+    }
+}
@@ -0,0 +1,114 @@
+#ifndef GPUQUERYRING_H
+#define GPUQUERYRING_H
+
+#include <QMetaType>
+#include <QOpenGLFunctions_4_5_Core>
+#include <QString>
+#include <QVector>
+
+/*!
+ * \brief The FrameStats struct
+ *
+ * GPU time and generated primitives of the render passes of one frame.
+ */
+struct FrameStats
+{
+    FrameStats();
+
+    enum Pass {
+        FacesPass = 0,
+        WireframePass,
+        /// Shared edge levels, compute tessellation and cache captures
+        ComputePass,
+        NUM_PASSES
+    };
+
+    /// Frame number, counted by GpuQueryRing::beginFrame
+    quint64 frame;
+
+    /// Set by the caller when the frame was started
+    QString label;
+
+    /// False if the pass was not rendered in this frame
+    bool hasPass[NUM_PASSES];
+
+    int numPrimitives[NUM_PASSES];
+
+    /// GPU time in milliseconds
+    double gpuTime[NUM_PASSES];
+};
+
+Q_DECLARE_METATYPE(FrameStats)
+
+/*!
+ * \brief The GpuQueryRing class
+ *
+ * Primitive and timer queries for a few frames in flight. Results are only
+ * read once GL_QUERY_RESULT_AVAILABLE is set, so measuring never waits for
+ * the GPU. If every slot is still in flight the frame is not measured.
+ *
+ * All methods require the context the ring was initialized with.
+ */
+class GpuQueryRing : protected QOpenGLFunctions_4_5_Core
+{
+
+    // =========================================================================
+    // -- Constructors and destructor ------------------------------------------
+    // =========================================================================
+
+public:
+
+    explicit GpuQueryRing(int numFrames = 4);
+
+    // =========================================================================
+    // -- Other methods --------------------------------------------------------
+    // =========================================================================
+
+public:
+
+    void initialize();
+
+    /// Deletes the query objects, call before the context is destroyed
+    void destroy();
+
+    void beginFrame(const QString &label = QString());
+
+    void beginPass(FrameStats::Pass pass);
+
+    void endPass(FrameStats::Pass pass);
+
+    void endFrame();
+
+    bool hasPendingFrames() const;
+
+    /// Appends the finished frames, oldest first, without blocking
+    void takeResults(QVector<FrameStats> &results);
+
+    // =========================================================================
+    // -- Data members ---------------------------------------------------------
+    // =========================================================================
+
+private:
+
+    struct Slot {
+        FrameStats stats;
+        GLuint primitiveQueries[FrameStats::NUM_PASSES];
+        GLuint timeQueries[FrameStats::NUM_PASSES];
+        bool isPending;
+    };
+
+    QVector<Slot> _slots;
+
+    /// Slot of the frame being recorded, -1 if this frame is skipped
+    int _current;
+
+    /// Next slot to use, slots are reused in order
+    int _next;
+
+    quint64 _frame;
+
+    bool _isInit;
+
+};
+
+#endif // GPUQUERYRING_H
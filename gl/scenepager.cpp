@@ -0,0 +1,440 @@
+#include <gl/scenepager.h>
+
+#include <geom/bezierquad.h>
+#include <geom/patchstore.h>
+#include <geom/powerbasis.h>
+#include <util/profiler.h>
+
+#include <QFile>
+#include <QPair>
+#include <QtConcurrent>
+#include <QtDebug>
+
+#include <algorithm>
+#include <numeric>
+
+namespace {
+
+/// Device memory of the slot pool, the number of slots follows from the
+/// largest page of the scene
+const quint64 POOL_BUDGET = quint64(512) << 20;
+
+/// Pages read by the thread pool at the same time
+const int MAX_PENDING_LOADS = 4;
+
+/// Pages uploaded per frame, bounds the stall of a frame
+const int MAX_UPLOADS_PER_FRAME = 2;
+
+// Shader storage bindings, same as BezierScene
+const GLuint INVARIANT_BINDING = 0;
+const GLuint POWER_BASIS_BINDING = 11;
+
+/// Distance from a point to a box, 0 inside
+float boxDistance(const QVector3D &point,
+                  const QVector3D &minValues,
+                  const QVector3D &maxValues) {
+    QVector3D delta;
+    for (int axis = 0; axis < 3; ++axis) {
+        delta[axis] = std::max(std::max(minValues[axis] - point[axis], 0.0f),
+                               point[axis] - maxValues[axis]);
+    }
+    return delta.length();
+}
+
+} // namespace
+
+// -----------------------------------------------------------------------------
+// -- Constructors and destructor ----------------------------------------------
+// -----------------------------------------------------------------------------
+
+ScenePager::ScenePager() :
+    _frame(0),
+    _numVisiblePages(0),
+    _slotVertices(0),
+    _drawCommandsChanged(false),
+    _isInit(false)
+{
+    for (int type = 0; type < BezierPatch::NUM_PATCH_TYPES; ++type) {
+        _slotIndices[type] = 0;
+        _slotPatches[type] = 0;
+    }
+}
+
+ScenePager::~ScenePager() {
+    // Loads only hold copies, but should not outlive the scene
+    for (PendingLoad &load : _pendingLoads) {
+        load.future.waitForFinished();
+    }
+    if (_isInit) {
+        deleteBuffers();
+    }
+}
+
+// -----------------------------------------------------------------------------
+// -- Other Methods ------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+// --- Public ------------------------------------------------------------------
+
+void ScenePager::setPageTable(const PagedSceneFormat::PageTable &table)
+{
+    for (PendingLoad &load : _pendingLoads) {
+        load.future.waitForFinished();
+    }
+    _pendingLoads.clear();
+    if (_isInit) {
+        deleteBuffers();
+        _isInit = false;
+    }
+    _table = table;
+    _pageBounds.clear();
+    _slotOfPage.clear();
+    _isFailed = QBitArray();
+    _slots.clear();
+    _numVisiblePages = 0;
+    for (int type = 0; type < BezierPatch::NUM_PATCH_TYPES; ++type) {
+        _drawCommands[type].clear();
+    }
+    if (_table.isEmpty()) {
+        return;
+    }
+
+    const int numPages = _table.pages.size();
+    _pageBounds.resize(numPages);
+    for (int page = 0; page < numPages; ++page) {
+        const PagedSceneFormat::Page &entry = _table.pages[page];
+        PatchBounds &bounds = _pageBounds[page];
+        bounds.minValues = QVector3D(entry.minValues[0], entry.minValues[1], entry.minValues[2]);
+        bounds.maxValues = QVector3D(entry.maxValues[0], entry.maxValues[1], entry.maxValues[2]);
+        // Pages have no normal cone, so they are never back facing
+        bounds.coneCutoff = 0.0f;
+        bounds.isBounded = true;
+    }
+    _slotOfPage.fill(-1, numPages);
+    _isFailed = QBitArray(numPages);
+
+    const PagedSceneFormat::Header &header = _table.header;
+    _slotVertices = header.maxPageVertices;
+    _slotIndices[BezierPatch::TriPatch] = header.maxPageIndices;
+    _slotIndices[BezierPatch::QuadPatch] = header.maxPageQuadIndices;
+    quint64 slotBytes = sizeof(QVector4D) * quint64(_slotVertices);
+    for (int type = 0; type < BezierPatch::NUM_PATCH_TYPES; ++type) {
+        const BezierPatch::Type patchType = static_cast<BezierPatch::Type>(type);
+        _slotPatches[type] = _slotIndices[type] / PatchStore::numControlPoints(patchType);
+        slotBytes += sizeof(unsigned) * quint64(_slotIndices[type]) +
+                (sizeof(PatchInvariants) + sizeof(QVector4D) * PowerBasis::numCoefficients(patchType)) *
+                quint64(_slotPatches[type]);
+    }
+    const int numSlots = static_cast<int>(std::min<quint64>(
+                numPages, std::max<quint64>(POOL_BUDGET / std::max<quint64>(slotBytes, 1), 1)));
+    _slots.fill({-1, 0}, numSlots);
+    qInfo() << "Page pool:" << numSlots << "of" << numPages << "pages,"
+            << (slotBytes * numSlots >> 20) << "MB";
+
+    initializeOpenGLFunctions();
+    createBuffers();
+    _isInit = true;
+}
+
+int ScenePager::getNumResidentPages() const
+{
+    return std::count_if(_slots.begin(), _slots.end(), [](const Slot &slot) {
+        return slot.page >= 0;
+    });
+}
+
+int ScenePager::update(const PatchCuller &culler, const QVector3D &eye)
+{
+    ScopedTimer timer("Page update");
+    if (!_isInit) {
+        return 0;
+    }
+    ++_frame;
+    QVector<int> visible;
+    for (int page = 0; page < _pageBounds.size(); ++page) {
+        if (culler.isVisible(_pageBounds[page])) {
+            visible.push_back(page);
+        }
+    }
+    _numVisiblePages = visible.size();
+    for (const int page : visible) {
+        if (_slotOfPage[page] >= 0) {
+            _slots[_slotOfPage[page]].lastUsed = _frame;
+        }
+    }
+
+    // Finished loads, only visible pages may evict a resident one
+    int numUploads = 0;
+    for (int i = 0; i < _pendingLoads.size() && numUploads < MAX_UPLOADS_PER_FRAME;) {
+        if (!_pendingLoads[i].future.isFinished()) {
+            ++i;
+            continue;
+        }
+        const int page = _pendingLoads[i].page;
+        const LoadedPage loaded = _pendingLoads[i].future.result();
+        _pendingLoads.remove(i);
+        if (!loaded.isValid) {
+            qWarning() << "Could not read page" << page << "of" << _table.fileName;
+            _isFailed.setBit(page);
+            continue;
+        }
+        const bool isVisible = std::binary_search(visible.begin(), visible.end(), page);
+        const int slot = findSlot(isVisible);
+        if (slot < 0) {
+            // Loaded again once it is needed
+            continue;
+        }
+        if (_slots[slot].page >= 0) {
+            _slotOfPage[_slots[slot].page] = -1;
+        }
+        upload(slot, loaded);
+        _slots[slot].page = page;
+        _slots[slot].lastUsed = isVisible ? _frame : 0;
+        _slotOfPage[page] = slot;
+        ++numUploads;
+    }
+
+    int numPatches = 0;
+    for (int type = 0; type < BezierPatch::NUM_PATCH_TYPES; ++type) {
+        _drawCommands[type].clear();
+    }
+    for (const int page : visible) {
+        const int slot = _slotOfPage[page];
+        if (slot < 0) continue;
+
+        const PagedSceneFormat::Page &entry = _table.pages[page];
+        const GLuint counts[BezierPatch::NUM_PATCH_TYPES] = {entry.numIndices, entry.numQuadIndices};
+        for (int type = 0; type < BezierPatch::NUM_PATCH_TYPES; ++type) {
+            if (counts[type] == 0) continue;
+            const DrawCommand command = {
+                counts[type], 1, slot * _slotIndices[type],
+                GLint(slot * _slotVertices), slot * _slotPatches[type]
+            };
+            _drawCommands[type].push_back(command);
+            numPatches += counts[type] / PatchStore::numControlPoints(
+                        static_cast<BezierPatch::Type>(type));
+        }
+    }
+    _drawCommandsChanged = true;
+
+    // Missing visible pages, as long as a slot not drawn this frame is left
+    // for each of them
+    int numAvailable = std::count_if(_slots.begin(), _slots.end(), [this](const Slot &slot) {
+        return slot.lastUsed < _frame;
+    }) - _pendingLoads.size();
+    for (const int page : loadOrder(visible, eye)) {
+        if (numAvailable <= 0 || _pendingLoads.size() >= MAX_PENDING_LOADS) break;
+        startLoad(page);
+        --numAvailable;
+    }
+
+    // Prefetch the nearest other pages into free slots once nothing visible
+    // is missing
+    const int numFree = _slots.size() - getNumResidentPages();
+    if (_pendingLoads.isEmpty() && numFree > 0) {
+        QVector<int> pages(_pageBounds.size());
+        std::iota(pages.begin(), pages.end(), 0);
+        for (const int page : loadOrder(pages, eye)) {
+            if (_pendingLoads.size() >= std::min(numFree, MAX_PENDING_LOADS)) break;
+            startLoad(page);
+        }
+    }
+    return numPatches;
+}
+
+void ScenePager::render(BezierPatch::Type type)
+{
+    if (!_isInit || _drawCommands[type].isEmpty()) {
+        return;
+    }
+    if (_drawCommandsChanged) {
+        for (int t = 0; t < BezierPatch::NUM_PATCH_TYPES; ++t) {
+            glNamedBufferData(_drawCommandBO[t],
+                              sizeof(DrawCommand) * _drawCommands[t].size(),
+                              _drawCommands[t].constData(),
+                              GL_STREAM_DRAW);
+        }
+        _drawCommandsChanged = false;
+    }
+
+    // The base vertex selects the slot, the base instance its first patch
+    glPatchParameteri(GL_PATCH_VERTICES, PatchStore::numControlPoints(type));
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INVARIANT_BINDING, _invariantSSBO[type]);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, POWER_BASIS_BINDING, _powerBasisSSBO[type]);
+    glBindVertexArray(_poolVAO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _indexBO[type]);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _drawCommandBO[type]);
+    glMultiDrawElementsIndirect(GL_PATCHES, GL_UNSIGNED_INT, 0,
+                                _drawCommands[type].size(), 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+// --- Private -----------------------------------------------------------------
+
+void ScenePager::createBuffers()
+{
+    const int numSlots = _slots.size();
+    glGenVertexArrays(1, &_poolVAO);
+    glGenBuffers(1, &_vertexBO);
+    glGenBuffers(BezierPatch::NUM_PATCH_TYPES, _indexBO);
+    glGenBuffers(1, &_patchBaseBO);
+    glGenBuffers(BezierPatch::NUM_PATCH_TYPES, _invariantSSBO);
+    glGenBuffers(BezierPatch::NUM_PATCH_TYPES, _powerBasisSSBO);
+    glGenBuffers(BezierPatch::NUM_PATCH_TYPES, _drawCommandBO);
+
+    // Slots are overwritten while streaming, never read back
+    glNamedBufferData(_vertexBO, sizeof(QVector4D) * GLsizeiptr(numSlots) * _slotVertices,
+                      nullptr, GL_DYNAMIC_DRAW);
+    GLuint maxPatches = 0;
+    for (int type = 0; type < BezierPatch::NUM_PATCH_TYPES; ++type) {
+        const BezierPatch::Type patchType = static_cast<BezierPatch::Type>(type);
+        const GLsizeiptr numPatches = GLsizeiptr(numSlots) * _slotPatches[type];
+        glNamedBufferData(_indexBO[type], sizeof(unsigned) * GLsizeiptr(numSlots) * _slotIndices[type],
+                          nullptr, GL_DYNAMIC_DRAW);
+        glNamedBufferData(_invariantSSBO[type], sizeof(PatchInvariants) * numPatches,
+                          nullptr, GL_DYNAMIC_DRAW);
+        glNamedBufferData(_powerBasisSSBO[type],
+                          sizeof(QVector4D) * PowerBasis::numCoefficients(patchType) * numPatches,
+                          nullptr, GL_DYNAMIC_DRAW);
+        maxPatches = std::max(maxPatches, GLuint(numPatches));
+    }
+    QVector<GLuint> patchBase(maxPatches);
+    std::iota(patchBase.begin(), patchBase.end(), 0u);
+    glNamedBufferData(_patchBaseBO, sizeof(GLuint) * patchBase.size(),
+                      patchBase.constData(), GL_STATIC_DRAW);
+
+    // Same attributes as the scene VAO of BezierScene
+    glBindVertexArray(_poolVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, _vertexBO);
+    glEnableVertexAttribArray(LOCATION);
+    glVertexAttribPointer(LOCATION, 4, GL_FLOAT, GL_FALSE, 0, 0);
+    glBindBuffer(GL_ARRAY_BUFFER, _patchBaseBO);
+    glEnableVertexAttribArray(PATCH_BASE);
+    glVertexAttribIPointer(PATCH_BASE, 1, GL_UNSIGNED_INT, 0, 0);
+    glVertexAttribDivisor(PATCH_BASE, 1);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+void ScenePager::deleteBuffers()
+{
+    glDeleteVertexArrays(1, &_poolVAO);
+    glDeleteBuffers(1, &_vertexBO);
+    glDeleteBuffers(BezierPatch::NUM_PATCH_TYPES, _indexBO);
+    glDeleteBuffers(1, &_patchBaseBO);
+    glDeleteBuffers(BezierPatch::NUM_PATCH_TYPES, _invariantSSBO);
+    glDeleteBuffers(BezierPatch::NUM_PATCH_TYPES, _powerBasisSSBO);
+    glDeleteBuffers(BezierPatch::NUM_PATCH_TYPES, _drawCommandBO);
+}
+
+void ScenePager::startLoad(int page)
+{
+    const QString fileName = _table.fileName;
+    const PagedSceneFormat::Page entry = _table.pages[page];
+    _pendingLoads.push_back({page, QtConcurrent::run([fileName, entry]() {
+        return loadPage(fileName, entry);
+    })});
+}
+
+QVector<int> ScenePager::loadOrder(const QVector<int> &pages, const QVector3D &eye) const
+{
+    QVector<QPair<float, int>> candidates;
+    for (const int page : pages) {
+        if (_slotOfPage[page] >= 0 || _isFailed.testBit(page)) continue;
+        const bool isPending = std::any_of(
+                    _pendingLoads.begin(), _pendingLoads.end(),
+                    [page](const PendingLoad &load) { return load.page == page; });
+        if (isPending) continue;
+        candidates.push_back(qMakePair(boxDistance(eye, _pageBounds[page].minValues,
+                                                   _pageBounds[page].maxValues), page));
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    QVector<int> order;
+    order.reserve(candidates.size());
+    for (const QPair<float, int> &candidate : candidates) {
+        order.push_back(candidate.second);
+    }
+    return order;
+}
+
+int ScenePager::findSlot(bool mayEvict) const
+{
+    int leastRecent = -1;
+    for (int slot = 0; slot < _slots.size(); ++slot) {
+        if (_slots[slot].page < 0) {
+            return slot;
+        }
+        if (mayEvict && _slots[slot].lastUsed < _frame &&
+                (leastRecent < 0 || _slots[slot].lastUsed < _slots[leastRecent].lastUsed)) {
+            leastRecent = slot;
+        }
+    }
+    return leastRecent;
+}
+
+void ScenePager::upload(int slot, const LoadedPage &page)
+{
+    const PagedSceneFormat::PageData &data = page.data;
+    glNamedBufferSubData(_vertexBO,
+                         sizeof(QVector4D) * GLintptr(slot) * _slotVertices,
+                         sizeof(QVector4D) * data.vertices.size(),
+                         data.vertices.constData());
+    const QVector<unsigned> *indices[BezierPatch::NUM_PATCH_TYPES] = {
+        &data.indices, &data.quadIndices
+    };
+    for (int type = 0; type < BezierPatch::NUM_PATCH_TYPES; ++type) {
+        const BezierPatch::Type patchType = static_cast<BezierPatch::Type>(type);
+        const GLintptr firstPatch = GLintptr(slot) * _slotPatches[type];
+        glNamedBufferSubData(_indexBO[type],
+                             sizeof(unsigned) * GLintptr(slot) * _slotIndices[type],
+                             sizeof(unsigned) * indices[type]->size(),
+                             indices[type]->constData());
+        glNamedBufferSubData(_invariantSSBO[type],
+                             sizeof(PatchInvariants) * firstPatch,
+                             sizeof(PatchInvariants) * page.invariants[type].size(),
+                             page.invariants[type].constData());
+        glNamedBufferSubData(_powerBasisSSBO[type],
+                             sizeof(QVector4D) * PowerBasis::numCoefficients(patchType) * firstPatch,
+                             sizeof(QVector4D) * page.powerBasis[type].size(),
+                             page.powerBasis[type].constData());
+    }
+}
+
+ScenePager::LoadedPage ScenePager::loadPage(const QString &fileName,
+                                            const PagedSceneFormat::Page &page)
+{
+    LoadedPage loaded;
+    QFile fin(fileName);
+    loaded.isValid = fin.open(QIODevice::ReadOnly) &&
+            PagedSceneFormat::readPage(fin, page, loaded.data);
+    if (!loaded.isValid) {
+        return loaded;
+    }
+
+    // Same per patch inputs as BezierScene::setPatchBuffers
+    const QVector<QVector4D> &vertices = loaded.data.vertices;
+    const QVector<unsigned> *indices[BezierPatch::NUM_PATCH_TYPES] = {
+        &loaded.data.indices, &loaded.data.quadIndices
+    };
+    QVector4D controlPoints[BezierQuad::NUM_CONTROL_POINTS];
+    for (int type = 0; type < BezierPatch::NUM_PATCH_TYPES; ++type) {
+        const BezierPatch::Type patchType = static_cast<BezierPatch::Type>(type);
+        const int numControlPoints = PatchStore::numControlPoints(patchType);
+        const int numCoefficients = PowerBasis::numCoefficients(patchType);
+        const int numPatches = indices[type]->size() / numControlPoints;
+        loaded.invariants[type].resize(numPatches);
+        loaded.powerBasis[type].resize(numPatches * numCoefficients);
+        for (int patch = 0; patch < numPatches; ++patch) {
+            for (int point = 0; point < numControlPoints; ++point) {
+                controlPoints[point] = vertices[(*indices[type])[patch * numControlPoints + point]];
+            }
+            loaded.invariants[type][patch] = PatchInvariants::fromPatch(patchType, controlPoints);
+            PowerBasis::fromPatch(patchType, controlPoints,
+                                  loaded.powerBasis[type].data() + patch * numCoefficients);
+        }
+    }
+    return loaded;
+}
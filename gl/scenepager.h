@@ -0,0 +1,205 @@
+#ifndef SCENEPAGER_H
+#define SCENEPAGER_H
+
+#include <geom/bezierpatch.h>
+#include <geom/patchbounds.h>
+#include <geom/patchculler.h>
+#include <geom/patchinvariants.h>
+#include <util/pagedsceneformat.h>
+
+#include <QBitArray>
+#include <QFuture>
+#include <QOpenGLFunctions_4_5_Core>
+#include <QVector>
+#include <QVector3D>
+#include <QVector4D>
+
+/*!
+ * \brief The ScenePager class
+ *
+ * Streams the pages of a PagedSceneFormat file through a fixed pool of GPU
+ * slots, so the scene never has to fit in host or device memory. Every slot
+ * holds one page: its vertices, index arrays, patch invariants and power
+ * basis coefficients, at a fixed offset in shared buffers.
+ *
+ * Pages are read and prepared on the global thread pool. Visible pages are
+ * loaded nearest first, then the nearest other pages are prefetched into
+ * free slots. A slot is reused for the page least recently drawn. A visible
+ * page is drawn as soon as it is resident, until then it is missing. If
+ * more pages are visible than there are slots, the furthest are missing.
+ *
+ * All methods except the constructor require the context of the scene.
+ */
+class ScenePager : protected QOpenGLFunctions_4_5_Core
+{
+
+    // =========================================================================
+    // -- Enums and types ------------------------------------------------------
+    // =========================================================================
+
+private:
+
+    /// Same as BezierScene::AttribArray
+    enum AttribArray {
+        LOCATION = 0,
+        PATCH_BASE = 3
+    };
+
+    /// Same as BezierScene::DrawCommand
+    struct DrawCommand {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance;
+    };
+
+    /// A page read and prepared by a worker thread
+    struct LoadedPage {
+        bool isValid;
+        PagedSceneFormat::PageData data;
+        QVector<PatchInvariants> invariants[BezierPatch::NUM_PATCH_TYPES];
+        QVector<QVector4D> powerBasis[BezierPatch::NUM_PATCH_TYPES];
+    };
+
+    struct PendingLoad {
+        int page;
+        QFuture<LoadedPage> future;
+    };
+
+    struct Slot {
+        /// Resident page, or -1
+        int page;
+        /// Frame in which the page was last drawn
+        quint64 lastUsed;
+    };
+
+    // =========================================================================
+    // -- Constructors and destructor ------------------------------------------
+    // =========================================================================
+
+public:
+
+    ScenePager();
+
+    ~ScenePager();
+
+    // =========================================================================
+    // -- Other methods --------------------------------------------------------
+    // =========================================================================
+
+public:
+
+    /// Sizes the pool for the largest page of the table, an empty table
+    /// releases it
+    void setPageTable(const PagedSceneFormat::PageTable &table);
+
+    bool isEmpty() const {
+        return _table.isEmpty();
+    }
+
+    int getNumPatches(BezierPatch::Type type) const {
+        return static_cast<int>(_table.header.numPatches[type]);
+    }
+
+    int getNumSlots() const {
+        return _slots.size();
+    }
+
+    /// Pages that passed the culler in the last update()
+    int getNumVisiblePages() const {
+        return _numVisiblePages;
+    }
+
+    int getNumResidentPages() const;
+
+    /*!
+     * \brief update selects the pages drawn this frame.
+     *
+     * Uploads the pages that finished loading, then starts the loads of
+     * visible pages that are not resident, nearest to the eye (in model
+     * coordinates) first. Returns the number of patches drawn.
+     */
+    int update(const PatchCuller &culler, const QVector3D &eye);
+
+    /// Draws the resident visible pages, like BezierScene::render()
+    void render(BezierPatch::Type type);
+
+private:
+
+    void createBuffers();
+
+    void deleteBuffers();
+
+    void startLoad(int page);
+
+    /// Nearest pages first, ignores pages that are resident or loading
+    QVector<int> loadOrder(const QVector<int> &pages, const QVector3D &eye) const;
+
+    /// Slot for a page, preferring free slots over the least recently used
+    /// one. Slots used in this frame are never evicted. Returns -1 if there
+    /// is none.
+    int findSlot(bool mayEvict) const;
+
+    void upload(int slot, const LoadedPage &page);
+
+    static LoadedPage loadPage(const QString &fileName,
+                               const PagedSceneFormat::Page &page);
+
+    // =========================================================================
+    // -- Data members ---------------------------------------------------------
+    // =========================================================================
+
+private:
+
+    PagedSceneFormat::PageTable _table;
+
+    /// Page table entries as culler input
+    QVector<PatchBounds> _pageBounds;
+
+    /// Slot of every page, or -1
+    QVector<int> _slotOfPage;
+
+    /// Pages that could not be read, they are not tried again
+    QBitArray _isFailed;
+
+    QVector<Slot> _slots;
+
+    QVector<PendingLoad> _pendingLoads;
+
+    quint64 _frame;
+
+    int _numVisiblePages;
+
+    /// Per slot, in vertices, indices and patches per type
+    GLuint _slotVertices;
+    GLuint _slotIndices[BezierPatch::NUM_PATCH_TYPES];
+    GLuint _slotPatches[BezierPatch::NUM_PATCH_TYPES];
+
+    /// One draw per resident visible page, per patch type
+    QVector<DrawCommand> _drawCommands[BezierPatch::NUM_PATCH_TYPES];
+
+    bool _drawCommandsChanged;
+
+    // --- OpenGL members ------------------------------------------------------
+
+    bool _isInit;
+
+    GLuint _poolVAO;
+
+    GLuint _vertexBO;
+
+    GLuint _indexBO[BezierPatch::NUM_PATCH_TYPES];
+
+    /// Same as BezierScene::_patchBaseBO
+    GLuint _patchBaseBO;
+
+    GLuint _invariantSSBO[BezierPatch::NUM_PATCH_TYPES];
+
+    GLuint _powerBasisSSBO[BezierPatch::NUM_PATCH_TYPES];
+
+    GLuint _drawCommandBO[BezierPatch::NUM_PATCH_TYPES];
+
+};
+
+#endif // SCENEPAGER_H
@@ -0,0 +1,48 @@
+#include <gl/shadersource.h>
+
+#include <QFile>
+#include <QtDebug>
+
+// -----------------------------------------------------------------------------
+// -- Other methods ------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+QByteArray ShaderSource::read(const QString &fileName, const QByteArray &defines) {
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Could not open shader:" << fileName;
+        return QByteArray();
+    }
+    QByteArray source = file.readAll();
+
+    const QByteArray directive("#include \"");
+    const QString directory = fileName.left(fileName.lastIndexOf('/') + 1);
+    int include = source.indexOf(directive);
+    while (include >= 0) {
+        const int nameBegin = include + directive.size();
+        const int nameEnd = source.indexOf('"', nameBegin);
+        int lineEnd = source.indexOf('\n', nameBegin);
+        if (lineEnd < 0) {
+            lineEnd = source.size();
+        }
+        if (nameEnd < 0 || nameEnd > lineEnd) {
+            qWarning() << "Malformed include in shader:" << fileName;
+            return QByteArray();
+        }
+
+        const QString includeName =
+                directory + QString::fromLatin1(source.mid(nameBegin, nameEnd - nameBegin));
+        QFile includeFile(includeName);
+        if (!includeFile.open(QIODevice::ReadOnly)) {
+            qWarning() << "Could not open shader include:" << includeName;
+            return QByteArray();
+        }
+        const QByteArray snippet = includeFile.readAll();
+        source.replace(include, lineEnd - include, snippet);
+        include = source.indexOf(directive, include + snippet.size());
+    }
+
+    const int versionEnd = source.indexOf('\n') + 1;
+    source.insert(versionEnd, defines);
+    return source;
+}
@@ -0,0 +1,30 @@
+#ifndef SHADERSOURCE_H
+#define SHADERSOURCE_H
+
+#include <QByteArray>
+#include <QString>
+
+/*!
+ * \brief The ShaderSource class
+ *
+ * Reads the GLSL sources of the shader programs. Defines are inserted after
+ * the #version line, every `#include "file"` line is replaced by that file
+ * from the directory of the shader (not recursively), since GLSL has no
+ * includes of its own.
+ */
+class ShaderSource
+{
+
+    // =========================================================================
+    // -- Other methods --------------------------------------------------------
+    // =========================================================================
+
+public:
+
+    /// Returns an empty source if the shader or an include can not be read
+    static QByteArray read(const QString &fileName,
+                           const QByteArray &defines = QByteArray());
+
+};
+
+#endif // SHADERSOURCE_H
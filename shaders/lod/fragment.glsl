@@ -0,0 +1,106 @@
+#version 430 core
+
+// =============================================================================
+// -- Defines ------------------------------------------------------------------
+// =============================================================================
+
+/// Same as the drawing modes in the tessellation fragment.glsl, the modes
+/// that need patch data fall back to SmoothShaded
+#define SmoothShaded 0
+#define Normal 2
+#define PatchesShaded 3
+
+// =============================================================================
+// -- In and outputs -----------------------------------------------------------
+// =============================================================================
+
+// --- Inputs ------------------------------------------------------------------
+
+in vec4 vert_coord_FS_in;
+in vec3 vert_normal_FS_in;
+
+// --- Outputs -----------------------------------------------------------------
+
+layout(location = 0) out vec4 fColor;
+
+// =============================================================================
+// -- Uniforms -----------------------------------------------------------------
+// =============================================================================
+
+/// Material properties
+/// ambient, diffuse, specular, specular power
+uniform vec4 MaterialProps;
+
+/// Front color
+uniform vec3 ColorFront;
+
+/// Back color
+uniform vec3 ColorBack;
+
+/// Drawing Mode
+uniform int DrawingMode;
+
+// =============================================================================
+// -- Functions ----------------------------------------------------------------
+// =============================================================================
+
+/// Same as the tessellation fragment.glsl
+vec4 smoothShaded(in vec3 Front, in vec3 Back, vec3 n) {
+  vec3 LightPosition = vec3(100.0, 250.0, 1000.0);
+  vec3 LightColor = vec3(1.0, 1.0, 1.0);
+
+  vec3 MaterialColor = Front;
+
+  // Retrieve the right normal
+  vec3 N = normalize(n);
+  if (!gl_FrontFacing) {
+    N = -N; // Flip normals on backface
+    MaterialColor = Back;
+  }
+
+  // Determine lighting vectors
+  vec3 L = normalize(LightPosition - vert_coord_FS_in.xyz);
+  vec3 E = normalize(-vert_coord_FS_in.xyz);
+  vec3 H = normalize(L + E);
+
+  // Calculate Ambient, Diffuse and Specular terms
+  vec3 ambient = MaterialColor * MaterialProps.x;
+  vec3 diffuse = MaterialColor * MaterialProps.y * clamp(dot(N, L), 0.0, 1.0);
+  vec3 specular = LightColor * MaterialProps.z * pow(max(dot(N, H), 0.0), MaterialProps.w);
+  return vec4(ambient + diffuse + specular, 1.0);
+}
+
+/// Same as the tessellation fragment.glsl
+vec4 normalColorMap(vec3 N) {
+  if (!gl_FrontFacing) {
+    N = -N; // Flip normals on backface
+  }
+  return vec4((N + 1.0) / 2.0, 1.0);
+}
+
+// =============================================================================
+// -- Main ---------------------------------------------------------------------
+// =============================================================================
+
+void main() {
+  // Clustering can merge opposite sides into a vertex without a normal
+  vec3 N = vert_normal_FS_in;
+  if (dot(N, N) < 1e-12) {
+    N = cross(dFdx(vert_coord_FS_in.xyz), dFdy(vert_coord_FS_in.xyz));
+  }
+
+  switch (DrawingMode) {
+    case Normal:
+      fColor = normalColorMap(normalize(N));
+      break;
+
+    case PatchesShaded:
+      // Proxies have no patches, they stand out in the back color
+      fColor = smoothShaded(ColorBack, ColorBack, N);
+      break;
+
+    default:
+      fColor = smoothShaded(ColorFront, ColorBack, N);
+      break;
+  }
+}
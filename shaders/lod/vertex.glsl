@@ -0,0 +1,35 @@
+#version 430 core
+
+// =============================================================================
+// -- In and outputs -----------------------------------------------------------
+// =============================================================================
+
+// --- Inputs ------------------------------------------------------------------
+
+/// Should be the same as PatchLOD::Vertex!
+layout(location = 0) in vec3 vert_coord_VS_in;
+layout(location = 1) in vec3 vert_normal_VS_in;
+
+// --- Outputs -----------------------------------------------------------------
+
+out vec4 vert_coord_FS_in;
+out vec3 vert_normal_FS_in;
+
+// =============================================================================
+// -- Uniforms -----------------------------------------------------------------
+// =============================================================================
+
+uniform mat4 ModelViewMatrix;
+uniform mat4 ProjectionMatrix;
+
+// =============================================================================
+// -- main ---------------------------------------------------------------------
+// =============================================================================
+
+void main() {
+  vert_coord_FS_in = ModelViewMatrix * vec4(vert_coord_VS_in, 1.0);
+  // The model view matrix only rotates and scales uniformly. Normals are
+  // normalized per fragment, some proxy vertices have none.
+  vert_normal_FS_in = mat3(ModelViewMatrix) * vert_normal_VS_in;
+  gl_Position = ProjectionMatrix * vert_coord_FS_in;
+}
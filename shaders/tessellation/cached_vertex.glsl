@@ -0,0 +1,158 @@
+#version 430 core
+
+// =============================================================================
+// -- Defines ------------------------------------------------------------------
+// =============================================================================
+
+// QUAD_PATCH is defined when the shader is used for bicubic quads
+#ifdef QUAD_PATCH
+#define NUM_CONTROL_POINTS 16
+#define B00 0
+#define B30 3
+#define B03 12
+#define B33 15
+#else
+#define NUM_CONTROL_POINTS 10
+#define UV003 0
+#define UV300 3
+#define UV030 6
+#endif
+
+// =============================================================================
+// -- In and outputs -----------------------------------------------------------
+// =============================================================================
+
+// --- Inputs ------------------------------------------------------------------
+
+// Tessellation evaluation outputs captured with transform feedback, should be
+// the same as BezierScene::CachedVertex!
+layout(location = 0) in vec4 vert_coord;
+layout(location = 1) in vec3 vert_normal;
+layout(location = 2) in vec3 barycenter;
+layout(location = 3) in vec2 tess_levels;
+layout(location = 4) in uint patch_number;
+
+// --- Outputs -----------------------------------------------------------------
+
+// Same as the outputs of the tessellation evaluation shaders
+
+out vec3 barycenter_GS_in;
+out vec4 vert_coord_GS_in;
+out vec3 vert_normal_GS_in;
+
+// --- Flat outputs ------------------------------------------------------------
+
+out vec3 patch_color_GS_in;
+out ControlCoords {
+  vec4 control_coord_GS_in[NUM_CONTROL_POINTS];
+};
+out float patch_curvature_GS_in;
+out float inner_tess_level_GS_in;
+out float outer_tess_level_GS_in;
+out vec3 patch_normal_GS_in;
+flat out uint patch_number_GS_in;
+
+// =============================================================================
+// -- Buffers ------------------------------------------------------------------
+// =============================================================================
+
+/// Should be the same as geom/patchinvariants.h!
+struct PatchInvariants {
+  vec4 edgeCurvature;
+  vec4 edgeDeviation;
+  float curvature;
+  float padding[3];
+};
+
+layout(std430, binding = 0) readonly buffer PatchInvariantBuffer {
+  PatchInvariants invariants[];
+};
+
+/// The vertex buffer of the scene
+layout(std430, binding = 5) readonly buffer ControlPointBuffer {
+  vec4 controlPoints[];
+};
+
+/// The index buffer of the patch type
+layout(std430, binding = 7) readonly buffer PatchIndexBuffer {
+  uint patchIndices[];
+};
+
+// =============================================================================
+// -- Uniforms -----------------------------------------------------------------
+// =============================================================================
+
+uniform mat4 ModelViewMatrix;
+uniform mat4 ProjectionMatrix;
+
+/// Maps the captured view coordinates to the current model view matrix, only
+/// differs from the identity for the slightly scaled wireframe pass
+uniform mat4 ReplayMatrix;
+
+// =============================================================================
+// -- Functions ----------------------------------------------------------------
+// =============================================================================
+
+vec3 projectTo3D(in vec4 v0) {
+  return v0.xyz / v0.w;
+}
+
+/// Same as vertex.glsl
+vec4 toViewSpace(in vec4 point) {
+  vec4 transformed = ModelViewMatrix * vec4(projectTo3D(point), 1.0);
+  return vec4(transformed.xyz / transformed.w * point.w, point.w);
+}
+
+/// Generates a random number from a vec2
+float rand(in vec2 co) {
+  return fract(sin(dot(co.xy, vec2(12.9898, 78.233))) * 43758.5453);
+}
+
+/// Same as randomColor in the control shaders
+vec3 randomColor(in uint patchNumber) {
+  float id = float(patchNumber);
+  vec3 c = vec3(0);
+  c.r = rand(vec2(id, id + 1));
+  c.g = rand(vec2(id + 2, id + 3));
+  c.b = rand(vec2(id + 4, id + 5));
+  return c;
+}
+
+// =============================================================================
+// -- main ---------------------------------------------------------------------
+// =============================================================================
+
+void main() {
+  // The control points are too large to capture, they are read again
+  for (int i = 0; i < NUM_CONTROL_POINTS; ++i) {
+    control_coord_GS_in[i] = toViewSpace(
+          controlPoints[patchIndices[NUM_CONTROL_POINTS * patch_number + i]]);
+  }
+
+  patch_color_GS_in = randomColor(patch_number);
+  patch_number_GS_in = patch_number;
+  float curvature = invariants[patch_number].curvature;
+  patch_curvature_GS_in = pow(clamp((1 - curvature), 0.0, 1.0), 1.0 / 3.0);
+
+  inner_tess_level_GS_in = tess_levels.x;
+  outer_tess_level_GS_in = tess_levels.y;
+  barycenter_GS_in = barycenter;
+
+#ifdef QUAD_PATCH
+  vec3 v00 = projectTo3D(control_coord_GS_in[B00]);
+  vec3 v30 = projectTo3D(control_coord_GS_in[B30]);
+  vec3 v03 = projectTo3D(control_coord_GS_in[B03]);
+  vec3 v33 = projectTo3D(control_coord_GS_in[B33]);
+  patch_normal_GS_in = normalize(cross(v33 - v00, v03 - v30));
+#else
+  vec3 origin = projectTo3D(control_coord_GS_in[UV003]);
+  vec3 tangent = normalize(projectTo3D(control_coord_GS_in[UV030]) - origin);
+  vec3 bitangent = normalize(projectTo3D(control_coord_GS_in[UV300]) - origin);
+  patch_normal_GS_in = normalize(cross(bitangent, tangent));
+#endif
+
+  vert_coord_GS_in = ReplayMatrix * vert_coord;
+  vert_coord_GS_in /= vert_coord_GS_in.w;
+  vert_normal_GS_in = normalize(mat3(ReplayMatrix) * vert_normal);
+  gl_Position = ProjectionMatrix * vert_coord_GS_in;
+}
@@ -0,0 +1,394 @@
+#version 430 core
+
+// =============================================================================
+// -- Defines ------------------------------------------------------------------
+// =============================================================================
+
+// QUAD_PATCH is defined when the shader is used for bicubic quads
+#ifdef QUAD_PATCH
+#define NUM_CONTROL_POINTS 16
+#else
+#define NUM_CONTROL_POINTS 10
+#endif
+
+/// Defines for vertex coord array offsets
+#define UV003 0
+#define UV102 1
+#define UV201 2
+#define UV300 3
+#define UV210 4
+#define UV120 5
+#define UV030 6
+#define UV021 7
+#define UV012 8
+#define UV111 9
+
+// Defines for offsets in outerLevels
+#define U0 0
+#define V0 1
+#define W0 2
+#define U1 2
+#define V1 3
+
+#define GROUP_SIZE 64
+
+// One work group per patch, the invocations share its vertices and indices
+// Should be the same as COMPUTE_GROUP_SIZE in gl/bezierscene.cpp!
+layout(local_size_x = GROUP_SIZE) in;
+
+// =============================================================================
+// -- Buffers ------------------------------------------------------------------
+// =============================================================================
+
+/// Should be the same as BezierScene::ComputedPatch!
+struct ComputedPatch {
+  vec4 outerLevels;
+  uint firstVertex;
+  uint firstIndex;
+  uint gridLevel;
+  float innerLevel;
+};
+
+/// Should be the same as BezierScene::ComputeCounters!
+struct ComputeCounters {
+  uint count;
+  uint instanceCount;
+  uint firstIndex;
+  int baseVertex;
+  uint baseInstance;
+  uint requestedIndices;
+  uint requestedVertices;
+  uint padding;
+};
+
+/// Should be the same as BezierScene::ComputedVertex!
+struct ComputedVertex {
+  vec4 position;
+  vec4 normal;
+  vec2 parameter;
+  uint patchNumber;
+  uint padding;
+};
+
+/// The vertex buffer of the scene
+layout(std430, binding = 5) readonly buffer ControlPointBuffer {
+  vec4 controlPoints[];
+};
+
+layout(std430, binding = 6) writeonly buffer ComputedVertexBuffer {
+  ComputedVertex computedVertices[];
+};
+
+/// The index buffer of the patch type
+layout(std430, binding = 7) readonly buffer PatchIndexBuffer {
+  uint patchIndices[];
+};
+
+layout(std430, binding = 8) readonly buffer ComputedPatchBuffer {
+  ComputedPatch computedPatches[];
+};
+
+layout(std430, binding = 9) buffer ComputeCounterBuffer {
+  ComputeCounters counters;
+};
+
+/// Drawn with glDrawElementsIndirect, the counters are the command
+layout(std430, binding = 10) writeonly buffer ComputedIndexBuffer {
+  uint computedIndices[];
+};
+
+// =============================================================================
+// -- Uniforms -----------------------------------------------------------------
+// =============================================================================
+
+uniform uint NumPatches;
+
+/// Sizes of the output buffers, patches that do not fit are dropped
+uniform uint VertexCapacity;
+uniform uint IndexCapacity;
+
+/// Limit of the grid level, same as in compute_levels.glsl
+uniform int MaxComputeLevel;
+
+// =============================================================================
+// -- Functions ----------------------------------------------------------------
+// =============================================================================
+
+/// Projects Weighted coordiantes to 3D coordinates
+vec3 projectTo3D(in vec4 v0) {
+  return v0.xyz / v0.w;
+}
+
+/// Control point of the patch in model coordinates
+vec4 controlPoint(in uint patchNumber, in int k) {
+  return controlPoints[patchIndices[NUM_CONTROL_POINTS * patchNumber + k]];
+}
+
+/// Same as roundLevel in geom/beziertriangletessellator.cpp
+uint roundLevel(in float level) {
+  return uint(clamp(int(ceil(level)), 1, MaxComputeLevel));
+}
+
+/// Snaps grid index g of an n grid to an edge of level m and returns the
+/// edge parameter, same as BezierTriangleTessellator::pattern
+float snapToEdge(in uint g, in uint n, in float level) {
+  uint m = roundLevel(level);
+  uint snapped = (2 * g * m + n) / (2 * n);
+  return float(snapped) / float(m);
+}
+
+#ifdef QUAD_PATCH
+
+/// Evaluates a cubic curve at t with de Casteljau
+vec4 evaluateCubic(in float t, in vec4 p0, in vec4 p1, in vec4 p2, in vec4 p3) {
+  vec4 A = mix(p0, p1, t);
+  vec4 B = mix(p1, p2, t);
+  vec4 C = mix(p2, p3, t);
+  return mix(mix(A, B, t), mix(B, C, t), t);
+}
+
+/// Last line segment of de Casteljau at t, the curve point lies on it
+void reduceCubic(
+    in float t,
+    in vec4 p0,
+    in vec4 p1,
+    in vec4 p2,
+    in vec4 p3,
+    out vec4 a,
+    out vec4 b) {
+  vec4 A = mix(p0, p1, t);
+  vec4 B = mix(p1, p2, t);
+  vec4 C = mix(p2, p3, t);
+  a = mix(A, B, t);
+  b = mix(B, C, t);
+}
+
+/// Same as main in quad_tess_eval.glsl
+void evaluate(in vec4 cp[NUM_CONTROL_POINTS], in vec2 uv, out vec3 point, out vec3 normal) {
+  // Reduce the rows in u and the columns in v to line segments
+  vec4 left[4], right[4], bottom[4], top[4];
+  for (int k = 0; k < 4; ++k) {
+    reduceCubic(uv.x,
+          cp[4 * k], cp[4 * k + 1], cp[4 * k + 2], cp[4 * k + 3],
+          left[k], right[k]);
+    reduceCubic(uv.y,
+          cp[k], cp[k + 4], cp[k + 8], cp[k + 12],
+          bottom[k], top[k]);
+  }
+  vec4 a = evaluateCubic(uv.y, left[0], left[1], left[2], left[3]);
+  vec4 b = evaluateCubic(uv.y, right[0], right[1], right[2], right[3]);
+  vec4 c = evaluateCubic(uv.x, bottom[0], bottom[1], bottom[2], bottom[3]);
+  vec4 d = evaluateCubic(uv.x, top[0], top[1], top[2], top[3]);
+
+  point = projectTo3D(mix(a, b, uv.x));
+
+  // The tangents run along the segments in u and v
+  vec3 du = normalize(projectTo3D(b) - projectTo3D(a));
+  vec3 dv = normalize(projectTo3D(d) - projectTo3D(c));
+  normal = normalize(cross(du, dv));
+}
+
+#else
+
+/// Interpolate three vec4 with Barycentric coordinates uvw
+vec4 interpolate4DUVW(
+    in vec3 uvw,
+    in vec4 v0,
+    in vec4 v1,
+    in vec4 v2) {
+  return uvw.z * v0 + uvw.x * v1 + uvw.y * v2;
+}
+
+/// Same as main in tess_eval.glsl
+void evaluate(in vec4 cp[NUM_CONTROL_POINTS], in vec2 uv, out vec3 point, out vec3 normal) {
+  vec3 uvw = vec3(uv, max(0.0, 1.0 - uv.x - uv.y));
+
+  if (distance(cp[UV030], cp[UV111]) < 0.00001) {
+    // Triangle contains singularity (cones)
+    float u = clamp(uvw.x / (1 - uvw.y), 0.0, 1.0);
+
+    vec3 top = projectTo3D(cp[UV030]);
+    vec3 left = projectTo3D(cp[UV003]);
+    vec3 leftTangent = projectTo3D(cp[UV102]);
+    vec3 right = projectTo3D(cp[UV300]);
+    vec3 rightTangent = projectTo3D(cp[UV201]);
+
+    vec3 leftNormal = normalize(cross(
+          normalize(leftTangent - left), normalize(top - left)));
+    vec3 rightNormal = normalize(cross(
+          normalize(top - right), normalize(rightTangent - right)));
+
+    // Determine point on the bottom of the cone
+    vec4 A = mix(cp[UV003], cp[UV102], u);
+    vec4 B = mix(cp[UV102], cp[UV201], u);
+    vec4 C = mix(cp[UV201], cp[UV300], u);
+    vec4 bottomPoint = mix(mix(A, B, u), mix(B, C, u), u);
+
+    point = projectTo3D(mix(bottomPoint, cp[UV030], uvw.y));
+    normal = normalize(mix(leftNormal, rightNormal, u));
+    return;
+  }
+
+  // Cubic to quadratic triangle
+  vec4 A = interpolate4DUVW(uvw, cp[UV003], cp[UV102], cp[UV012]);
+  vec4 B = interpolate4DUVW(uvw, cp[UV102], cp[UV201], cp[UV111]);
+  vec4 C = interpolate4DUVW(uvw, cp[UV201], cp[UV300], cp[UV210]);
+  vec4 D = interpolate4DUVW(uvw, cp[UV012], cp[UV111], cp[UV021]);
+  vec4 E = interpolate4DUVW(uvw, cp[UV111], cp[UV210], cp[UV120]);
+  vec4 F = interpolate4DUVW(uvw, cp[UV021], cp[UV120], cp[UV030]);
+
+  // Quadratic to linear triangle
+  vec4 a = interpolate4DUVW(uvw, A, B, D);
+  vec4 b = interpolate4DUVW(uvw, B, C, E);
+  vec4 c = interpolate4DUVW(uvw, D, E, F);
+
+  point = projectTo3D(interpolate4DUVW(uvw, a, b, c));
+
+  vec3 aw = projectTo3D(a);
+  vec3 ab = normalize(projectTo3D(b) - aw);
+  vec3 ac = normalize(projectTo3D(c) - aw);
+  normal = normalize(cross(ab, ac));
+}
+
+#endif
+
+/// Domain coordinates of grid vertex (i, j), border vertices are snapped to
+/// the level of their edge
+vec2 gridParameter(in ComputedPatch computed, in uint i, in uint j) {
+  uint n = computed.gridLevel;
+#ifdef QUAD_PATCH
+  if (i == 0 || i == n) {
+    return vec2(i == 0 ? 0.0 : 1.0,
+                snapToEdge(j, n, computed.outerLevels[i == 0 ? U0 : U1]));
+  }
+  if (j == 0 || j == n) {
+    return vec2(snapToEdge(i, n, computed.outerLevels[j == 0 ? V0 : V1]),
+                j == 0 ? 0.0 : 1.0);
+  }
+#else
+  if (i == 0) {
+    return vec2(0.0, snapToEdge(j, n, computed.outerLevels[U0]));
+  }
+  if (j == 0) {
+    return vec2(snapToEdge(i, n, computed.outerLevels[V0]), 0.0);
+  }
+  if (i + j == n) {
+    float u = snapToEdge(i, n, computed.outerLevels[W0]);
+    return vec2(u, 1.0 - u);
+  }
+#endif
+  return vec2(i, j) / float(n);
+}
+
+/// Number of vertex (i, j) within the patch
+uint gridVertex(in uint n, in uint i, in uint j) {
+#ifdef QUAD_PATCH
+  return j * (n + 1) + i;
+#else
+  return j * (n + 1) - j * (j - 1) / 2 + i;
+#endif
+}
+
+// =============================================================================
+// -- main ---------------------------------------------------------------------
+// =============================================================================
+
+void main() {
+  uint patchNumber = gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x;
+  if (patchNumber == 0 && gl_LocalInvocationIndex == 0) {
+    // Indices beyond the capacity were never written
+    counters.count = min(counters.requestedIndices, IndexCapacity);
+    counters.instanceCount = 1;
+  }
+  if (patchNumber >= NumPatches) {
+    return;
+  }
+
+  ComputedPatch computed = computedPatches[patchNumber];
+  uint n = computed.gridLevel;
+#ifdef QUAD_PATCH
+  uint numVertices = (n + 1) * (n + 1);
+  uint numIndices = 6 * n * n;
+#else
+  uint numVertices = (n + 1) * (n + 2) / 2;
+  uint numIndices = 3 * n * n;
+#endif
+
+  // Dropped patches fill the part of their index range that fits with
+  // degenerate triangles
+  if (computed.firstVertex + numVertices > VertexCapacity ||
+      computed.firstIndex + numIndices > IndexCapacity) {
+    for (uint k = gl_LocalInvocationIndex;
+         k < numIndices && computed.firstIndex + k < IndexCapacity;
+         k += GROUP_SIZE) {
+      computedIndices[computed.firstIndex + k] = 0;
+    }
+    return;
+  }
+
+  vec4 cp[NUM_CONTROL_POINTS];
+  for (int k = 0; k < NUM_CONTROL_POINTS; ++k) {
+    cp[k] = controlPoint(patchNumber, k);
+  }
+
+  // --- Vertices --------------------------------------------------------------
+
+  for (uint j = 0; j <= n; ++j) {
+#ifdef QUAD_PATCH
+    uint rowLength = n + 1;
+#else
+    uint rowLength = n + 1 - j;
+#endif
+    for (uint i = gl_LocalInvocationIndex; i < rowLength; i += GROUP_SIZE) {
+      ComputedVertex vertex;
+      vertex.parameter = gridParameter(computed, i, j);
+      vec3 point, normal;
+      evaluate(cp, vertex.parameter, point, normal);
+      vertex.position = vec4(point, 1.0);
+      vertex.normal = vec4(normal, 0.0);
+      vertex.patchNumber = patchNumber;
+      vertex.padding = 0;
+      computedVertices[computed.firstVertex + gridVertex(n, i, j)] = vertex;
+    }
+  }
+
+  // --- Triangles -------------------------------------------------------------
+
+  // Indices are absolute, all patches of the type are a single draw
+  uint base = computed.firstVertex;
+  for (uint j = 0; j < n; ++j) {
+#ifdef QUAD_PATCH
+    uint rowStart = 2 * j * n;
+    for (uint i = gl_LocalInvocationIndex; i < n; i += GROUP_SIZE) {
+      uint v00 = base + gridVertex(n, i, j);
+      uint v10 = base + gridVertex(n, i + 1, j);
+      uint v01 = base + gridVertex(n, i, j + 1);
+      uint v11 = base + gridVertex(n, i + 1, j + 1);
+      uint first = computed.firstIndex + 3 * (rowStart + 2 * i);
+      computedIndices[first + 0] = v00;
+      computedIndices[first + 1] = v10;
+      computedIndices[first + 2] = v11;
+      computedIndices[first + 3] = v00;
+      computedIndices[first + 4] = v11;
+      computedIndices[first + 5] = v01;
+    }
+#else
+    // Row j has n - j triangles at its bottom and n - j - 1 on top
+    uint rowStart = 2 * n * j - j * j;
+    for (uint i = gl_LocalInvocationIndex; i + j < n; i += GROUP_SIZE) {
+      uint v00 = base + gridVertex(n, i, j);
+      uint v10 = base + gridVertex(n, i + 1, j);
+      uint v01 = base + gridVertex(n, i, j + 1);
+      uint first = computed.firstIndex + 3 * (rowStart + 2 * i);
+      computedIndices[first + 0] = v00;
+      computedIndices[first + 1] = v10;
+      computedIndices[first + 2] = v01;
+      if (i + j + 1 < n) {
+        computedIndices[first + 3] = v10;
+        computedIndices[first + 4] = base + gridVertex(n, i + 1, j + 1);
+        computedIndices[first + 5] = v01;
+      }
+    }
+#endif
+  }
+}
@@ -0,0 +1,217 @@
+#version 430 core
+
+// =============================================================================
+// -- Defines ------------------------------------------------------------------
+// =============================================================================
+
+// QUAD_PATCH is defined when the shader is used for bicubic quads
+#ifdef QUAD_PATCH
+#define NUM_CONTROL_POINTS 16
+#define NUM_EDGES 4
+#else
+#define NUM_CONTROL_POINTS 10
+#define NUM_EDGES 3
+#endif
+
+// Heuristic defines, uniforms and level functions, shared with the level
+// control shaders
+#include "heuristics.glsl"
+
+// Should be the same as COMPUTE_GROUP_SIZE in gl/bezierscene.cpp!
+layout(local_size_x = 64) in;
+
+// =============================================================================
+// -- Buffers ------------------------------------------------------------------
+// =============================================================================
+
+/// Should be the same as geom/patchinvariants.h!
+struct PatchInvariants {
+  vec4 edgeCurvature;
+  vec4 edgeDeviation;
+  float curvature;
+  float padding[3];
+};
+
+/// Should be the same as BezierScene::ComputedPatch!
+struct ComputedPatch {
+  vec4 outerLevels;
+  uint firstVertex;
+  uint firstIndex;
+  uint gridLevel;
+  float innerLevel;
+};
+
+/// Should be the same as BezierScene::ComputeCounters!
+struct ComputeCounters {
+  uint count;
+  uint instanceCount;
+  uint firstIndex;
+  int baseVertex;
+  uint baseInstance;
+  uint requestedIndices;
+  uint requestedVertices;
+  uint padding;
+};
+
+layout(std430, binding = 0) readonly buffer PatchInvariantBuffer {
+  PatchInvariants invariants[];
+};
+
+layout(std430, binding = 1) readonly buffer PatchEdgeBuffer {
+  uint patchEdges[];
+};
+
+layout(std430, binding = 2) readonly buffer EdgeLevelBuffer {
+  float edgeLevels[];
+};
+
+/// The vertex buffer of the scene
+layout(std430, binding = 5) readonly buffer ControlPointBuffer {
+  vec4 controlPoints[];
+};
+
+/// The index buffer of the patch type
+layout(std430, binding = 7) readonly buffer PatchIndexBuffer {
+  uint patchIndices[];
+};
+
+layout(std430, binding = 8) writeonly buffer ComputedPatchBuffer {
+  ComputedPatch computedPatches[];
+};
+
+/// Reset to zero by the CPU before every tessellation
+layout(std430, binding = 9) buffer ComputeCounterBuffer {
+  ComputeCounters counters;
+};
+
+// =============================================================================
+// -- Uniforms -----------------------------------------------------------------
+// =============================================================================
+
+uniform uint NumPatches;
+
+/// Limit of the grid level, independent of GL_MAX_TESS_GEN_LEVEL
+uniform int MaxComputeLevel;
+
+/// Read the outer levels from edgeLevels instead of the EdgeHeuristic
+uniform bool SharedEdgeLevels;
+
+// --- Common OpenGL uniforms --------------------------------------------------
+
+uniform mat4 ModelViewMatrix;
+
+// =============================================================================
+// -- Functions ----------------------------------------------------------------
+// =============================================================================
+
+/// Control point of the patch in view coordinates, same as vertex.glsl
+vec4 controlPoint(in uint patchNumber, in int k) {
+  vec4 point = controlPoints[patchIndices[NUM_CONTROL_POINTS * patchNumber + k]];
+  vec4 transformed = ModelViewMatrix * vec4(stripWeight(point), 1.0);
+  return vec4(transformed.xyz / transformed.w * point.w, point.w);
+}
+
+/// Patch control point k of an edge, same as PatchEdgeTable::edgeControlPoint
+int edgeControlPoint(in int edge, in int k) {
+#ifdef QUAD_PATCH
+  if (edge == 0) {
+    return 4 * k;
+  }
+  if (edge == 1) {
+    return k;
+  }
+  if (edge == 2) {
+    return 4 * k + 3;
+  }
+  return 12 + k;
+#else
+  // B003, B102, B201, B300, B210, B120, B030, B021, B012
+  if (edge == 0) {
+    return k == 0 ? 0 : 9 - k;
+  }
+  if (edge == 1) {
+    return k;
+  }
+  return 3 + k;
+#endif
+}
+
+// --- Tessellation heuristic inputs -------------------------------------------
+
+float screenProjectionEdge(in uint patchNumber, in int edge) {
+  return screenProjectionLevel(
+        controlPoint(patchNumber, edgeControlPoint(edge, 0)),
+        controlPoint(patchNumber, edgeControlPoint(edge, 1)),
+        controlPoint(patchNumber, edgeControlPoint(edge, 2)),
+        controlPoint(patchNumber, edgeControlPoint(edge, 3)));
+}
+
+/// Outer level of an edge, from edge_levels.glsl or the EdgeHeuristic
+float edgeLevel(in uint patchNumber, in int edge) {
+  if (SharedEdgeLevels) {
+    return edgeLevels[patchEdges[NUM_EDGES * patchNumber + uint(edge)]];
+  }
+  float projection = 0.0;
+  if (usesScreenProjection(EdgeHeuristic)) {
+    projection = screenProjectionEdge(patchNumber, edge);
+  }
+  return edgeHeuristicLevel(
+        invariants[patchNumber].edgeCurvature[edge],
+        invariants[patchNumber].edgeDeviation[edge],
+        projection);
+}
+
+/// Inner level for the FaceHeuristic
+///
+/// The screen space normal heuristic needs the normals of the whole patch,
+/// it uses the view independent curvature here.
+float faceLevel(in uint patchNumber) {
+  float curvature = invariants[patchNumber].curvature;
+  float projection = 0.0;
+  if (usesScreenProjection(FaceHeuristic)) {
+    for (int edge = 0; edge < NUM_EDGES; ++edge) {
+      projection = max(projection, screenProjectionEdge(patchNumber, edge));
+    }
+  }
+  return faceHeuristicLevel(curvature, projection, curvature);
+}
+
+// =============================================================================
+// -- main ---------------------------------------------------------------------
+// =============================================================================
+
+void main() {
+  uint patchNumber = gl_GlobalInvocationID.x;
+  if (patchNumber >= NumPatches) {
+    return;
+  }
+
+  ComputedPatch computed;
+  computed.outerLevels = vec4(1.0);
+  for (int edge = 0; edge < NUM_EDGES; ++edge) {
+    computed.outerLevels[edge] = edgeLevel(patchNumber, edge);
+  }
+  computed.innerLevel = faceLevel(patchNumber);
+
+  // Uniform grid of the highest level, edges snap to their own level
+  float level = computed.innerLevel;
+  for (int edge = 0; edge < NUM_EDGES; ++edge) {
+    level = max(level, computed.outerLevels[edge]);
+  }
+  uint n = uint(clamp(int(ceil(level)), 1, MaxComputeLevel));
+  computed.gridLevel = n;
+
+#ifdef QUAD_PATCH
+  uint numVertices = (n + 1) * (n + 1);
+  uint numIndices = 6 * n * n;
+#else
+  uint numVertices = (n + 1) * (n + 2) / 2;
+  uint numIndices = 3 * n * n;
+#endif
+
+  // Ranges are reserved even if they do not fit, so the CPU can read the
+  // required buffer sizes back, see compute_evaluate.glsl
+  computed.firstIndex = atomicAdd(counters.requestedIndices, numIndices);
+  computed.firstVertex = atomicAdd(counters.requestedVertices, numVertices);
+  computedPatches[patchNumber] = computed;
+}
@@ -0,0 +1,180 @@
+#version 430 core
+
+// =============================================================================
+// -- Defines ------------------------------------------------------------------
+// =============================================================================
+
+// QUAD_PATCH is defined when the shader is used for bicubic quads
+#ifdef QUAD_PATCH
+#define NUM_CONTROL_POINTS 16
+#define B00 0
+#define B30 3
+#define B03 12
+#define B33 15
+#else
+#define NUM_CONTROL_POINTS 10
+#define UV003 0
+#define UV300 3
+#define UV030 6
+#endif
+
+// =============================================================================
+// -- In and outputs -----------------------------------------------------------
+// =============================================================================
+
+// Vertices are read from the compute buffers with gl_VertexID, the outputs
+// are the same as the ones of the tessellation evaluation shaders
+
+out vec3 barycenter_GS_in;
+out vec4 vert_coord_GS_in;
+out vec3 vert_normal_GS_in;
+
+// --- Flat outputs ------------------------------------------------------------
+
+out vec3 patch_color_GS_in;
+out ControlCoords {
+  vec4 control_coord_GS_in[NUM_CONTROL_POINTS];
+};
+out float patch_curvature_GS_in;
+out float inner_tess_level_GS_in;
+out float outer_tess_level_GS_in;
+out vec3 patch_normal_GS_in;
+flat out uint patch_number_GS_in;
+
+// =============================================================================
+// -- Buffers ------------------------------------------------------------------
+// =============================================================================
+
+/// Should be the same as geom/patchinvariants.h!
+struct PatchInvariants {
+  vec4 edgeCurvature;
+  vec4 edgeDeviation;
+  float curvature;
+  float padding[3];
+};
+
+/// Should be the same as BezierScene::ComputedPatch!
+struct ComputedPatch {
+  vec4 outerLevels;
+  uint firstVertex;
+  uint firstIndex;
+  uint gridLevel;
+  float innerLevel;
+};
+
+/// Should be the same as BezierScene::ComputedVertex!
+struct ComputedVertex {
+  vec4 position;
+  vec4 normal;
+  vec2 parameter;
+  uint patchNumber;
+  uint padding;
+};
+
+layout(std430, binding = 0) readonly buffer PatchInvariantBuffer {
+  PatchInvariants invariants[];
+};
+
+/// The vertex buffer of the scene
+layout(std430, binding = 5) readonly buffer ControlPointBuffer {
+  vec4 controlPoints[];
+};
+
+layout(std430, binding = 6) readonly buffer ComputedVertexBuffer {
+  ComputedVertex computedVertices[];
+};
+
+/// The index buffer of the patch type
+layout(std430, binding = 7) readonly buffer PatchIndexBuffer {
+  uint patchIndices[];
+};
+
+layout(std430, binding = 8) readonly buffer ComputedPatchBuffer {
+  ComputedPatch computedPatches[];
+};
+
+// =============================================================================
+// -- Uniforms -----------------------------------------------------------------
+// =============================================================================
+
+uniform mat4 ModelViewMatrix;
+uniform mat4 ProjectionMatrix;
+
+// =============================================================================
+// -- Functions ----------------------------------------------------------------
+// =============================================================================
+
+vec3 projectTo3D(in vec4 v0) {
+  return v0.xyz / v0.w;
+}
+
+/// Same as vertex.glsl
+vec4 toViewSpace(in vec4 point) {
+  vec4 transformed = ModelViewMatrix * vec4(projectTo3D(point), 1.0);
+  return vec4(transformed.xyz / transformed.w * point.w, point.w);
+}
+
+/// Generates a random number from a vec2
+float rand(in vec2 co) {
+  return fract(sin(dot(co.xy, vec2(12.9898, 78.233))) * 43758.5453);
+}
+
+/// Same as randomColor in the control shaders
+vec3 randomColor(in uint patchNumber) {
+  float id = float(patchNumber);
+  vec3 c = vec3(0);
+  c.r = rand(vec2(id, id + 1));
+  c.g = rand(vec2(id + 2, id + 3));
+  c.b = rand(vec2(id + 4, id + 5));
+  return c;
+}
+
+// =============================================================================
+// -- main ---------------------------------------------------------------------
+// =============================================================================
+
+void main() {
+  ComputedVertex vertex = computedVertices[gl_VertexID];
+  uint patchNumber = vertex.patchNumber;
+  ComputedPatch computed = computedPatches[patchNumber];
+
+  for (int i = 0; i < NUM_CONTROL_POINTS; ++i) {
+    control_coord_GS_in[i] = toViewSpace(
+          controlPoints[patchIndices[NUM_CONTROL_POINTS * patchNumber + i]]);
+  }
+
+  patch_color_GS_in = randomColor(patchNumber);
+  patch_number_GS_in = patchNumber;
+  float curvature = invariants[patchNumber].curvature;
+  patch_curvature_GS_in = pow(clamp((1 - curvature), 0.0, 1.0), 1.0 / 3.0);
+
+  inner_tess_level_GS_in = computed.innerLevel;
+  outer_tess_level_GS_in = max(
+        max(computed.outerLevels[0], computed.outerLevels[1]),
+        max(computed.outerLevels[2], computed.outerLevels[3]));
+
+#ifdef QUAD_PATCH
+  // The fragment shader evaluates quads at barycenter.xy
+  barycenter_GS_in = vec3(vertex.parameter, 0.0);
+
+  vec3 v00 = projectTo3D(control_coord_GS_in[B00]);
+  vec3 v30 = projectTo3D(control_coord_GS_in[B30]);
+  vec3 v03 = projectTo3D(control_coord_GS_in[B03]);
+  vec3 v33 = projectTo3D(control_coord_GS_in[B33]);
+  patch_normal_GS_in = normalize(cross(v33 - v00, v03 - v30));
+#else
+  barycenter_GS_in = vec3(vertex.parameter,
+                          max(0.0, 1.0 - vertex.parameter.x - vertex.parameter.y));
+
+  vec3 origin = projectTo3D(control_coord_GS_in[UV003]);
+  vec3 tangent = normalize(projectTo3D(control_coord_GS_in[UV030]) - origin);
+  vec3 bitangent = normalize(projectTo3D(control_coord_GS_in[UV300]) - origin);
+  patch_normal_GS_in = normalize(cross(bitangent, tangent));
+#endif
+
+  // The model view matrix only rotates, translates and scales uniformly
+  vert_coord_GS_in = ModelViewMatrix * vertex.position;
+  vert_coord_GS_in /= vert_coord_GS_in.w;
+  vert_normal_GS_in = normalize(mat3(ModelViewMatrix) * vertex.normal.xyz);
+  gl_Position = ProjectionMatrix * vert_coord_GS_in;
+}
@@ -0,0 +1,89 @@
+#version 430 core
+
+// =============================================================================
+// -- Defines ------------------------------------------------------------------
+// =============================================================================
+
+// Control points per edge
+#define EDGE_SIZE 4
+
+// Heuristic defines, uniforms and level functions, shared with the level
+// control shaders
+#include "heuristics.glsl"
+
+// Should be the same as EDGE_LEVEL_GROUP_SIZE in gl/bezierscene.cpp!
+layout(local_size_x = 64) in;
+
+// =============================================================================
+// -- Buffers ------------------------------------------------------------------
+// =============================================================================
+
+/// Should be the same as geom/patchinvariants.h!
+struct EdgeInvariants {
+  float curvature;
+  float deviation;
+};
+
+/// Level of every unique edge, read by the control shaders
+layout(std430, binding = 2) writeonly buffer EdgeLevelBuffer {
+  float edgeLevels[];
+};
+
+/// Control point indices of the unique edges, see PatchEdgeTable
+layout(std430, binding = 3) readonly buffer EdgeBuffer {
+  uint edgeVertices[];
+};
+
+layout(std430, binding = 4) readonly buffer EdgeInvariantBuffer {
+  EdgeInvariants edgeInvariants[];
+};
+
+/// The vertex buffer of the scene
+layout(std430, binding = 5) readonly buffer ControlPointBuffer {
+  vec4 controlPoints[];
+};
+
+// =============================================================================
+// -- Uniforms -----------------------------------------------------------------
+// =============================================================================
+
+uniform uint NumEdges;
+
+// --- Common OpenGL uniforms --------------------------------------------------
+
+uniform mat4 ModelViewMatrix;
+
+// =============================================================================
+// -- Functions ----------------------------------------------------------------
+// =============================================================================
+
+/// Control point k of an edge in view coordinates, same as vertex.glsl
+vec4 edgePoint(in uint edge, in int k) {
+  vec4 point = controlPoints[edgeVertices[EDGE_SIZE * edge + k]];
+  vec4 transformed = ModelViewMatrix * vec4(stripWeight(point), 1.0);
+  return vec4(transformed.xyz / transformed.w * point.w, point.w);
+}
+
+// =============================================================================
+// -- main ---------------------------------------------------------------------
+// =============================================================================
+
+void main() {
+  uint edge = gl_GlobalInvocationID.x;
+  if (edge >= NumEdges) {
+    return;
+  }
+
+  float projection = 0.0;
+  if (usesScreenProjection(EdgeHeuristic)) {
+    projection = screenProjectionLevel(
+          edgePoint(edge, 0),
+          edgePoint(edge, 1),
+          edgePoint(edge, 2),
+          edgePoint(edge, 3));
+  }
+  edgeLevels[edge] = edgeHeuristicLevel(
+        edgeInvariants[edge].curvature,
+        edgeInvariants[edge].deviation,
+        projection);
+}
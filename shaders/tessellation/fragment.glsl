@@ -1,4 +1,4 @@
-#version 410 core
+#version 430 core
 
 // =============================================================================
 // -- Defines ------------------------------------------------------------------
@@ -23,7 +23,16 @@
 #define OuterTessLevel 10
 #define LocalCurvature 11
 
+/// Defines for Wireframe Mode
+#define NoWireframe 0
+#define WireframeOverlay 1
+#define WireframeOnly 2
+
 /// Defines for vertex coord array offsets
+/// QUAD_PATCH is defined when the shader is used for bicubic quads
+#ifdef QUAD_PATCH
+#define NUM_CONTROL_POINTS 16
+#else
 #define UV003 0
 #define UV102 1
 #define UV201 2
@@ -35,6 +44,17 @@
 #define UV012 8
 #define UV111 9
 #define NUM_CONTROL_POINTS 10
+#endif
+
+/// POWER_BASIS is defined when the patch is evaluated from the coefficients
+/// of geom/powerbasis.h, rows of ROW_LENGTH coefficients starting at ROW_START
+#ifdef QUAD_PATCH
+#define ROW_START(b) (4 * (b))
+#define ROW_LENGTH(b) 4
+#else
+#define ROW_START(b) ((b) * (9 - (b)) / 2)
+#define ROW_LENGTH(b) (4 - (b))
+#endif
 
 #define MinTriangleSize 2.0
 #define MaxTriangleSize 50.0
@@ -48,10 +68,15 @@
 in vec3 barycenter_FS_in;
 in vec4 vert_coord_FS_in;
 in vec3 vert_normal_FS_in;
+noperspective in vec3 edge_distance_FS_in;
 
 flat in vec3 patch_color_FS_in;
 flat in vec3 flat_normal_FS_in;
+#ifdef POWER_BASIS
+flat in uint patch_number_FS_in;
+#else
 flat in vec4 control_coord_FS_in[NUM_CONTROL_POINTS];
+#endif
 flat in float patch_curvature_FS_in;
 flat in float max_triangle_size_FS_in;
 flat in float min_triangle_size_FS_in;
@@ -83,12 +108,122 @@ uniform int DrawingMode;
 /// Contains the minimum and maximum tessellation levels
 uniform int TessLevels[NUM_LEVELS];
 
+/// Edges of the tessellated triangles, drawn in the same pass as the faces
+uniform int WireframeMode;
+uniform vec3 WireframeColor;
+/// Line width in pixels
+uniform float WireframeWidth;
+
+#ifdef POWER_BASIS
+uniform mat4 ModelViewMatrix;
+
+// =============================================================================
+// -- Buffers ------------------------------------------------------------------
+// =============================================================================
+
+/// Should be the same as geom/powerbasis.h!
+layout(std430, binding = 11) readonly buffer PowerBasisBuffer {
+  vec4 powerCoefficients[];
+};
+#endif
+
 // =============================================================================
 // -- Functions ----------------------------------------------------------------
 // =============================================================================
 
 // --- Interpolation functions -------------------------------------------------
 
+#ifdef POWER_BASIS
+
+/// Evaluates the homogeneous model coordinates of the patch and their
+/// derivatives in u and v with Horner's rule, (u, v) is in barycenter_FS_in.xy
+vec4 evaluatePowerBasis(out vec4 du, out vec4 dv) {
+  float u = barycenter_FS_in.x;
+  float v = barycenter_FS_in.y;
+  uint base = NUM_CONTROL_POINTS * patch_number_FS_in;
+
+  vec4 point = vec4(0.0);
+  du = vec4(0.0);
+  dv = vec4(0.0);
+  for (int b = 3; b >= 0; --b) {
+    // Polynomial in u of the coefficients of v^b
+    vec4 row = vec4(0.0);
+    vec4 rowDu = vec4(0.0);
+    for (int a = ROW_LENGTH(b) - 1; a >= 0; --a) {
+      rowDu = rowDu * u + row;
+      row = row * u + powerCoefficients[base + ROW_START(b) + a];
+    }
+    dv = dv * v + point;
+    point = point * v + row;
+    du = du * v + rowDu;
+  }
+  return point;
+}
+
+/// Same as evaluateCoord below, but from the power basis coefficients
+vec4 evaluateCoord(out vec3 interpolatedNormal) {
+  vec4 du, dv;
+  vec4 point = evaluatePowerBasis(du, dv);
+
+  // Derivatives of point.xyz / point.w, up to the common factor 1 / w^2
+  mat3 normalMatrix = mat3(ModelViewMatrix);
+  vec3 tangent = normalMatrix * (du.xyz * point.w - point.xyz * du.w);
+  vec3 bitangent = normalMatrix * (dv.xyz * point.w - point.xyz * dv.w);
+  interpolatedNormal = normalize(cross(tangent, bitangent));
+
+  // Same as toViewSpace in vertex.glsl
+  vec4 transformed = ModelViewMatrix * vec4(point.xyz / point.w, 1.0);
+  return vec4(transformed.xyz / transformed.w, point.w);
+}
+
+#elif defined(QUAD_PATCH)
+
+/// Evaluates a cubic curve at t with de Casteljau
+vec4 evaluateCubic(in float t, in vec4 p0, in vec4 p1, in vec4 p2, in vec4 p3) {
+  vec4 A = mix(p0, p1, t);
+  vec4 B = mix(p1, p2, t);
+  vec4 C = mix(p2, p3, t);
+  return mix(mix(A, B, t), mix(B, C, t), t);
+}
+
+/// Calculate the coordinated if the bezier quad were to be evaluated at
+/// each fragment, (u, v) is in barycenter_FS_in.xy
+/// Also output the normal at the coordinate
+vec4 evaluateCoord(out vec3 interpolatedNormal) {
+  float u = barycenter_FS_in.x;
+  float v = barycenter_FS_in.y;
+
+  // Reduce the rows in u and the columns in v to line segments
+  vec4 left[4], right[4], bottom[4], top[4];
+  for (int k = 0; k < 4; ++k) {
+    vec4 A = mix(control_coord_FS_in[4 * k], control_coord_FS_in[4 * k + 1], u);
+    vec4 B = mix(control_coord_FS_in[4 * k + 1], control_coord_FS_in[4 * k + 2], u);
+    vec4 C = mix(control_coord_FS_in[4 * k + 2], control_coord_FS_in[4 * k + 3], u);
+    left[k] = mix(A, B, u);
+    right[k] = mix(B, C, u);
+
+    A = mix(control_coord_FS_in[k], control_coord_FS_in[k + 4], v);
+    B = mix(control_coord_FS_in[k + 4], control_coord_FS_in[k + 8], v);
+    C = mix(control_coord_FS_in[k + 8], control_coord_FS_in[k + 12], v);
+    bottom[k] = mix(A, B, v);
+    top[k] = mix(B, C, v);
+  }
+  vec4 a = evaluateCubic(v, left[0], left[1], left[2], left[3]);
+  vec4 b = evaluateCubic(v, right[0], right[1], right[2], right[3]);
+  vec4 c = evaluateCubic(u, bottom[0], bottom[1], bottom[2], bottom[3]);
+  vec4 d = evaluateCubic(u, top[0], top[1], top[2], top[3]);
+
+  vec3 du = normalize(b.xyz / b.w - a.xyz / a.w);
+  vec3 dv = normalize(d.xyz / d.w - c.xyz / c.w);
+  interpolatedNormal = normalize(cross(du, dv));
+
+  // Final homogeneous coordinates
+  vec4 homogeneousCoord = mix(a, b, u);
+  return vec4(homogeneousCoord.xyz / homogeneousCoord.w, homogeneousCoord.w);
+}
+
+#else
+
 /// Interpolate three vec4 using barycenter_FS_in
 vec4 interpolate4D(in vec4 v0, in vec4 v1, in vec4 v2) {
   return barycenter_FS_in.z * v0 +
@@ -144,6 +279,8 @@ vec4 evaluateCoord(out vec3 interpolatedNormal) {
   return vec4(homogeneousCoord.xyz / homogeneousCoord.w, homogeneousCoord.w);
 }
 
+#endif
+
 // --- Drawing Modes -----------------------------------------------------------
 
 /// Blinn-Phong Shading with given colors and normals
@@ -297,4 +434,21 @@ void main() {
 
   }
 
+  if (WireframeMode != NoWireframe) {
+    float edgeDistance = min(min(edge_distance_FS_in.x, edge_distance_FS_in.y),
+                             edge_distance_FS_in.z);
+    // One pixel of anti-aliasing on both sides of the line
+    float halfWidth = 0.5 * WireframeWidth;
+    float coverage = 1.0 - smoothstep(halfWidth - 0.5, halfWidth + 0.5, edgeDistance);
+
+    if (WireframeMode == WireframeOnly) {
+      if (coverage < 0.5) {
+        discard;
+      }
+      fColor = vec4(WireframeColor, 1.0);
+    } else {
+      fColor = mix(fColor, vec4(WireframeColor, 1.0), coverage);
+    }
+  }
+
 }
@@ -4,7 +4,14 @@
 // -- Defines ------------------------------------------------------------------
 // =============================================================================
 
+// QUAD_PATCH is defined when the shader is used for bicubic quads
+// POWER_BASIS is defined when the fragments evaluate the power basis buffer
+// instead of the control points
+#ifdef QUAD_PATCH
+#define NUM_CONTROL_POINTS 16
+#else
 #define NUM_CONTROL_POINTS 10
+#endif
 
 // =============================================================================
 // -- In and outputs -----------------------------------------------------------
@@ -31,6 +38,7 @@ in float patch_curvature_GS_in[];
 in float inner_tess_level_GS_in[];
 in float outer_tess_level_GS_in[];
 in vec3 patch_normal_GS_in[];
+flat in uint patch_number_GS_in[];
 
 // --- Outputs -----------------------------------------------------------------
 
@@ -41,10 +49,17 @@ out vec3 barycenter_FS_in;
 out vec4 vert_coord_FS_in;
 out vec3 vert_normal_FS_in;
 
+/// Window space distances to the three edges of the output triangle
+noperspective out vec3 edge_distance_FS_in;
+
 // --- Flat outputs ------------------------------------------------------------
 
 flat out vec3 patch_color_FS_in;
+#ifdef POWER_BASIS
+flat out uint patch_number_FS_in;
+#else
 flat out vec4 control_coord_FS_in[NUM_CONTROL_POINTS];
+#endif
 flat out float patch_curvature_FS_in;
 flat out vec3 flat_normal_FS_in;
 flat out float max_triangle_size_FS_in;
@@ -64,14 +79,19 @@ uniform int Height;
 // -- Functions ----------------------------------------------------------------
 // =============================================================================
 
-void emitPerVertex(in int index) {
+void emitPerVertex(in int index, in vec3 edgeDistance) {
   gl_Position = gl_in[index].gl_Position;
   barycenter_FS_in = barycenter_GS_in[index];
   vert_coord_FS_in = vert_coord_GS_in[index];
   vert_normal_FS_in = vert_normal_GS_in[index];
+  edge_distance_FS_in = edgeDistance;
   EmitVertex();
 }
 
+vec2 toWindow(in vec4 v) {
+  return 0.5 * (v.xy / v.w) * vec2(Width, Height);
+}
+
 float distanceProjectedPoints(in vec4 v0, in vec4 v1) {
   vec2 WH = vec2(Width, Height);
   vec2 p0 = (v0.xy / v0.w) * WH;
@@ -86,9 +106,13 @@ float distanceProjectedPoints(in vec4 v0, in vec4 v1) {
 void main() {
 
   patch_color_FS_in = patch_color_GS_in[0];
+#ifdef POWER_BASIS
+  patch_number_FS_in = patch_number_GS_in[0];
+#else
   for (int i = 0; i < NUM_CONTROL_POINTS; ++i) {
     control_coord_FS_in[i] = controls[0].control_coord_GS_in[i];
   }
+#endif
   patch_curvature_FS_in = patch_curvature_GS_in[0];
   inner_tess_level_FS_in = inner_tess_level_GS_in[0];
   outer_tess_level_FS_in = outer_tess_level_GS_in[0];
@@ -109,9 +133,21 @@ void main() {
   max_triangle_size_FS_in = max(max(u0, v0), w0);
   min_triangle_size_FS_in = min(min(u0, v0), w0);
 
-  emitPerVertex(0);
-  emitPerVertex(1);
-  emitPerVertex(2);
+  // Height of each vertex above the opposite edge, in pixels
+  vec2 p0 = toWindow(gl_in[0].gl_Position);
+  vec2 p1 = toWindow(gl_in[1].gl_Position);
+  vec2 p2 = toWindow(gl_in[2].gl_Position);
+  vec2 e0 = p2 - p1;
+  vec2 e1 = p2 - p0;
+  vec2 e2 = p1 - p0;
+  float area = abs(e1.x * e2.y - e1.y * e2.x);
+  float h0 = area / max(length(e0), 1e-6);
+  float h1 = area / max(length(e1), 1e-6);
+  float h2 = area / max(length(e2), 1e-6);
+
+  emitPerVertex(0, vec3(h0, 0.0, 0.0));
+  emitPerVertex(1, vec3(0.0, h1, 0.0));
+  emitPerVertex(2, vec3(0.0, 0.0, h2));
 
   EndPrimitive();
 }
@@ -0,0 +1,163 @@
+// Tessellation level heuristics, shared by the tessellation control shaders,
+// edge_levels.glsl and compute_levels.glsl. ShaderSource::read() pastes
+// this file over the #include line of those shaders.
+//
+// The stages only gather the inputs of a patch or an edge (invariants,
+// projected edge lengths, normal deviation). The levels are selected here,
+// so a heuristic is changed in one place.
+// Should be the same as geom/tessellationheuristic.cpp!
+
+// =============================================================================
+// -- Defines ------------------------------------------------------------------
+// =============================================================================
+
+// Defines for level array offsets
+#define MinLevel 0
+#define MaxLevel 1
+#define NUM_LEVELS 2
+
+// Defines for heuristics array offsets
+// Should be the same in geom/tessellationheuristic.h!
+#define FixedLevels 0
+#define ScreenSpaceNormal 1
+#define ScreenProjection 2
+#define Curvature 3
+#define MaxDeviation 4
+// CombinedMethods
+#define MinProjectionCurvature 5
+#define NUM_HEURISTICS 6
+
+// =============================================================================
+// -- Uniforms -----------------------------------------------------------------
+// =============================================================================
+
+/// Contains the minimum and maximum tessellation levels
+uniform int TessLevels[NUM_LEVELS];
+
+uniform int EdgeHeuristic;
+
+uniform int FaceHeuristic;
+
+// --- Tolerances --------------------------------------------------------------
+uniform float ProjectionTolerance;
+
+uniform float DeviationTolerance;
+
+// --- Common OpenGL uniforms --------------------------------------------------
+
+uniform mat4 ProjectionMatrix;
+/// Uniform scale of the model view matrix, for the model space deviations
+uniform float ModelViewScale;
+uniform int Width;
+uniform int Height;
+
+// =============================================================================
+// -- Functions ----------------------------------------------------------------
+// =============================================================================
+
+/// Projects Weighted coordiantes to 3D coordinates
+vec3 stripWeight(in vec4 homogeneous) {
+  return homogeneous.xyz / homogeneous.w;
+}
+
+/// Whether a heuristic needs screenProjectionLevel() of the edges
+bool usesScreenProjection(in int heuristic) {
+  return heuristic == ScreenProjection || heuristic == MinProjectionCurvature;
+}
+
+// --- Tessellation heuristic functions ----------------------------------------
+
+/// Level for a normal deviation, used by the curvature heuristics
+///
+/// f is the minimum dot product of the normals with a reference normal,
+/// see TessellationHeuristic::edgeCurvature and calculateCurvature
+float curvatureLevel(in float f) {
+  // Cubic root is used for faster curve
+  float factor = pow(1 - clamp(f, 0.0, 1.0), 1.0 / 3.0);
+  return mix(
+      TessLevels[MinLevel],
+      TessLevels[MaxLevel],
+      factor);
+}
+
+/// Level for the model space deviation of an edge from its chord
+float deviationLevel(in float deviation) {
+  return clamp(
+      deviation * ModelViewScale / DeviationTolerance,
+      TessLevels[MinLevel],
+      TessLevels[MaxLevel]);
+}
+
+/// Level for the projected length of a cubic edge in view coordinates
+float screenProjectionLevel(in vec4 v0, in vec4 e0, in vec4 e1, in vec4 v1) {
+  // Project to screen
+  vec2 WH = vec2(Width, Height);
+
+  vec4 vp0 = ProjectionMatrix * vec4(stripWeight(v0), 1.0);
+  vec2 vn0 = (vp0.xy / vp0.w) * WH;
+
+  vec4 ep0 = ProjectionMatrix * vec4(stripWeight(e0), 1.0);
+  vec2 en0 = (ep0.xy / ep0.w) * WH;
+
+  vec4 ep1 = ProjectionMatrix * vec4(stripWeight(e1), 1.0);
+  vec2 en1 = (ep1.xy / ep1.w) * WH;
+
+  vec4 vp1 = ProjectionMatrix * vec4(stripWeight(v1), 1.0);
+  vec2 vn1 = (vp1.xy / vp1.w) * WH;
+
+  // Sum the distance
+  float d = distance(vn0, en0);
+  d += distance(en0, en1);
+  d += distance(en1, vn1);
+
+  // Divide by 2 since the distance is doubled
+  return clamp(
+      d / (2 * ProjectionTolerance),
+      TessLevels[MinLevel],
+      TessLevels[MaxLevel]);
+}
+
+/// Outer level of an edge for the EdgeHeuristic
+///
+/// curvature and deviation are the edge invariants, projection is the
+/// screenProjectionLevel() of the edge if usesScreenProjection(EdgeHeuristic).
+/// The screen space normal heuristic has no edge variant, its edges keep
+/// level 1.
+float edgeHeuristicLevel(in float curvature, in float deviation, in float projection) {
+  switch (EdgeHeuristic) {
+    case FixedLevels:
+      return TessLevels[MaxLevel];
+    case ScreenProjection:
+      return floor(projection);
+    case Curvature:
+      return floor(curvatureLevel(curvature));
+    case MaxDeviation:
+      return floor(deviationLevel(deviation));
+    case MinProjectionCurvature:
+      return min(floor(curvatureLevel(curvature)), floor(projection));
+  }
+  return 1;
+}
+
+/// Inner level of a patch for the FaceHeuristic
+///
+/// curvature is the view independent normal deviation of the patch,
+/// normalDeviation the one from the view direction (ScreenSpaceNormal only)
+/// and projection the largest screenProjectionLevel() of its edges if
+/// usesScreenProjection(FaceHeuristic). The maximum deviation heuristic
+/// has no face variant, the inner level stays 1.
+float faceHeuristicLevel(in float curvature, in float projection, in float normalDeviation) {
+  switch (FaceHeuristic) {
+    case FixedLevels:
+      return TessLevels[MaxLevel];
+    case ScreenSpaceNormal:
+      return floor(curvatureLevel(normalDeviation));
+    case ScreenProjection:
+      return floor(projection);
+    case Curvature:
+      return floor(curvatureLevel(curvature));
+    case MinProjectionCurvature:
+      return min(floor(projection), floor(curvatureLevel(curvature)));
+  }
+  return 1;
+}
@@ -0,0 +1,289 @@
+#version 430 core
+
+// =============================================================================
+// -- Defines ------------------------------------------------------------------
+// =============================================================================
+
+// Defines for offsets in gl_TessLevelOuter, edges of the quad domain
+#define U0 0
+#define V0 1
+#define U1 2
+#define V1 3
+
+// Defines for vertex coord array offsets, B_ij is at 4 * j + i
+#define B00 0
+#define B30 3
+#define B03 12
+#define B33 15
+#define NUM_CONTROL_POINTS 16
+
+// Heuristic defines, uniforms and level functions, shared with the other
+// level shaders
+#include "heuristics.glsl"
+
+// =============================================================================
+// -- In and outputs -----------------------------------------------------------
+// =============================================================================
+
+layout(vertices = NUM_CONTROL_POINTS) out;
+
+in vec4 vert_coord_CS_in[];
+in vec4 model_coord_CS_in[];
+in uint patch_base_CS_in[];
+
+out vec4 vert_coord_ES_in[];
+patch out vec3 patch_color_ES_in;
+patch out float patch_curvature_ES_in;
+/// Captured by the tessellation cache, see cached_vertex.glsl
+patch out uint patch_number_ES_in;
+
+// =============================================================================
+// -- Buffers ------------------------------------------------------------------
+// =============================================================================
+
+/// View independent heuristic inputs, computed once per scene
+/// Should be the same as geom/patchinvariants.h!
+struct PatchInvariants {
+  vec4 edgeCurvature;
+  vec4 edgeDeviation;
+  float curvature;
+  float padding[3];
+};
+
+layout(std430, binding = 0) readonly buffer PatchInvariantBuffer {
+  PatchInvariants invariants[];
+};
+
+/// Unique edge of every patch edge, see PatchEdgeTable
+layout(std430, binding = 1) readonly buffer PatchEdgeBuffer {
+  uint patchEdges[];
+};
+
+/// Written by edge_levels.glsl, shared by the neighbours of an edge
+layout(std430, binding = 2) readonly buffer EdgeLevelBuffer {
+  float edgeLevels[];
+};
+
+// =============================================================================
+// -- Uniforms -----------------------------------------------------------------
+// =============================================================================
+
+/// Read the outer levels from edgeLevels instead of the EdgeHeuristic
+uniform bool SharedEdgeLevels;
+
+// =============================================================================
+// -- Functions ----------------------------------------------------------------
+// =============================================================================
+
+// --- Utility functions -------------------------------------------------------
+
+/// Generates a random number from a vec2
+float rand(in vec2 co) {
+  return fract(sin(dot(co.xy, vec2(12.9898, 78.233))) * 43758.5453);
+}
+
+/// Number of the patch within its type, gl_PrimitiveID restarts for every
+/// run of a multi draw
+uint patchNumber() {
+  return patch_base_CS_in[0] + uint(gl_PrimitiveID);
+}
+
+/// Level of an edge computed by edge_levels.glsl
+float sharedEdgeLevel(in int edge) {
+  return edgeLevels[patchEdges[4 * patchNumber() + uint(edge)]];
+}
+
+/// Returns a random color based on the patch number
+vec3 randomColor() {
+  float id = float(patchNumber());
+  vec3 c = vec3(0);
+  c.r = rand(vec2(id, id + 1));
+  c.g = rand(vec2(id + 2, id + 3));
+  c.b = rand(vec2(id + 4, id + 5));
+  return c;
+}
+
+/// Control point B_ij
+vec4 controlPoint(in int i, in int j) {
+  return vert_coord_CS_in[4 * j + i];
+}
+
+/// Evaluates a cubic curve at t with de Casteljau
+vec4 evaluateCubic(in float t, in vec4 p0, in vec4 p1, in vec4 p2, in vec4 p3) {
+  vec4 A = mix(p0, p1, t);
+  vec4 B = mix(p1, p2, t);
+  vec4 C = mix(p2, p3, t);
+  return mix(mix(A, B, t), mix(B, C, t), t);
+}
+
+/// Last line segment of de Casteljau at t, the curve point lies on it
+void reduceCubic(
+    in float t,
+    in vec4 p0,
+    in vec4 p1,
+    in vec4 p2,
+    in vec4 p3,
+    out vec4 a,
+    out vec4 b) {
+  vec4 A = mix(p0, p1, t);
+  vec4 B = mix(p1, p2, t);
+  vec4 C = mix(p2, p3, t);
+  a = mix(A, B, t);
+  b = mix(B, C, t);
+}
+
+// --- Tessellation heuristic helper functions ---------------------------------
+
+/// Interpolate normal at the given (u, v)
+vec3 interpolateNormal(in vec2 uv) {
+  // Reduce the rows in u and the columns in v to line segments, the
+  // tangents run along these segments evaluated in the other direction
+  vec4 left[4], right[4], bottom[4], top[4];
+  for (int k = 0; k < 4; ++k) {
+    reduceCubic(uv.x,
+          controlPoint(0, k), controlPoint(1, k),
+          controlPoint(2, k), controlPoint(3, k),
+          left[k], right[k]);
+    reduceCubic(uv.y,
+          controlPoint(k, 0), controlPoint(k, 1),
+          controlPoint(k, 2), controlPoint(k, 3),
+          bottom[k], top[k]);
+  }
+  vec3 du = stripWeight(evaluateCubic(uv.y, right[0], right[1], right[2], right[3])) -
+      stripWeight(evaluateCubic(uv.y, left[0], left[1], left[2], left[3]));
+  vec3 dv = stripWeight(evaluateCubic(uv.x, top[0], top[1], top[2], top[3])) -
+      stripWeight(evaluateCubic(uv.x, bottom[0], bottom[1], bottom[2], bottom[3]));
+  return normalize(cross(du, dv));
+}
+
+/// Control point k of an edge, in the direction of increasing u or v
+vec4 edgePoint(in int edge, in int k) {
+  if (edge == U0) {
+    return controlPoint(0, k);
+  }
+  if (edge == V0) {
+    return controlPoint(k, 0);
+  }
+  if (edge == U1) {
+    return controlPoint(3, k);
+  }
+  return controlPoint(k, 3);
+}
+
+float calculateCurvature(in vec3 N) {
+  // Calculate normals at the corners, the center and center of edges
+  vec3 n0 = interpolateNormal(vec2(0.0, 0.0)); // B00
+  vec3 n1 = interpolateNormal(vec2(1.0, 0.0)); // B30
+  vec3 n2 = interpolateNormal(vec2(0.0, 1.0)); // B03
+  vec3 n3 = interpolateNormal(vec2(1.0, 1.0)); // B33
+
+  vec3 n4 = interpolateNormal(vec2(0.5, 0.5)); // Center
+
+  vec3 n5 = interpolateNormal(vec2(0.0, 0.5)); // U0
+  vec3 n6 = interpolateNormal(vec2(0.5, 0.0)); // V0
+  vec3 n7 = interpolateNormal(vec2(1.0, 0.5)); // U1
+  vec3 n8 = interpolateNormal(vec2(0.5, 1.0)); // V1
+
+  // Determine maximum deviation of the normal
+  float f0 = dot(n0, N);
+  float f1 = min(dot(n1, N), f0);
+  float f2 = min(dot(n2, N), f1);
+  float f3 = min(dot(n3, N), f2);
+  float f4 = min(dot(n4, N), f3);
+  float f5 = min(dot(n5, N), f4);
+  float f6 = min(dot(n6, N), f5);
+  float f7 = min(dot(n7, N), f6);
+  float f8 = min(dot(n8, N), f7);
+
+  return f8;
+}
+
+// --- Tessellation heuristic inputs -------------------------------------------
+
+/// Screen projection level of an edge
+float screenProjectionEdge(in int edge) {
+  return screenProjectionLevel(
+        edgePoint(edge, 0),
+        edgePoint(edge, 1),
+        edgePoint(edge, 2),
+        edgePoint(edge, 3));
+}
+
+/// Normal deviation from the view direction at the patch center, the input
+/// of the screen space normal heuristic
+float screenSpaceNormalFace() {
+  vec3 vc = 0.25 * (stripWeight(vert_coord_CS_in[B00]) +
+                    stripWeight(vert_coord_CS_in[B30]) +
+                    stripWeight(vert_coord_CS_in[B03]) +
+                    stripWeight(vert_coord_CS_in[B33]));
+  vec3 vn = normalize(-vc);
+
+  return calculateCurvature(vn);
+}
+
+/// Takes the maximum of all projected edges
+float screenProjectionFace() {
+  float d = 0.0;
+  for (int edge = U0; edge <= V1; ++edge) {
+    d = max(d, screenProjectionEdge(edge));
+  }
+  return d;
+}
+
+/// Outer level of an edge, from edge_levels.glsl or the EdgeHeuristic
+float edgeLevel(in int edge) {
+  if (SharedEdgeLevels) {
+    return sharedEdgeLevel(edge);
+  }
+  float projection = 0.0;
+  if (usesScreenProjection(EdgeHeuristic)) {
+    projection = screenProjectionEdge(edge);
+  }
+  return edgeHeuristicLevel(
+        invariants[patchNumber()].edgeCurvature[edge],
+        invariants[patchNumber()].edgeDeviation[edge],
+        projection);
+}
+
+/// Inner level of the patch for the FaceHeuristic
+float faceLevel(in float curvature) {
+  float projection = 0.0;
+  if (usesScreenProjection(FaceHeuristic)) {
+    projection = screenProjectionFace();
+  }
+  float normalDeviation = 0.0;
+  if (FaceHeuristic == ScreenSpaceNormal) {
+    normalDeviation = screenSpaceNormalFace();
+  }
+  return faceHeuristicLevel(curvature, projection, normalDeviation);
+}
+
+// =============================================================================
+// -- main ---------------------------------------------------------------------
+// =============================================================================
+
+void main() {
+
+  // Pass vertex coordinates to the evaluation shader
+  vert_coord_ES_in[gl_InvocationID] = vert_coord_CS_in[gl_InvocationID];
+
+  // Allow only proving vertex to set the tessellation levels and color
+  if (gl_InvocationID == 0) {
+    patch_color_ES_in = randomColor();
+    patch_number_ES_in = patchNumber();
+
+    // Normal deviation from the flat quad, does not depend on the view
+    float curvature = invariants[patchNumber()].curvature;
+    // transform [1, -1] to [0, 1] (0 no curvature, 1 max, can be > 1)
+    patch_curvature_ES_in = pow(clamp((1 - curvature), 0.0, 1.0), 1.0 / 3.0);
+
+    gl_TessLevelOuter[U0] = edgeLevel(U0);
+    gl_TessLevelOuter[V0] = edgeLevel(V0);
+    gl_TessLevelOuter[U1] = edgeLevel(U1);
+    gl_TessLevelOuter[V1] = edgeLevel(V1);
+
+    float inner = faceLevel(curvature);
+    gl_TessLevelInner[0] = inner;
+    gl_TessLevelInner[1] = inner;
+  }
+}
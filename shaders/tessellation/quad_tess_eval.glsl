@@ -0,0 +1,150 @@
+#version 410 core
+
+// =============================================================================
+// -- Defines ------------------------------------------------------------------
+// =============================================================================
+
+/// Defines for vertex coord array offsets, B_ij is at 4 * j + i
+#define B00 0
+#define B30 3
+#define B03 12
+#define B33 15
+#define NUM_CONTROL_POINTS 16
+
+// =============================================================================
+// -- In and outputs -----------------------------------------------------------
+// =============================================================================
+
+// --- Inputs ------------------------------------------------------------------
+
+layout(quads, equal_spacing, ccw) in;
+
+in vec4 vert_coord_ES_in[];
+patch in vec3 patch_color_ES_in;
+patch in float patch_curvature_ES_in;
+patch in uint patch_number_ES_in;
+
+// --- Interpolated outputs ----------------------------------------------------
+
+out vec3 barycenter_GS_in;
+out vec4 vert_coord_GS_in;
+out vec3 vert_normal_GS_in;
+
+// --- Flat outputs ------------------------------------------------------------
+
+out vec3 patch_color_GS_in;
+out ControlCoords {
+  vec4 control_coord_GS_in[NUM_CONTROL_POINTS];
+};
+out float patch_curvature_GS_in;
+out float inner_tess_level_GS_in;
+out float outer_tess_level_GS_in;
+out vec3 patch_normal_GS_in;
+
+/// Captured by the tessellation cache, indexes the POWER_BASIS coefficients
+flat out uint patch_number_GS_in;
+
+// =============================================================================
+// -- Uniforms -----------------------------------------------------------------
+// =============================================================================
+
+// --- Common OpenGL uniforms --------------------------------------------------
+
+uniform mat4 ProjectionMatrix;
+
+uniform mat3 NormalMatrix;
+
+// =============================================================================
+// -- Functions ----------------------------------------------------------------
+// =============================================================================
+
+vec3 projectTo3D(in vec4 v0) {
+  return v0.xyz / v0.w;
+}
+
+/// Control point B_ij
+vec4 controlPoint(in int i, in int j) {
+  return vert_coord_ES_in[4 * j + i];
+}
+
+/// Evaluates a cubic curve at t with de Casteljau
+vec4 evaluateCubic(in float t, in vec4 p0, in vec4 p1, in vec4 p2, in vec4 p3) {
+  vec4 A = mix(p0, p1, t);
+  vec4 B = mix(p1, p2, t);
+  vec4 C = mix(p2, p3, t);
+  return mix(mix(A, B, t), mix(B, C, t), t);
+}
+
+/// Last line segment of de Casteljau at t, the curve point lies on it
+void reduceCubic(
+    in float t,
+    in vec4 p0,
+    in vec4 p1,
+    in vec4 p2,
+    in vec4 p3,
+    out vec4 a,
+    out vec4 b) {
+  vec4 A = mix(p0, p1, t);
+  vec4 B = mix(p1, p2, t);
+  vec4 C = mix(p2, p3, t);
+  a = mix(A, B, t);
+  b = mix(B, C, t);
+}
+
+// =============================================================================
+// -- main ---------------------------------------------------------------------
+// =============================================================================
+
+void main() {
+  // Pass control points to the fragment shader
+  for (int i = 0; i < NUM_CONTROL_POINTS; i++) {
+    control_coord_GS_in[i] = vert_coord_ES_in[i];
+  }
+
+  patch_color_GS_in = patch_color_ES_in;
+  patch_curvature_GS_in = patch_curvature_ES_in;
+  patch_number_GS_in = patch_number_ES_in;
+
+  inner_tess_level_GS_in = max(gl_TessLevelInner[0], gl_TessLevelInner[1]);
+  outer_tess_level_GS_in = max(
+        max(gl_TessLevelOuter[0], gl_TessLevelOuter[1]),
+        max(gl_TessLevelOuter[2], gl_TessLevelOuter[3]));
+
+  vec2 uv = gl_TessCoord.xy;
+  // The fragment shader evaluates quads at barycenter.xy
+  barycenter_GS_in = vec3(uv, 0.0);
+
+  vec3 v00 = projectTo3D(vert_coord_ES_in[B00]);
+  vec3 v30 = projectTo3D(vert_coord_ES_in[B30]);
+  vec3 v03 = projectTo3D(vert_coord_ES_in[B03]);
+  vec3 v33 = projectTo3D(vert_coord_ES_in[B33]);
+  patch_normal_GS_in = normalize(cross(v33 - v00, v03 - v30));
+
+  // Reduce the rows in u and the columns in v to line segments
+  vec4 left[4], right[4], bottom[4], top[4];
+  for (int k = 0; k < 4; ++k) {
+    reduceCubic(uv.x,
+          controlPoint(0, k), controlPoint(1, k),
+          controlPoint(2, k), controlPoint(3, k),
+          left[k], right[k]);
+    reduceCubic(uv.y,
+          controlPoint(k, 0), controlPoint(k, 1),
+          controlPoint(k, 2), controlPoint(k, 3),
+          bottom[k], top[k]);
+  }
+  vec4 a = evaluateCubic(uv.y, left[0], left[1], left[2], left[3]);
+  vec4 b = evaluateCubic(uv.y, right[0], right[1], right[2], right[3]);
+  vec4 c = evaluateCubic(uv.x, bottom[0], bottom[1], bottom[2], bottom[3]);
+  vec4 d = evaluateCubic(uv.x, top[0], top[1], top[2], top[3]);
+
+  // Final homogeneous coordinates
+  vec4 homogeneousCoord = mix(a, b, uv.x);
+  vec3 weightedCoord = homogeneousCoord.xyz / homogeneousCoord.w;
+  vert_coord_GS_in = vec4(weightedCoord, 1.0);
+  gl_Position = ProjectionMatrix * vert_coord_GS_in;
+
+  // The tangents run along the segments in u and v
+  vec3 du = normalize(projectTo3D(b) - projectTo3D(a));
+  vec3 dv = normalize(projectTo3D(d) - projectTo3D(c));
+  vert_normal_GS_in = normalize(cross(du, dv));
+}
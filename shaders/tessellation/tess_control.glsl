@@ -1,4 +1,4 @@
-#version 410 core
+#version 430 core
 
 // =============================================================================
 // -- Defines ------------------------------------------------------------------
@@ -9,11 +9,6 @@
 #define V0 1
 #define W0 2
 
-// Defines for level array offsets
-#define MinLevel 0
-#define MaxLevel 1
-#define NUM_LEVELS 2
-
 // Defines for vertex coord array offsets
 #define UV003 0
 #define UV102 1
@@ -27,16 +22,9 @@
 #define UV111 9
 #define NUM_CONTROL_POINTS 10
 
-// Defines for heuristics array offsets
-// Should be the same in TessellationHeurstic.h!
-#define FixedLevels 0
-#define ScreenSpaceNormal 1
-#define ScreenProjection 2
-#define Curvature 3
-#define MaxDeviation 4
-// CombinedMethods
-#define MinProjectionCurvature 5
-#define NUM_HEURISTICS 6
+// Heuristic defines, uniforms and level functions, shared with the other
+// level shaders
+#include "heuristics.glsl"
 
 // =============================================================================
 // -- In and outputs -----------------------------------------------------------
@@ -46,32 +34,47 @@ layout(vertices = NUM_CONTROL_POINTS) out;
 
 in vec4 vert_coord_CS_in[];
 in vec4 model_coord_CS_in[];
+in uint patch_base_CS_in[];
 
 out vec4 vert_coord_ES_in[];
 patch out vec3 patch_color_ES_in;
 patch out float patch_curvature_ES_in;
+/// Captured by the tessellation cache, see cached_vertex.glsl
+patch out uint patch_number_ES_in;
 
 // =============================================================================
-// -- Uniforms -----------------------------------------------------------------
+// -- Buffers ------------------------------------------------------------------
 // =============================================================================
 
-/// Contains the minimum and maximum tessellation levels
-uniform int TessLevels[NUM_LEVELS];
-
-uniform int EdgeHeuristic;
-
-uniform int FaceHeuristic;
+/// View independent heuristic inputs, computed once per scene
+/// Should be the same as geom/patchinvariants.h!
+struct PatchInvariants {
+  vec4 edgeCurvature;
+  vec4 edgeDeviation;
+  float curvature;
+  float padding[3];
+};
+
+layout(std430, binding = 0) readonly buffer PatchInvariantBuffer {
+  PatchInvariants invariants[];
+};
+
+/// Unique edge of every patch edge, see PatchEdgeTable
+layout(std430, binding = 1) readonly buffer PatchEdgeBuffer {
+  uint patchEdges[];
+};
+
+/// Written by edge_levels.glsl, shared by the neighbours of an edge
+layout(std430, binding = 2) readonly buffer EdgeLevelBuffer {
+  float edgeLevels[];
+};
 
-// --- Tolerances --------------------------------------------------------------
-uniform float ProjectionTolerance;
-
-uniform float DeviationTolerance;
-
-// --- Common OpenGL uniforms --------------------------------------------------
+// =============================================================================
+// -- Uniforms -----------------------------------------------------------------
+// =============================================================================
 
-uniform mat4 ProjectionMatrix;
-uniform int Width;
-uniform int Height;
+/// Read the outer levels from edgeLevels instead of the EdgeHeuristic
+uniform bool SharedEdgeLevels;
 
 // =============================================================================
 // -- Functions ----------------------------------------------------------------
@@ -79,27 +82,29 @@ uniform int Height;
 
 // --- Utility functions -------------------------------------------------------
 
-/// Projects Weighted coordiantes to 3D coordinates
-vec3 stripWeight(in vec4 homogeneous) {
-  return homogeneous.xyz / homogeneous.w;
-}
-
 /// Generates a random number from a vec2
 float rand(in vec2 co) {
   return fract(sin(dot(co.xy, vec2(12.9898, 78.233))) * 43758.5453);
 }
 
-/// Sums the square of each component
-float sumSqr3(in vec3 v) {
-  return v.x * v.x + v.y * v.y + v.z * v.z;
+/// Number of the patch within its type, gl_PrimitiveID restarts for every
+/// run of a multi draw
+uint patchNumber() {
+  return patch_base_CS_in[0] + uint(gl_PrimitiveID);
 }
 
-/// Returns a random color based on the PrimitiveID
+/// Level of an edge computed by edge_levels.glsl
+float sharedEdgeLevel(in int edge) {
+  return edgeLevels[patchEdges[3 * patchNumber() + uint(edge)]];
+}
+
+/// Returns a random color based on the patch number
 vec3 randomColor() {
+  float id = float(patchNumber());
   vec3 c = vec3(0);
-  c.r = rand(vec2(gl_PrimitiveID, gl_PrimitiveID + 1));
-  c.g = rand(vec2(gl_PrimitiveID + 2, gl_PrimitiveID + 3));
-  c.b = rand(vec2(gl_PrimitiveID + 4, gl_PrimitiveID + 5));
+  c.r = rand(vec2(id, id + 1));
+  c.g = rand(vec2(id + 2, id + 3));
+  c.b = rand(vec2(id + 4, id + 5));
   return c;
 }
 
@@ -114,44 +119,6 @@ vec4 interpolate4DUVW(
 
 // --- Tessellation heuristic helper functions ---------------------------------
 
-/// Determines maximum deviation from the edge
-/// Ported from C++ code (TODO: add class and function name)
-float maxEdgeDeviation(
-    in vec3 v0,
-    in vec3 v1,
-    in vec3 v2,
-    in vec3 v3) {
-  vec3 dxyz = v3 - v0;
-  float U0NormSqr = 1.0 / sumSqr3(dxyz);
-  vec3 p1 = v1 - v0;
-  vec3 d1 = cross(dxyz, p1);
-  float d1Sqr = sumSqr3(d1);
-  vec3 p2 = v2 - v0;
-  vec3 d2 = cross(dxyz, p2);
-  float d2Sqr = sumSqr3(d2);
-  return sqrt(max(d1Sqr, d2Sqr) * U0NormSqr);
-}
-
-/// Interpolate tangent at the given t
-vec3 interpolateTangent(
-    in float t,
-    in vec4 v0,
-    in vec4 e0,
-    in vec4 e1,
-    in vec4 v1) {
-  vec4 A = mix(v0, e0, t);
-  vec4 B = mix(e0, e1, t);
-  vec4 C = mix(e1, v1, t);
-
-  vec4 a = mix(A, B, t);
-  vec4 b = mix(B, C, t);
-
-  vec3 aw = stripWeight(a);
-  vec3 bw = stripWeight(b);
-
-  return normalize(bw - aw);
-}
-
 /// Interpolate normal at the given barycentric coordinate
 vec3 interpolateNormal(in vec3 uvw) {
   // Cubic to quadratic triangle
@@ -234,80 +201,32 @@ float calculateCurvature(in vec3 N) {
   return f6;
 }
 
-// --- Tessellation heuristic functions ----------------------------------------
+// --- Tessellation heuristic inputs -------------------------------------------
 
-/// Calculate edge tessellation level using the max deviation heuristic
-float maxDeviationEdge(
-    in vec4 v0,
-    in vec4 v1,
-    in vec4 v2,
-    in vec4 v3) {
-  float deviation = maxEdgeDeviation(
-        stripWeight(v0),
-        stripWeight(v1),
-        stripWeight(v2),
-        stripWeight(v3));
-  return clamp(
-      deviation / DeviationTolerance,
-      TessLevels[MinLevel],
-      TessLevels[MaxLevel]);
-}
-
-// TODO: find something for faces and deviation...
-
-/// Calculate edge tessellation level using the Curvature heuristic
-///
-/// Determines maximum deviation of tangent compared to the
-/// tangent of the edge endpoints
-float curvatureEdge(
-    in vec4 v0,
-    in vec4 e0,
-    in vec4 e1,
-    in vec4 v1) {
-
-  // Calculate tangent of the whole edge
-  vec3 T = normalize(stripWeight(v1) - stripWeight(v0));
-
-  // Calculate tangents in between
-  vec3 t0 = interpolateTangent(0.0 / 6.0, v0, e0, e1, v1);
-  vec3 t1 = interpolateTangent(2.0 / 6.0, v0, e0, e1, v1);
-  vec3 t2 = interpolateTangent(3.0 / 6.0, v0, e0, e1, v1);
-  vec3 t3 = interpolateTangent(4.0 / 6.0, v0, e0, e1, v1);
-  vec3 t4 = interpolateTangent(6.0 / 6.0, v0, e0, e1, v1);
-
-  // Find the most divergent tangent
-  float f0 = dot(t0, T);
-  float f1 = min(dot(t1, T), f0);
-  float f2 = min(dot(t2, T), f1);
-  float f3 = min(dot(t3, T), f2);
-  float f4 = min(dot(t4, T), f3);
-
-  // Cubic root is used for faster curve
-  float factor = pow(1 - clamp(f4, 0.0, 1.0), 1.0 / 3.0);
-  return mix(
-      TessLevels[MinLevel],
-      TessLevels[MaxLevel],
-      factor);
+/// The control points of an edge, in the same order as
+/// PatchEdgeTable::edgeControlPoint
+vec4 edgePoint(in int edge, in int k) {
+  if (edge == U0) {
+    return vert_coord_CS_in[k == 0 ? UV003 : NUM_CONTROL_POINTS - 1 - k];
+  }
+  if (edge == V0) {
+    return vert_coord_CS_in[UV003 + k];
+  }
+  return vert_coord_CS_in[UV300 + k];
 }
 
-/// Calculate face tessellation level, using curvature heuristic
-///
-/// Curvature is determines by comparing the interpolated normal
-/// at using barycentric coordaintes from the centers of the nine
-/// subtriangles that make up the control net for rational bezier
-/// triangles
-float curvatureFace(in vec3 N, in float curvature) {
-  // Use a cubic root for a faster curve
-  float factor = pow(1 - clamp(curvature, 0.0, 1.0), 1.0 / 3.0);
-  return mix(
-      TessLevels[MinLevel],
-      TessLevels[MaxLevel],
-      factor);
+/// Screen projection level of an edge
+float screenProjectionEdge(in int edge) {
+  return screenProjectionLevel(
+        edgePoint(edge, 0),
+        edgePoint(edge, 1),
+        edgePoint(edge, 2),
+        edgePoint(edge, 3));
 }
 
-/// Calculate the face tessellation level using the
-/// screen space normal heuristic
-float screenSpaceNormalFace(in vec3 N) {
+/// Normal deviation from the view direction at the patch center, the input
+/// of the screen space normal heuristic
+float screenSpaceNormalFace() {
 
   vec3 v0 = stripWeight(vert_coord_CS_in[UV003]);
   vec3 v1 = stripWeight(vert_coord_CS_in[UV300]);
@@ -316,64 +235,43 @@ float screenSpaceNormalFace(in vec3 N) {
   vec3 vc = (v0+v1+v2)/3.0;
   vec3 vn = normalize(-vc);
 
-  float normalDeviation = calculateCurvature(vn);
-  float factor = pow(1 - clamp(normalDeviation, 0.0, 1.0), 1.0 / 3.0);
-  return mix(
-      TessLevels[MinLevel],
-      TessLevels[MaxLevel],
-      factor);
+  return calculateCurvature(vn);
 }
 
-/// Calculate the edge tessellation level using the screen
-/// projection heuristic
-float screenProjectionEdge(in vec4 v0, in vec4 e0, in vec4 e1, in vec4 v1) {
-  // Project to screen
-  vec2 WH = vec2(Width, Height);
-
-  vec4 vp0 = ProjectionMatrix * vec4(stripWeight(v0), 1.0);
-  vec2 vn0 = (vp0.xy / vp0.w) * WH;
-
-  vec4 ep0 = ProjectionMatrix * vec4(stripWeight(e0), 1.0);
-  vec2 en0 = (ep0.xy / ep0.w) * WH;
-
-  vec4 ep1 = ProjectionMatrix * vec4(stripWeight(e1), 1.0);
-  vec2 en1 = (ep1.xy / ep1.w) * WH;
-
-  vec4 vp1 = ProjectionMatrix * vec4(stripWeight(v1), 1.0);
-  vec2 vn1 = (vp1.xy / vp1.w) * WH;
-
-  // Sum the distance
-  float d = distance(vn0, en0);
-  d += distance(en0, en1);
-  d += distance(en1, vn1);
+/// Takes the maximum of all projected edges
+float screenProjectionFace() {
+  float d0 = screenProjectionEdge(U0);
+  float d1 = screenProjectionEdge(V0);
+  float d2 = screenProjectionEdge(W0);
+  return max(max(d0, d1), d2);
+}
 
-  // Divide by 2 since the distance is doubled
-  return clamp(
-      d / (2 * ProjectionTolerance),
-      TessLevels[MinLevel],
-      TessLevels[MaxLevel]);
+/// Outer level of an edge, from edge_levels.glsl or the EdgeHeuristic
+float edgeLevel(in int edge) {
+  if (SharedEdgeLevels) {
+    return sharedEdgeLevel(edge);
+  }
+  float projection = 0.0;
+  if (usesScreenProjection(EdgeHeuristic)) {
+    projection = screenProjectionEdge(edge);
+  }
+  return edgeHeuristicLevel(
+        invariants[patchNumber()].edgeCurvature[edge],
+        invariants[patchNumber()].edgeDeviation[edge],
+        projection);
 }
 
-/// Takes the maximum of all projected edges
-float screenProjectionFace() {
-  // TODO check for edge heuristic == ScreenProjection
-  // Can take the max from the outer levels instead
-  float d0 = screenProjectionEdge(
-        vert_coord_CS_in[UV003],
-        vert_coord_CS_in[UV012],
-        vert_coord_CS_in[UV021],
-        vert_coord_CS_in[UV030]);
-  float d1 = screenProjectionEdge(
-        vert_coord_CS_in[UV003],
-        vert_coord_CS_in[UV102],
-        vert_coord_CS_in[UV201],
-        vert_coord_CS_in[UV300]);
-  float d2 = screenProjectionEdge(
-        vert_coord_CS_in[UV300],
-        vert_coord_CS_in[UV210],
-        vert_coord_CS_in[UV120],
-        vert_coord_CS_in[UV030]);
-  return floor(max(max(d0, d1), d2));
+/// Inner level of the patch for the FaceHeuristic
+float faceLevel(in float curvature) {
+  float projection = 0.0;
+  if (usesScreenProjection(FaceHeuristic)) {
+    projection = screenProjectionFace();
+  }
+  float normalDeviation = 0.0;
+  if (FaceHeuristic == ScreenSpaceNormal) {
+    normalDeviation = screenSpaceNormalFace();
+  }
+  return faceHeuristicLevel(curvature, projection, normalDeviation);
 }
 
 // =============================================================================
@@ -388,163 +286,16 @@ void main() {
   // Allow only proving vertex to set the tessellation levels and color
   if (gl_InvocationID == 0) {
     patch_color_ES_in = randomColor();
+    patch_number_ES_in = patchNumber();
 
-    // Calculate the vertex and center points in view coordinates
-    vec3 v0 = stripWeight(vert_coord_CS_in[UV003]);
-    vec3 v1 = stripWeight(vert_coord_CS_in[UV300]);
-    vec3 v2 = stripWeight(vert_coord_CS_in[UV030]);
-    vec3 vc = stripWeight(vert_coord_CS_in[UV111]);
-
-    // Calculate the normal of the flat triangle
-    vec3 N  = normalize(cross(normalize(v1 - v0), normalize(v2 - v0)));
-    float curvature = calculateCurvature(N);
+    // Normal deviation from the flat triangle, does not depend on the view
+    float curvature = invariants[patchNumber()].curvature;
     // transform [1, -1] to [0, 1] (0 no curvature, 1 max, can be > 1)
     patch_curvature_ES_in = pow(clamp((1 - curvature), 0.0, 1.0), 1.0 / 3.0);
 
-    // =========================================================================
-    // -- Implementation -------------------------------------------------------
-    // =========================================================================
-
-    // --- Fixed Levels --------------------------------------------------------
-
-    if (EdgeHeuristic == FixedLevels) {
-      gl_TessLevelOuter[U0] = TessLevels[MaxLevel];
-      gl_TessLevelOuter[V0] = TessLevels[MaxLevel];
-      gl_TessLevelOuter[W0] = TessLevels[MaxLevel];
-    }
-    if (FaceHeuristic == FixedLevels) {
-      gl_TessLevelInner[0] = TessLevels[MaxLevel];
-    }
-
-    // -- ScreenSpaceNormal ----------------------------------------------------
-
-    if (EdgeHeuristic == ScreenSpaceNormal) {
-      // TODO: write Edge normal heuristic
-      gl_TessLevelOuter[U0] = 1;
-      gl_TessLevelOuter[V0] = 1;
-      gl_TessLevelOuter[W0] = 1;
-    }
-    if (FaceHeuristic == ScreenSpaceNormal) {
-      gl_TessLevelInner[0] = floor(screenSpaceNormalFace(N));
-    }
-
-    // --- ScreenProjection ----------------------------------------------------
-
-    if (EdgeHeuristic == ScreenProjection) {
-      gl_TessLevelOuter[U0] = floor(screenProjectionEdge(
-                vert_coord_CS_in[UV003],
-                vert_coord_CS_in[UV012],
-                vert_coord_CS_in[UV021],
-                vert_coord_CS_in[UV030]));
-      gl_TessLevelOuter[V0] = floor(screenProjectionEdge(
-                vert_coord_CS_in[UV003],
-                vert_coord_CS_in[UV102],
-                vert_coord_CS_in[UV201],
-                vert_coord_CS_in[UV300]));
-      gl_TessLevelOuter[W0] = floor(screenProjectionEdge(
-                vert_coord_CS_in[UV300],
-                vert_coord_CS_in[UV210],
-                vert_coord_CS_in[UV120],
-                vert_coord_CS_in[UV030]));
-    }
-    if (FaceHeuristic == ScreenProjection) {
-      gl_TessLevelInner[0] = floor(screenProjectionFace());
-    }
-
-    // --- Curvature -----------------------------------------------------------
-
-    if (EdgeHeuristic == Curvature) {
-      gl_TessLevelOuter[U0] = floor(curvatureEdge(
-                vert_coord_CS_in[UV003],
-                vert_coord_CS_in[UV012],
-                vert_coord_CS_in[UV021],
-                vert_coord_CS_in[UV030]));
-      gl_TessLevelOuter[V0] = floor(curvatureEdge(
-                vert_coord_CS_in[UV003],
-                vert_coord_CS_in[UV102],
-                vert_coord_CS_in[UV201],
-                vert_coord_CS_in[UV300]));
-      gl_TessLevelOuter[W0] = floor(curvatureEdge(
-                vert_coord_CS_in[UV300],
-                vert_coord_CS_in[UV210],
-                vert_coord_CS_in[UV120],
-                vert_coord_CS_in[UV030]));
-    }
-    if (FaceHeuristic == Curvature) {
-      gl_TessLevelInner[0] = floor(curvatureFace(N, curvature));
-    }
-
-    // --- MaxDeviation --------------------------------------------------------
-
-    if (EdgeHeuristic == MaxDeviation) {
-      gl_TessLevelOuter[U0] =  floor(maxDeviationEdge(
-                vert_coord_CS_in[UV003],
-                vert_coord_CS_in[UV012],
-                vert_coord_CS_in[UV021],
-                vert_coord_CS_in[UV030]));
-      gl_TessLevelOuter[V0] = floor(maxDeviationEdge(
-                vert_coord_CS_in[UV003],
-                vert_coord_CS_in[UV102],
-                vert_coord_CS_in[UV201],
-                vert_coord_CS_in[UV300]));
-      gl_TessLevelOuter[W0] = floor(maxDeviationEdge(
-                vert_coord_CS_in[UV300],
-                vert_coord_CS_in[UV210],
-                vert_coord_CS_in[UV120],
-                vert_coord_CS_in[UV030]));
-    }
-    if (FaceHeuristic == MaxDeviation) {
-      // TODO: find face MaxDev
-      gl_TessLevelInner[0] = 1;
-    }
-
-    // =========================================================================
-    // -- Combined heuristics --------------------------------------------------
-    // =========================================================================
-
-    // --- min(ScreenProjection,Curvature) -------------------------------------
-
-    if (EdgeHeuristic == MinProjectionCurvature) {
-      gl_TessLevelOuter[U0] = min(
-            floor(curvatureEdge(
-                    vert_coord_CS_in[UV003],
-                    vert_coord_CS_in[UV012],
-                    vert_coord_CS_in[UV021],
-                    vert_coord_CS_in[UV030])),
-            floor(screenProjectionEdge(
-                    vert_coord_CS_in[UV003],
-                    vert_coord_CS_in[UV012],
-                    vert_coord_CS_in[UV021],
-                    vert_coord_CS_in[UV030])));
-      gl_TessLevelOuter[V0] = min(
-            floor(curvatureEdge(
-                    vert_coord_CS_in[UV003],
-                    vert_coord_CS_in[UV102],
-                    vert_coord_CS_in[UV201],
-                    vert_coord_CS_in[UV300])),
-            floor(screenProjectionEdge(
-                    vert_coord_CS_in[UV003],
-                    vert_coord_CS_in[UV102],
-                    vert_coord_CS_in[UV201],
-                    vert_coord_CS_in[UV300])));
-      gl_TessLevelOuter[W0] = min(
-            floor(curvatureEdge(
-                    vert_coord_CS_in[UV300],
-                    vert_coord_CS_in[UV210],
-                    vert_coord_CS_in[UV120],
-                    vert_coord_CS_in[UV030])),
-            floor(screenProjectionEdge(
-                    vert_coord_CS_in[UV300],
-                    vert_coord_CS_in[UV210],
-                    vert_coord_CS_in[UV120],
-                    vert_coord_CS_in[UV030])));
-    }
-    if (FaceHeuristic == MinProjectionCurvature) {
-      gl_TessLevelInner[0] = min(
-            floor(screenProjectionFace()),
-            floor(curvatureFace(N, curvature))
-            );
-    }
-
+    gl_TessLevelOuter[U0] = edgeLevel(U0);
+    gl_TessLevelOuter[V0] = edgeLevel(V0);
+    gl_TessLevelOuter[W0] = edgeLevel(W0);
+    gl_TessLevelInner[0] = faceLevel(curvature);
   }
 }
@@ -28,6 +28,7 @@ layout(triangles, equal_spacing, ccw) in;
 in vec4 vert_coord_ES_in[];
 patch in vec3 patch_color_ES_in;
 patch in float patch_curvature_ES_in;
+patch in uint patch_number_ES_in;
 
 // --- Interpolated outputs ----------------------------------------------------
 
@@ -49,6 +50,9 @@ out float inner_tess_level_GS_in;
 out float outer_tess_level_GS_in;
 out vec3 patch_normal_GS_in;
 
+/// Captured by the tessellation cache, indexes the POWER_BASIS coefficients
+flat out uint patch_number_GS_in;
+
 // =============================================================================
 // -- Uniforms -----------------------------------------------------------------
 // =============================================================================
@@ -115,6 +119,7 @@ void main() {
 
   patch_color_GS_in = patch_color_ES_in;
   patch_curvature_GS_in = patch_curvature_ES_in;
+  patch_number_GS_in = patch_number_ES_in;
 
   inner_tess_level_GS_in = gl_TessLevelInner[0];
   outer_tess_level_GS_in = max(
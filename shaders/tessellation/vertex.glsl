@@ -5,9 +5,12 @@
 // =============================================================================
 
 layout(location = 0) in vec4 vert_coord_VS_in;
+// First patch of the draw, read per instance (see BezierScene::render)
+layout(location = 3) in uint patch_base_VS_in;
 
 out vec4 model_coord_CS_in;
 out vec4 vert_coord_CS_in;
+flat out uint patch_base_CS_in;
 
 // =============================================================================
 // -- Uniforms -----------------------------------------------------------------
@@ -34,4 +37,6 @@ void main() {
   model_coord_CS_in = vert_coord_VS_in;
 
   vert_coord_CS_in = homogeneousCoord;
+
+  patch_base_CS_in = patch_base_VS_in;
 }
@@ -0,0 +1,495 @@
+#include <geom/paralleltessellator.h>
+#include <geom/patchedgetable.h>
+#include <geom/patchsubdivision.h>
+#include <util/beziersceneimporter.h>
+#include <util/binarysceneformat.h>
+#include <util/dirtyrangetracker.h>
+#include <util/meshwriter.h>
+#include <util/pagedsceneformat.h>
+
+#include <QBuffer>
+#include <QDir>
+#include <QTemporaryFile>
+#include <QtTest>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+/*!
+ * \brief The CoreTest class
+ *
+ * QTest suite for the importer, the scene formats and the geometry code.
+ * Every data driven test runs on all scenes in scenes/bezier.
+ */
+class CoreTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+
+    // --- Scene formats -------------------------------------------------------
+
+    void parseModes_data();
+    void parseModes();
+
+    void parallelChunks();
+
+    void binaryRoundTrip_data();
+    void binaryRoundTrip();
+
+    void streamedPaged_data();
+    void streamedPaged();
+
+    // --- Geometry ------------------------------------------------------------
+
+    void subdivisionWatertight();
+
+    void streamedMesh_data();
+    void streamedMesh();
+
+    // --- Utilities -----------------------------------------------------------
+
+    void dirtyRanges();
+
+private:
+
+    void addSceneRows();
+
+};
+
+namespace {
+
+QStringList bundledScenes() {
+    return QDir(SCENE_DIR).entryList(QStringList() << "*.bezier", QDir::Files, QDir::Name);
+}
+
+/// Vertex, normal and face lines of an OBJ file, each in file order
+QByteArray groupObjLines(const QByteArray &obj) {
+    QByteArray groups[3];
+    for (int begin = 0; begin < obj.size();) {
+        int end = obj.indexOf('\n', begin);
+        end = end < 0 ? obj.size() : end + 1;
+        const QByteArray line = obj.mid(begin, end - begin);
+        groups[line.startsWith("vn ") ? 1 : line.startsWith("f ") ? 2 : 0] += line;
+        begin = end;
+    }
+    return groups[0] + groups[1] + groups[2];
+}
+
+/*!
+ * Scene with triangles with and without center points and quads, their
+ * control points anywhere among the earlier vertices. Vertex and patch lines
+ * alternate, so every chunk of a parallel parse holds both and refers back
+ * to the vertices of earlier chunks.
+ */
+QByteArray mixedScene(int numPatches) {
+    quint32 state = 12345;
+    const auto random = [&state](quint32 range) {
+        state = state * 1664525u + 1013904223u;
+        return (state >> 8) % range;
+    };
+
+    QByteArray scene("# Mixed patches\n");
+    char line[256];
+    quint32 numVertices = 0;
+    for (int patch = 0; patch < numPatches; ++patch) {
+        const quint32 newVertices = numVertices < BezierQuad::NUM_CONTROL_POINTS ?
+                    BezierQuad::NUM_CONTROL_POINTS : 1 + random(4);
+        for (quint32 i = 0; i < newVertices; ++i, ++numVertices) {
+            const float w = 0.5f + random(1000) / 1000.0f;
+            const int size = std::snprintf(line, sizeof(line), "v %.6f %.6f %.6f %.6f\n",
+                                           random(20000) / 1000.0f - 10.0f,
+                                           random(20000) / 1000.0f - 10.0f,
+                                           random(20000) / 1000.0f - 10.0f, w);
+            scene.append(line, size);
+        }
+        // Triangles without a center point, with one, and quads
+        const int numPoints = patch % 3 == 0 ? BezierTriangle::NUM_CONTROL_POINTS - 1 :
+                              patch % 3 == 1 ? BezierTriangle::NUM_CONTROL_POINTS :
+                                               BezierQuad::NUM_CONTROL_POINTS;
+        scene.append("p");
+        for (int point = 0; point < numPoints; ++point) {
+            scene.append(' ');
+            scene.append(QByteArray::number(random(numVertices)));
+        }
+        scene.append('\n');
+    }
+    return scene;
+}
+
+/// Control points of every patch of a type as raw bytes, sorted
+QList<QByteArray> sortedPatches(const QVector<QVector4D> &vertices,
+                                const QVector<unsigned> &indices,
+                                int numControlPoints) {
+    QList<QByteArray> patches;
+    for (int first = 0; first < indices.size(); first += numControlPoints) {
+        QByteArray patch;
+        for (int point = 0; point < numControlPoints; ++point) {
+            patch.append(reinterpret_cast<const char *>(&vertices[indices[first + point]]),
+                         sizeof(QVector4D));
+        }
+        patches.append(patch);
+    }
+    std::sort(patches.begin(), patches.end());
+    return patches;
+}
+
+/// Compares the arrays and every patch, so a scene with the same sizes but
+/// other indices or control points is different
+bool isEqual(const BezierSceneData &a, const BezierSceneData &b) {
+    if (a.vertices.size() != b.vertices.size() ||
+            std::memcmp(a.vertices.constData(), b.vertices.constData(),
+                        a.vertices.size() * sizeof(QVector4D)) != 0 ||
+            a.indices != b.indices ||
+            a.quadIndices != b.quadIndices ||
+            a.centerPoints != b.centerPoints ||
+            a.minValues != b.minValues ||
+            a.maxValues != b.maxValues) {
+        return false;
+    }
+    QVector4D pointsA[BezierQuad::NUM_CONTROL_POINTS];
+    QVector4D pointsB[BezierQuad::NUM_CONTROL_POINTS];
+    for (int type = 0; type < BezierPatch::NUM_PATCH_TYPES; ++type) {
+        const BezierPatch::Type patchType = static_cast<BezierPatch::Type>(type);
+        const int numPatches = a.patches.numPatches(patchType);
+        if (numPatches != b.patches.numPatches(patchType)) {
+            return false;
+        }
+        for (int patch = 0; patch < numPatches; ++patch) {
+            a.patches.gatherControlPoints(patchType, patch, pointsA);
+            b.patches.gatherControlPoints(patchType, patch, pointsB);
+            if (std::memcmp(pointsA, pointsB, PatchStore::numControlPoints(patchType) *
+                            sizeof(QVector4D)) != 0) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/*!
+ * Two curved triangles that share the diagonal of the unit square, on the
+ * paraboloid z = x^2 + y^2. Control points on the same lattice point are the
+ * same vertex, like in a scene that shares its vertices.
+ */
+PatchStore curvedSquare() {
+    // Corners of the triangles in lattice units, B003, B300 and B030
+    const int corners[2][3][2] = {
+        {{0, 0}, {3, 0}, {3, 3}},
+        {{0, 0}, {3, 3}, {0, 3}}
+    };
+    const int exponents[BezierTriangle::NUM_CONTROL_POINTS][2] = {
+        {0, 0}, {1, 0}, {2, 0}, {3, 0}, {2, 1}, {1, 2}, {0, 3}, {0, 2}, {0, 1}, {1, 1}
+    };
+
+    QVector<QVector4D> vertices;
+    QVector<unsigned> indices;
+    QHash<int, unsigned> vertexOfLatticePoint;
+    for (const auto &triangle : corners) {
+        for (const auto &exponent : exponents) {
+            const int i = exponent[0];
+            const int j = exponent[1];
+            const int k = 3 - i - j;
+            const int x = (k * triangle[0][0] + i * triangle[1][0] + j * triangle[2][0]) / 3;
+            const int y = (k * triangle[0][1] + i * triangle[1][1] + j * triangle[2][1]) / 3;
+            auto it = vertexOfLatticePoint.find(4 * y + x);
+            if (it == vertexOfLatticePoint.end()) {
+                const float u = x / 3.0f;
+                const float v = y / 3.0f;
+                it = vertexOfLatticePoint.insert(4 * y + x, vertices.size());
+                vertices.append(QVector4D(u, v, u * u + v * v, 1.0f));
+            }
+            indices.append(*it);
+        }
+    }
+    return PatchStore(vertices, indices, QVector<unsigned>());
+}
+
+} // namespace
+
+// -----------------------------------------------------------------------------
+// -- Setup --------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+void CoreTest::addSceneRows() {
+    QTest::addColumn<QString>("fileName");
+    const QStringList scenes = bundledScenes();
+    QVERIFY(!scenes.isEmpty());
+    for (const QString &scene : scenes) {
+        QTest::newRow(qPrintable(scene)) << QDir(SCENE_DIR).filePath(scene);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// -- Scene formats ------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+void CoreTest::parseModes_data() {
+    addSceneRows();
+}
+
+void CoreTest::parseModes() {
+    QFETCH(QString, fileName);
+
+    BezierSceneData textData;
+    QVERIFY(BezierSceneImporter().importBezierSceneData(
+                fileName, textData, BezierSceneImporter::TextStream));
+    QVERIFY(!textData.patches.isEmpty());
+    BezierSceneData mappedData;
+    QVERIFY(BezierSceneImporter().importBezierSceneData(
+                fileName, mappedData, BezierSceneImporter::MemoryMapped));
+    BezierSceneData parallelData;
+    QVERIFY(BezierSceneImporter().importBezierSceneData(
+                fileName, parallelData, BezierSceneImporter::ParallelMemoryMapped));
+
+    // The bundled scenes are below the default chunk size
+    BezierSceneData chunkedData;
+    BezierSceneImporter chunkedImporter;
+    chunkedImporter.setMinChunkSize(256);
+    QVERIFY(chunkedImporter.importBezierSceneData(
+                fileName, chunkedData, BezierSceneImporter::ParallelMemoryMapped));
+
+    QVERIFY2(isEqual(mappedData, textData), "Memory mapped import differs");
+    QVERIFY2(isEqual(parallelData, textData), "Parallel import differs");
+    QVERIFY2(isEqual(chunkedData, textData), "Chunked parallel import differs");
+}
+
+void CoreTest::parallelChunks() {
+    const QByteArray scene = mixedScene(3000);
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    QCOMPARE(file.write(scene), qint64(scene.size()));
+    QVERIFY(file.flush());
+
+    BezierSceneData textData;
+    QVERIFY(BezierSceneImporter().importBezierSceneData(
+                file.fileName(), textData, BezierSceneImporter::TextStream));
+    QCOMPARE(textData.patches.size(), 3000);
+
+    // From chunks of a few lines up to one chunk per thread of the pool,
+    // chunk borders fall between any two lines
+    for (qint64 minChunkSize : {64, 997, 4096, 1 << 16}) {
+        BezierSceneData parallelData;
+        BezierSceneImporter importer;
+        importer.setMinChunkSize(minChunkSize);
+        QVERIFY(importer.importBezierSceneData(
+                    file.fileName(), parallelData, BezierSceneImporter::ParallelMemoryMapped));
+        QVERIFY2(isEqual(parallelData, textData), qPrintable(
+                     QString("Parallel import with chunks of %1 bytes differs").arg(minChunkSize)));
+    }
+}
+
+void CoreTest::binaryRoundTrip_data() {
+    addSceneRows();
+}
+
+void CoreTest::binaryRoundTrip() {
+    QFETCH(QString, fileName);
+
+    BezierSceneData data;
+    QVERIFY(BezierSceneImporter().importBezierSceneData(fileName, data));
+
+    QBuffer buffer;
+    QVERIFY(buffer.open(QIODevice::WriteOnly));
+    QVERIFY(BinarySceneFormat::write(buffer, data));
+    const QByteArray bytes = buffer.data();
+    QVERIFY(BinarySceneFormat::isBinaryScene(bytes.constData(),
+                                             bytes.constData() + bytes.size()));
+
+    // The format stores no patches, they are created like in an import
+    BezierSceneData binaryData;
+    QVERIFY(BinarySceneFormat::read(bytes.constData(), bytes.constData() + bytes.size(),
+                                    binaryData));
+    binaryData.patches = PatchStore(binaryData.vertices, binaryData.indices,
+                                    binaryData.quadIndices);
+    QVERIFY2(isEqual(binaryData, data), "Binary round trip differs");
+
+    // Truncated files are rejected instead of read past the end
+    BezierSceneData truncatedData;
+    QVERIFY(!BinarySceneFormat::read(bytes.constData(),
+                                     bytes.constData() + bytes.size() - 1,
+                                     truncatedData));
+}
+
+void CoreTest::streamedPaged_data() {
+    addSceneRows();
+}
+
+void CoreTest::streamedPaged() {
+    QFETCH(QString, fileName);
+
+    BezierSceneData data;
+    QVERIFY(BezierSceneImporter().importBezierSceneData(fileName, data));
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    const QByteArray source = file.readAll();
+
+    // Few patches per page, so the scenes span several pages
+    const int patchesPerPage = 7;
+    QBuffer buffer;
+    QVERIFY(buffer.open(QIODevice::ReadWrite));
+    QVERIFY(PagedSceneFormat::writeStreamed(buffer, source.constData(),
+                                            source.constData() + source.size(),
+                                            patchesPerPage));
+    PagedSceneFormat::PageTable table;
+    QVERIFY(PagedSceneFormat::readPageTable(buffer, table));
+    QCOMPARE(table.header.numPatches[BezierPatch::TriPatch],
+             quint64(data.patches.numPatches(BezierPatch::TriPatch)));
+    QCOMPARE(table.header.numPatches[BezierPatch::QuadPatch],
+             quint64(data.patches.numPatches(BezierPatch::QuadPatch)));
+    QCOMPARE(table.pages.size(), (data.patches.size() + patchesPerPage - 1) / patchesPerPage);
+
+    // Pages hold every patch once, in another order than the scene
+    QList<QByteArray> pagedPatches[BezierPatch::NUM_PATCH_TYPES];
+    PagedSceneFormat::PageData page;
+    for (const PagedSceneFormat::Page &entry : table.pages) {
+        QVERIFY(PagedSceneFormat::readPage(buffer, entry, page));
+        QVERIFY(page.indices.size() + page.quadIndices.size() > 0);
+        pagedPatches[BezierPatch::TriPatch].append(sortedPatches(
+                    page.vertices, page.indices, BezierTriangle::NUM_CONTROL_POINTS));
+        pagedPatches[BezierPatch::QuadPatch].append(sortedPatches(
+                    page.vertices, page.quadIndices, BezierQuad::NUM_CONTROL_POINTS));
+    }
+    QVector<QVector4D> sceneVertices;
+    QVector<unsigned> sceneIndices[BezierPatch::NUM_PATCH_TYPES];
+    QVector4D controlPoints[BezierQuad::NUM_CONTROL_POINTS];
+    for (int type = 0; type < BezierPatch::NUM_PATCH_TYPES; ++type) {
+        const BezierPatch::Type patchType = static_cast<BezierPatch::Type>(type);
+        for (int patch = 0; patch < data.patches.numPatches(patchType); ++patch) {
+            data.patches.gatherControlPoints(patchType, patch, controlPoints);
+            for (int point = 0; point < PatchStore::numControlPoints(patchType); ++point) {
+                sceneIndices[type].append(sceneVertices.size());
+                sceneVertices.append(controlPoints[point]);
+            }
+        }
+        std::sort(pagedPatches[type].begin(), pagedPatches[type].end());
+        QVERIFY2(pagedPatches[type] == sortedPatches(
+                     sceneVertices, sceneIndices[type], PatchStore::numControlPoints(patchType)),
+                 "Streamed pages differ from the scene");
+    }
+}
+
+// -----------------------------------------------------------------------------
+// -- Geometry -----------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+void CoreTest::subdivisionWatertight() {
+    const PatchStore patches = curvedSquare();
+    PatchEdgeTable edges;
+    edges.build(patches);
+    QCOMPARE(edges.size(), 5);
+    QCOMPARE(edges.numBorderEdges(), 4);
+
+    // Every patch is curved, so both are split to the full depth
+    const int depth = 2;
+    const PatchStore subdivided = PatchSubdivision::subdivide(patches, 0.0f, depth);
+    QCOMPARE(subdivided.numPatches(BezierPatch::TriPatch), 2 * 16);
+
+    // Leaves share their edges, also across the diagonal, only the sides of
+    // the square are left on the border
+    edges.build(subdivided);
+    QCOMPARE(edges.numBorderEdges(), 4 * (1 << depth));
+    QCOMPARE(edges.size(), (3 * 2 * 16 + edges.numBorderEdges()) / 2);
+}
+
+void CoreTest::streamedMesh_data() {
+    addSceneRows();
+}
+
+void CoreTest::streamedMesh() {
+    QFETCH(QString, fileName);
+
+    BezierSceneData data;
+    QVERIFY(BezierSceneImporter().importBezierSceneData(fileName, data));
+
+    // Curvature levels differ per patch, so chunks differ in size
+    TessellationHeuristic::Settings settings;
+    settings.edgeHeuristic = TessellationHeuristic::Curvature;
+    settings.faceHeuristic = TessellationHeuristic::Curvature;
+    settings.maxLevel = 8;
+    const TessellationHeuristic heuristic(settings);
+    const ParallelTessellator tessellator(heuristic);
+    BezierTriangleTessellator::Mesh mesh;
+    tessellator.tessellate(data.patches, mesh);
+    qint64 numVertices = 0;
+    qint64 numTriangles = 0;
+    tessellator.count(data.patches, numVertices, numTriangles);
+    QCOMPARE(numVertices, qint64(mesh.vertices.size()));
+    QCOMPARE(numTriangles, qint64(mesh.numTriangles()));
+
+    // The streamed file is the same as the one of the merged mesh, up to
+    // the order of the OBJ lines
+    for (MeshWriter::Format format : {MeshWriter::Obj, MeshWriter::Ply}) {
+        QBuffer merged;
+        QVERIFY(merged.open(QIODevice::WriteOnly));
+        QVERIFY(format == MeshWriter::Obj ? MeshWriter::writeObj(merged, mesh) :
+                                            MeshWriter::writePly(merged, mesh));
+
+        QBuffer streamed;
+        QVERIFY(streamed.open(QIODevice::WriteOnly));
+        MeshWriter writer(streamed, format);
+        QVERIFY(writer.begin(numVertices, numTriangles));
+        QVERIFY(tessellator.tessellate(data.patches, [&](const BezierTriangleTessellator::Mesh &part) {
+            return writer.append(part);
+        }));
+        QVERIFY(writer.finish());
+        const QByteArray expected = format == MeshWriter::Obj ?
+                    groupObjLines(merged.data()) : merged.data();
+        const QByteArray actual = format == MeshWriter::Obj ?
+                    groupObjLines(streamed.data()) : streamed.data();
+        QVERIFY2(actual == expected, qPrintable(MeshWriter::suffix(format) + " files differ"));
+    }
+}
+
+// -----------------------------------------------------------------------------
+// -- Utilities ----------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+void CoreTest::dirtyRanges() {
+    DirtyRangeTracker tracker;
+    QVERIFY(tracker.isEmpty());
+
+    // Alternating edits of the same elements must not add ranges
+    for (int i = 0; i < 100; ++i) {
+        tracker.markDirty(10);
+        tracker.markDirty(50, 2);
+        tracker.markDirty(30);
+    }
+    // Touches 10 and 50 on either side, joins nothing else
+    tracker.markDirty(11, 19);
+    QVector<DirtyRangeTracker::Range> ranges = tracker.takeRanges();
+    QCOMPARE(ranges.size(), 2);
+    QCOMPARE(ranges[0].begin, 10);
+    QCOMPARE(ranges[0].end, 31);
+    QCOMPARE(ranges[1].begin, 50);
+    QCOMPARE(ranges[1].end, 52);
+    QVERIFY(tracker.isEmpty());
+
+    // A range spanning several others replaces them
+    tracker.markDirty(0);
+    tracker.markDirty(4);
+    tracker.markDirty(8);
+    tracker.markDirty(20);
+    tracker.markDirty(2, 7);
+    ranges = tracker.takeRanges();
+    QCOMPARE(ranges.size(), 3);
+    QCOMPARE(ranges[0].begin, 0);
+    QCOMPARE(ranges[0].end, 1);
+    QCOMPARE(ranges[1].begin, 2);
+    QCOMPARE(ranges[1].end, 9);
+    QCOMPARE(ranges[2].begin, 20);
+
+    // Gaps are only joined when the ranges are taken
+    tracker.markDirty(0);
+    tracker.markDirty(4);
+    tracker.markDirty(100);
+    ranges = tracker.takeRanges(3);
+    QCOMPARE(ranges.size(), 2);
+    QCOMPARE(ranges[0].end, 5);
+    QCOMPARE(ranges[1].begin, 100);
+}
+
+QTEST_GUILESS_MAIN(CoreTest)
+
+#include "coretest.moc"
@@ -0,0 +1,338 @@
+#include <geom/beziertriangletessellator.h>
+#include <geom/tessellationheuristic.h>
+#include <gl/bezierscene.h>
+#include <gl/shadersource.h>
+#include <util/beziersceneimporter.h>
+
+#include <QDir>
+#include <QGuiApplication>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLFunctions_4_5_Core>
+#include <QOpenGLShaderProgram>
+#include <QScopedPointer>
+#include <QSet>
+#include <QtTest>
+
+#include <algorithm>
+#include <limits>
+
+/*!
+ * \brief The ComputeTest class
+ *
+ * Runs the compute shader tessellation on an offscreen context and compares
+ * it with BezierTriangleTessellator, which samples the same grid. With
+ * fixed levels both give the same triangles and the same surface points.
+ *
+ * Also reads back the vertex buffer of an editable scene after an edit, to
+ * check that only the dirty ranges are uploaded.
+ */
+class ComputeTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+
+    void initTestCase();
+
+    void cleanupTestCase();
+
+    // --- Compute tessellation ------------------------------------------------
+
+    void computeTessellation_data();
+    void computeTessellation();
+
+    // --- Editable scenes -----------------------------------------------------
+
+    void editControlPoints_data();
+    void editControlPoints();
+
+private:
+
+    QOpenGLShaderProgram *createProgram(const QStringList &fileNames,
+                                        const QVector<QOpenGLShader::ShaderType> &types);
+
+    void setUniforms(QOpenGLShaderProgram &program);
+
+    QOffscreenSurface _surface;
+
+    QOpenGLContext _context;
+
+    QOpenGLFunctions_4_5_Core *_gl;
+
+    QScopedPointer<QOpenGLShaderProgram> _levelProgram;
+
+    QScopedPointer<QOpenGLShaderProgram> _evaluateProgram;
+
+    QScopedPointer<QOpenGLShaderProgram> _renderProgram;
+
+};
+
+namespace {
+
+/// Fixed level of the test, below the initial size of the compute buffers
+const int LEVEL = 4;
+
+const int FRAMEBUFFER_SIZE = 64;
+
+/// Control points moved by editControlPoints, spread over the scene
+const int NUM_EDITS = 8;
+
+} // namespace
+
+// -----------------------------------------------------------------------------
+// -- Setup --------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+void ComputeTest::initTestCase() {
+    QSurfaceFormat format;
+    format.setVersion(4, 5);
+    format.setProfile(QSurfaceFormat::CoreProfile);
+    _surface.setFormat(format);
+    _surface.create();
+    _context.setFormat(format);
+    if (!_context.create() || _context.format().version() < qMakePair(4, 5) ||
+            !_context.makeCurrent(&_surface)) {
+        QSKIP("No OpenGL 4.5 core context, run with Mesa llvmpipe");
+    }
+    _gl = _context.versionFunctions<QOpenGLFunctions_4_5_Core>();
+    QVERIFY(_gl && _gl->initializeOpenGLFunctions());
+
+    const QString dir = ":/shaders/tessellation/";
+    _levelProgram.reset(createProgram(QStringList() << dir + "compute_levels.glsl",
+                                      {QOpenGLShader::Compute}));
+    _evaluateProgram.reset(createProgram(QStringList() << dir + "compute_evaluate.glsl",
+                                         {QOpenGLShader::Compute}));
+    _renderProgram.reset(createProgram(QStringList() << dir + "compute_vertex.glsl"
+                                       << dir + "geometry.glsl" << dir + "fragment.glsl",
+                                       {QOpenGLShader::Vertex, QOpenGLShader::Geometry,
+                                        QOpenGLShader::Fragment}));
+    QVERIFY(_levelProgram && _evaluateProgram && _renderProgram);
+}
+
+void ComputeTest::cleanupTestCase() {
+    // Programs are released while the context is still current
+    _levelProgram.reset();
+    _evaluateProgram.reset();
+    _renderProgram.reset();
+    _context.doneCurrent();
+}
+
+// -----------------------------------------------------------------------------
+// -- Compute tessellation -----------------------------------------------------
+// -----------------------------------------------------------------------------
+
+void ComputeTest::computeTessellation_data() {
+    QTest::addColumn<QString>("fileName");
+    const QStringList scenes = QDir(SCENE_DIR).entryList(
+                QStringList() << "*.bezier", QDir::Files, QDir::Name);
+    QVERIFY(!scenes.isEmpty());
+    for (const QString &scene : scenes) {
+        QTest::newRow(qPrintable(scene)) << QDir(SCENE_DIR).filePath(scene);
+    }
+}
+
+void ComputeTest::computeTessellation() {
+    QFETCH(QString, fileName);
+
+    BezierSceneData data;
+    QVERIFY(BezierSceneImporter().importBezierSceneData(fileName, data));
+    const int numPatches = data.patches.numPatches(BezierPatch::TriPatch);
+    if (numPatches == 0) {
+        QSKIP("No triangle patches");
+    }
+    const float tolerance = 1e-4f * std::max(1.0f, (data.maxValues - data.minValues).length());
+
+    BezierScene scene;
+    scene.setSceneData(data);
+    setUniforms(*_levelProgram);
+    setUniforms(*_renderProgram);
+    QVERIFY(scene.computeTessellation(*_levelProgram, *_evaluateProgram,
+                                      BezierPatch::TriPatch, "test"));
+    BezierTriangleTessellator::Mesh computed;
+    QVector<unsigned> patchNumbers;
+    QVERIFY(scene.readComputed(BezierPatch::TriPatch, computed, &patchNumbers));
+
+    // Patches are written in any order, so they are compared one by one
+    QVector<QVector<QVector3D>> computedPatches(numPatches);
+    for (int vertex = 0; vertex < computed.vertices.size(); ++vertex) {
+        QVERIFY(patchNumbers[vertex] < unsigned(numPatches));
+        computedPatches[patchNumbers[vertex]].append(computed.vertices[vertex]);
+    }
+
+    BezierTriangleTessellator tessellator;
+    const BezierTriangleTessellator::Levels levels(LEVEL);
+    int numTriangles = 0;
+    QVector4D controlPoints[BezierTriangle::NUM_CONTROL_POINTS];
+    for (int patch = 0; patch < numPatches; ++patch) {
+        BezierTriangleTessellator::Mesh reference;
+        data.patches.gatherControlPoints(BezierPatch::TriPatch, patch, controlPoints);
+        tessellator.tessellate(controlPoints, levels, reference);
+        numTriangles += reference.numTriangles();
+
+        QCOMPARE(computedPatches[patch].size(), reference.vertices.size());
+        for (const QVector3D &point : reference.vertices) {
+            float distance = std::numeric_limits<float>::max();
+            for (const QVector3D &computedPoint : computedPatches[patch]) {
+                distance = std::min(distance, (computedPoint - point).length());
+            }
+            QVERIFY2(distance <= tolerance, qPrintable(
+                         QString("Patch %1 misses a point by %2").arg(patch).arg(distance)));
+        }
+    }
+    QCOMPARE(computed.numTriangles(), numTriangles);
+
+    // The indirect draw of renderComputed draws all of them
+    QOpenGLFramebufferObject framebuffer(FRAMEBUFFER_SIZE, FRAMEBUFFER_SIZE,
+                                         QOpenGLFramebufferObject::Depth);
+    QVERIFY(framebuffer.bind());
+    GLuint query = 0;
+    _gl->glCreateQueries(GL_PRIMITIVES_GENERATED, 1, &query);
+    _renderProgram->bind();
+    _gl->glBeginQuery(GL_PRIMITIVES_GENERATED, query);
+    scene.renderComputed(*_renderProgram, BezierPatch::TriPatch);
+    _gl->glEndQuery(GL_PRIMITIVES_GENERATED);
+    GLuint numPrimitives = 0;
+    _gl->glGetQueryObjectuiv(query, GL_QUERY_RESULT, &numPrimitives);
+    _gl->glDeleteQueries(1, &query);
+    framebuffer.release();
+    QCOMPARE(int(numPrimitives), numTriangles);
+}
+
+// -----------------------------------------------------------------------------
+// -- Editable scenes ----------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+void ComputeTest::editControlPoints_data() {
+    computeTessellation_data();
+}
+
+void ComputeTest::editControlPoints() {
+    QFETCH(QString, fileName);
+
+    BezierSceneData data;
+    QVERIFY(BezierSceneImporter().importBezierSceneData(fileName, data));
+    if (data.patches.numPatches(BezierPatch::TriPatch) == 0) {
+        QSKIP("No triangle patches");
+    }
+    BezierScene scene;
+    scene.setSceneData(data, BezierScene::PersistentBuffers);
+    QVERIFY(scene.isEditable());
+    QVERIFY(scene._mappedVertices);
+
+    // The region the next upload writes is filled with a marker, which stays
+    // where nothing is uploaded
+    const int numVertices = data.vertices.size();
+    const int region = (scene._editRegion + 1) % BezierScene::NUM_EDIT_REGIONS;
+    QVector4D *regionVertices = scene._mappedVertices + region * scene._editRegionStride;
+    const GLintptr regionOffset = sizeof(QVector4D) * GLintptr(region) * scene._editRegionStride;
+    const QVector4D marker(-1234.5f, 1234.5f, -1234.5f, -1.0f);
+    std::fill(regionVertices, regionVertices + numVertices, marker);
+    _gl->glFlushMappedNamedBufferRange(scene._sceneBO, regionOffset,
+                                       sizeof(QVector4D) * numVertices);
+
+    QVector<unsigned> indices;
+    QVector<QVector4D> points;
+    QSet<unsigned> dirty;
+    const int numEdits = std::min(NUM_EDITS, numVertices);
+    for (int i = 0; i < numEdits; ++i) {
+        const unsigned index = unsigned(qint64(i) * numVertices / numEdits);
+        const QVector4D point = scene.getControlPoint(index);
+        indices.append(index);
+        points.append(point + QVector4D(0.1f * point.w(), 0.0f, 0.0f, 0.0f));
+        dirty.insert(index);
+    }
+    // Interpolated center points follow the other points of their triangle
+    QSet<unsigned> centerPoints;
+    for (unsigned index : data.centerPoints) {
+        centerPoints.insert(index);
+    }
+    for (int patch = 0; patch < data.indices.size() / BezierTriangle::NUM_CONTROL_POINTS; ++patch) {
+        const unsigned *patchIndices = data.indices.constData() +
+                patch * BezierTriangle::NUM_CONTROL_POINTS;
+        if (!centerPoints.contains(patchIndices[BezierTriangle::B111])) continue;
+        for (int point = 0; point < BezierTriangle::NUM_CONTROL_POINTS; ++point) {
+            if (point != BezierTriangle::B111 && indices.contains(patchIndices[point])) {
+                dirty.insert(patchIndices[BezierTriangle::B111]);
+            }
+        }
+    }
+    scene.setControlPoints(indices, points);
+
+    // Every draw that reads the control points uploads the edits first
+    setUniforms(*_levelProgram);
+    QVERIFY(scene.computeTessellation(*_levelProgram, *_evaluateProgram,
+                                      BezierPatch::TriPatch, "edit"));
+    QCOMPARE(scene._editRegion, region);
+    _gl->glFinish();
+    QVector<QVector4D> uploaded(numVertices);
+    _gl->glGetNamedBufferSubData(scene._sceneBO, regionOffset,
+                                 sizeof(QVector4D) * numVertices, uploaded.data());
+
+    // Dirty vertices are uploaded, others only in short gaps between them
+    QVector<unsigned> sortedDirty = dirty.values().toVector();
+    std::sort(sortedDirty.begin(), sortedDirty.end());
+    int numUploaded = 0;
+    for (int vertex = 0; vertex < numVertices; ++vertex) {
+        const bool isDirty = dirty.contains(vertex);
+        if (uploaded[vertex] == marker) {
+            QVERIFY2(!isDirty, qPrintable(QString("Vertex %1 was not uploaded").arg(vertex)));
+            continue;
+        }
+        ++numUploaded;
+        QVERIFY(uploaded[vertex] == scene.getControlPoint(vertex));
+        if (!isDirty) {
+            const auto above = std::upper_bound(sortedDirty.constBegin(),
+                                                sortedDirty.constEnd(), unsigned(vertex));
+            QVERIFY2(above != sortedDirty.constBegin() && above != sortedDirty.constEnd() &&
+                     *above - *(above - 1) - 1 <= unsigned(BezierScene::FLUSH_MERGE_GAP),
+                     qPrintable(QString("Vertex %1 was uploaded but not edited").arg(vertex)));
+        }
+    }
+    qInfo() << numUploaded << "of" << numVertices << "vertices uploaded";
+}
+
+// -----------------------------------------------------------------------------
+// -- Other methods ------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+QOpenGLShaderProgram *ComputeTest::createProgram(
+        const QStringList &fileNames,
+        const QVector<QOpenGLShader::ShaderType> &types) {
+    QScopedPointer<QOpenGLShaderProgram> program(new QOpenGLShaderProgram());
+    for (int i = 0; i < fileNames.size(); ++i) {
+        if (!program->addShaderFromSourceCode(types[i], ShaderSource::read(fileNames[i]))) {
+            return nullptr;
+        }
+    }
+    return program->link() ? program.take() : nullptr;
+}
+
+void ComputeTest::setUniforms(QOpenGLShaderProgram &program) {
+    const GLint tessLevels[] = {1, LEVEL};
+    program.bind();
+    program.setUniformValue("ProjectionMatrix", QMatrix4x4());
+    program.setUniformValue("ModelViewMatrix", QMatrix4x4());
+    program.setUniformValueArray("TessLevels", tessLevels, 2);
+    program.setUniformValue("EdgeHeuristic", int(TessellationHeuristic::FixedLevels));
+    program.setUniformValue("FaceHeuristic", int(TessellationHeuristic::FixedLevels));
+    program.setUniformValue("SharedEdgeLevels", false);
+    program.setUniformValue("ProjectionTolerance", 1.0f);
+    program.setUniformValue("DeviationTolerance", 1.0f);
+    program.setUniformValue("ModelViewScale", 1.0f);
+    program.setUniformValue("Width", FRAMEBUFFER_SIZE);
+    program.setUniformValue("Height", FRAMEBUFFER_SIZE);
+}
+
+int main(int argc, char *argv[]) {
+    // Mesa picks llvmpipe, so the results do not depend on the GPU
+    if (!qEnvironmentVariableIsSet("LIBGL_ALWAYS_SOFTWARE")) {
+        qputenv("LIBGL_ALWAYS_SOFTWARE", "1");
+    }
+    QGuiApplication app(argc, argv);
+    ComputeTest test;
+    return QTest::qExec(&test, argc, argv);
+}
+
+#include "computetest.moc"
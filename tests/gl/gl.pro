@@ -0,0 +1,27 @@
+#-------------------------------------------------
+#
+# OpenGL tests, compares the compute shader tessellation with the CPU
+# tessellator on the scenes in scenes/bezier
+#
+# Needs no GPU, the context is created on an offscreen surface with Mesa
+# llvmpipe, e.g.   QT_QPA_PLATFORM=offscreen ./gltests
+# Tests are skipped if no OpenGL 4.5 core context can be created.
+#
+#-------------------------------------------------
+
+QT       += core gui testlib
+
+TARGET = gltests
+TEMPLATE = app
+
+CONFIG += console testcase
+CONFIG -= app_bundle
+
+DEFINES += QT_DEPRECATED_WARNINGS
+DEFINES += SCENE_DIR=\\\"$$PWD/../../scenes/bezier\\\"
+
+include(../../core.pri)
+
+SOURCES += computetest.cpp
+
+RESOURCES += ../../resources.qrc
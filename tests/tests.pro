@@ -0,0 +1,22 @@
+#-------------------------------------------------
+#
+# Unit tests for the importer, the scene formats and the geometry code
+#
+# Run with `make check` or ./tests, scenes are read from scenes/bezier
+#
+#-------------------------------------------------
+
+QT       += core gui testlib
+
+TARGET = tests
+TEMPLATE = app
+
+CONFIG += console testcase
+CONFIG -= app_bundle
+
+DEFINES += QT_DEPRECATED_WARNINGS
+DEFINES += SCENE_DIR=\\\"$$PWD/../scenes/bezier\\\"
+
+include(../core.pri)
+
+SOURCES += coretest.cpp
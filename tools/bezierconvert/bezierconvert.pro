@@ -0,0 +1,19 @@
+#-------------------------------------------------
+#
+# Converts .bezier scenes to the binary scene format
+#
+#-------------------------------------------------
+
+QT       += core gui
+
+TARGET = bezierconvert
+TEMPLATE = app
+
+CONFIG += console
+CONFIG -= app_bundle
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+include(../../core.pri)
+
+SOURCES += main.cpp
@@ -0,0 +1,245 @@
+#include <util/beziersceneimporter.h>
+#include <util/binarysceneformat.h>
+#include <util/pagedsceneformat.h>
+
+#include <QBuffer>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QFileInfo>
+#include <QtDebug>
+
+#include <cstring>
+
+namespace {
+
+bool isEqual(const BezierSceneData &a, const BezierSceneData &b) {
+    return a.vertices.size() == b.vertices.size() &&
+            std::memcmp(a.vertices.constData(), b.vertices.constData(),
+                        a.vertices.size() * sizeof(QVector4D)) == 0 &&
+            a.indices == b.indices &&
+            a.quadIndices == b.quadIndices &&
+            a.centerPoints == b.centerPoints &&
+            a.minValues == b.minValues &&
+            a.maxValues == b.maxValues &&
+            a.patches.numPatches(BezierPatch::TriPatch) ==
+            b.patches.numPatches(BezierPatch::TriPatch) &&
+            a.patches.numPatches(BezierPatch::QuadPatch) ==
+            b.patches.numPatches(BezierPatch::QuadPatch);
+}
+
+/// Checks that all parse modes and a binary round trip give the same scene
+bool verify(const QString &fileName,
+            const BezierSceneData &data,
+            float tolerance,
+            int maxDepth) {
+    BezierSceneData textData;
+    BezierSceneImporter textImporter;
+    textImporter.setPreSubdivision(tolerance, maxDepth);
+    textImporter.importBezierSceneData(fileName, textData, BezierSceneImporter::TextStream);
+    BezierSceneData mappedData;
+    BezierSceneImporter mappedImporter;
+    mappedImporter.setPreSubdivision(tolerance, maxDepth);
+    mappedImporter.importBezierSceneData(fileName, mappedData, BezierSceneImporter::MemoryMapped);
+
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    BezierSceneData binaryData;
+    const bool roundTrip = BinarySceneFormat::write(buffer, data) &&
+            BinarySceneFormat::read(buffer.data().constData(),
+                                    buffer.data().constData() + buffer.data().size(),
+                                    binaryData);
+    // Patches are not stored, they are created from the arrays like an import
+    binaryData.patches = PatchStore(binaryData.vertices, binaryData.indices,
+                                    binaryData.quadIndices);
+
+    bool success = true;
+    if (!isEqual(textData, data) || !isEqual(mappedData, data)) {
+        qCritical() << "Parse modes differ for" << fileName;
+        success = false;
+    }
+    if (!roundTrip || !isEqual(binaryData, data)) {
+        qCritical() << "Binary round trip failed for" << fileName;
+        success = false;
+    }
+    return success;
+}
+
+/// Checks that the pages hold every patch once, in the order of the leaves
+/// of the hierarchy, with the same control points
+bool verifyPaged(const QString &fileName,
+                 const BezierSceneData &data,
+                 int patchesPerPage) {
+    QBuffer buffer;
+    buffer.open(QIODevice::ReadWrite);
+    PagedSceneFormat::PageTable table;
+    bool success = PagedSceneFormat::write(buffer, data, patchesPerPage) &&
+            PagedSceneFormat::readPageTable(buffer, table);
+
+    QVector<QVector4D> pagedPoints[BezierPatch::NUM_PATCH_TYPES];
+    PagedSceneFormat::PageData page;
+    for (int i = 0; success && i < table.pages.size(); ++i) {
+        success = PagedSceneFormat::readPage(buffer, table.pages[i], page);
+        for (unsigned index : page.indices) {
+            pagedPoints[BezierPatch::TriPatch].push_back(page.vertices[index]);
+        }
+        for (unsigned index : page.quadIndices) {
+            pagedPoints[BezierPatch::QuadPatch].push_back(page.vertices[index]);
+        }
+    }
+
+    const PatchStore &patches = data.patches;
+    const int numPatches = patches.size();
+    const bool hasBVH = data.bvh.numPatches() == numPatches && numPatches > 0;
+    QVector<QVector4D> scenePoints[BezierPatch::NUM_PATCH_TYPES];
+    QVector4D controlPoints[BezierQuad::NUM_CONTROL_POINTS];
+    for (int i = 0; i < numPatches; ++i) {
+        const int patch = hasBVH ? data.bvh.leafPatch(numPatches - 1 + i) : i;
+        const BezierPatch::Type type = patches.patchType(patch);
+        patches.gatherControlPoints(type, patch - patches.firstPatch(type), controlPoints);
+        for (int point = 0; point < PatchStore::numControlPoints(type); ++point) {
+            scenePoints[type].push_back(controlPoints[point]);
+        }
+    }
+
+    if (!success ||
+            pagedPoints[BezierPatch::TriPatch] != scenePoints[BezierPatch::TriPatch] ||
+            pagedPoints[BezierPatch::QuadPatch] != scenePoints[BezierPatch::QuadPatch]) {
+        qCritical() << "Paged round trip failed for" << fileName;
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("bezierconvert");
+
+    qSetMessagePattern("%{if-debug}D%{endif}%{if-info}I%{endif}%{if-warning}W%{endif}%{if-critical}C%{endif}%{if-fatal}F%{endif}] %{message}");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Converts .bezier scenes to the binary or paged scene format");
+    parser.addHelpOption();
+    parser.addPositionalArgument("scenes", "The .bezier files to convert.", "scenes...");
+    QCommandLineOption outputOption(
+                QStringList() << "o" << "output",
+                "Output directory, defaults to the directory of each scene.",
+                "directory");
+    parser.addOption(outputOption);
+    QCommandLineOption verifyOption(
+                "verify",
+                "Check that the binary scene round trips to the parsed scene.");
+    parser.addOption(verifyOption);
+    QCommandLineOption dryRunOption(
+                QStringList() << "n" << "dry-run",
+                "Do not write any files (useful with --verify).");
+    parser.addOption(dryRunOption);
+    QCommandLineOption subdivideOption(
+                "subdivide",
+                "Split triangles until their relative flatness is below the tolerance.",
+                "tolerance");
+    parser.addOption(subdivideOption);
+    QCommandLineOption depthOption(
+                "max-depth",
+                "Maximum number of times a triangle is split (default 5).",
+                "depth",
+                "5");
+    parser.addOption(depthOption);
+    QCommandLineOption pagedOption(
+                "paged",
+                "Write out-of-core .bezierpaged scenes instead, streamed in while drawing. "
+                "Without --verify and --subdivide the scene is paged without importing it.");
+    parser.addOption(pagedOption);
+    QCommandLineOption pagePatchesOption(
+                "page-patches",
+                QString("Patches per page of a paged scene (default %1).")
+                .arg(PagedSceneFormat::DEFAULT_PAGE_PATCHES),
+                "patches",
+                QString::number(PagedSceneFormat::DEFAULT_PAGE_PATCHES));
+    parser.addOption(pagePatchesOption);
+    parser.process(app);
+
+    const QStringList fileNames = parser.positionalArguments();
+    if (fileNames.isEmpty()) {
+        parser.showHelp(1);
+    }
+
+    const float tolerance = parser.isSet(subdivideOption) ?
+                parser.value(subdivideOption).toFloat() : 0.0f;
+    const int maxDepth = parser.value(depthOption).toInt();
+    const bool paged = parser.isSet(pagedOption);
+    const int pagePatches = parser.value(pagePatchesOption).toInt();
+    if (paged && pagePatches <= 0) {
+        qCritical() << "Invalid number of patches per page:" << parser.value(pagePatchesOption);
+        return 1;
+    }
+
+    // Pre-subdivision and verification need the imported scene
+    const bool streamPaged = paged && !parser.isSet(verifyOption) &&
+            !parser.isSet(subdivideOption) && !parser.isSet(dryRunOption);
+
+    int numFailed = 0;
+    for (const QString &fileName : fileNames) {
+        const QFileInfo info(fileName);
+        const QDir outputDir(parser.isSet(outputOption) ?
+                                 parser.value(outputOption) : info.absolutePath());
+        const QString outputName = outputDir.filePath(
+                    info.completeBaseName() + (paged ? ".bezierpaged" : ".bezierbin"));
+
+        if (streamPaged) {
+            QFile fin(outputName);
+            PagedSceneFormat::PageTable table;
+            if (!PagedSceneFormat::writeStreamed(outputName, fileName, pagePatches) ||
+                    !fin.open(QIODevice::ReadOnly) ||
+                    !PagedSceneFormat::readPageTable(fin, table)) {
+                ++numFailed;
+                continue;
+            }
+            qInfo() << fileName << "->" << outputName
+                    << table.header.numPatches[BezierPatch::TriPatch] +
+                       table.header.numPatches[BezierPatch::QuadPatch] << "patches"
+                    << table.pages.size() << "pages";
+            continue;
+        }
+
+        BezierSceneData data;
+        BezierSceneImporter importer;
+        importer.setPreSubdivision(tolerance, maxDepth);
+        if (!importer.importBezierSceneData(
+                    fileName, data, BezierSceneImporter::ParallelMemoryMapped)) {
+            ++numFailed;
+            continue;
+        }
+        if (parser.isSet(verifyOption) &&
+                (!verify(fileName, data, tolerance, maxDepth) ||
+                 (paged && !verifyPaged(fileName, data, pagePatches)))) {
+            ++numFailed;
+            continue;
+        }
+        if (parser.isSet(dryRunOption)) {
+            continue;
+        }
+
+        const bool written = paged ?
+                    PagedSceneFormat::write(outputName, data, pagePatches) :
+                    BinarySceneFormat::write(outputName, data);
+        if (!written) {
+            ++numFailed;
+            continue;
+        }
+        qInfo() << fileName << "->" << outputName
+                << data.vertices.size() << "vertices"
+                << data.patches.size() << "patches"
+                << data.edgeTable.size() << "edges"
+                << data.edgeTable.numBorderEdges() << "on the border";
+    }
+
+    if (numFailed > 0) {
+        qCritical() << numFailed << "of" << fileNames.size() << "scenes failed";
+        return 1;
+    }
+    return 0;
+}
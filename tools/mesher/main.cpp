@@ -0,0 +1,359 @@
+#include <geom/beziertriangletessellator.h>
+#include <geom/paralleltessellator.h>
+#include <geom/tessellationheuristic.h>
+#include <util/beziersceneimporter.h>
+#include <util/meshwriter.h>
+#include <util/profiler.h>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QTextStream>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <QtDebug>
+
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+struct MesherOptions {
+    TessellationHeuristic::Settings settings;
+    MeshWriter::Format format;
+    QString outputDirectory;
+    BezierSceneImporter::ParseMode parseMode;
+    bool dryRun;
+};
+
+struct SceneResult {
+    QString fileName;
+    QString outputName;
+    bool success;
+    int numPatches;
+    qint64 numVertices;
+    qint64 numTriangles;
+    qint64 loadTime;
+    qint64 tessellateTime;
+    qint64 writeTime;
+};
+
+/// Peak resident set size of the process in bytes, -1 if unknown
+qint64 peakMemory() {
+#ifdef Q_OS_UNIX
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef Q_OS_MACOS
+        return usage.ru_maxrss;
+#else
+        return static_cast<qint64>(usage.ru_maxrss) * 1024;
+#endif
+    }
+#endif
+    return -1;
+}
+
+/// Same camera as MainView without any user interaction
+void setDefaultCamera(TessellationHeuristic::Settings &settings,
+                      const QMatrix4x4 &modelMatrix) {
+    QMatrix4x4 view;
+    view.translate(0, 0, -1.0);
+    settings.modelViewMatrix = view * modelMatrix;
+
+    const double aspect = static_cast<double>(settings.width) /
+            static_cast<double>(settings.height);
+    settings.projectionMatrix.setToIdentity();
+    settings.projectionMatrix.perspective(60, aspect, 0.1, 100);
+}
+
+class MeshScene
+{
+public:
+    typedef SceneResult result_type;
+
+    explicit MeshScene(const MesherOptions &options) :
+        _options(options) {}
+
+    SceneResult operator()(const QString &fileName) const {
+        SceneResult result;
+        result.fileName = fileName;
+        result.success = false;
+        result.numPatches = result.numVertices = result.numTriangles = 0;
+        result.loadTime = result.tessellateTime = result.writeTime = 0;
+
+        QElapsedTimer timer;
+        timer.start();
+
+        BezierSceneData data;
+        BezierSceneImporter importer;
+        if (!importer.importBezierSceneData(fileName, data, _options.parseMode)) {
+            return result;
+        }
+        result.numPatches = data.patches.size();
+        result.loadTime = timer.restart();
+        if (data.patches.numPatches(BezierPatch::QuadPatch) > 0) {
+            // The CPU tessellator and heuristics only handle triangles
+            qWarning().noquote() << fileName << "skipping"
+                                 << data.patches.numPatches(BezierPatch::QuadPatch)
+                                 << "quad patches";
+        }
+
+        TessellationHeuristic::Settings settings = _options.settings;
+        setDefaultCamera(settings, data.modelMatrix);
+        const TessellationHeuristic heuristic(settings);
+
+        // Uses the threads the other scenes leave idle. The mesh is
+        // streamed to the file, only a few chunks are in memory at a time.
+        const ParallelTessellator tessellator(heuristic);
+        qint64 numVertices = 0;
+        qint64 numTriangles = 0;
+        tessellator.count(data.patches, numVertices, numTriangles);
+        result.numVertices = numVertices;
+        result.numTriangles = numTriangles;
+
+        if (_options.dryRun) {
+            ScopedTimer tessellateTimer("Tessellate");
+            tessellator.tessellate(data.patches, [](const BezierTriangleTessellator::Mesh &) {
+                return true;
+            });
+            result.tessellateTime = timer.restart();
+        } else {
+            const QFileInfo info(fileName);
+            const QDir outputDir(_options.outputDirectory.isEmpty() ?
+                                     info.absolutePath() : _options.outputDirectory);
+            result.outputName = outputDir.filePath(
+                        info.completeBaseName() + "." + MeshWriter::suffix(_options.format));
+            QSaveFile file(result.outputName);
+            if (!file.open(QIODevice::WriteOnly)) {
+                qWarning() << "Could not open" << result.outputName << "for writing:"
+                           << file.errorString();
+                return result;
+            }
+
+            ScopedTimer writeTimer("Tessellate and write mesh");
+            MeshWriter writer(file, _options.format);
+            QElapsedTimer writeTime;
+            const auto append = [&](const BezierTriangleTessellator::Mesh &part) {
+                writeTime.start();
+                const bool written = writer.append(part);
+                result.writeTime += writeTime.elapsed();
+                return written;
+            };
+            const bool success = writer.begin(numVertices, numTriangles) &&
+                    tessellator.tessellate(data.patches, append) && writer.finish();
+            if (!success || !file.commit()) {
+                qWarning() << "Could not write" << result.outputName << ":" << file.errorString();
+                return result;
+            }
+            result.tessellateTime = timer.restart() - result.writeTime;
+        }
+        result.success = true;
+        return result;
+    }
+
+private:
+    MesherOptions _options;
+};
+
+/// Expands directories to the scenes they contain
+QStringList collectScenes(const QStringList &paths) {
+    QStringList fileNames;
+    for (const QString &path : paths) {
+        const QFileInfo info(path);
+        if (info.isDir()) {
+            const QDir dir(path);
+            const QStringList entries = dir.entryList(
+                        QStringList() << "*.bezier" << "*.bezierbin",
+                        QDir::Files, QDir::Name);
+            for (const QString &entry : entries) {
+                fileNames << dir.filePath(entry);
+            }
+        } else {
+            fileNames << path;
+        }
+    }
+    return fileNames;
+}
+
+bool parseHeuristic(const QString &value, TessellationHeuristic::Heuristic &heuristic) {
+    bool ok = false;
+    heuristic = TessellationHeuristic::fromName(value, &ok);
+    if (!ok) {
+        qCritical() << "Unknown heuristic" << value;
+    }
+    return ok;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("mesher");
+
+    qSetMessagePattern("%{if-debug}D%{endif}%{if-info}I%{endif}%{if-warning}W%{endif}%{if-critical}C%{endif}%{if-fatal}F%{endif}] %{message}");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+                "Tessellates .bezier scenes on the CPU and writes the meshes as OBJ or PLY");
+    parser.addHelpOption();
+    parser.addPositionalArgument("scenes", "Scene files or directories with scenes.", "scenes...");
+
+    QCommandLineOption outputOption(
+                QStringList() << "o" << "output",
+                "Output directory, defaults to the directory of each scene.",
+                "directory");
+    QCommandLineOption formatOption(
+                QStringList() << "f" << "format",
+                "Mesh format: obj or ply (default).",
+                "format", "ply");
+    QCommandLineOption edgeOption(
+                "edge-heuristic",
+                "Edge heuristic, name or number as in the GUI (default FixedLevels).",
+                "heuristic", "FixedLevels");
+    QCommandLineOption faceOption(
+                "face-heuristic",
+                "Face heuristic, name or number as in the GUI (default FixedLevels).",
+                "heuristic", "FixedLevels");
+    QCommandLineOption minLevelOption("min-level", "Minimum tessellation level.", "level", "1");
+    QCommandLineOption maxLevelOption("max-level", "Maximum tessellation level.", "level", "8");
+    QCommandLineOption projectionOption(
+                "projection-tolerance", "Screen projection tolerance in pixels.",
+                "tolerance", "1.0");
+    QCommandLineOption deviationOption(
+                "deviation-tolerance", "Maximum deviation tolerance.",
+                "tolerance", "1.0");
+    QCommandLineOption sizeOption(
+                "size", "Viewport used by the screen space heuristics.",
+                "WxH", "1024x768");
+    QCommandLineOption jobsOption(
+                QStringList() << "j" << "jobs",
+                "Number of scenes processed in parallel, defaults to the number of cores.",
+                "jobs");
+    QCommandLineOption statsOption(
+                "stats", "Write per scene statistics as CSV to this file.", "file");
+    QCommandLineOption traceOption(
+                "trace", "Write the import and tessellation timings as a Chrome trace.",
+                "file");
+    QCommandLineOption dryRunOption(
+                QStringList() << "n" << "dry-run",
+                "Tessellate, but do not write any meshes.");
+
+    parser.addOptions(QList<QCommandLineOption>()
+                      << outputOption << formatOption << edgeOption << faceOption
+                      << minLevelOption << maxLevelOption
+                      << projectionOption << deviationOption << sizeOption
+                      << jobsOption << statsOption << traceOption << dryRunOption);
+    parser.process(app);
+
+    const QStringList fileNames = collectScenes(parser.positionalArguments());
+    if (fileNames.isEmpty()) {
+        parser.showHelp(1);
+    }
+
+    MesherOptions options;
+    TessellationHeuristic::Settings &settings = options.settings;
+    if (!parseHeuristic(parser.value(edgeOption), settings.edgeHeuristic) ||
+            !parseHeuristic(parser.value(faceOption), settings.faceHeuristic)) {
+        return 1;
+    }
+    settings.minLevel = qBound(1, parser.value(minLevelOption).toInt(),
+                               static_cast<int>(BezierTriangleTessellator::MAX_TESS_LEVEL));
+    settings.maxLevel = qBound(settings.minLevel, parser.value(maxLevelOption).toInt(),
+                               static_cast<int>(BezierTriangleTessellator::MAX_TESS_LEVEL));
+    settings.projectionTolerance = parser.value(projectionOption).toFloat();
+    settings.deviationTolerance = parser.value(deviationOption).toFloat();
+    const QStringList size = parser.value(sizeOption).split('x');
+    if (size.size() != 2 || size[0].toInt() <= 0 || size[1].toInt() <= 0) {
+        qCritical() << "Invalid viewport size" << parser.value(sizeOption);
+        return 1;
+    }
+    settings.width = size[0].toInt();
+    settings.height = size[1].toInt();
+
+    const QString format = parser.value(formatOption).toLower();
+    if (format != "obj" && format != "ply") {
+        qCritical() << "Unknown mesh format" << format;
+        return 1;
+    }
+    options.format = format == "obj" ? MeshWriter::Obj : MeshWriter::Ply;
+    options.outputDirectory = parser.value(outputOption);
+    options.dryRun = parser.isSet(dryRunOption);
+
+    if (parser.isSet(jobsOption)) {
+        QThreadPool::globalInstance()->setMaxThreadCount(
+                    qMax(1, parser.value(jobsOption).toInt()));
+    }
+    // Parallelize within a scene only when there is nothing else to do
+    options.parseMode = fileNames.size() > 1 ?
+                BezierSceneImporter::MemoryMapped :
+                BezierSceneImporter::ParallelMemoryMapped;
+
+    QElapsedTimer timer;
+    timer.start();
+    const QVector<SceneResult> results =
+            QtConcurrent::blockingMapped<QVector<SceneResult>>(fileNames, MeshScene(options));
+    const qint64 totalTime = timer.elapsed();
+
+    QFile statsFile;
+    QTextStream stats;
+    if (parser.isSet(statsOption)) {
+        statsFile.setFileName(parser.value(statsOption));
+        if (!statsFile.open(QIODevice::WriteOnly | QIODevice::Text)) {
+            qCritical() << "Could not open" << statsFile.fileName();
+            return 1;
+        }
+        stats.setDevice(&statsFile);
+        stats << "scene,success,patches,vertices,triangles,load_ms,tessellate_ms,write_ms\n";
+    }
+
+    int numFailed = 0;
+    qint64 numTriangles = 0;
+    for (const SceneResult &result : results) {
+        if (!result.success) {
+            ++numFailed;
+        }
+        numTriangles += result.numTriangles;
+        qInfo().noquote() << result.fileName
+                          << (result.success ? "->" : "FAILED")
+                          << result.outputName
+                          << result.numPatches << "patches"
+                          << result.numTriangles << "triangles"
+                          << "load" << result.loadTime << "ms"
+                          << "tessellate" << result.tessellateTime << "ms"
+                          << "write" << result.writeTime << "ms";
+        if (stats.device()) {
+            stats << result.fileName << ','
+                  << (result.success ? 1 : 0) << ','
+                  << result.numPatches << ','
+                  << result.numVertices << ','
+                  << result.numTriangles << ','
+                  << result.loadTime << ','
+                  << result.tessellateTime << ','
+                  << result.writeTime << '\n';
+        }
+    }
+
+    const qint64 peak = peakMemory();
+    qInfo().noquote() << results.size() << "scenes"
+                      << numTriangles << "triangles"
+                      << "in" << totalTime << "ms,"
+                      << "peak memory"
+                      << (peak < 0 ? QString("unknown") :
+                                     QString::number(peak / (1024 * 1024)) + " MiB");
+
+    if (parser.isSet(traceOption) &&
+            !Profiler::instance().writeChromeTrace(parser.value(traceOption))) {
+        return 1;
+    }
+    if (numFailed > 0) {
+        qCritical() << numFailed << "of" << results.size() << "scenes failed";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,19 @@
+#-------------------------------------------------
+#
+# Headless mesher, tessellates .bezier scenes on the CPU
+#
+#-------------------------------------------------
+
+QT       += core gui
+
+TARGET = mesher
+TEMPLATE = app
+
+CONFIG += console
+CONFIG -= app_bundle
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+include(../../core.pri)
+
+SOURCES += main.cpp
@@ -1,11 +1,39 @@
 #include <ui/mainview.h>
 
+#include <gl/shadersource.h>
 #include <util/beziersceneimporter.h>
+#include <util/profiler.h>
 
+#include <QtConcurrent>
 #include <QtDebug>
+#include <QFutureWatcher>
 #include <QImage>
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <limits>
+
+namespace {
+
+/// Milliseconds between polls of the query ring while idle
+const int STATS_POLL_INTERVAL = 20;
+
+const char STATS_LOG_HEADER[] =
+        "frame,edge_heuristic,face_heuristic,min_level,max_level,"
+        "projection_tolerance,cull_flags,faces_primitives,faces_ms,"
+        "wireframe_primitives,wireframe_ms,compute_primitives,compute_ms\n";
+
+/// Relative flatness and depth of the optional pre-subdivision
+const float SUBDIVISION_TOLERANCE = 0.1f;
+const int SUBDIVISION_DEPTH = 5;
+
+const BezierPatch::Type PATCH_TYPES[] = {
+    BezierPatch::TriPatch,
+    BezierPatch::QuadPatch
+};
+
+} // namespace
 
 // =============================================================================
 // -- Constructors and destructor ----------------------------------------------
@@ -15,19 +43,44 @@ MainView::MainView(QWidget *parent) :
     QOpenGLWidget(parent),
     _xRot(0),
     _yRot(0),
+    _selectedPatch(-1),
     _scale(1.0),
     _currentMouseState(MouseState::None),
     _drawFaces(true),
     _drawWireframe(false),
+    _singlePassWireframe(true),
     _currentDrawingMode(0),
     _edgeHeuristic(0),
     _faceHeuristic(0),
     _minTessLevel(1),
     _maxTessLevel(8),
-    _projectionTolerance(1.0f){}
+    _projectionTolerance(1.0f),
+    _cullFlags(PatchCuller::CullFrustum),
+    _preSubdivision(false),
+    _sharedEdgeLevels(false),
+    _computeTessellation(false),
+    _tessellationCache(true),
+    _powerBasis(false),
+    _lod(true),
+    _editControlPoints(false),
+    _dragDepth(0.0f)
+{
+    qRegisterMetaType<FrameStats>("FrameStats");
+    std::fill(_isCached, _isCached + BezierPatch::NUM_PATCH_TYPES, false);
+
+    _statsTimer.setSingleShot(true);
+    _statsTimer.setInterval(STATS_POLL_INTERVAL);
+    connect(&_statsTimer, SIGNAL(timeout()), this, SLOT(collectPendingStats()));
+}
 
 MainView::~MainView() {
-    glDeleteQueries(1, &_primitiveQuery);
+    if (_loadCancelFlag) {
+        _loadCancelFlag->storeRelease(1);
+    }
+    makeCurrent();
+    _scene.clear();
+    _queryRing.destroy();
+    doneCurrent();
 }
 
 // =============================================================================
@@ -38,7 +91,14 @@ void MainView::mousePressEvent(QMouseEvent *event) {
 
     switch(event->button()) {
     case Qt::LeftButton:
-        _currentMouseState = MouseState::Rotate;
+        // Ctrl drags the nearest control point of a patch, Ctrl+Shift all
+        // control points of the patch
+        if ((event->modifiers() & Qt::ControlModifier) &&
+                startDrag(event->x(), event->y(), event->modifiers() & Qt::ShiftModifier)) {
+            _currentMouseState = MouseState::DragControlPoints;
+        } else {
+            _currentMouseState = MouseState::Rotate;
+        }
         break;
     case Qt::RightButton:
         _currentMouseState = MouseState::Translate;
@@ -48,6 +108,8 @@ void MainView::mousePressEvent(QMouseEvent *event) {
     }
     _lastX = event->x();
     _lastY = event->y();
+    _pressX = event->x();
+    _pressY = event->y();
 
     this->setFocus();
     update();
@@ -68,6 +130,9 @@ void MainView::mouseMoveEvent(QMouseEvent *event) {
         _rotationMatrix = rotationMatrix * _rotationMatrix;
     }
         break;
+    case MouseState::DragControlPoints:
+        dragControlPoints(event->x(), event->y());
+        break;
     default:
         // Do nothing
         break;
@@ -75,6 +140,16 @@ void MainView::mouseMoveEvent(QMouseEvent *event) {
     update();
 }
 
+void MainView::mouseReleaseEvent(QMouseEvent *event) {
+    if (event->button() == Qt::LeftButton &&
+            _currentMouseState != MouseState::DragControlPoints &&
+            event->x() == _pressX && event->y() == _pressY) {
+        pickPatch(event->x(), event->y());
+    }
+    _currentMouseState = MouseState::None;
+    update();
+}
+
 void MainView::wheelEvent(QWheelEvent *event) {
     if (event->delta() > 0) {
         _scale += 0.05;
@@ -94,6 +169,60 @@ void MainView::keyReleaseEvent(QKeyEvent *event) {
         img.save("test.png");
     }
         break;
+    case Qt::Key_W:
+        // Compare against the old two pass wireframe
+        _singlePassWireframe = !_singlePassWireframe;
+        qDebug() << "Single pass wireframe:" << _singlePassWireframe;
+        break;
+    case Qt::Key_L:
+        setStatsLogFile(_statsLog.isOpen() ? QString() : QString("frame_stats.csv"));
+        break;
+    case Qt::Key_C:
+        setCullFlags(_cullFlags ^ PatchCuller::CullFrustum);
+        break;
+    case Qt::Key_B:
+        setCullFlags(_cullFlags ^ PatchCuller::CullBackPatches);
+        break;
+    case Qt::Key_D:
+        // Reload the scene with strongly curved patches split on the CPU
+        _preSubdivision = !_preSubdivision;
+        qDebug() << "Pre-subdivision:" << _preSubdivision;
+        loadSceneAsync(_sceneFileName);
+        break;
+    case Qt::Key_M:
+        // Reload the scene with persistently mapped buffers, or without
+        _editControlPoints = !_editControlPoints;
+        qDebug() << "Edit control points:" << _editControlPoints;
+        loadSceneAsync(_sceneFileName);
+        break;
+    case Qt::Key_E:
+        // Compare the per patch edge levels against the shared ones
+        _sharedEdgeLevels = !_sharedEdgeLevels;
+        qDebug() << "Shared edge levels:" << _sharedEdgeLevels;
+        break;
+    case Qt::Key_T:
+        // Compare the tessellation stages against the compute shaders
+        _computeTessellation = !_computeTessellation;
+        qDebug() << "Compute tessellation:" << _computeTessellation;
+        break;
+    case Qt::Key_R:
+        // Compare tessellating every frame against replaying the capture
+        _tessellationCache = !_tessellationCache;
+        qDebug() << "Tessellation cache:" << _tessellationCache;
+        break;
+    case Qt::Key_P:
+        // Compare de Casteljau per fragment against the power basis
+        _powerBasis = !_powerBasis;
+        qDebug() << "Power basis:" << _powerBasis;
+        makeCurrent();
+        createPatchPrograms();
+        doneCurrent();
+        break;
+    case Qt::Key_O:
+        // Compare the proxies of distant nodes against the full patches
+        _lod = !_lod;
+        qDebug() << "Level of detail:" << _lod;
+        break;
     default:
         // Do nothing
         break;
@@ -137,13 +266,12 @@ void MainView::initializeGL() {
     glVersion = reinterpret_cast<const char*>(glGetString(GL_VERSION));
     qInfo() << "OpenGL:" << qPrintable(glVersion);
 
-    // TODO: this needs to be set for each different patch!
-    glPatchParameteri(GL_PATCH_VERTICES, 10);
-
     createSimpleProgram();
-    createTessellationProgram();
+    createLodProgram();
+    createEdgeLevelProgram();
+    createPatchPrograms();
 
-    glGenQueries(1, &_primitiveQuery);
+    _queryRing.initialize();
 
     glEnable(GL_DEPTH_TEST);
     glDepthFunc(GL_LEQUAL);
@@ -160,11 +288,19 @@ void MainView::initializeGL() {
     //glEnable(GL_LINE_SMOOTH);
     glLineWidth(1.0);
 
-    BezierSceneImporter importer = BezierSceneImporter();
-    _scene = importer.importBezierScene(":/scenes/bezier/beziersphere.bezier");
+    loadSceneAsync(":/scenes/bezier/beziersphere.bezier");
 }
 
 void MainView::paintGL() {
+    ScopedTimer frameTimer("paintGL");
+    swapInPendingScene();
+
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    if (!_scene) {
+        // Initial scene is still being loaded
+        return;
+    }
+
     QMatrix4x4 projection, model, view, scale;
     scale.scale(_scale);
     model = scale * _scene->getModelMatrix();
@@ -183,54 +319,197 @@ void MainView::paintGL() {
     const QVector3D white = QVector3D(0,0,1);
     const QVector3D backColor = QVector3D(0, 1, 0);
 
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
     const double aspect = static_cast<double>(width())/static_cast<double>(height());
     projection.perspective(60, aspect, 0.1, 100);
 
-    _tessProgram->bind();
+    _modelViewMatrix = view * model;
+    _projectionMatrix = projection;
+    // Scales the model space edge deviations of the patch invariants
+    const float modelViewScale = std::cbrt(std::abs(_modelViewMatrix.determinant()));
+    // Computed tessellations ignore culling, the proxies would be drawn
+    // on top of their patches
+    const bool computeTessellation = useComputeTessellation();
+    const bool useLod = _lod && !computeTessellation && _scene->hasLod();
+    _scene->setLodTolerance(useLod ? _projectionTolerance : 0.0f, height());
+    _scene->cull(view * model, projection, _cullFlags);
+
+    const bool sharedEdgeLevels = _sharedEdgeLevels && _scene->hasEdgeTable();
+
+    // Uniforms of the frame, set on the programs of every patch type
+    for (const BezierPatch::Type type : PATCH_TYPES) {
+        QOpenGLShaderProgram *programs[] = {
+            tessellationProgram(type),
+            _computeLevelPrograms[type],
+            _computeEvaluatePrograms[type],
+            _computeRenderPrograms[type],
+            _capturePrograms[type],
+            _cachedPrograms[type]
+        };
+        for (QOpenGLShaderProgram *program : programs) {
+            program->bind();
+            program->setUniformValue("ProjectionMatrix", projection);
+            program->setUniformValue("ModelViewMatrix", view * model);
+            program->setUniformValueArray("TessLevels", tessLevels, 2);
+            program->setUniformValue("EdgeHeuristic", _edgeHeuristic);
+            program->setUniformValue("FaceHeuristic", _faceHeuristic);
+            program->setUniformValue("SharedEdgeLevels", sharedEdgeLevels);
+            program->setUniformValue("ProjectionTolerance", _projectionTolerance);
+            program->setUniformValue("DeviationTolerance", deviationTolerance);
+            program->setUniformValue("ModelViewScale", modelViewScale);
+            program->setUniformValue("ReplayMatrix", QMatrix4x4());
+
+            program->setUniformValue("Width", width());
+            program->setUniformValue("Height", height());
+        }
+    }
 
-    _tessProgram->setUniformValue("ProjectionMatrix", projection);
-    _tessProgram->setUniformValue("ModelViewMatrix", view * model);
-    _tessProgram->setUniformValueArray("TessLevels", tessLevels, 2);
-    _tessProgram->setUniformValue("EdgeHeuristic", _edgeHeuristic);
-    _tessProgram->setUniformValue("FaceHeuristic", _faceHeuristic);
-    _tessProgram->setUniformValue("ProjectionTolerance", _projectionTolerance);
-    _tessProgram->setUniformValue("DeviationTolerance", deviationTolerance);
+    // Settings of this frame, in the column order of the stats log
+    const QString settings = QString("%1,%2,%3,%4,%5,%6")
+            .arg(_edgeHeuristic).arg(_faceHeuristic)
+            .arg(_minTessLevel).arg(_maxTessLevel)
+            .arg(_projectionTolerance).arg(_cullFlags);
+    _queryRing.beginFrame(settings);
+
+    // Everything the tessellation depends on, computed and captured
+    // tessellations are reused as long as this stays the same
+    QByteArray tessellationKey = settings.toLatin1();
+    tessellationKey.append(reinterpret_cast<const char *>(_modelViewMatrix.constData()),
+                           16 * sizeof(float));
+    tessellationKey.append(reinterpret_cast<const char *>(projection.constData()),
+                           16 * sizeof(float));
+    tessellationKey.append(QString(",%1,%2,%3,%4").arg(sharedEdgeLevels).arg(useLod)
+                           .arg(width()).arg(height()).toLatin1());
+
+    const bool useCache = _tessellationCache && !computeTessellation;
+    const bool computePass = sharedEdgeLevels || computeTessellation || useCache;
+    if (computePass) {
+        _queryRing.beginPass(FrameStats::ComputePass);
+    }
+    if (sharedEdgeLevels) {
+        _edgeLevelProgram->bind();
+        _edgeLevelProgram->setUniformValue("NumEdges", GLuint(_scene->getNumEdges()));
+        _edgeLevelProgram->setUniformValue("ProjectionMatrix", projection);
+        _edgeLevelProgram->setUniformValue("ModelViewMatrix", view * model);
+        _edgeLevelProgram->setUniformValueArray("TessLevels", tessLevels, 2);
+        _edgeLevelProgram->setUniformValue("EdgeHeuristic", _edgeHeuristic);
+        _edgeLevelProgram->setUniformValue("ProjectionTolerance", _projectionTolerance);
+        _edgeLevelProgram->setUniformValue("DeviationTolerance", deviationTolerance);
+        _edgeLevelProgram->setUniformValue("ModelViewScale", modelViewScale);
+        _edgeLevelProgram->setUniformValue("Width", width());
+        _edgeLevelProgram->setUniformValue("Height", height());
+        _scene->computeEdgeLevels(*_edgeLevelProgram);
+    }
+    if (computeTessellation) {
+        for (const BezierPatch::Type type : PATCH_TYPES) {
+            _scene->computeTessellation(*_computeLevelPrograms[type],
+                                        *_computeEvaluatePrograms[type],
+                                        type, tessellationKey);
+        }
+    }
+    for (const BezierPatch::Type type : PATCH_TYPES) {
+        _isCached[type] = false;
+        if (useCache) {
+            _capturePrograms[type]->bind();
+            _isCached[type] = _scene->updateTessellationCache(
+                        *_capturePrograms[type], type, tessellationKey);
+        }
+    }
+    if (computePass) {
+        _queryRing.endPass(FrameStats::ComputePass);
+    }
 
-    _tessProgram->setUniformValue("Width", width());
-    _tessProgram->setUniformValue("Height", height());
+    // Single pass: the edges are drawn by the fragment shader
+    const bool singlePassWireframe = _drawWireframe && _singlePassWireframe;
 
-    glBeginQuery(GL_PRIMITIVES_GENERATED, _primitiveQuery);
-    if (_drawFaces) {
+    if (_drawFaces || singlePassWireframe) {
+        ScopedTimer timer("Faces pass");
+        _queryRing.beginPass(FrameStats::FacesPass);
         glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        _tessProgram->setUniformValue("MaterialProps",materialProps);
-        _tessProgram->setUniformValue("ColorFront", frontColor);
-        _tessProgram->setUniformValue("ColorBack", backColor);
-        _tessProgram->setUniformValue("DrawingMode", _currentDrawingMode);
-        _scene->render(*_tessProgram);
+        for (const BezierPatch::Type type : PATCH_TYPES) {
+            if (_scene->getNumPatches(type) == 0) continue;
+            QOpenGLShaderProgram *program = renderProgram(type);
+            program->bind();
+            program->setUniformValue("MaterialProps",materialProps);
+            program->setUniformValue("ColorFront", frontColor);
+            program->setUniformValue("ColorBack", backColor);
+            program->setUniformValue("DrawingMode", _currentDrawingMode);
+            if (singlePassWireframe) {
+                program->setUniformValue(
+                            "WireframeMode", _drawFaces ? WireframeOverlay : WireframeOnly);
+                program->setUniformValue("WireframeColor", white);
+                program->setUniformValue("WireframeWidth", 1.0f);
+            } else {
+                program->setUniformValue("WireframeMode", NoWireframe);
+            }
+            renderPatches(*program, type);
+        }
+        if (_scene->getNumVisibleProxies() > 0) {
+            // The proxy shaders have no single pass wireframe, without faces
+            // the proxy triangles are drawn as lines instead
+            const bool proxyLines = !_drawFaces;
+            _lodProgram->bind();
+            _lodProgram->setUniformValue("ProjectionMatrix", projection);
+            _lodProgram->setUniformValue("ModelViewMatrix", view * model);
+            _lodProgram->setUniformValue("MaterialProps", proxyLines ? lineMaterial : materialProps);
+            _lodProgram->setUniformValue("ColorFront", proxyLines ? white : frontColor);
+            _lodProgram->setUniformValue("ColorBack", proxyLines ? white : backColor);
+            _lodProgram->setUniformValue("DrawingMode", proxyLines ? 0 : _currentDrawingMode);
+            glPolygonMode(GL_FRONT_AND_BACK, proxyLines ? GL_LINE : GL_FILL);
+            _scene->renderLod(*_lodProgram);
+            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        }
+        _queryRing.endPass(FrameStats::FacesPass);
     }
-    glEndQuery(GL_PRIMITIVES_GENERATED);
-
-    int numPrimitives;
-
-    glGetQueryObjectiv(_primitiveQuery, GL_QUERY_RESULT, &numPrimitives);
 
-    if (_drawWireframe) {
+    if (_drawWireframe && !_singlePassWireframe) {
+        ScopedTimer timer("Wireframe pass");
+        _queryRing.beginPass(FrameStats::WireframePass);
         glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
         model.scale(1.001f);
-        _tessProgram->setUniformValue("ModelViewMatrix", view * model);
-        _tessProgram->setUniformValue("MaterialProps",lineMaterial);
-        _tessProgram->setUniformValue("ColorFront", white);
-        _tessProgram->setUniformValue("ColorBack", white);
-        _tessProgram->setUniformValue("DrawingMode", 0); // Smooth
-        _scene->render(*_tessProgram);
+        for (const BezierPatch::Type type : PATCH_TYPES) {
+            if (_scene->getNumPatches(type) == 0) continue;
+            QOpenGLShaderProgram *program = renderProgram(type);
+            program->bind();
+            program->setUniformValue("ModelViewMatrix", view * model);
+            program->setUniformValue("ReplayMatrix", view * model * _modelViewMatrix.inverted());
+            program->setUniformValue("MaterialProps",lineMaterial);
+            program->setUniformValue("ColorFront", white);
+            program->setUniformValue("ColorBack", white);
+            program->setUniformValue("DrawingMode", 0); // Smooth
+            program->setUniformValue("WireframeMode", NoWireframe);
+            renderPatches(*program, type);
+        }
+        if (_scene->getNumVisibleProxies() > 0) {
+            _lodProgram->bind();
+            _lodProgram->setUniformValue("ProjectionMatrix", projection);
+            _lodProgram->setUniformValue("ModelViewMatrix", view * model);
+            _lodProgram->setUniformValue("MaterialProps", lineMaterial);
+            _lodProgram->setUniformValue("ColorFront", white);
+            _lodProgram->setUniformValue("ColorBack", white);
+            _lodProgram->setUniformValue("DrawingMode", 0); // Smooth
+            _scene->renderLod(*_lodProgram);
+        }
+        _queryRing.endPass(FrameStats::WireframePass);
     }
 
+    if (_selectedPatch >= 0) {
+        QOpenGLShaderProgram *program =
+                tessellationProgram(_scene->getPatchType(_selectedPatch));
+        program->bind();
+        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+        program->setUniformValue("MaterialProps", lineMaterial);
+        program->setUniformValue("ColorFront", white);
+        program->setUniformValue("ColorBack", white);
+        program->setUniformValue("DrawingMode", 0); // Smooth
+        program->setUniformValue("WireframeMode", NoWireframe);
+        _scene->renderPatch(*program, _selectedPatch);
+    }
 
-    emit onPrimitivesDrawn(numPrimitives);
+    _queryRing.endFrame();
 
     _tessProgram->release();
+
+    collectFrameStats();
 }
 
 void MainView::resizeGL(int newWidth, int newHeight) {
@@ -299,46 +578,48 @@ void MainView::setTessellationLevels(int minLevel, int maxLevel) {
 }
 
 void MainView::setScene(int sceneID) {
-    // Make sure the OpenGL context is current
-    this->makeCurrent();
-    BezierSceneImporter importer = BezierSceneImporter();
     switch (sceneID) {
     case 0:
-        _scene = importer.importBezierScene(":/scenes/bezier/beziersphere.bezier");
+        loadSceneAsync(":/scenes/bezier/beziersphere.bezier");
         break;
     case 1:
-        _scene = importer.importBezierScene(":/scenes/bezier/cone.bezier");
+        loadSceneAsync(":/scenes/bezier/cone.bezier");
         break;
     case 2:
-        _scene = importer.importBezierScene(":/scenes/bezier/rationalbeziersphere.bezier");
+        loadSceneAsync(":/scenes/bezier/rationalbeziersphere.bezier");
         break;
     case 3:
-        _scene = importer.importBezierScene(":/scenes/bezier/simpletriangle.bezier");
+        loadSceneAsync(":/scenes/bezier/simpletriangle.bezier");
         break;
     case 4:
-        _scene = importer.importBezierScene(":/scenes/bezier/slottedcylinder.bezier");
+        loadSceneAsync(":/scenes/bezier/slottedcylinder.bezier");
         break;
     case 5:
-        _scene = importer.importBezierScene(":/scenes/bezier/splitin4.bezier");
+        loadSceneAsync(":/scenes/bezier/splitin4.bezier");
         break;
     case 6:
-        _scene = importer.importBezierScene(":/scenes/bezier/teapot.bezier");
+        loadSceneAsync(":/scenes/bezier/teapot.bezier");
         break;
     case 7:
-        _scene = importer.importBezierScene(":/scenes/bezier/testblock.bezier");
+        loadSceneAsync(":/scenes/bezier/testblock.bezier");
         break;
     case 8:
-        _scene = importer.importBezierScene(":/scenes/bezier/floating.bezier");
+        loadSceneAsync(":/scenes/bezier/floating.bezier");
         break;
     case 9:
-        _scene = importer.importBezierScene(":/scenes/bezier/extremecurvature.bezier");
+        loadSceneAsync(":/scenes/bezier/extremecurvature.bezier");
+        break;
+    case 10:
+        loadSceneAsync(":/scenes/bezier/quadsheet.bezier");
         break;
     default:
-        _scene = importer.importBezierScene(":/scenes/bezier/teapot.bezier");
+        loadSceneAsync(":/scenes/bezier/teapot.bezier");
         break;
     }
-    this->doneCurrent();
-    update();
+}
+
+void MainView::loadScene(const QString &fileName) {
+    loadSceneAsync(fileName);
 }
 
 void MainView::setProjectionTolerance(double tolerance) {
@@ -346,6 +627,29 @@ void MainView::setProjectionTolerance(double tolerance) {
     update();
 }
 
+void MainView::setCullFlags(int flags) {
+    _cullFlags = flags;
+    qDebug() << "setCullFlags(" << flags << ")";
+    update();
+}
+
+void MainView::setStatsLogFile(const QString &fileName) {
+    if (_statsLog.isOpen()) {
+        _statsLog.close();
+        qInfo() << "Stopped logging frame stats to" << _statsLog.fileName();
+    }
+    if (fileName.isEmpty()) {
+        return;
+    }
+    _statsLog.setFileName(fileName);
+    if (!_statsLog.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Could not open stats log:" << fileName;
+        return;
+    }
+    _statsLog.write(STATS_LOG_HEADER);
+    qInfo() << "Logging frame stats to" << fileName;
+}
+
 void MainView::onMessageLogged(QOpenGLDebugMessage message) {
     switch(message.severity()) {
     case QOpenGLDebugMessage::NotificationSeverity:
@@ -366,29 +670,65 @@ void MainView::onMessageLogged(QOpenGLDebugMessage message) {
 // -- Ohter methods ------------------------------------------------------------
 // =============================================================================
 
-void MainView::createTessellationProgram() {
-    _tessProgram = new QOpenGLShaderProgram(this);
+QByteArray MainView::patchDefines(BezierPatch::Type type) const {
+    QByteArray defines;
+    if (type == BezierPatch::QuadPatch) {
+        defines += "#define QUAD_PATCH\n";
+    }
+    if (_powerBasis) {
+        defines += "#define POWER_BASIS\n";
+    }
+    return defines;
+}
 
-    _tessProgram->addShaderFromSourceFile(
+void MainView::createPatchPrograms() {
+    delete _tessProgram;
+    delete _quadProgram;
+    for (const BezierPatch::Type type : PATCH_TYPES) {
+        delete _computeLevelPrograms[type];
+        delete _computeEvaluatePrograms[type];
+        delete _computeRenderPrograms[type];
+        delete _capturePrograms[type];
+        delete _cachedPrograms[type];
+    }
+
+    _tessProgram = createTessellationProgram(BezierPatch::TriPatch);
+    _quadProgram = createTessellationProgram(BezierPatch::QuadPatch);
+    for (const BezierPatch::Type type : PATCH_TYPES) {
+        createComputePrograms(type);
+        createCachePrograms(type);
+    }
+}
+
+QOpenGLShaderProgram *MainView::createTessellationProgram(BezierPatch::Type type) {
+    QOpenGLShaderProgram *program = new QOpenGLShaderProgram(this);
+
+    const bool isQuad = type == BezierPatch::QuadPatch;
+    const QByteArray defines = patchDefines(type);
+
+    program->addShaderFromSourceFile(
                 QOpenGLShader::Vertex,
                 ":/shaders/tessellation/vertex.glsl");
-    _tessProgram->addShaderFromSourceFile(
+    program->addShaderFromSourceCode(
                 QOpenGLShader::TessellationControl,
-                ":/shaders/tessellation/tess_control.glsl");
-    _tessProgram->addShaderFromSourceFile(
+                ShaderSource::read(isQuad ? ":/shaders/tessellation/quad_tess_control.glsl" :
+                                            ":/shaders/tessellation/tess_control.glsl"));
+    program->addShaderFromSourceFile(
                 QOpenGLShader::TessellationEvaluation,
-                ":/shaders/tessellation/tess_eval.glsl");
-    _tessProgram->addShaderFromSourceFile(
+                isQuad ? ":/shaders/tessellation/quad_tess_eval.glsl" :
+                         ":/shaders/tessellation/tess_eval.glsl");
+    program->addShaderFromSourceCode(
                 QOpenGLShader::Geometry,
-                ":/shaders/tessellation/geometry.glsl");
-    _tessProgram->addShaderFromSourceFile(
+                ShaderSource::read(":/shaders/tessellation/geometry.glsl", defines));
+    program->addShaderFromSourceCode(
                 QOpenGLShader::Fragment,
-                ":/shaders/tessellation/fragment.glsl");
+                ShaderSource::read(":/shaders/tessellation/fragment.glsl", defines));
 
-    if (!_tessProgram->link()) {
-        qFatal("Tessellation program did not compile");
+    if (!program->link()) {
+        qFatal(isQuad ? "Quad tessellation program did not compile" :
+                        "Tessellation program did not compile");
     }
-
+    return program;
 }
 
 void MainView::createSimpleProgram() {
@@ -405,3 +745,291 @@ void MainView::createSimpleProgram() {
         qFatal("Simple program did not compile!");
     }
 }
+
+void MainView::createLodProgram() {
+    _lodProgram = new QOpenGLShaderProgram(this);
+
+    _lodProgram->addShaderFromSourceFile(
+                QOpenGLShader::Vertex,
+                ":/shaders/lod/vertex.glsl");
+    _lodProgram->addShaderFromSourceFile(
+                QOpenGLShader::Fragment,
+                ":/shaders/lod/fragment.glsl");
+
+    if (!_lodProgram->link()) {
+        qFatal("Level of detail program did not compile!");
+    }
+}
+
+void MainView::createEdgeLevelProgram() {
+    _edgeLevelProgram = new QOpenGLShaderProgram(this);
+
+    _edgeLevelProgram->addShaderFromSourceCode(
+                QOpenGLShader::Compute,
+                ShaderSource::read(":/shaders/tessellation/edge_levels.glsl"));
+
+    if (!_edgeLevelProgram->link()) {
+        qFatal("Edge level program did not compile!");
+    }
+}
+
+void MainView::createComputePrograms(BezierPatch::Type type) {
+    const QByteArray defines = patchDefines(type);
+
+    QOpenGLShaderProgram *levelProgram = new QOpenGLShaderProgram(this);
+    levelProgram->addShaderFromSourceCode(
+                QOpenGLShader::Compute,
+                ShaderSource::read(":/shaders/tessellation/compute_levels.glsl", defines));
+
+    QOpenGLShaderProgram *evaluateProgram = new QOpenGLShaderProgram(this);
+    evaluateProgram->addShaderFromSourceCode(
+                QOpenGLShader::Compute,
+                ShaderSource::read(":/shaders/tessellation/compute_evaluate.glsl", defines));
+
+    QOpenGLShaderProgram *renderProgram = new QOpenGLShaderProgram(this);
+    renderProgram->addShaderFromSourceCode(
+                QOpenGLShader::Vertex,
+                ShaderSource::read(":/shaders/tessellation/compute_vertex.glsl", defines));
+    renderProgram->addShaderFromSourceCode(
+                QOpenGLShader::Geometry,
+                ShaderSource::read(":/shaders/tessellation/geometry.glsl", defines));
+    renderProgram->addShaderFromSourceCode(
+                QOpenGLShader::Fragment,
+                ShaderSource::read(":/shaders/tessellation/fragment.glsl", defines));
+
+    if (!levelProgram->link() || !evaluateProgram->link() || !renderProgram->link()) {
+        qFatal("Compute tessellation programs did not compile");
+    }
+    _computeLevelPrograms[type] = levelProgram;
+    _computeEvaluatePrograms[type] = evaluateProgram;
+    _computeRenderPrograms[type] = renderProgram;
+}
+
+void MainView::createCachePrograms(BezierPatch::Type type) {
+    const bool isQuad = type == BezierPatch::QuadPatch;
+    const QByteArray defines = patchDefines(type);
+
+    // Same stages as the tessellation program, up to the evaluation shader
+    QOpenGLShaderProgram *captureProgram = new QOpenGLShaderProgram(this);
+    captureProgram->addShaderFromSourceFile(
+                QOpenGLShader::Vertex,
+                ":/shaders/tessellation/vertex.glsl");
+    captureProgram->addShaderFromSourceCode(
+                QOpenGLShader::TessellationControl,
+                ShaderSource::read(isQuad ? ":/shaders/tessellation/quad_tess_control.glsl" :
+                                            ":/shaders/tessellation/tess_control.glsl"));
+    captureProgram->addShaderFromSourceFile(
+                QOpenGLShader::TessellationEvaluation,
+                isQuad ? ":/shaders/tessellation/quad_tess_eval.glsl" :
+                         ":/shaders/tessellation/tess_eval.glsl");
+
+    // Should be the same as BezierScene::CachedVertex!
+    const char *varyings[] = {
+        "vert_coord_GS_in",
+        "vert_normal_GS_in",
+        "barycenter_GS_in",
+        "inner_tess_level_GS_in",
+        "outer_tess_level_GS_in",
+        "patch_number_GS_in"
+    };
+    glTransformFeedbackVaryings(captureProgram->programId(), 6, varyings,
+                                GL_INTERLEAVED_ATTRIBS);
+
+    QOpenGLShaderProgram *cachedProgram = new QOpenGLShaderProgram(this);
+    cachedProgram->addShaderFromSourceCode(
+                QOpenGLShader::Vertex,
+                ShaderSource::read(":/shaders/tessellation/cached_vertex.glsl", defines));
+    cachedProgram->addShaderFromSourceCode(
+                QOpenGLShader::Geometry,
+                ShaderSource::read(":/shaders/tessellation/geometry.glsl", defines));
+    cachedProgram->addShaderFromSourceCode(
+                QOpenGLShader::Fragment,
+                ShaderSource::read(":/shaders/tessellation/fragment.glsl", defines));
+
+    if (!captureProgram->link() || !cachedProgram->link()) {
+        qFatal("Tessellation cache programs did not compile");
+    }
+    _capturePrograms[type] = captureProgram;
+    _cachedPrograms[type] = cachedProgram;
+}
+
+void MainView::renderPatches(QOpenGLShaderProgram &program, BezierPatch::Type type) {
+    if (useComputeTessellation()) {
+        _scene->renderComputed(program, type);
+    } else if (_isCached[type]) {
+        _scene->renderCached(program, type);
+    } else {
+        _scene->render(program, type);
+    }
+}
+
+void MainView::loadSceneAsync(const QString &fileName) {
+    // Only the most recent request may replace the scene
+    if (_loadCancelFlag) {
+        _loadCancelFlag->storeRelease(1);
+    }
+    QSharedPointer<QAtomicInt> cancelFlag(new QAtomicInt(0));
+    _loadCancelFlag = cancelFlag;
+    _sceneFileName = fileName;
+    const bool preSubdivision = _preSubdivision;
+
+    typedef QSharedPointer<BezierSceneData> SceneDataPtr;
+    QFutureWatcher<SceneDataPtr> *watcher = new QFutureWatcher<SceneDataPtr>(this);
+    connect(watcher, &QFutureWatcher<SceneDataPtr>::finished, this,
+            [this, watcher, cancelFlag]() {
+        const SceneDataPtr data = watcher->result();
+        watcher->deleteLater();
+        if (cancelFlag->loadAcquire() != 0 || !data) {
+            return;
+        }
+        _pendingSceneData = data;
+        update();
+    });
+
+    watcher->setFuture(QtConcurrent::run([fileName, cancelFlag, preSubdivision]() {
+        SceneDataPtr data(new BezierSceneData());
+        BezierSceneImporter importer = BezierSceneImporter();
+        importer.setCancelFlag(cancelFlag.data());
+        if (preSubdivision) {
+            importer.setPreSubdivision(SUBDIVISION_TOLERANCE, SUBDIVISION_DEPTH);
+        }
+        if (!importer.importBezierSceneData(fileName, *data)) {
+            return SceneDataPtr();
+        }
+        return data;
+    }));
+}
+
+void MainView::swapInPendingScene() {
+    if (!_pendingSceneData) {
+        return;
+    }
+    // Context is current in paintGL, the old scene is released here as well
+    QSharedPointer<BezierScene> scene(new BezierScene());
+    // Paged scenes have no control points on the CPU to edit
+    const bool editable = _editControlPoints && _pendingSceneData->pageTable.isEmpty();
+    scene->setSceneData(*_pendingSceneData, editable ? BezierScene::PersistentBuffers :
+                                                       BezierScene::StaticBuffers);
+    _pendingSceneData.clear();
+    _scene = scene;
+    _dragIndices.clear();
+    _dragOrigins.clear();
+    if (_selectedPatch >= 0) {
+        _selectedPatch = -1;
+        emit onPatchSelected(_selectedPatch);
+    }
+}
+
+void MainView::collectPendingStats() {
+    makeCurrent();
+    collectFrameStats();
+    doneCurrent();
+}
+
+void MainView::collectFrameStats() {
+    ScopedTimer timer("Collect frame stats");
+    QVector<FrameStats> results;
+    _queryRing.takeResults(results);
+
+    for (const FrameStats &stats : results) {
+        if (_statsLog.isOpen()) {
+            QString line = QString("%1,%2").arg(stats.frame).arg(stats.label);
+            for (int pass = 0; pass < FrameStats::NUM_PASSES; ++pass) {
+                line += QString(",%1,%2")
+                        .arg(stats.numPrimitives[pass])
+                        .arg(stats.gpuTime[pass], 0, 'f', 4);
+            }
+            _statsLog.write(line.toLatin1() + '\n');
+        }
+        emit onFrameStats(stats);
+    }
+    if (!results.isEmpty()) {
+        emit onPrimitivesDrawn(results.last().numPrimitives[FrameStats::FacesPass]);
+    }
+
+    if (_queryRing.hasPendingFrames()) {
+        _statsTimer.start();
+    } else {
+        _statsTimer.stop();
+    }
+}
+
+void MainView::pickPatch(int x, int y) {
+    if (!_scene || width() <= 0 || height() <= 0) {
+        return;
+    }
+    // Unproject the pixel to the near and far plane in model coordinates
+    const QVector3D nearPoint = unproject(x, y, -1.0f);
+    const QVector3D farPoint = unproject(x, y, 1.0f);
+
+    {
+        ScopedTimer timer("Pick");
+        _selectedPatch = _scene->pick(nearPoint, farPoint - nearPoint);
+    }
+
+    emit onPatchSelected(_selectedPatch);
+}
+
+QVector3D MainView::unproject(int x, int y, float depth) const {
+    const float ndcX = 2.0f * (x + 0.5f) / width() - 1.0f;
+    const float ndcY = 1.0f - 2.0f * (y + 0.5f) / height();
+    const QMatrix4x4 inverse = (_projectionMatrix * _modelViewMatrix).inverted();
+    return inverse.map(QVector3D(ndcX, ndcY, depth));
+}
+
+bool MainView::startDrag(int x, int y, bool wholePatch) {
+    if (!_scene || !_scene->isEditable()) {
+        return false;
+    }
+    pickPatch(x, y);
+    if (_selectedPatch < 0) {
+        return false;
+    }
+
+    // The control point nearest to the cursor on screen is the anchor
+    const QMatrix4x4 viewProjection = _projectionMatrix * _modelViewMatrix;
+    const QVector3D cursor = viewProjection.map(unproject(x, y, 0.0f));
+    const unsigned *indices = _scene->getPatchIndices(_selectedPatch);
+    const int numPoints = PatchStore::numControlPoints(_scene->getPatchType(_selectedPatch));
+    int nearest = 0;
+    float nearestDistance = std::numeric_limits<float>::max();
+    for (int i = 0; i < numPoints; ++i) {
+        const QVector4D point = _scene->getControlPoint(indices[i]);
+        const QVector3D projected = viewProjection.map(point.toVector3D() / point.w());
+        const float dx = projected.x() - cursor.x();
+        const float dy = projected.y() - cursor.y();
+        const float distance = dx * dx + dy * dy;
+        if (distance < nearestDistance) {
+            nearest = i;
+            nearestDistance = distance;
+        }
+    }
+
+    _dragIndices.clear();
+    _dragOrigins.clear();
+    for (int i = 0; i < numPoints; ++i) {
+        if (wholePatch || i == nearest) {
+            _dragIndices.push_back(indices[i]);
+            _dragOrigins.push_back(_scene->getControlPoint(indices[i]));
+        }
+    }
+    const QVector4D anchor = _scene->getControlPoint(indices[nearest]);
+    _dragAnchor = anchor.toVector3D() / anchor.w();
+    _dragDepth = viewProjection.map(_dragAnchor).z();
+    return true;
+}
+
+void MainView::dragControlPoints(int x, int y) {
+    if (!_scene || !_scene->isEditable() || _dragIndices.isEmpty()) {
+        return;
+    }
+    // Weighted points move by the offset times their weight
+    const QVector3D offset = unproject(x, y, _dragDepth) - _dragAnchor;
+    QVector<QVector4D> points(_dragOrigins.size());
+    for (int i = 0; i < points.size(); ++i) {
+        const QVector4D &origin = _dragOrigins[i];
+        points[i] = origin + QVector4D(offset * origin.w(), 0.0f);
+    }
+    ScopedTimer timer("Drag control points");
+    _scene->setControlPoints(_dragIndices, points);
+}
@@ -3,7 +3,8 @@
 
 #include <geom/beziertriangle.h>
 #include <gl/bezierscene.h>
-
+#include <gl/gpuqueryring.h>
+#include <util/bezierscenedata.h>
 
 #include <QMatrix3x3>
 #include <QMatrix4x4>
@@ -11,8 +12,11 @@
 #include <QOpenGLDebugLogger>
 #include <QOpenGLFunctions_4_5_Core>
 #include <QOpenGLShaderProgram>
+#include <QAtomicInt>
+#include <QFile>
 #include <QOpenGLWidget>
 #include <QPointer>
+#include <QTimer>
 
 class MainView : public QOpenGLWidget, protected QOpenGLFunctions_4_5_Core
 {
@@ -28,9 +32,18 @@ class MainView : public QOpenGLWidget, protected QOpenGLFunctions_4_5_Core
         Rotate,
         Scale,
         Translate,
+        /// Moves the control points picked by the press
+        DragControlPoints,
         NUM_MOUSE_STATES
     };
 
+    /// Should be the same as the defines in fragment.glsl!
+    enum WireframeMode {
+        NoWireframe = 0,
+        WireframeOverlay,
+        WireframeOnly
+    };
+
     // =========================================================================
     // -- Constructors and destructor ------------------------------------------
     // =========================================================================
@@ -51,6 +64,8 @@ protected:
 
     virtual void mouseMoveEvent(QMouseEvent *event) override;
 
+    virtual void mouseReleaseEvent(QMouseEvent *event) override;
+
     virtual void wheelEvent(QWheelEvent *event) override;
 
     virtual void keyReleaseEvent(QKeyEvent *event) override;
@@ -77,6 +92,12 @@ signals:
 
     void onPrimitivesDrawn(int numPrimitives);
 
+    /// Emitted a few frames after the frame was rendered
+    void onFrameStats(const FrameStats &stats);
+
+    /// -1 if the selection was cleared
+    void onPatchSelected(int patch);
+
 public slots:
 
     void onXRotation(int rotation);
@@ -101,22 +122,95 @@ public slots:
 
     void setScene(int sceneID);
 
+    /// Loads a scene file in the background, e.g. a paged scene
+    void loadScene(const QString &fileName);
+
     void setProjectionTolerance(double tolerance);
 
+    void setCullFlags(int flags);
+
+    /// Appends the frame stats to a CSV file, an empty name stops logging
+    void setStatsLogFile(const QString &fileName);
+
 private slots:
 
     void onMessageLogged(QOpenGLDebugMessage message);
 
+    /// Reads finished queries while no frames are rendered
+    void collectPendingStats();
+
     // =========================================================================
     // -- Ohter methods --------------------------------------------------------
     // =========================================================================
 
 private:
 
-    void createTessellationProgram();
+    /// QUAD_PATCH and POWER_BASIS for the shaders shared by the patch types
+    QByteArray patchDefines(BezierPatch::Type type) const;
+
+    /// (Re)creates every program that uses patchDefines()
+    void createPatchPrograms();
+
+    QOpenGLShaderProgram *createTessellationProgram(BezierPatch::Type type);
+
+    /// Program that tessellates the given patch type
+    QOpenGLShaderProgram *tessellationProgram(BezierPatch::Type type) const {
+        return type == BezierPatch::TriPatch ? _tessProgram : _quadProgram;
+    }
+
+    /// Program that draws the given patch type with the current backend
+    QOpenGLShaderProgram *renderProgram(BezierPatch::Type type) const {
+        if (useComputeTessellation()) return _computeRenderPrograms[type];
+        if (_isCached[type]) return _cachedPrograms[type];
+        return tessellationProgram(type);
+    }
+
+    /// Paged scenes have no patches on the GPU to tessellate from
+    bool useComputeTessellation() const {
+        return _computeTessellation && _scene && !_scene->isPaged();
+    }
+
+    /// Draws with the tessellation stages, the last compute tessellation or
+    /// the captured tessellation
+    void renderPatches(QOpenGLShaderProgram &program, BezierPatch::Type type);
 
     void createSimpleProgram();
 
+    /// Draws the proxies of BezierScene::renderLod()
+    void createLodProgram();
+
+    /// Compute program of BezierScene::computeEdgeLevels
+    void createEdgeLevelProgram();
+
+    /// Level, evaluate and render programs of BezierScene::computeTessellation
+    void createComputePrograms(BezierPatch::Type type);
+
+    /// Capture and replay programs of BezierScene::updateTessellationCache
+    void createCachePrograms(BezierPatch::Type type);
+
+    /// Parses the scene on the thread pool, the current scene stays visible
+    void loadSceneAsync(const QString &fileName);
+
+    /// Uploads a finished background import, called from paintGL
+    void swapInPendingScene();
+
+    /// Selects the patch under a widget position, using the last frame's view
+    void pickPatch(int x, int y);
+
+    /// Model coordinates of a widget position at a depth in normalized
+    /// device coordinates, using the last frame's view
+    QVector3D unproject(int x, int y, float depth) const;
+
+    /// Picks a patch of an editable scene and grabs its control point
+    /// nearest to the position, or all of them
+    bool startDrag(int x, int y, bool wholePatch);
+
+    /// Moves the grabbed control points in the view plane
+    void dragControlPoints(int x, int y);
+
+    /// Emits and logs the finished frames, requires a current context
+    void collectFrameStats();
+
     // =========================================================================
     // -- Data members ---------------------------------------------------------
     // =========================================================================
@@ -127,24 +221,81 @@ private:
 
     QPointer<QOpenGLShaderProgram> _simpleProgram;
 
+    QPointer<QOpenGLShaderProgram> _lodProgram;
+
     QPointer<QOpenGLShaderProgram> _tessProgram;
 
+    /// Shares the vertex, geometry and fragment shaders with _tessProgram
+    QPointer<QOpenGLShaderProgram> _quadProgram;
+
+    QPointer<QOpenGLShaderProgram> _edgeLevelProgram;
+
+    // --- Compute tessellation, per patch type --------------------------------
+
+    QPointer<QOpenGLShaderProgram> _computeLevelPrograms[BezierPatch::NUM_PATCH_TYPES];
+
+    QPointer<QOpenGLShaderProgram> _computeEvaluatePrograms[BezierPatch::NUM_PATCH_TYPES];
+
+    /// Shares the geometry and fragment shaders with the tessellation programs
+    QPointer<QOpenGLShaderProgram> _computeRenderPrograms[BezierPatch::NUM_PATCH_TYPES];
+
+    // --- Tessellation cache, per patch type ----------------------------------
+
+    /// Tessellation program without geometry and fragment shaders
+    QPointer<QOpenGLShaderProgram> _capturePrograms[BezierPatch::NUM_PATCH_TYPES];
+
+    /// Draws the captured vertices with the tessellation geometry and
+    /// fragment shaders
+    QPointer<QOpenGLShaderProgram> _cachedPrograms[BezierPatch::NUM_PATCH_TYPES];
+
+    /// The cache of the type is drawn in this frame
+    bool _isCached[BezierPatch::NUM_PATCH_TYPES];
+
     QSharedPointer<BezierScene> _scene;
 
+    // --- Background loading --------------------------------------------------
+
+    /// Cancel flag of the import that is currently in flight
+    QSharedPointer<QAtomicInt> _loadCancelFlag;
+
+    /// Imported data waiting for the GL upload in the next paintGL
+    QSharedPointer<BezierSceneData> _pendingSceneData;
+
+    /// Last requested scene, reloaded when the import options change
+    QString _sceneFileName;
+
     int _xRot, _yRot;
 
     QMatrix4x4 _rotationMatrix;
 
     int _lastX, _lastY;
 
+    /// Position of the last press, a release at the same position picks
+    int _pressX, _pressY;
+
+    /// Matrices of the last frame, for picking
+    QMatrix4x4 _modelViewMatrix, _projectionMatrix;
+
+    int _selectedPatch;
+
     float _scale;
 
-    GLuint _primitiveQuery;
+    // --- GPU statistics ------------------------------------------------------
+
+    GpuQueryRing _queryRing;
+
+    /// Polls the query ring when no new frames arrive
+    QTimer _statsTimer;
+
+    QFile _statsLog;
 
     MouseState _currentMouseState;
 
     bool _drawFaces, _drawWireframe;
 
+    /// Draw the wireframe in the face pass instead of a second line pass
+    bool _singlePassWireframe;
+
     int _currentDrawingMode;
     int _edgeHeuristic;
     int _faceHeuristic;
@@ -152,6 +303,44 @@ private:
 
     float _projectionTolerance;
 
+    /// PatchCuller::CullFlag values
+    int _cullFlags;
+
+    /// Split strongly curved triangles when importing
+    bool _preSubdivision;
+
+    /// Compute the outer levels once per unique edge, without cracks
+    bool _sharedEdgeLevels;
+
+    /// Tessellate with compute shaders instead of the tessellation stages
+    bool _computeTessellation;
+
+    /// Replay the tessellation while the view and settings stay the same
+    bool _tessellationCache;
+
+    /// Evaluate the fragments from the power basis instead of de Casteljau
+    bool _powerBasis;
+
+    /// Draw distant parts of huge scenes as their proxies
+    bool _lod;
+
+    // --- Editing -------------------------------------------------------------
+
+    /// Upload scenes with persistently mapped buffers, so control points
+    /// can be dragged with Ctrl
+    bool _editControlPoints;
+
+    QVector<unsigned> _dragIndices;
+
+    /// Grabbed control points at the press
+    QVector<QVector4D> _dragOrigins;
+
+    /// Grabbed point under the cursor at the press, in model coordinates
+    QVector3D _dragAnchor;
+
+    /// Depth of the anchor, the points move parallel to the view plane
+    float _dragDepth;
+
 };
 
 #endif // MAINVIEW_H
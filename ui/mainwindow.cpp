@@ -1,7 +1,10 @@
 #include <ui/mainwindow.h>
 #include "ui_mainwindow.h"
 
+#include <util/profiler.h>
+
 #include <QApplication>
+#include <QFileDialog>
 #include <QStatusBar>
 #include <QComboBox>
 #include <QSpinBox>
@@ -17,13 +20,16 @@ MainWindow::MainWindow(QWidget *parent) :
 {
     ui->setupUi(this);
 
+    _profilerOverlay = new ProfilerOverlay(ui->mainView);
+    _profilerOverlay->hide();
+
     connect(ui->xSlider, SIGNAL(valueChanged(int)),
             ui->mainView, SLOT(onXRotation(int)), Qt::QueuedConnection);
     connect(ui->ySlider, SIGNAL(valueChanged(int)),
             ui->mainView, SLOT(onYRotation(int)), Qt::QueuedConnection);
 
-    connect(ui->mainView, SIGNAL(onPrimitivesDrawn(int)),
-            this, SLOT(onPrimitivesDrawn(int)), Qt::QueuedConnection);
+    connect(ui->mainView, SIGNAL(onFrameStats(FrameStats)),
+            this, SLOT(onFrameStats(FrameStats)), Qt::QueuedConnection);
     connect(ui->actionToggleWireframe, SIGNAL(triggered(bool)),
             ui->mainView, SLOT(setDrawWireframe(bool)), Qt::QueuedConnection);
     connect(ui->shadingBox, SIGNAL(currentIndexChanged(int)),
@@ -60,9 +66,24 @@ void MainWindow::aboutQt() {
     QApplication::aboutQt();
 }
 
-void MainWindow::onPrimitivesDrawn(int numPrimitives) {
+void MainWindow::onFrameStats(const FrameStats &stats) {
+    QString message = QString("%1 primitives").arg(
+                stats.numPrimitives[FrameStats::FacesPass]);
+    if (stats.hasPass[FrameStats::FacesPass]) {
+        message += QString(", faces %1 ms").arg(
+                    stats.gpuTime[FrameStats::FacesPass], 0, 'f', 2);
+    }
+    if (stats.hasPass[FrameStats::WireframePass]) {
+        message += QString(", wireframe %1 ms").arg(
+                    stats.gpuTime[FrameStats::WireframePass], 0, 'f', 2);
+    }
+    if (stats.hasPass[FrameStats::ComputePass]) {
+        message += QString(", compute %1 ms").arg(
+                    stats.gpuTime[FrameStats::ComputePass], 0, 'f', 2);
+    }
     this->statusBar()->clearMessage();
-    this->statusBar()->showMessage(QString("%1 primitives").arg(numPrimitives));
+    this->statusBar()->showMessage(message);
+    _profilerOverlay->addFrameStats(stats);
 }
 
 void MainWindow::on_minTessLevel_valueChanged(int level)
@@ -80,3 +101,30 @@ void MainWindow::on_maxTessLevel_valueChanged(int level)
                 ui->minTessLevel->value(),
                 ui->maxTessLevel->value());
 }
+
+void MainWindow::on_actionProfilerOverlay_toggled(bool checked)
+{
+    _profilerOverlay->setVisible(checked);
+}
+
+void MainWindow::on_actionOpenScene_triggered()
+{
+    const QString fileName = QFileDialog::getOpenFileName(
+                this, "Open scene", QString(),
+                "Bezier scenes (*.bezier *.bezierbin *.bezierpaged);;All files (*)");
+    if (!fileName.isEmpty()) {
+        ui->mainView->loadScene(fileName);
+    }
+}
+
+void MainWindow::on_actionExportTrace_triggered()
+{
+    const QString fileName = QFileDialog::getSaveFileName(
+                this, "Export trace", "trace.json", "Chrome trace (*.json)");
+    if (fileName.isEmpty()) {
+        return;
+    }
+    if (Profiler::instance().writeChromeTrace(fileName)) {
+        statusBar()->showMessage(QString("Trace written to %1").arg(fileName));
+    }
+}
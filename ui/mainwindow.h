@@ -1,6 +1,9 @@
 #ifndef MAINWINDOW_H
 #define MAINWINDOW_H
 
+#include <gl/gpuqueryring.h>
+#include <ui/profileroverlay.h>
+
 #include <QMainWindow>
 
 namespace Ui {
@@ -31,7 +34,7 @@ private slots:
 
     void aboutQt();
 
-    void onPrimitivesDrawn(int);
+    void onFrameStats(const FrameStats &stats);
 
 // --- Automaticly generated slots ---------------------------------------------
 
@@ -39,6 +42,12 @@ private slots:
 
     void on_maxTessLevel_valueChanged(int level);
 
+    void on_actionProfilerOverlay_toggled(bool checked);
+
+    void on_actionOpenScene_triggered();
+
+    void on_actionExportTrace_triggered();
+
 // -----------------------------------------------------------------------------
 // -- Data members -------------------------------------------------------------
 // -----------------------------------------------------------------------------
@@ -46,6 +55,8 @@ private slots:
 private:
 
     Ui::MainWindow *ui;
+
+    ProfilerOverlay *_profilerOverlay;
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,105 @@
+#include <ui/profileroverlay.h>
+
+#include <util/profiler.h>
+
+#include <cstdio>
+
+namespace {
+
+/// Samples per scope of the percentiles
+const int WINDOW = 256;
+
+/// Milliseconds between updates of the table
+const int REFRESH_INTERVAL = 500;
+
+const char *const PASS_NAMES[FrameStats::NUM_PASSES] = {
+    "GPU faces pass",
+    "GPU wireframe pass",
+    "GPU compute pass"
+};
+
+QString formatRow(const Profiler::Summary &summary)
+{
+    char row[160];
+    std::snprintf(row, sizeof(row), "%-28s %8.3f %8.3f %8.3f %8.3f %5d",
+                  qPrintable(summary.name), summary.median, summary.p95,
+                  summary.p99, summary.max, summary.count);
+    return QString::fromLatin1(row);
+}
+
+} // namespace
+
+// -----------------------------------------------------------------------------
+// -- Constructors and destructor ----------------------------------------------
+// -----------------------------------------------------------------------------
+
+ProfilerOverlay::ProfilerOverlay(QWidget *parent) :
+    QLabel(parent)
+{
+    for (int pass = 0; pass < FrameStats::NUM_PASSES; ++pass) {
+        _gpuTimes[pass].reserve(WINDOW);
+        _nextGpuTime[pass] = 0;
+    }
+    setAttribute(Qt::WA_TransparentForMouseEvents);
+    setTextFormat(Qt::PlainText);
+    setStyleSheet("QLabel { background-color: rgba(0, 0, 0, 160); color: white;"
+                  " font-family: monospace; padding: 6px; }");
+    move(8, 8);
+
+    _refreshTimer.setInterval(REFRESH_INTERVAL);
+    connect(&_refreshTimer, SIGNAL(timeout()), this, SLOT(refresh()));
+}
+
+// -----------------------------------------------------------------------------
+// -- Signals and slots --------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+void ProfilerOverlay::addFrameStats(const FrameStats &stats)
+{
+    for (int pass = 0; pass < FrameStats::NUM_PASSES; ++pass) {
+        if (!stats.hasPass[pass]) continue;
+        QVector<double> &times = _gpuTimes[pass];
+        if (times.size() < WINDOW) {
+            times.push_back(stats.gpuTime[pass]);
+        } else {
+            times[_nextGpuTime[pass]] = stats.gpuTime[pass];
+            _nextGpuTime[pass] = (_nextGpuTime[pass] + 1) % WINDOW;
+        }
+    }
+}
+
+void ProfilerOverlay::refresh()
+{
+    QStringList rows;
+    char header[160];
+    std::snprintf(header, sizeof(header), "%-28s %8s %8s %8s %8s %5s",
+                  "Scope (ms)", "median", "p95", "p99", "max", "n");
+    rows << QString::fromLatin1(header);
+
+    for (const Profiler::Summary &summary : Profiler::instance().summarize(WINDOW)) {
+        rows << formatRow(summary);
+    }
+    for (int pass = 0; pass < FrameStats::NUM_PASSES; ++pass) {
+        if (_gpuTimes[pass].isEmpty()) continue;
+        rows << formatRow(Profiler::summarizeSamples(PASS_NAMES[pass], _gpuTimes[pass]));
+    }
+    setText(rows.join("\n"));
+    adjustSize();
+}
+
+// -----------------------------------------------------------------------------
+// -- QWidget ------------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+void ProfilerOverlay::showEvent(QShowEvent *event)
+{
+    QLabel::showEvent(event);
+    refresh();
+    _refreshTimer.start();
+}
+
+void ProfilerOverlay::hideEvent(QHideEvent *event)
+{
+    QLabel::hideEvent(event);
+    _refreshTimer.stop();
+}
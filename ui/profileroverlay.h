@@ -0,0 +1,65 @@
+#ifndef PROFILEROVERLAY_H
+#define PROFILEROVERLAY_H
+
+#include <gl/gpuqueryring.h>
+
+#include <QLabel>
+#include <QTimer>
+#include <QVector>
+
+/*!
+ * \brief The ProfilerOverlay class
+ *
+ * Semi-transparent table over the view with rolling percentiles of the
+ * Profiler scopes and of the GPU pass times. Only refreshed while visible.
+ */
+class ProfilerOverlay : public QLabel
+{
+
+    Q_OBJECT
+
+    // =========================================================================
+    // -- Constructors and destructor ------------------------------------------
+    // =========================================================================
+
+public:
+
+    explicit ProfilerOverlay(QWidget *parent = 0);
+
+    // =========================================================================
+    // -- Signals and slots ----------------------------------------------------
+    // =========================================================================
+
+public slots:
+
+    void addFrameStats(const FrameStats &stats);
+
+    void refresh();
+
+    // =========================================================================
+    // -- QWidget --------------------------------------------------------------
+    // =========================================================================
+
+protected:
+
+    virtual void showEvent(QShowEvent *event) override;
+
+    virtual void hideEvent(QHideEvent *event) override;
+
+    // =========================================================================
+    // -- Data members ---------------------------------------------------------
+    // =========================================================================
+
+private:
+
+    QTimer _refreshTimer;
+
+    /// Ring of the last GPU times per pass, in milliseconds
+    QVector<double> _gpuTimes[FrameStats::NUM_PASSES];
+
+    /// Slot to overwrite once the ring is full
+    int _nextGpuTime[FrameStats::NUM_PASSES];
+
+};
+
+#endif // PROFILEROVERLAY_H
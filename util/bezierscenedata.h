@@ -0,0 +1,69 @@
+#ifndef BEZIERSCENEDATA_H
+#define BEZIERSCENEDATA_H
+
+#include <geom/patchbounds.h>
+#include <geom/patchbvh.h>
+#include <geom/patchedgetable.h>
+#include <geom/patchinvariants.h>
+#include <geom/patchlod.h>
+#include <geom/patchstore.h>
+#include <util/pagedsceneformat.h>
+
+#include <QMatrix4x4>
+#include <QVector>
+#include <QVector3D>
+#include <QVector4D>
+
+/*!
+ * \brief The BezierSceneData struct
+ *
+ * CPU side representation of an imported scene. Contains everything that
+ * is needed to set up a BezierScene, without touching OpenGL, so it can be
+ * created on any thread.
+ */
+struct BezierSceneData
+{
+    /// Homogeneous control points, including the interpolated center points
+    QVector<QVector4D> vertices;
+
+    /// Ten vertex indices per triangle patch
+    QVector<unsigned> indices;
+
+    /// Sixteen vertex indices per quad patch, row by row
+    QVector<unsigned> quadIndices;
+
+    /// Indices of the vertices that were interpolated by the importer
+    QVector<unsigned> centerPoints;
+
+    /// Bounding box of the (non interpolated) control points
+    QVector3D minValues, maxValues;
+
+    QMatrix4x4 modelMatrix;
+
+    /// Shares the vertex and index arrays above
+    PatchStore patches;
+
+    /// Bounds and normal cones of the patches, used for culling
+    QVector<PatchBounds> patchBounds;
+
+    /// Hierarchy over patchBounds
+    PatchBVH bvh;
+
+    /// Proxies of the large nodes of bvh, for distant parts of huge scenes
+    PatchLOD lod;
+
+    /// View independent heuristic inputs, uploaded for the control shaders
+    QVector<PatchInvariants> patchInvariants;
+
+    /// Unique patch edges, for tessellation levels shared by neighbours
+    PatchEdgeTable edgeTable;
+
+    /// View independent heuristic inputs per unique edge
+    QVector<EdgeInvariants> edgeInvariants;
+
+    /// Pages of an out-of-core scene, which leaves everything above empty
+    /// except for the bounds and the model matrix
+    PagedSceneFormat::PageTable pageTable;
+};
+
+#endif // BEZIERSCENEDATA_H
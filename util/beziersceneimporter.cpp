@@ -1,14 +1,98 @@
 #include <util/beziersceneimporter.h>
 
 #include <gl/bezierscene.h>
+#include <geom/bezierquad.h>
 #include <geom/beziertriangle.h>
+#include <geom/patchsubdivision.h>
+#include <util/binarysceneformat.h>
+#include <util/bezierscenetokenizer.h>
+#include <util/pagedsceneformat.h>
+#include <util/profiler.h>
 
 #include <QFile>
+#include <QThread>
+#include <QtConcurrent>
 #include <QtDebug>
 
+#include <algorithm>
+#include <cstring>
 #include <limits>
 
-BezierSceneImporter::BezierSceneImporter()
+namespace {
+
+/// Files smaller than this are not worth splitting over multiple threads,
+/// default of setMinChunkSize()
+const qint64 MIN_CHUNK_SIZE = 1 << 20;
+
+/// Tokens of a patch line: 'p' and the control point indices
+const int TRIANGLE_TOKENS = 1 + BezierTriangle::NUM_CONTROL_POINTS - 1;
+const int TRIANGLE_CENTER_TOKENS = 1 + BezierTriangle::NUM_CONTROL_POINTS;
+const int QUAD_TOKENS = 1 + BezierQuad::NUM_CONTROL_POINTS;
+
+/// Same as QString::split(' ', QString::SkipEmptyParts), but the tokens
+/// refer to the line and reuse the capacity of the vector
+void splitLine(const QString &line, QVector<QStringRef> &tokens) {
+    tokens.resize(0);
+    const int size = line.size();
+    int begin = 0;
+    while (begin < size) {
+        if (line.at(begin) == QLatin1Char(' ')) {
+            ++begin;
+            continue;
+        }
+        int end = begin + 1;
+        while (end < size && line.at(end) != QLatin1Char(' ')) {
+            ++end;
+        }
+        tokens.push_back(line.midRef(begin, end - begin));
+        begin = end;
+    }
+}
+
+} // namespace
+
+/*!
+ * \brief The BezierSceneImporter::SceneChunk struct
+ *
+ * Part of a memory mapped file, parsed independently of the other chunks.
+ * Vertex indices in patches are global, except for interpolated center
+ * points, which are stored as slots in the local vertex array and
+ * renumbered when the chunks are merged.
+ */
+struct BezierSceneImporter::SceneChunk {
+    const char *begin;
+    const char *end;
+
+    /// Parsed vertices, with placeholders for the interpolated center points
+    QVector<QVector4D> vertices;
+
+    /// Ten indices per triangle patch
+    QVector<unsigned> indices;
+
+    /// Sixteen indices per quad patch
+    QVector<unsigned> quadIndices;
+
+    /// Offsets into indices of center points that need to be interpolated
+    QVector<unsigned> centerPoints;
+
+    QVector3D minValues, maxValues;
+
+    /// Index of the first vertex of this chunk in the merged vertex array
+    unsigned vertexOffset;
+
+    /// Offset of the first index of this chunk in the merged index array
+    unsigned indexOffset;
+
+    /// Offset of the first quad index of this chunk in the merged array
+    unsigned quadIndexOffset;
+
+};
+
+BezierSceneImporter::BezierSceneImporter() :
+    _cancelFlag(nullptr),
+    _subdivisionTolerance(0.0f),
+    _subdivisionDepth(0),
+    _minChunkSize(MIN_CHUNK_SIZE)
 {
     minValues = QVector3D(
                 std::numeric_limits<float>::max(),
@@ -27,96 +111,538 @@ BezierSceneImporter::~BezierSceneImporter() {
 
 
 
-QSharedPointer<BezierScene> BezierSceneImporter::importBezierScene(QString fileName)
+QSharedPointer<BezierScene> BezierSceneImporter::importBezierScene(
+        QString fileName,
+        ParseMode mode)
 {
     QSharedPointer<BezierScene> scene(new BezierScene());
+    BezierSceneData data;
+    if (importBezierSceneData(fileName, data, mode)) {
+        scene->setSceneData(data);
+    }
+    return scene;
+}
+
+bool BezierSceneImporter::importBezierSceneData(
+        QString fileName,
+        BezierSceneData &data,
+        ParseMode mode)
+{
+    ScopedTimer importTimer("Import");
     QFile fin(fileName);
-    QVector<unsigned> indices;
-    QVector<QVector4D> vertices;
+    if (!fin.open(QIODevice::ReadOnly)) {
+        qWarning() << "Could not open file:" << fileName;
+        return false;
+    }
+    qInfo() << "Importing file:" << fileName;
+
+    const QByteArray pagedMagic = fin.peek(PagedSceneFormat::MAGIC_SIZE);
+    if (PagedSceneFormat::isPagedScene(
+                pagedMagic.constData(), pagedMagic.constData() + pagedMagic.size())) {
+        // Only the page table is read, the pages are streamed in while drawing
+        ScopedTimer timer("Import page table");
+        data.pageTable.fileName = fileName;
+        if (!PagedSceneFormat::readPageTable(fin, data.pageTable)) {
+            qWarning() << "Could not read paged scene:" << fileName;
+            return false;
+        }
+        const PagedSceneFormat::Header &header = data.pageTable.header;
+        minValues = QVector3D(header.minValues[0], header.minValues[1], header.minValues[2]);
+        maxValues = QVector3D(header.maxValues[0], header.maxValues[1], header.maxValues[2]);
+        data.minValues = minValues;
+        data.maxValues = maxValues;
+        data.modelMatrix = calculateModelMatrix();
+        qInfo() << "Paged scene:" << header.numPages << "pages";
+        return true;
+    }
 
-    if (fin.open(QIODevice::ReadOnly)) {
-        qInfo() << "Importing file:" << fileName;
+    bool success = true;
+    const QByteArray magic = fin.peek(BinarySceneFormat::MAGIC_SIZE);
+    const bool isBinary = BinarySceneFormat::isBinaryScene(
+                magic.constData(), magic.constData() + magic.size());
+    if (mode == TextStream && !isBinary) {
+        // Reading and tokenizing are interleaved with parsing
+        ScopedTimer timer("Import parse");
         QTextStream in(&fin);
-        parseScene(in, vertices, indices, *scene.data());
-        scene->setIndexBuffer(indices);
-        scene->setVertexBuffer(vertices);
-        scene->setModelMatrix(calculateModelMatrix());
+        parseScene(in, data);
     } else {
-        qWarning() << "Could not open file:" << fileName;
+        const qint64 size = fin.size();
+        uchar *mapped = nullptr;
+        QByteArray bytes;
+        {
+            // Pages of a mapped file are only read while parsing
+            ScopedTimer timer("Import read");
+            mapped = size > 0 ? fin.map(0, size) : nullptr;
+            if (!mapped) {
+                // Compressed resources and some devices can not be mapped
+                bytes = fin.readAll();
+            }
+        }
+        const char *begin = mapped ?
+                    reinterpret_cast<const char *>(mapped) : bytes.constData();
+        const char *end = begin + (mapped ? size : bytes.size());
+
+        ScopedTimer timer("Import parse");
+        if (isBinary) {
+            success = BinarySceneFormat::read(begin, end, data);
+            if (success) {
+                minValues = data.minValues;
+                maxValues = data.maxValues;
+            }
+        } else if (mode == ParallelMemoryMapped) {
+            parseParallelScene(begin, end, data);
+        } else {
+            parseMappedScene(begin, end, data);
+        }
+        if (mapped) {
+            fin.unmap(mapped);
+        }
     }
-    return scene;
+    if (isCancelled()) {
+        qInfo() << "Import cancelled:" << fileName;
+        return false;
+    }
+    if (!success) {
+        qWarning() << "Could not read binary scene:" << fileName;
+        return false;
+    }
+    data.minValues = minValues;
+    data.maxValues = maxValues;
+    data.modelMatrix = calculateModelMatrix();
+    data.patches = PatchStore(data.vertices, data.indices, data.quadIndices);
+    if (_subdivisionTolerance > 0.0f) {
+        ScopedTimer timer("Import subdivide");
+        const int numPatches = data.patches.size();
+        data.patches = PatchSubdivision::subdivide(
+                    data.patches, _subdivisionTolerance, _subdivisionDepth);
+        // The original vertices stay in front, so centerPoints stays valid
+        data.vertices = data.patches.controlPoints();
+        data.indices = data.patches.indices(BezierPatch::TriPatch);
+        qInfo() << "Pre-subdivision:" << numPatches << "->" << data.patches.size() << "patches";
+    }
+    {
+        ScopedTimer timer("Import bounds");
+        data.patchBounds = PatchBounds::fromPatches(data.patches);
+        data.bvh.build(data.patchBounds);
+    }
+    {
+        ScopedTimer timer("Import LOD");
+        data.lod.build(data.patches, data.bvh);
+    }
+    {
+        ScopedTimer timer("Import invariants");
+        data.patchInvariants = PatchInvariants::fromPatches(data.patches);
+    }
+    {
+        ScopedTimer timer("Import edges");
+        data.edgeTable.build(data.patches);
+        data.edgeInvariants = EdgeInvariants::fromEdges(data.edgeTable, data.vertices);
+    }
+    return true;
+}
+
+void BezierSceneImporter::setCancelFlag(const QAtomicInt *cancelFlag)
+{
+    _cancelFlag = cancelFlag;
+}
+
+void BezierSceneImporter::setPreSubdivision(float tolerance, int maxDepth)
+{
+    _subdivisionTolerance = tolerance;
+    _subdivisionDepth = maxDepth;
+}
+
+void BezierSceneImporter::setMinChunkSize(qint64 minChunkSize)
+{
+    _minChunkSize = std::max<qint64>(1, minChunkSize);
 }
 
 const QVector4D BezierSceneImporter::interpolateTriCenterPoint(const QVector<QVector4D> &points) const
 {
     Q_ASSERT(points.size() == 9);
-    const QVector4D UV003 = points.at(0);
-    const QVector4D UV102 = points.at(1);
-    const QVector4D UV201 = points.at(2);
-    const QVector4D UV300 = points.at(3);
-    const QVector4D UV210 = points.at(4);
-    const QVector4D UV120 = points.at(5);
-    const QVector4D UV030 = points.at(6);
-    const QVector4D UV021 = points.at(7);
-    const QVector4D UV012 = points.at(8);
-
-    // Midpoints are interpolated using: G. Farin
-    // Curves and Surfaces for CAGD, p. 342
-    const QVector4D UV111 =
-            1.0/4.0 * (UV201 + UV102 + UV021 + UV012 + UV210 + UV120)
-            -  1.0/6.0 * (UV300 + UV030 + UV003);
+    return interpolateTriCenterPoint(points.constData());
+}
 
-    return UV111;
+const QVector4D BezierSceneImporter::interpolateTriCenterPoint(const QVector4D *points) const
+{
+    return BezierTriangle::interpolateCenterPoint(points);
 }
 
 
-void BezierSceneImporter::parsePatch(
-        const QStringList &tokens,
+BezierSceneImporter::SceneCounts BezierSceneImporter::countScene(
+        const char *begin,
+        const char *end)
+{
+    SceneCounts counts = {0, 0, 0, 0};
+    BezierSceneTokenizer tokenizer(begin, end);
+    while (tokenizer.nextLine()) {
+        if (tokenizer.tokenEquals(0, 'v')) {
+            ++counts.numVertices;
+        } else if (tokenizer.tokenEquals(0, 'p')) {
+            // Same cases as the parsers
+            const int numTokens = tokenizer.numTokens();
+            if (numTokens == QUAD_TOKENS) {
+                ++counts.numQuads;
+            } else if (numTokens >= TRIANGLE_TOKENS) {
+                ++counts.numTriangles;
+                if (numTokens != TRIANGLE_CENTER_TOKENS) {
+                    ++counts.numInterpolated;
+                }
+            }
+        }
+    }
+    return counts;
+}
+
+void BezierSceneImporter::reserve(
+        const SceneCounts &counts,
         QVector<QVector4D> &vertices,
         QVector<unsigned> &indices,
-        BezierScene &scene)
-{
-    Q_ASSERT(tokens.size() == 10 || tokens.size() == 11);
-    QVector<QVector4D> patchVertices;
-    patchVertices.reserve(10);
-    // TODO: check for QUAD patches
-
-    for (unsigned i = 1; i < 10; ++i) {
-        unsigned index = tokens.at(i).toUInt();
-        Q_ASSERT(index < static_cast<unsigned>(vertices.size()));
-        indices.push_back(index);
-        patchVertices.push_back(vertices.at(index));
-    }
-    if (tokens.size() == 11) {
-        unsigned midpoint = tokens.at(10).toUInt();
-        indices.push_back(midpoint);
-        patchVertices.push_back(vertices.at(midpoint));
+        QVector<unsigned> &quadIndices,
+        QVector<unsigned> &centerPoints)
+{
+    // Interpolated center points are appended to the vertices
+    vertices.reserve(vertices.size() + counts.numVertices + counts.numInterpolated);
+    indices.reserve(indices.size() + BezierTriangle::NUM_CONTROL_POINTS * counts.numTriangles);
+    quadIndices.reserve(quadIndices.size() + BezierQuad::NUM_CONTROL_POINTS * counts.numQuads);
+    centerPoints.reserve(centerPoints.size() + counts.numInterpolated);
+}
+
+void BezierSceneImporter::addTriangle(
+        const unsigned *patchIndices,
+        bool hasCenterPoint,
+        BezierSceneData &data)
+{
+    QVector<QVector4D> &vertices = data.vertices;
+    QVector<unsigned> &indices = data.indices;
+
+    for (unsigned i = 0; i < 9; ++i) {
+        Q_ASSERT(patchIndices[i] < static_cast<unsigned>(vertices.size()));
+        indices.push_back(patchIndices[i]);
+    }
+    if (hasCenterPoint) {
+        indices.push_back(patchIndices[9]);
     } else {
         // interpolate midpoint
+        QVector4D patchVertices[9];
+        for (unsigned i = 0; i < 9; ++i) {
+            patchVertices[i] = vertices.at(patchIndices[i]);
+        }
+        data.centerPoints.push_back(vertices.size());
         indices.push_back(vertices.size());
-        const QVector4D center = interpolateTriCenterPoint(patchVertices);
-        vertices.push_back(center);
-        patchVertices.push_back(center);
+        vertices.push_back(interpolateTriCenterPoint(patchVertices));
     }
-    scene.addBezierTriangle(BezierTriangle(patchVertices));
+}
+
+void BezierSceneImporter::addQuad(
+        const unsigned *patchIndices,
+        BezierSceneData &data)
+{
+    for (int i = 0; i < BezierQuad::NUM_CONTROL_POINTS; ++i) {
+        Q_ASSERT(patchIndices[i] < static_cast<unsigned>(data.vertices.size()));
+        data.quadIndices.push_back(patchIndices[i]);
+    }
+}
+
+void BezierSceneImporter::addVertex(
+        const QVector4D &point,
+        QVector<QVector4D> &vertices)
+{
+    checkMinMax(QVector3D(
+                    point.x() / point.w(),
+                    point.y() / point.w(),
+                    point.z() / point.w()));
+    vertices.push_back(point);
+}
+
+void BezierSceneImporter::parseChunk(SceneChunk &chunk) const
+{
+    reserve(countScene(chunk.begin, chunk.end),
+            chunk.vertices, chunk.indices, chunk.quadIndices, chunk.centerPoints);
+
+    BezierSceneTokenizer tokenizer(chunk.begin, chunk.end);
+    while (tokenizer.nextLine() && !isCancelled()) {
+        const int numTokens = tokenizer.numTokens();
+        if (tokenizer.tokenEquals(0, 'v')) {
+            Q_ASSERT(numTokens == 5);
+            if (numTokens < 5) {
+                qWarning() << "Vertex has too few coordinates:" << QString::fromLatin1(
+                                  tokenizer.lineBegin(),
+                                  tokenizer.lineEnd() - tokenizer.lineBegin());
+                continue;
+            }
+            const QVector4D point(
+                        BezierSceneTokenizer::toFloat(tokenizer.token(1)),
+                        BezierSceneTokenizer::toFloat(tokenizer.token(2)),
+                        BezierSceneTokenizer::toFloat(tokenizer.token(3)),
+                        BezierSceneTokenizer::toFloat(tokenizer.token(4)));
+            checkMinMax(QVector3D(
+                            point.x() / point.w(),
+                            point.y() / point.w(),
+                            point.z() / point.w()),
+                        chunk.minValues,
+                        chunk.maxValues);
+            chunk.vertices.push_back(point);
+        } else if (tokenizer.tokenEquals(0, 'p')) {
+            Q_ASSERT(numTokens == TRIANGLE_TOKENS ||
+                     numTokens == TRIANGLE_CENTER_TOKENS ||
+                     numTokens == QUAD_TOKENS);
+            if (numTokens < TRIANGLE_TOKENS) {
+                qWarning() << "Patch has too few control points:" << QString::fromLatin1(
+                                  tokenizer.lineBegin(),
+                                  tokenizer.lineEnd() - tokenizer.lineBegin());
+                continue;
+            }
+            if (numTokens == QUAD_TOKENS) {
+                for (int i = 1; i < QUAD_TOKENS; ++i) {
+                    chunk.quadIndices.push_back(BezierSceneTokenizer::toUInt(tokenizer.token(i)));
+                }
+                continue;
+            }
+            for (int i = 1; i < 10; ++i) {
+                chunk.indices.push_back(BezierSceneTokenizer::toUInt(tokenizer.token(i)));
+            }
+            if (numTokens == TRIANGLE_CENTER_TOKENS) {
+                chunk.indices.push_back(BezierSceneTokenizer::toUInt(tokenizer.token(10)));
+            } else {
+                // Reserve a slot, the center is interpolated after merging
+                chunk.centerPoints.push_back(chunk.indices.size());
+                chunk.indices.push_back(chunk.vertices.size());
+                chunk.vertices.push_back(QVector4D());
+            }
+        } else {
+            qWarning() << "Unknown line:" << QString::fromLatin1(
+                              tokenizer.lineBegin(),
+                              tokenizer.lineEnd() - tokenizer.lineBegin()) << endl;
+        }
+    }
+}
+
+void BezierSceneImporter::parseMappedScene(
+        const char *begin,
+        const char *end,
+        BezierSceneData &data)
+{
+    {
+        // Every array is allocated once instead of growing line by line
+        ScopedTimer timer("Import count");
+        reserve(countScene(begin, end),
+                data.vertices, data.indices, data.quadIndices, data.centerPoints);
+    }
+
+    BezierSceneTokenizer tokenizer(begin, end);
+    while (tokenizer.nextLine() && !isCancelled()) {
+        if (tokenizer.tokenEquals(0, 'v')) {
+            parseMappedVertex(tokenizer, data.vertices);
+        } else if (tokenizer.tokenEquals(0, 'p')) {
+            parseMappedPatch(tokenizer, data);
+        } else {
+            qWarning() << "Unknown line:" << QString::fromLatin1(
+                              tokenizer.lineBegin(),
+                              tokenizer.lineEnd() - tokenizer.lineBegin()) << endl;
+        }
+    }
+}
+
+void BezierSceneImporter::parseMappedPatch(
+        const BezierSceneTokenizer &tokenizer,
+        BezierSceneData &data)
+{
+    const int numTokens = tokenizer.numTokens();
+    Q_ASSERT(numTokens == TRIANGLE_TOKENS ||
+             numTokens == TRIANGLE_CENTER_TOKENS ||
+             numTokens == QUAD_TOKENS);
+    if (numTokens < TRIANGLE_TOKENS) {
+        qWarning() << "Patch has too few control points:" << QString::fromLatin1(
+                          tokenizer.lineBegin(),
+                          tokenizer.lineEnd() - tokenizer.lineBegin());
+        return;
+    }
+    if (numTokens == QUAD_TOKENS) {
+        unsigned patchIndices[BezierQuad::NUM_CONTROL_POINTS];
+        for (int i = 0; i < BezierQuad::NUM_CONTROL_POINTS; ++i) {
+            patchIndices[i] = BezierSceneTokenizer::toUInt(tokenizer.token(i + 1));
+        }
+        addQuad(patchIndices, data);
+        return;
+    }
+
+    const bool hasCenterPoint = numTokens == TRIANGLE_CENTER_TOKENS;
+    unsigned patchIndices[10];
+    for (int i = 0; i < (hasCenterPoint ? 10 : 9); ++i) {
+        patchIndices[i] = BezierSceneTokenizer::toUInt(tokenizer.token(i + 1));
+    }
+    addTriangle(patchIndices, hasCenterPoint, data);
+}
+
+void BezierSceneImporter::parseMappedVertex(
+        const BezierSceneTokenizer &tokenizer,
+        QVector<QVector4D> &vertices)
+{
+    Q_ASSERT(tokenizer.numTokens() == 5);
+    if (tokenizer.numTokens() < 5) {
+        qWarning() << "Vertex has too few coordinates:" << QString::fromLatin1(
+                          tokenizer.lineBegin(),
+                          tokenizer.lineEnd() - tokenizer.lineBegin());
+        return;
+    }
+    addVertex(QVector4D(
+                  BezierSceneTokenizer::toFloat(tokenizer.token(1)),
+                  BezierSceneTokenizer::toFloat(tokenizer.token(2)),
+                  BezierSceneTokenizer::toFloat(tokenizer.token(3)),
+                  BezierSceneTokenizer::toFloat(tokenizer.token(4))),
+              vertices);
+}
+
+void BezierSceneImporter::parseParallelScene(
+        const char *begin,
+        const char *end,
+        BezierSceneData &data)
+{
+    const qint64 size = end - begin;
+    const int numChunks = static_cast<int>(std::min<qint64>(
+                size / _minChunkSize,
+                4 * std::max(1, QThread::idealThreadCount())));
+    if (numChunks < 2) {
+        parseMappedScene(begin, end, data);
+        return;
+    }
+
+    // Split the file at line boundaries
+    QVector<SceneChunk> chunks(numChunks);
+    const char *chunkBegin = begin;
+    for (int i = 0; i < numChunks; ++i) {
+        const char *chunkEnd = begin + size * (i + 1) / numChunks;
+        if (chunkEnd < chunkBegin) {
+            chunkEnd = chunkBegin;
+        }
+        if (i == numChunks - 1) {
+            chunkEnd = end;
+        } else if (chunkEnd != end) {
+            const char *newline = static_cast<const char *>(
+                        std::memchr(chunkEnd, '\n', end - chunkEnd));
+            chunkEnd = newline ? newline + 1 : end;
+        }
+        SceneChunk &chunk = chunks[i];
+        chunk.begin = chunkBegin;
+        chunk.end = chunkEnd;
+        chunk.minValues = minValues;
+        chunk.maxValues = maxValues;
+        chunkBegin = chunkEnd;
+    }
+
+    QtConcurrent::blockingMap(chunks, [this](SceneChunk &chunk) {
+        ScopedTimer timer("Import parse chunk");
+        parseChunk(chunk);
+    });
+    if (isCancelled()) return;
+
+    // Deterministic merge, in file order
+    ScopedTimer timer("Import merge");
+    QVector<QVector4D> &vertices = data.vertices;
+    QVector<unsigned> &indices = data.indices;
+    QVector<unsigned> &quadIndices = data.quadIndices;
+    unsigned numVertices = vertices.size();
+    unsigned numIndices = indices.size();
+    unsigned numQuadIndices = quadIndices.size();
+    int numCenterPoints = data.centerPoints.size();
+    for (SceneChunk &chunk : chunks) {
+        chunk.vertexOffset = numVertices;
+        chunk.indexOffset = numIndices;
+        chunk.quadIndexOffset = numQuadIndices;
+        numVertices += chunk.vertices.size();
+        numIndices += chunk.indices.size();
+        numQuadIndices += chunk.quadIndices.size();
+        numCenterPoints += chunk.centerPoints.size();
+        for (int axis = 0; axis < 3; ++axis) {
+            if (chunk.maxValues[axis] > maxValues[axis]) {
+                maxValues[axis] = chunk.maxValues[axis];
+            }
+            if (chunk.minValues[axis] < minValues[axis]) {
+                minValues[axis] = chunk.minValues[axis];
+            }
+        }
+    }
+    vertices.resize(numVertices);
+    indices.resize(numIndices);
+    quadIndices.resize(numQuadIndices);
+    data.centerPoints.reserve(numCenterPoints);
+
+    QtConcurrent::blockingMap(chunks, [&vertices, &indices, &quadIndices](SceneChunk &chunk) {
+        std::copy(chunk.vertices.constBegin(), chunk.vertices.constEnd(),
+                  vertices.data() + chunk.vertexOffset);
+        for (const unsigned offset : chunk.centerPoints) {
+            chunk.indices[offset] += chunk.vertexOffset;
+        }
+        std::copy(chunk.indices.constBegin(), chunk.indices.constEnd(),
+                  indices.data() + chunk.indexOffset);
+        std::copy(chunk.quadIndices.constBegin(), chunk.quadIndices.constEnd(),
+                  quadIndices.data() + chunk.quadIndexOffset);
+        chunk.vertices.clear();
+        chunk.indices.clear();
+        chunk.quadIndices.clear();
+    });
+
+    // Center points may refer to any earlier vertex, so these are
+    // interpolated in file order, which is cheap compared to parsing
+    QVector4D patchVertices[9];
+    for (const SceneChunk &chunk : chunks) {
+        for (const unsigned offset : chunk.centerPoints) {
+            const unsigned *patchIndices = indices.constData() + chunk.indexOffset + offset - 9;
+            for (int i = 0; i < 9; ++i) {
+                Q_ASSERT(patchIndices[i] < patchIndices[9]);
+                patchVertices[i] = vertices.at(patchIndices[i]);
+            }
+            vertices[patchIndices[9]] = interpolateTriCenterPoint(patchVertices);
+            data.centerPoints.push_back(patchIndices[9]);
+        }
+    }
+}
+
+void BezierSceneImporter::parsePatch(
+        const QVector<QStringRef> &tokens,
+        BezierSceneData &data)
+{
+    Q_ASSERT(tokens.size() == TRIANGLE_TOKENS ||
+             tokens.size() == TRIANGLE_CENTER_TOKENS ||
+             tokens.size() == QUAD_TOKENS);
+    if (tokens.size() < TRIANGLE_TOKENS) {
+        qWarning() << "Patch has too few control points:" << *tokens.first().string();
+        return;
+    }
+    if (tokens.size() == QUAD_TOKENS) {
+        unsigned patchIndices[BezierQuad::NUM_CONTROL_POINTS];
+        for (int i = 0; i < BezierQuad::NUM_CONTROL_POINTS; ++i) {
+            patchIndices[i] = tokens.at(i + 1).toUInt();
+        }
+        addQuad(patchIndices, data);
+        return;
+    }
+
+    const bool hasCenterPoint = tokens.size() == TRIANGLE_CENTER_TOKENS;
+    unsigned patchIndices[10];
+    for (int i = 0; i < (hasCenterPoint ? 10 : 9); ++i) {
+        patchIndices[i] = tokens.at(i + 1).toUInt();
+    }
+    addTriangle(patchIndices, hasCenterPoint, data);
 }
 
 void BezierSceneImporter::parseScene(QTextStream &in,
-                                     QVector<QVector4D> &vertices,
-                                     QVector<unsigned> &indices,
-                                     BezierScene &scene)
+                                     BezierSceneData &data)
 {
+    // Both are reused for every line, the text stream can not be counted
+    // in advance, so the arrays grow as usual
     QString line;
-    QStringList tokens;
-    while (in.readLineInto(&line)) {
+    QVector<QStringRef> tokens;
+    while (in.readLineInto(&line) && !isCancelled()) {
         if (line.startsWith("#")) continue; // skip comments
-        tokens = line.split(" ", QString::SkipEmptyParts);
+        splitLine(line, tokens);
         if (tokens.size() < 1) continue; // skip empty lines
 
         if (tokens[0] == "v") {
-            parseVertex(tokens, vertices);
+            parseVertex(tokens, data.vertices);
         } else if (tokens[0] == "p") {
-            parsePatch(tokens, vertices, indices, scene);
+            parsePatch(tokens, data);
         } else {
             qWarning() << "Unknown line:" << line << endl;
         }
@@ -125,7 +651,7 @@ void BezierSceneImporter::parseScene(QTextStream &in,
 }
 
 void BezierSceneImporter::parseVertex(
-        const QStringList &tokens,
+        const QVector<QStringRef> &tokens,
         QVector<QVector4D> &vertices)
 {
     Q_ASSERT(tokens.size() == 5);
@@ -133,15 +659,18 @@ void BezierSceneImporter::parseVertex(
     double y = tokens.at(2).toDouble();
     double z = tokens.at(3).toDouble();
     double w = tokens.at(4).toDouble();
-    const QVector4D point(x, y, z, w);
-    checkMinMax(QVector3D(
-                    point.x() / point.w(),
-                    point.y() / point.w(),
-                    point.z() / point.w()));
-    vertices.push_back(point);
+    addVertex(QVector4D(x, y, z, w), vertices);
 }
 
 void BezierSceneImporter::checkMinMax(const QVector3D &point)
+{
+    checkMinMax(point, minValues, maxValues);
+}
+
+void BezierSceneImporter::checkMinMax(
+        const QVector3D &point,
+        QVector3D &minValues,
+        QVector3D &maxValues)
 {
     if (point.x() > maxValues.x()) {
         maxValues.setX(point.x());
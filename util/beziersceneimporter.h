@@ -1,7 +1,11 @@
 #ifndef BEZIERSCENEIMPORTER_H
 #define BEZIERSCENEIMPORTER_H
 
+#include <util/bezierscenedata.h>
+
+#include <QAtomicInt>
 #include <QSharedPointer>
+#include <QStringRef>
 #include <QTextStream>
 #include <QVector>
 #include <QVector3D>
@@ -9,37 +13,125 @@
 
 // Fwd Declare
 class BezierScene;
+class BezierSceneTokenizer;
 
 class BezierSceneImporter
 {
+    friend class CoreBenchmark;
 
 public:
+
+    enum ParseMode {
+        /// Reads the file line by line through a QTextStream
+        TextStream,
+        /// Memory maps the file and tokenizes it in place
+        MemoryMapped,
+        /// Memory maps the file and parses chunks of it on the thread pool
+        ParallelMemoryMapped
+    };
+
     BezierSceneImporter();
 
     virtual ~BezierSceneImporter();
 
-    QSharedPointer<BezierScene> importBezierScene(QString fileName);
+    QSharedPointer<BezierScene> importBezierScene(
+            QString fileName,
+            ParseMode mode = MemoryMapped);
+
+    /// Imports a text or binary scene, or the page table of a paged scene,
+    /// without touching OpenGL
+    bool importBezierSceneData(
+            QString fileName,
+            BezierSceneData &data,
+            ParseMode mode = MemoryMapped);
+
+    /// Import is aborted (and fails) as soon as the flag becomes non-zero
+    void setCancelFlag(const QAtomicInt *cancelFlag);
+
+    bool isCancelled() const {
+        return _cancelFlag && _cancelFlag->loadAcquire() != 0;
+    }
+
+    /// Splits strongly curved triangles after the import, see
+    /// PatchSubdivision::subdivide(). A tolerance of 0 disables it.
+    void setPreSubdivision(float tolerance, int maxDepth);
+
+    /// Smallest chunk of the ParallelMemoryMapped parse in bytes, files
+    /// below twice this size are parsed on one thread. Tests lower it to
+    /// split the small bundled scenes.
+    void setMinChunkSize(qint64 minChunkSize);
 
 private:
 
-    const QVector4D interpolateTriCenterPoint(const QVector<QVector4D> &points) const;
+    struct SceneChunk;
+
+    /// Lines of a scene by kind, see countScene()
+    struct SceneCounts {
+        int numVertices;
+        int numTriangles;
+        /// Triangles without a center point, interpolated while parsing
+        int numInterpolated;
+        int numQuads;
+    };
 
-    void parsePatch(const QStringList &tokens,
+    /// Counts the vertex and patch lines without parsing any numbers, so
+    /// the arrays of a scene can be allocated once before parsing
+    static SceneCounts countScene(const char *begin, const char *end);
+
+    /// Reserves the arrays for the counted lines on top of their contents
+    static void reserve(const SceneCounts &counts,
             QVector<QVector4D> &vertices,
             QVector<unsigned> &indices,
-            BezierScene &scene);
+            QVector<unsigned> &quadIndices,
+            QVector<unsigned> &centerPoints);
+
+    const QVector4D interpolateTriCenterPoint(const QVector<QVector4D> &points) const;
+
+    const QVector4D interpolateTriCenterPoint(const QVector4D *points) const;
+
+    void addTriangle(const unsigned *patchIndices,
+            bool hasCenterPoint,
+            BezierSceneData &data);
+
+    void addQuad(const unsigned *patchIndices,
+            BezierSceneData &data);
+
+    void addVertex(const QVector4D &point,
+            QVector<QVector4D> &vertices);
+
+    void parseChunk(SceneChunk &chunk) const;
+
+    void parseMappedScene(const char *begin,
+            const char *end,
+            BezierSceneData &data);
+
+    void parseMappedPatch(const BezierSceneTokenizer &tokenizer,
+            BezierSceneData &data);
+
+    void parseMappedVertex(const BezierSceneTokenizer &tokenizer,
+            QVector<QVector4D> &vertices);
+
+    void parseParallelScene(const char *begin,
+            const char *end,
+            BezierSceneData &data);
+
+    void parsePatch(const QVector<QStringRef> &tokens,
+            BezierSceneData &data);
 
     void parseScene(QTextStream &in,
-            QVector<QVector4D> &vertices,
-            QVector<unsigned> &indices,
-            BezierScene &scene);
+            BezierSceneData &data);
 
     void parseVertex(
-            const QStringList &tokens,
+            const QVector<QStringRef> &tokens,
             QVector<QVector4D> &vertices);
 
     void checkMinMax(const QVector3D &point);
 
+    static void checkMinMax(
+            const QVector3D &point,
+            QVector3D &minValues,
+            QVector3D &maxValues);
+
     const QMatrix4x4 calculateModelMatrix() const;
 
     /// Datamemembers
@@ -48,6 +140,13 @@ private:
 
     QVector3D minValues, maxValues;
 
+    const QAtomicInt *_cancelFlag;
+
+    float _subdivisionTolerance;
+    int _subdivisionDepth;
+
+    qint64 _minChunkSize;
+
 };
 
 #endif // BEZIERSCENEIMPORTER_H
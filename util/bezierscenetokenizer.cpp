@@ -0,0 +1,234 @@
+#include <util/bezierscenetokenizer.h>
+
+#include <QString>
+
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+/// Number of decimal digits that always fit in an unsigned 64 bit integer
+const int MAX_MANTISSA_DIGITS = 19;
+
+/// Largest power of ten that can be represented exactly as a long double
+const int MAX_EXACT_POW10 =
+        std::numeric_limits<long double>::digits >= 64 ? 27 : 22;
+
+struct PowersOfTen {
+    PowersOfTen() {
+        table[0] = 1.0L;
+        for (int i = 1; i < 28; ++i) {
+            table[i] = table[i - 1] * 10.0L;
+        }
+    }
+    long double table[28];
+};
+
+const long double *powersOfTen() {
+    static const PowersOfTen powers;
+    return powers.table;
+}
+
+inline bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+} // namespace
+
+// -----------------------------------------------------------------------------
+// -- Constructors and destructor ----------------------------------------------
+// -----------------------------------------------------------------------------
+
+BezierSceneTokenizer::BezierSceneTokenizer(const char *begin, const char *end) :
+    _current(begin),
+    _end(end),
+    _lineBegin(begin),
+    _lineEnd(begin),
+    _numTokens(0)
+{
+    // Skip the UTF-8 byte order mark, QTextStream does the same
+    if (_end - _current >= 3 && std::memcmp(_current, "\xEF\xBB\xBF", 3) == 0) {
+        _current += 3;
+    }
+}
+
+BezierSceneTokenizer::~BezierSceneTokenizer() {
+
+}
+
+// -----------------------------------------------------------------------------
+// -- Other Methods ------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+// --- Public ------------------------------------------------------------------
+
+bool BezierSceneTokenizer::nextLine() {
+    while (_current != _end) {
+        _lineBegin = _current;
+        const char *newline = static_cast<const char *>(
+                    std::memchr(_current, '\n', _end - _current));
+        _lineEnd = newline ? newline : _end;
+        _current = newline ? newline + 1 : _end;
+        if (_lineEnd != _lineBegin && _lineEnd[-1] == '\r') {
+            --_lineEnd;
+        }
+        if (_lineEnd != _lineBegin && *_lineBegin == '#') continue; // skip comments
+
+        _numTokens = 0;
+        const char *p = _lineBegin;
+        while (p != _lineEnd) {
+            if (*p == ' ') {
+                ++p;
+                continue;
+            }
+            const char *tokenBegin = p;
+            while (p != _lineEnd && *p != ' ') {
+                ++p;
+            }
+            if (_numTokens < MAX_TOKENS) {
+                _tokens[_numTokens].begin = tokenBegin;
+                _tokens[_numTokens].end = p;
+            }
+            ++_numTokens;
+        }
+        if (_numTokens > 0) return true; // skip empty lines
+    }
+    _numTokens = 0;
+    return false;
+}
+
+float BezierSceneTokenizer::toFloat(const Token &token) {
+    const char *p = token.begin;
+    const char *end = token.end;
+
+    bool negative = false;
+    if (p != end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        ++p;
+    }
+
+    // Collect up to 19 significant digits, value = mantissa * 10^exponent
+    quint64 mantissa = 0;
+    int numDigits = 0;
+    int exponent = 0;
+    bool hasDigits = false;
+    bool truncated = false;
+
+    for (; p != end && isDigit(*p); ++p) {
+        hasDigits = true;
+        const unsigned digit = *p - '0';
+        if (numDigits < MAX_MANTISSA_DIGITS) {
+            mantissa = mantissa * 10 + digit;
+            if (mantissa != 0) ++numDigits;
+        } else {
+            ++exponent;
+            truncated |= digit != 0;
+        }
+    }
+    if (p != end && *p == '.') {
+        for (++p; p != end && isDigit(*p); ++p) {
+            hasDigits = true;
+            const unsigned digit = *p - '0';
+            if (numDigits < MAX_MANTISSA_DIGITS) {
+                mantissa = mantissa * 10 + digit;
+                if (mantissa != 0) ++numDigits;
+                --exponent;
+            } else {
+                truncated |= digit != 0;
+            }
+        }
+    }
+    if (!hasDigits) {
+        return toFloatFallback(token);
+    }
+    if (p != end && (*p == 'e' || *p == 'E')) {
+        ++p;
+        bool negativeExponent = false;
+        if (p != end && (*p == '-' || *p == '+')) {
+            negativeExponent = *p == '-';
+            ++p;
+        }
+        if (p == end) {
+            return toFloatFallback(token);
+        }
+        int value = 0;
+        for (; p != end && isDigit(*p); ++p) {
+            if (value < 100000) {
+                value = value * 10 + (*p - '0');
+            }
+        }
+        exponent += negativeExponent ? -value : value;
+    }
+    if (p != end) {
+        // Anything else (inf, nan, garbage) takes the slow path
+        return toFloatFallback(token);
+    }
+
+    if (mantissa == 0) {
+        return negative ? -0.0f : 0.0f;
+    }
+    if (exponent > MAX_EXACT_POW10 || exponent < -MAX_EXACT_POW10) {
+        return toFloatFallback(token);
+    }
+
+    // Not a single rounding: the product or quotient is rounded to long
+    // double here and again to float below, and where long double is double
+    // (MSVC) a mantissa above 2^53 is already inexact. The boundary check
+    // below falls back for every value these roundings could move, keep it.
+    const long double *pow10 = powersOfTen();
+    const long double value = exponent >= 0 ?
+                static_cast<long double>(mantissa) * pow10[exponent] :
+                static_cast<long double>(mantissa) / pow10[-exponent];
+
+    if (value > static_cast<long double>(FLT_MAX) * 0.5L ||
+            value < static_cast<long double>(FLT_MIN) * 4.0L) {
+        return toFloatFallback(token);
+    }
+
+    // The text parser rounds to double first and then to float. Both give the
+    // same float, unless the value lies very close to a float rounding boundary.
+    const float result = static_cast<float>(value);
+    const long double below = (static_cast<long double>(result) +
+                               std::nextafter(result, 0.0f)) * 0.5L;
+    const long double above = (static_cast<long double>(result) +
+                               std::nextafter(result, FLT_MAX)) * 0.5L;
+    const long double tolerance = value * (
+                8.0L * std::numeric_limits<long double>::epsilon() +
+                static_cast<long double>(std::numeric_limits<double>::epsilon()) +
+                (truncated ? 1e-17L : 0.0L));
+    if (value - below <= tolerance || above - value <= tolerance) {
+        return toFloatFallback(token);
+    }
+    return negative ? -result : result;
+}
+
+unsigned BezierSceneTokenizer::toUInt(const Token &token) {
+    if (token.begin == token.end) {
+        return toUIntFallback(token);
+    }
+    quint64 value = 0;
+    for (const char *p = token.begin; p != token.end; ++p) {
+        if (!isDigit(*p)) {
+            return toUIntFallback(token);
+        }
+        value = value * 10 + (*p - '0');
+        if (value > std::numeric_limits<unsigned>::max()) {
+            return 0; // QString::toUInt returns 0 on overflow
+        }
+    }
+    return static_cast<unsigned>(value);
+}
+
+// --- Private -----------------------------------------------------------------
+
+float BezierSceneTokenizer::toFloatFallback(const Token &token) {
+    const QString string = QString::fromLatin1(token.begin, token.end - token.begin);
+    return static_cast<float>(string.toDouble());
+}
+
+unsigned BezierSceneTokenizer::toUIntFallback(const Token &token) {
+    const QString string = QString::fromLatin1(token.begin, token.end - token.begin);
+    return string.toUInt();
+}
@@ -0,0 +1,108 @@
+#ifndef BEZIERSCENETOKENIZER_H
+#define BEZIERSCENETOKENIZER_H
+
+/*!
+ * \brief The BezierSceneTokenizer class
+ *
+ * Splits an in-memory .bezier file (usually a memory mapped QFile) into
+ * lines and space separated tokens without copying or allocating. Tokens
+ * point directly into the buffer and are only valid until the next call
+ * to nextLine().
+ *
+ * The tokenizer mirrors the behaviour of the QTextStream based parser:
+ * lines end at "\n" or "\r\n", lines starting with a # are comments and
+ * tokens are separated by spaces only.
+ */
+class BezierSceneTokenizer
+{
+
+    // =========================================================================
+    // -- Enums and types ------------------------------------------------------
+    // =========================================================================
+
+public:
+
+    enum {
+        /// Tokens beyond this number are counted, but not stored
+        MAX_TOKENS = 32
+    };
+
+    struct Token {
+        const char *begin;
+        const char *end;
+    };
+
+    // =========================================================================
+    // -- Constructors and destructor ------------------------------------------
+    // =========================================================================
+
+public:
+
+    BezierSceneTokenizer(const char *begin, const char *end);
+
+    ~BezierSceneTokenizer();
+
+    // =========================================================================
+    // -- Other methods --------------------------------------------------------
+    // =========================================================================
+
+public:
+
+    /// Advances to the next line containing tokens, skipping comments
+    /// and empty lines. Returns false at the end of the buffer.
+    bool nextLine();
+
+    int numTokens() const {
+        return _numTokens;
+    }
+
+    const Token &token(int i) const {
+        return _tokens[i];
+    }
+
+    bool tokenEquals(int i, char c) const {
+        return _tokens[i].end - _tokens[i].begin == 1 && *_tokens[i].begin == c;
+    }
+
+    const char *lineBegin() const {
+        return _lineBegin;
+    }
+
+    const char *lineEnd() const {
+        return _lineEnd;
+    }
+
+    /// Parses the token as QString::toDouble() would, followed by the
+    /// conversion to float that QVector4D does.
+    static float toFloat(const Token &token);
+
+    /// Parses the token as QString::toUInt() would.
+    static unsigned toUInt(const Token &token);
+
+private:
+
+    static float toFloatFallback(const Token &token);
+
+    static unsigned toUIntFallback(const Token &token);
+
+    // =========================================================================
+    // -- Data members ---------------------------------------------------------
+    // =========================================================================
+
+private:
+
+    const char *_current;
+
+    const char *_end;
+
+    const char *_lineBegin;
+
+    const char *_lineEnd;
+
+    Token _tokens[MAX_TOKENS];
+
+    int _numTokens;
+
+};
+
+#endif // BEZIERSCENETOKENIZER_H
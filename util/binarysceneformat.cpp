@@ -0,0 +1,199 @@
+#include <util/binarysceneformat.h>
+
+#include <QSaveFile>
+#include <QtDebug>
+
+#include <cstddef>
+#include <cstring>
+#include <limits>
+
+static_assert(sizeof(QVector4D) == 4 * sizeof(float),
+              "QVector4D must be tightly packed to be stored as is");
+
+namespace {
+
+const char MAGIC[BinarySceneFormat::MAGIC_SIZE + 1] = "BEZSCENE";
+
+/// Header of version 1 files, which end before the quad patches
+const quint32 HEADER_SIZE_V1 = offsetof(BinarySceneFormat::Header, numQuadIndices);
+
+quint64 align(quint64 offset) {
+    return (offset + BinarySceneFormat::ALIGNMENT - 1) &
+            ~static_cast<quint64>(BinarySceneFormat::ALIGNMENT - 1);
+}
+
+/// Checks that the array lies within the file and fits in a QVector
+bool isValidArray(quint64 offset, quint64 count, quint64 elementSize, quint64 fileSize) {
+    if (offset > fileSize) return false;
+    if (count > static_cast<quint64>(std::numeric_limits<int>::max())) return false;
+    return count <= (fileSize - offset) / elementSize;
+}
+
+} // namespace
+
+// -----------------------------------------------------------------------------
+// -- Other Methods ------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+// --- Public ------------------------------------------------------------------
+
+bool BinarySceneFormat::isBinaryScene(const char *begin, const char *end) {
+    return end - begin >= MAGIC_SIZE && std::memcmp(begin, MAGIC, MAGIC_SIZE) == 0;
+}
+
+bool BinarySceneFormat::read(const char *begin, const char *end, BezierSceneData &data) {
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    Q_UNUSED(begin);
+    Q_UNUSED(end);
+    Q_UNUSED(data);
+    qWarning() << "Binary scenes are not supported on big endian systems";
+    return false;
+#else
+    const quint64 fileSize = end - begin;
+    if (fileSize < HEADER_SIZE_V1 || !isBinaryScene(begin, end)) {
+        return false;
+    }
+    Header header;
+    std::memset(&header, 0, sizeof(Header));
+    std::memcpy(&header, begin, HEADER_SIZE_V1);
+    const bool isVersion1 = header.version == 1 && header.headerSize == HEADER_SIZE_V1;
+    if (!isVersion1 && (header.version != VERSION || header.headerSize != sizeof(Header) ||
+                        fileSize < sizeof(Header))) {
+        qWarning() << "Unsupported binary scene version:" << header.version;
+        return false;
+    }
+    if (!isVersion1) {
+        std::memcpy(&header, begin, sizeof(Header));
+    }
+    if (!isValidArray(header.vertexOffset, header.numVertices, sizeof(QVector4D), fileSize) ||
+            !isValidArray(header.indexOffset, header.numIndices, sizeof(unsigned), fileSize) ||
+            !isValidArray(header.centerPointOffset, header.numCenterPoints, sizeof(unsigned), fileSize) ||
+            !isValidArray(header.quadIndexOffset, header.numQuadIndices, sizeof(unsigned), fileSize) ||
+            header.numIndices % 10 != 0 ||
+            header.numQuadIndices % 16 != 0) {
+        qWarning() << "Corrupt binary scene header";
+        return false;
+    }
+
+    data.vertices.resize(static_cast<int>(header.numVertices));
+    std::memcpy(data.vertices.data(),
+                begin + header.vertexOffset,
+                header.numVertices * sizeof(QVector4D));
+    data.indices.resize(static_cast<int>(header.numIndices));
+    std::memcpy(data.indices.data(),
+                begin + header.indexOffset,
+                header.numIndices * sizeof(unsigned));
+    data.centerPoints.resize(static_cast<int>(header.numCenterPoints));
+    std::memcpy(data.centerPoints.data(),
+                begin + header.centerPointOffset,
+                header.numCenterPoints * sizeof(unsigned));
+    data.quadIndices.resize(static_cast<int>(header.numQuadIndices));
+    std::memcpy(data.quadIndices.data(),
+                begin + header.quadIndexOffset,
+                header.numQuadIndices * sizeof(unsigned));
+
+    // A single pass over the indices, so corrupt files can not crash us later
+    unsigned maxIndex = 0;
+    for (const unsigned index : data.indices) {
+        maxIndex = std::max(maxIndex, index);
+    }
+    for (const unsigned index : data.centerPoints) {
+        maxIndex = std::max(maxIndex, index);
+    }
+    for (const unsigned index : data.quadIndices) {
+        maxIndex = std::max(maxIndex, index);
+    }
+    if ((header.numIndices > 0 || header.numCenterPoints > 0 || header.numQuadIndices > 0) &&
+            maxIndex >= header.numVertices) {
+        qWarning() << "Binary scene refers to vertex" << maxIndex
+                   << "of" << header.numVertices;
+        return false;
+    }
+
+    data.minValues = QVector3D(header.minValues[0], header.minValues[1], header.minValues[2]);
+    data.maxValues = QVector3D(header.maxValues[0], header.maxValues[1], header.maxValues[2]);
+    return true;
+#endif
+}
+
+bool BinarySceneFormat::write(QIODevice &device, const BezierSceneData &data) {
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    Q_UNUSED(device);
+    Q_UNUSED(data);
+    qWarning() << "Binary scenes are not supported on big endian systems";
+    return false;
+#else
+    Header header;
+    std::memset(&header, 0, sizeof(Header));
+    std::memcpy(header.magic, MAGIC, MAGIC_SIZE);
+    header.version = VERSION;
+    header.headerSize = sizeof(Header);
+
+    header.numVertices = data.vertices.size();
+    header.vertexOffset = align(sizeof(Header));
+    header.numIndices = data.indices.size();
+    header.indexOffset = align(header.vertexOffset + header.numVertices * sizeof(QVector4D));
+    header.numCenterPoints = data.centerPoints.size();
+    header.centerPointOffset = align(header.indexOffset + header.numIndices * sizeof(unsigned));
+    header.numQuadIndices = data.quadIndices.size();
+    header.quadIndexOffset = align(header.centerPointOffset +
+                                   header.numCenterPoints * sizeof(unsigned));
+
+    for (int axis = 0; axis < 3; ++axis) {
+        header.minValues[axis] = data.minValues[axis];
+        header.maxValues[axis] = data.maxValues[axis];
+    }
+
+    quint64 position = 0;
+    return writeArray(device, position, 0, &header, sizeof(Header)) &&
+            writeArray(device, position, header.vertexOffset,
+                       data.vertices.constData(),
+                       header.numVertices * sizeof(QVector4D)) &&
+            writeArray(device, position, header.indexOffset,
+                       data.indices.constData(),
+                       header.numIndices * sizeof(unsigned)) &&
+            writeArray(device, position, header.centerPointOffset,
+                       data.centerPoints.constData(),
+                       header.numCenterPoints * sizeof(unsigned)) &&
+            writeArray(device, position, header.quadIndexOffset,
+                       data.quadIndices.constData(),
+                       header.numQuadIndices * sizeof(unsigned));
+#endif
+}
+
+bool BinarySceneFormat::write(const QString &fileName, const BezierSceneData &data) {
+    QSaveFile fout(fileName);
+    if (!fout.open(QIODevice::WriteOnly)) {
+        qWarning() << "Could not open file:" << fileName;
+        return false;
+    }
+    if (!write(fout, data)) {
+        qWarning() << "Could not write file:" << fileName << fout.errorString();
+        fout.cancelWriting();
+        return false;
+    }
+    return fout.commit();
+}
+
+// --- Private -----------------------------------------------------------------
+
+bool BinarySceneFormat::writeArray(
+        QIODevice &device,
+        quint64 &position,
+        quint64 offset,
+        const void *data,
+        quint64 size)
+{
+    Q_ASSERT(offset >= position);
+    static const char padding[ALIGNMENT] = {};
+    const qint64 paddingSize = static_cast<qint64>(offset - position);
+    if (paddingSize > 0 && device.write(padding, paddingSize) != paddingSize) {
+        return false;
+    }
+    if (size > 0 && device.write(static_cast<const char *>(data),
+                                 static_cast<qint64>(size)) != static_cast<qint64>(size)) {
+        return false;
+    }
+    position = offset + size;
+    return true;
+}
@@ -0,0 +1,78 @@
+#ifndef BINARYSCENEFORMAT_H
+#define BINARYSCENEFORMAT_H
+
+#include <util/bezierscenedata.h>
+
+#include <QIODevice>
+#include <QString>
+
+/*!
+ * \brief The BinarySceneFormat class
+ *
+ * Compact binary alternative to the text .bezier format. The file starts
+ * with a fixed size header, followed by the vertex array, the triangle index
+ * array, the indices of the interpolated center points and the quad index
+ * array. The arrays are stored exactly as they are uploaded to OpenGL
+ * (little endian, 16 byte aligned), so loading a scene is a plain copy.
+ *
+ * Version 1 files have no quad patches and a shorter header, they can still
+ * be read.
+ */
+class BinarySceneFormat
+{
+
+    // =========================================================================
+    // -- Enums and types ------------------------------------------------------
+    // =========================================================================
+
+public:
+
+    enum {
+        MAGIC_SIZE = 8,
+        VERSION = 2,
+        ALIGNMENT = 16
+    };
+
+    struct Header {
+        char magic[MAGIC_SIZE];
+        quint32 version;
+        quint32 headerSize;
+        quint64 numVertices;
+        quint64 vertexOffset;
+        quint64 numIndices;
+        quint64 indexOffset;
+        quint64 numCenterPoints;
+        quint64 centerPointOffset;
+        float minValues[3];
+        float maxValues[3];
+        // Version 2
+        quint64 numQuadIndices;
+        quint64 quadIndexOffset;
+    };
+
+    // =========================================================================
+    // -- Other methods --------------------------------------------------------
+    // =========================================================================
+
+public:
+
+    static bool isBinaryScene(const char *begin, const char *end);
+
+    /// Reads the arrays and bounding box, patches are not created
+    static bool read(const char *begin, const char *end, BezierSceneData &data);
+
+    static bool write(QIODevice &device, const BezierSceneData &data);
+
+    static bool write(const QString &fileName, const BezierSceneData &data);
+
+private:
+
+    static bool writeArray(QIODevice &device,
+                           quint64 &position,
+                           quint64 offset,
+                           const void *data,
+                           quint64 size);
+
+};
+
+#endif // BINARYSCENEFORMAT_H
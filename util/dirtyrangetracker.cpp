@@ -0,0 +1,67 @@
+#include <util/dirtyrangetracker.h>
+
+#include <algorithm>
+
+// -----------------------------------------------------------------------------
+// -- Constructors and destructor ----------------------------------------------
+// -----------------------------------------------------------------------------
+
+DirtyRangeTracker::DirtyRangeTracker()
+{
+
+}
+
+// -----------------------------------------------------------------------------
+// -- Other Methods ------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+// --- Public ------------------------------------------------------------------
+
+void DirtyRangeTracker::markDirty(int first, int count) {
+    if (count <= 0) return;
+
+    Range range = {first, first + count};
+    // The first range that ends at or after the new one begins, it and the
+    // ranges after it that begin before the new one ends are merged into it
+    QVector<Range>::iterator begin = std::lower_bound(
+                _ranges.begin(), _ranges.end(), range.begin,
+                [](const Range &r, int element) {
+        return r.end < element;
+    });
+    QVector<Range>::iterator end = begin;
+    while (end != _ranges.end() && end->begin <= range.end) {
+        range.begin = std::min(range.begin, end->begin);
+        range.end = std::max(range.end, end->end);
+        ++end;
+    }
+    if (begin == end) {
+        _ranges.insert(begin, range);
+    } else {
+        *begin = range;
+        _ranges.erase(begin + 1, end);
+    }
+}
+
+void DirtyRangeTracker::clear() {
+    _ranges.clear();
+}
+
+QVector<DirtyRangeTracker::Range> DirtyRangeTracker::takeRanges(int mergeGap) {
+    QVector<Range> ranges;
+    ranges.swap(_ranges);
+    if (ranges.size() < 2 || mergeGap <= 0) {
+        return ranges;
+    }
+
+    int merged = 0;
+    for (int i = 1; i < ranges.size(); ++i) {
+        Range &current = ranges[merged];
+        if (ranges[i].begin <= current.end + mergeGap) {
+            current.end = ranges[i].end;
+        } else {
+            ranges[++merged] = ranges[i];
+        }
+    }
+    ranges.resize(merged + 1);
+    return ranges;
+}
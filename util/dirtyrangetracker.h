@@ -0,0 +1,69 @@
+#ifndef DIRTYRANGETRACKER_H
+#define DIRTYRANGETRACKER_H
+
+#include <QVector>
+
+/*!
+ * \brief The DirtyRangeTracker class
+ *
+ * Collects the element ranges of a buffer that were modified since the last
+ * upload. Ranges are kept sorted and disjoint, a new range is merged with
+ * every range it overlaps or touches. Repeated edits of the same elements
+ * therefore never add ranges, and marking an element is logarithmic in the
+ * number of ranges.
+ */
+class DirtyRangeTracker
+{
+
+    // =========================================================================
+    // -- Enums and types ------------------------------------------------------
+    // =========================================================================
+
+public:
+
+    /// Half open range [begin, end) of elements
+    struct Range {
+        int begin;
+        int end;
+    };
+
+    // =========================================================================
+    // -- Constructors and destructor ------------------------------------------
+    // =========================================================================
+
+public:
+
+    DirtyRangeTracker();
+
+    // =========================================================================
+    // -- Other methods --------------------------------------------------------
+    // =========================================================================
+
+public:
+
+    void markDirty(int element) {
+        markDirty(element, 1);
+    }
+
+    void markDirty(int first, int count);
+
+    bool isEmpty() const {
+        return _ranges.isEmpty();
+    }
+
+    void clear();
+
+    /// Sorted, disjoint ranges. Ranges closer than mergeGap are joined as well.
+    QVector<Range> takeRanges(int mergeGap = 0);
+
+    // =========================================================================
+    // -- Data members ---------------------------------------------------------
+    // =========================================================================
+
+private:
+
+    QVector<Range> _ranges;
+
+};
+
+#endif // DIRTYRANGETRACKER_H
@@ -0,0 +1,264 @@
+#include <util/meshwriter.h>
+
+#include <QByteArray>
+#include <QSaveFile>
+#include <QtDebug>
+
+#include <cstdio>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+/// Output is collected in blocks of this size before it is written
+const int BLOCK_SIZE = 1 << 20;
+
+/// Collects formatted output and writes it to the device in large blocks
+class BlockWriter
+{
+public:
+    explicit BlockWriter(QIODevice &device) :
+        _device(device),
+        _ok(true) {
+        _block.reserve(BLOCK_SIZE + 256);
+    }
+
+    void append(const char *data, int size) {
+        _block.append(data, size);
+        if (_block.size() >= BLOCK_SIZE) flush();
+    }
+
+    template<typename T>
+    void appendRaw(const T &value) {
+        append(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+
+    bool flush() {
+        if (!_block.isEmpty()) {
+            _ok = _ok && _device.write(_block) == _block.size();
+            _block.resize(0);
+        }
+        return _ok;
+    }
+
+private:
+    QIODevice &_device;
+    QByteArray _block;
+    bool _ok;
+};
+
+/// Vertex and normal lines of a mesh
+void appendObjVertices(BlockWriter &writer, const BezierTriangleTessellator::Mesh &mesh) {
+    char line[128];
+    for (const QVector3D &v : mesh.vertices) {
+        const int size = std::snprintf(line, sizeof(line), "v %.7g %.7g %.7g\n",
+                                       v.x(), v.y(), v.z());
+        writer.append(line, size);
+    }
+    for (const QVector3D &n : mesh.normals) {
+        const int size = std::snprintf(line, sizeof(line), "vn %.7g %.7g %.7g\n",
+                                       n.x(), n.y(), n.z());
+        writer.append(line, size);
+    }
+}
+
+/// Face lines of a mesh of which the vertices start at firstVertex
+void appendObjFaces(BlockWriter &writer,
+                    const BezierTriangleTessellator::Mesh &mesh,
+                    qint64 firstVertex) {
+    // OBJ indices start at one, normals share the vertex index
+    char line[128];
+    const qint64 offset = firstVertex + 1;
+    for (int i = 0; i + 2 < mesh.indices.size(); i += 3) {
+        const qlonglong a = mesh.indices[i] + offset;
+        const qlonglong b = mesh.indices[i + 1] + offset;
+        const qlonglong c = mesh.indices[i + 2] + offset;
+        const int size = std::snprintf(line, sizeof(line),
+                                       "f %lld//%lld %lld//%lld %lld//%lld\n",
+                                       a, a, b, b, c, c);
+        writer.append(line, size);
+    }
+}
+
+QByteArray plyHeader(qint64 numVertices, qint64 numTriangles) {
+    return QByteArray(
+                "ply\n"
+                "format binary_little_endian 1.0\n"
+                "comment cadrender tessellated mesh\n"
+                "element vertex ") + QByteArray::number(numVertices) + "\n"
+            "property float x\n"
+            "property float y\n"
+            "property float z\n"
+            "property float nx\n"
+            "property float ny\n"
+            "property float nz\n"
+            "element face " + QByteArray::number(numTriangles) + "\n"
+            "property list uchar uint vertex_indices\n"
+            "end_header\n";
+}
+
+void appendPlyVertices(BlockWriter &writer, const BezierTriangleTessellator::Mesh &mesh) {
+    const bool hasNormals = mesh.normals.size() == mesh.vertices.size();
+    for (int i = 0; i < mesh.vertices.size(); ++i) {
+        const QVector3D &v = mesh.vertices[i];
+        const QVector3D n = hasNormals ? mesh.normals[i] : QVector3D();
+        const float values[6] = {v.x(), v.y(), v.z(), n.x(), n.y(), n.z()};
+        writer.appendRaw(values);
+    }
+}
+
+/// Faces of a mesh of which the vertices start at firstVertex
+void appendPlyFaces(BlockWriter &writer,
+                    const BezierTriangleTessellator::Mesh &mesh,
+                    quint32 firstVertex) {
+    const quint8 numIndices = 3;
+    for (int i = 0; i + 2 < mesh.indices.size(); i += 3) {
+        writer.appendRaw(numIndices);
+        const quint32 face[3] = {
+            mesh.indices[i] + firstVertex,
+            mesh.indices[i + 1] + firstVertex,
+            mesh.indices[i + 2] + firstVertex
+        };
+        writer.appendRaw(face);
+    }
+}
+
+} // namespace
+
+// -----------------------------------------------------------------------------
+// -- Constructors and destructor ----------------------------------------------
+// -----------------------------------------------------------------------------
+
+MeshWriter::MeshWriter(QIODevice &device, Format format) :
+    _device(device),
+    _format(format),
+    _numVertices(0),
+    _numTriangles(0),
+    _expectedVertices(0),
+    _expectedTriangles(0)
+{
+
+}
+
+// -----------------------------------------------------------------------------
+// -- Other Methods ------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+// --- Public ------------------------------------------------------------------
+
+bool MeshWriter::begin(qint64 numVertices, qint64 numTriangles)
+{
+    _numVertices = _numTriangles = 0;
+    _expectedVertices = numVertices;
+    _expectedTriangles = numTriangles;
+    _faces.reset();
+    if (_format == Obj) {
+        return true;
+    }
+#if Q_BYTE_ORDER != Q_LITTLE_ENDIAN
+    qWarning() << "Writing PLY files is only supported on little endian hosts";
+    return false;
+#endif
+    if (numVertices > std::numeric_limits<quint32>::max()) {
+        qWarning() << "PLY indices can not address" << numVertices << "vertices";
+        return false;
+    }
+    _faces.reset(new QTemporaryFile());
+    if (!_faces->open()) {
+        qWarning() << "Could not open a temporary file for the faces:" << _faces->errorString();
+        return false;
+    }
+    const QByteArray header = plyHeader(numVertices, numTriangles);
+    return _device.write(header) == header.size();
+}
+
+bool MeshWriter::append(const BezierTriangleTessellator::Mesh &part)
+{
+    BlockWriter writer(_device);
+    if (_format == Obj) {
+        appendObjVertices(writer, part);
+        appendObjFaces(writer, part, _numVertices);
+    } else {
+        if (!_faces) {
+            return false;
+        }
+        BlockWriter faceWriter(*_faces);
+        appendPlyVertices(writer, part);
+        appendPlyFaces(faceWriter, part, quint32(_numVertices));
+        if (!faceWriter.flush()) {
+            qWarning() << "Could not write the faces:" << _faces->errorString();
+            return false;
+        }
+    }
+    _numVertices += part.vertices.size();
+    _numTriangles += part.numTriangles();
+    return writer.flush();
+}
+
+bool MeshWriter::finish()
+{
+    if (_numVertices != _expectedVertices || _numTriangles != _expectedTriangles) {
+        qWarning() << "MeshWriter: wrote" << _numVertices << "vertices and" << _numTriangles
+                   << "triangles instead of" << _expectedVertices << "and" << _expectedTriangles;
+        return false;
+    }
+    if (_format == Obj) {
+        return true;
+    }
+    if (!_faces || !_faces->seek(0)) {
+        return false;
+    }
+    QByteArray block;
+    while (!(block = _faces->read(BLOCK_SIZE)).isEmpty()) {
+        if (_device.write(block) != block.size()) {
+            return false;
+        }
+    }
+    const bool atEnd = _faces->atEnd();
+    _faces.reset();
+    return atEnd;
+}
+
+bool MeshWriter::write(
+        const QString &fileName,
+        const BezierTriangleTessellator::Mesh &mesh,
+        Format format)
+{
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Could not open" << fileName << "for writing:" << file.errorString();
+        return false;
+    }
+    const bool success = format == Obj ? writeObj(file, mesh) : writePly(file, mesh);
+    if (!success || !file.commit()) {
+        qWarning() << "Could not write" << fileName << ":" << file.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool MeshWriter::writeObj(QIODevice &device, const BezierTriangleTessellator::Mesh &mesh)
+{
+    BlockWriter writer(device);
+    appendObjVertices(writer, mesh);
+    appendObjFaces(writer, mesh, 0);
+    return writer.flush();
+}
+
+bool MeshWriter::writePly(QIODevice &device, const BezierTriangleTessellator::Mesh &mesh)
+{
+#if Q_BYTE_ORDER != Q_LITTLE_ENDIAN
+    qWarning() << "Writing PLY files is only supported on little endian hosts";
+    return false;
+#endif
+    const QByteArray header = plyHeader(mesh.vertices.size(), mesh.numTriangles());
+    BlockWriter writer(device);
+    writer.append(header.constData(), header.size());
+    appendPlyVertices(writer, mesh);
+    appendPlyFaces(writer, mesh, 0);
+    return writer.flush();
+}
+
+QString MeshWriter::suffix(Format format) {
+    return format == Obj ? "obj" : "ply";
+}
@@ -0,0 +1,90 @@
+#ifndef MESHWRITER_H
+#define MESHWRITER_H
+
+#include <geom/beziertriangletessellator.h>
+
+#include <QIODevice>
+#include <QString>
+#include <QTemporaryFile>
+
+#include <memory>
+
+/*!
+ * \brief The MeshWriter class
+ *
+ * Writes tessellated meshes as Wavefront OBJ (text) or PLY (binary, little
+ * endian) files, with vertex normals.
+ *
+ * Meshes that do not fit in memory are written in parts by an instance:
+ * begin() with the final size, append() the parts in order and finish().
+ * OBJ parts are written as they come, the PLY faces are collected in a
+ * temporary file until all vertices are written.
+ */
+class MeshWriter
+{
+
+    // =========================================================================
+    // -- Enums and types ------------------------------------------------------
+    // =========================================================================
+
+public:
+
+    enum Format {
+        Obj,
+        Ply
+    };
+
+    // =========================================================================
+    // -- Constructors and destructor ------------------------------------------
+    // =========================================================================
+
+public:
+
+    MeshWriter(QIODevice &device, Format format);
+
+    // =========================================================================
+    // -- Other methods --------------------------------------------------------
+    // =========================================================================
+
+public:
+
+    /// Writes the header of a mesh of the given size
+    bool begin(qint64 numVertices, qint64 numTriangles);
+
+    /// Writes the next part, its indices start at its own first vertex
+    bool append(const BezierTriangleTessellator::Mesh &part);
+
+    /// Completes the mesh, fails if the parts do not match begin()
+    bool finish();
+
+    static bool write(const QString &fileName,
+                      const BezierTriangleTessellator::Mesh &mesh,
+                      Format format);
+
+    static bool writeObj(QIODevice &device, const BezierTriangleTessellator::Mesh &mesh);
+
+    static bool writePly(QIODevice &device, const BezierTriangleTessellator::Mesh &mesh);
+
+    static QString suffix(Format format);
+
+    // =========================================================================
+    // -- Data members ---------------------------------------------------------
+    // =========================================================================
+
+private:
+
+    QIODevice &_device;
+
+    Format _format;
+
+    /// PLY faces written before the last vertex
+    std::unique_ptr<QTemporaryFile> _faces;
+
+    qint64 _numVertices, _numTriangles;
+
+    /// Size given to begin()
+    qint64 _expectedVertices, _expectedTriangles;
+
+};
+
+#endif // MESHWRITER_H
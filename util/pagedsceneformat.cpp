@@ -0,0 +1,661 @@
+#include <util/pagedsceneformat.h>
+
+#include <geom/bezierquad.h>
+#include <geom/beziertriangle.h>
+#include <util/bezierscenedata.h>
+#include <util/bezierscenetokenizer.h>
+
+#include <QFile>
+#include <QHash>
+#include <QSaveFile>
+#include <QTemporaryFile>
+#include <QtDebug>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <numeric>
+
+static_assert(sizeof(PagedSceneFormat::Header) == 88,
+              "PagedSceneFormat::Header must not contain padding");
+static_assert(sizeof(PagedSceneFormat::Page) == 48,
+              "PagedSceneFormat::Page must not contain padding");
+
+namespace {
+
+const char MAGIC[PagedSceneFormat::MAGIC_SIZE + 1] = "BEZPAGED";
+
+/// Most bits per axis of the cells of writeStreamed()
+const int MAX_CELL_BITS = 7;
+
+/// Cells per page writeStreamed() aims for, so pages follow the cells
+const int CELLS_PER_PAGE = 8;
+
+/// Vertices written to the temporary file at once
+const int VERTEX_BLOCK_SIZE = 1 << 16;
+
+/// Patch of writeStreamed() in the temporary file, in cell order
+struct PatchRecord {
+    /// 9 for a triangle without a center point, 10 or 16
+    quint32 numPoints;
+    quint32 indices[BezierQuad::NUM_CONTROL_POINTS];
+    quint32 padding[3];
+    /// Interpolated center point of a triangle without one
+    QVector4D center;
+};
+
+/// Same as in binarysceneformat.cpp
+quint64 align(quint64 offset) {
+    return (offset + PagedSceneFormat::ALIGNMENT - 1) &
+            ~static_cast<quint64>(PagedSceneFormat::ALIGNMENT - 1);
+}
+
+/// Writes zeros up to offset, then the array
+bool writeArray(QIODevice &device, quint64 &position, quint64 offset,
+                const void *data, quint64 size) {
+    Q_ASSERT(offset >= position);
+    static const char padding[PagedSceneFormat::ALIGNMENT] = {};
+    const qint64 paddingSize = static_cast<qint64>(offset - position);
+    if (paddingSize > 0 && device.write(padding, paddingSize) != paddingSize) {
+        return false;
+    }
+    if (size > 0 && device.write(static_cast<const char *>(data),
+                                 static_cast<qint64>(size)) != static_cast<qint64>(size)) {
+        return false;
+    }
+    position = offset + size;
+    return true;
+}
+
+bool readArray(QIODevice &device, quint64 offset, void *data, quint64 size) {
+    if (size == 0) return true;
+    return device.seek(static_cast<qint64>(offset)) &&
+            device.read(static_cast<char *>(data), static_cast<qint64>(size)) ==
+            static_cast<qint64>(size);
+}
+
+/// Same as in geom/patchbvh.cpp
+quint32 expandBits(quint32 v) {
+    v = (v * 0x00010001u) & 0xFF0000FFu;
+    v = (v * 0x00000101u) & 0x0F00F00Fu;
+    v = (v * 0x00000011u) & 0xC30C30C3u;
+    v = (v * 0x00000005u) & 0x49249249u;
+    return v;
+}
+
+/// Control points of a patch line, 0 for lines the importer skips
+int patchPoints(int numTokens) {
+    if (numTokens == 1 + BezierQuad::NUM_CONTROL_POINTS) {
+        return BezierQuad::NUM_CONTROL_POINTS;
+    }
+    if (numTokens == 1 + BezierTriangle::NUM_CONTROL_POINTS) {
+        return BezierTriangle::NUM_CONTROL_POINTS;
+    }
+    // Same as the importer, other lines long enough interpolate the center
+    return numTokens >= BezierTriangle::NUM_CONTROL_POINTS ?
+                BezierTriangle::NUM_CONTROL_POINTS - 1 : 0;
+}
+
+/// Reads the patch on the line of the tokenizer, false if an index is out
+/// of range
+bool readPatch(const BezierSceneTokenizer &tokenizer,
+               quint32 numVertices,
+               PatchRecord &record) {
+    record = PatchRecord();
+    record.numPoints = patchPoints(tokenizer.numTokens());
+    for (quint32 i = 0; i < record.numPoints; ++i) {
+        record.indices[i] = BezierSceneTokenizer::toUInt(tokenizer.token(i + 1));
+        if (record.indices[i] >= numVertices) {
+            qWarning() << "Patch index out of range:" << QString::fromLatin1(
+                              tokenizer.lineBegin(),
+                              tokenizer.lineEnd() - tokenizer.lineBegin());
+            return false;
+        }
+    }
+    return true;
+}
+
+/// Cell of the average corner of a patch on a grid of 2^bits cells per axis
+quint32 patchCell(const PatchRecord &record,
+                  const QVector4D *vertices,
+                  const QVector3D &minValues,
+                  const QVector3D &extent,
+                  int bits) {
+    // B003, B300 and B030, or the corners of a quad
+    const int triangleCorners[] = {0, 3, 6};
+    const int quadCorners[] = {0, 3, 12, 15};
+    const bool isQuad = record.numPoints == BezierQuad::NUM_CONTROL_POINTS;
+    const int numCorners = isQuad ? 4 : 3;
+    QVector3D center;
+    for (int i = 0; i < numCorners; ++i) {
+        const QVector4D &point = vertices[record.indices[
+                isQuad ? quadCorners[i] : triangleCorners[i]]];
+        center += point.toVector3D() / point.w();
+    }
+    center /= numCorners;
+
+    quint32 cell = 0;
+    for (int axis = 0; axis < 3; ++axis) {
+        const float unit = extent[axis] > 0.0f ?
+                    (center[axis] - minValues[axis]) / extent[axis] : 0.0f;
+        const float cells = static_cast<float>(1 << bits);
+        cell |= expandBits(static_cast<quint32>(qBound(0.0f, unit * cells, cells - 1.0f)))
+                << (2 - axis);
+    }
+    return cell;
+}
+
+/// Patches in the order of the BVH leaves, so pages are spatially coherent
+QVector<int> patchOrder(const BezierSceneData &data) {
+    const int numPatches = data.patches.size();
+    QVector<int> order(numPatches);
+    if (data.bvh.numPatches() == numPatches && numPatches > 0) {
+        for (int i = 0; i < numPatches; ++i) {
+            order[i] = data.bvh.leafPatch(numPatches - 1 + i);
+        }
+    } else {
+        std::iota(order.begin(), order.end(), 0);
+    }
+    return order;
+}
+
+} // namespace
+
+// -----------------------------------------------------------------------------
+// -- Other Methods ------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+// --- Public ------------------------------------------------------------------
+
+bool PagedSceneFormat::isPagedScene(const char *begin, const char *end) {
+    return end - begin >= MAGIC_SIZE && std::memcmp(begin, MAGIC, MAGIC_SIZE) == 0;
+}
+
+bool PagedSceneFormat::write(QIODevice &device,
+                             const BezierSceneData &data,
+                             int patchesPerPage) {
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    Q_UNUSED(device);
+    Q_UNUSED(data);
+    Q_UNUSED(patchesPerPage);
+    qWarning() << "Paged scenes are not supported on big endian systems";
+    return false;
+#else
+    if (device.isSequential() || patchesPerPage <= 0) {
+        return false;
+    }
+    const PatchStore &patches = data.patches;
+    const QVector<int> order = patchOrder(data);
+    const int numPages = (order.size() + patchesPerPage - 1) / patchesPerPage;
+
+    Header header;
+    initHeader(header, numPages);
+    header.numPatches[BezierPatch::TriPatch] = patches.numPatches(BezierPatch::TriPatch);
+    header.numPatches[BezierPatch::QuadPatch] = patches.numPatches(BezierPatch::QuadPatch);
+    for (int axis = 0; axis < 3; ++axis) {
+        header.minValues[axis] = data.minValues[axis];
+        header.maxValues[axis] = data.maxValues[axis];
+    }
+
+    // The table is written again once the sizes of the pages are known
+    QVector<Page> pages(numPages);
+    if (!writePageTable(device, header, pages)) {
+        return false;
+    }
+    quint64 position = header.pageTableOffset + sizeof(Page) * quint64(numPages);
+
+    const bool hasBounds = data.patchBounds.size() == patches.size();
+    QHash<unsigned, unsigned> localIndex;
+    PageData pageData;
+    for (int pageNumber = 0; pageNumber < numPages; ++pageNumber) {
+        const int first = pageNumber * patchesPerPage;
+        const int last = std::min(first + patchesPerPage, order.size());
+        localIndex.clear();
+        pageData.vertices.clear();
+        pageData.indices.clear();
+        pageData.quadIndices.clear();
+        QVector3D minValues(std::numeric_limits<float>::max(),
+                            std::numeric_limits<float>::max(),
+                            std::numeric_limits<float>::max());
+        QVector3D maxValues = -minValues;
+
+        for (int i = first; i < last; ++i) {
+            const int patch = order[i];
+            const BezierPatch::Type type = patches.patchType(patch);
+            const unsigned *indices = patches.patchIndices(type, patch - patches.firstPatch(type));
+            QVector<unsigned> &pageIndices = type == BezierPatch::TriPatch ?
+                        pageData.indices : pageData.quadIndices;
+            for (int point = 0; point < PatchStore::numControlPoints(type); ++point) {
+                auto it = localIndex.find(indices[point]);
+                if (it == localIndex.end()) {
+                    it = localIndex.insert(indices[point], pageData.vertices.size());
+                    pageData.vertices.push_back(patches.controlPoints()[indices[point]]);
+                }
+                pageIndices.push_back(*it);
+            }
+            if (hasBounds && data.patchBounds[patch].isBounded) {
+                const PatchBounds &bounds = data.patchBounds[patch];
+                for (int axis = 0; axis < 3; ++axis) {
+                    minValues[axis] = std::min(minValues[axis], bounds.minValues[axis]);
+                    maxValues[axis] = std::max(maxValues[axis], bounds.maxValues[axis]);
+                }
+            } else {
+                // Unbounded patches get the box of the whole scene
+                minValues = data.minValues;
+                maxValues = data.maxValues;
+            }
+        }
+
+        Page &page = pages[pageNumber];
+        for (int axis = 0; axis < 3; ++axis) {
+            page.minValues[axis] = minValues[axis];
+            page.maxValues[axis] = maxValues[axis];
+        }
+        if (!writePage(device, position, pageData, page, header)) {
+            return false;
+        }
+    }
+
+    const qint64 end = device.pos();
+    return writePageTable(device, header, pages) && device.seek(end);
+#endif
+}
+
+bool PagedSceneFormat::write(const QString &fileName,
+                             const BezierSceneData &data,
+                             int patchesPerPage) {
+    QSaveFile fout(fileName);
+    if (!fout.open(QIODevice::WriteOnly)) {
+        qWarning() << "Could not open file:" << fileName;
+        return false;
+    }
+    if (!write(fout, data, patchesPerPage)) {
+        qWarning() << "Could not write file:" << fileName << fout.errorString();
+        fout.cancelWriting();
+        return false;
+    }
+    return fout.commit();
+}
+
+bool PagedSceneFormat::writeStreamed(QIODevice &device,
+                                     const char *begin,
+                                     const char *end,
+                                     int patchesPerPage) {
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    Q_UNUSED(device);
+    Q_UNUSED(begin);
+    Q_UNUSED(end);
+    Q_UNUSED(patchesPerPage);
+    qWarning() << "Paged scenes are not supported on big endian systems";
+    return false;
+#else
+    if (device.isSequential() || patchesPerPage <= 0) {
+        return false;
+    }
+
+    // --- Vertices and the box of the scene ---
+
+    QTemporaryFile vertexFile;
+    if (!vertexFile.open()) {
+        qWarning() << "Could not open a temporary file:" << vertexFile.errorString();
+        return false;
+    }
+    QVector3D minValues(std::numeric_limits<float>::max(),
+                        std::numeric_limits<float>::max(),
+                        std::numeric_limits<float>::max());
+    QVector3D maxValues = -minValues;
+    quint64 numPatches[BezierPatch::NUM_PATCH_TYPES] = {0, 0};
+    quint64 numVertices = 0;
+    {
+        QVector<QVector4D> block;
+        block.reserve(VERTEX_BLOCK_SIZE);
+        const auto writeBlock = [&]() {
+            const qint64 size = sizeof(QVector4D) * block.size();
+            const bool written = vertexFile.write(
+                        reinterpret_cast<const char *>(block.constData()), size) == size;
+            block.resize(0);
+            return written;
+        };
+        BezierSceneTokenizer tokenizer(begin, end);
+        while (tokenizer.nextLine()) {
+            if (tokenizer.tokenEquals(0, 'v') && tokenizer.numTokens() >= 5) {
+                const QVector4D point(BezierSceneTokenizer::toFloat(tokenizer.token(1)),
+                                      BezierSceneTokenizer::toFloat(tokenizer.token(2)),
+                                      BezierSceneTokenizer::toFloat(tokenizer.token(3)),
+                                      BezierSceneTokenizer::toFloat(tokenizer.token(4)));
+                const QVector3D position = point.toVector3D() / point.w();
+                for (int axis = 0; axis < 3; ++axis) {
+                    minValues[axis] = std::min(minValues[axis], position[axis]);
+                    maxValues[axis] = std::max(maxValues[axis], position[axis]);
+                }
+                block.push_back(point);
+                ++numVertices;
+                if (block.size() == VERTEX_BLOCK_SIZE && !writeBlock()) {
+                    return false;
+                }
+            } else if (tokenizer.tokenEquals(0, 'p')) {
+                const int numPoints = patchPoints(tokenizer.numTokens());
+                if (numPoints == BezierQuad::NUM_CONTROL_POINTS) {
+                    ++numPatches[BezierPatch::QuadPatch];
+                } else if (numPoints > 0) {
+                    ++numPatches[BezierPatch::TriPatch];
+                }
+            }
+        }
+        if (!block.isEmpty() && !writeBlock()) {
+            return false;
+        }
+    }
+    if (numVertices == 0) {
+        minValues = maxValues = QVector3D();
+    }
+    if (numVertices > std::numeric_limits<quint32>::max()) {
+        qWarning() << "Too many vertices for a paged scene:" << numVertices;
+        return false;
+    }
+    const quint64 totalPatches = numPatches[BezierPatch::TriPatch] +
+            numPatches[BezierPatch::QuadPatch];
+    const quint64 numPages = (totalPatches + patchesPerPage - 1) / patchesPerPage;
+    if (numPages > quint64(std::numeric_limits<int>::max())) {
+        qWarning() << "Too many pages for a paged scene:" << numPages;
+        return false;
+    }
+    const QVector4D *vertices = numVertices == 0 ? nullptr :
+            reinterpret_cast<const QVector4D *>(
+                vertexFile.map(0, sizeof(QVector4D) * numVertices));
+    if (numVertices > 0 && !vertices) {
+        qWarning() << "Could not map the temporary vertex file:" << vertexFile.errorString();
+        return false;
+    }
+
+    // --- Patches per cell ---
+
+    int bits = 1;
+    while (bits < MAX_CELL_BITS && (quint64(1) << (3 * bits)) < numPages * CELLS_PER_PAGE) {
+        ++bits;
+    }
+    const QVector3D extent = maxValues - minValues;
+    QVector<quint64> cellStart((1 << (3 * bits)) + 1, 0);
+    PatchRecord record;
+    {
+        BezierSceneTokenizer tokenizer(begin, end);
+        while (tokenizer.nextLine()) {
+            if (!tokenizer.tokenEquals(0, 'p') || patchPoints(tokenizer.numTokens()) == 0) {
+                continue;
+            }
+            if (!readPatch(tokenizer, numVertices, record)) {
+                return false;
+            }
+            ++cellStart[patchCell(record, vertices, minValues, extent, bits) + 1];
+        }
+    }
+    for (int cell = 1; cell < cellStart.size(); ++cell) {
+        cellStart[cell] += cellStart[cell - 1];
+    }
+
+    // --- Patches in cell order ---
+
+    QTemporaryFile recordFile;
+    if (!recordFile.open() || !recordFile.resize(sizeof(PatchRecord) * totalPatches)) {
+        qWarning() << "Could not open a temporary file:" << recordFile.errorString();
+        return false;
+    }
+    PatchRecord *records = totalPatches == 0 ? nullptr :
+            reinterpret_cast<PatchRecord *>(recordFile.map(0, sizeof(PatchRecord) * totalPatches));
+    if (totalPatches > 0 && !records) {
+        qWarning() << "Could not map the temporary patch file:" << recordFile.errorString();
+        return false;
+    }
+    {
+        BezierSceneTokenizer tokenizer(begin, end);
+        while (tokenizer.nextLine()) {
+            if (!tokenizer.tokenEquals(0, 'p') || patchPoints(tokenizer.numTokens()) == 0) {
+                continue;
+            }
+            readPatch(tokenizer, numVertices, record);
+            if (record.numPoints == BezierTriangle::NUM_CONTROL_POINTS - 1) {
+                QVector4D points[BezierTriangle::NUM_CONTROL_POINTS - 1];
+                for (quint32 i = 0; i < record.numPoints; ++i) {
+                    points[i] = vertices[record.indices[i]];
+                }
+                record.center = BezierTriangle::interpolateCenterPoint(points);
+            }
+            const quint32 cell = patchCell(record, vertices, minValues, extent, bits);
+            records[cellStart[cell]++] = record;
+        }
+    }
+
+    // --- Pages ---
+
+    Header header;
+    initHeader(header, numPages);
+    header.numPatches[BezierPatch::TriPatch] = numPatches[BezierPatch::TriPatch];
+    header.numPatches[BezierPatch::QuadPatch] = numPatches[BezierPatch::QuadPatch];
+    for (int axis = 0; axis < 3; ++axis) {
+        header.minValues[axis] = minValues[axis];
+        header.maxValues[axis] = maxValues[axis];
+    }
+    QVector<Page> pages(static_cast<int>(numPages));
+    if (!writePageTable(device, header, pages)) {
+        return false;
+    }
+    quint64 position = header.pageTableOffset + sizeof(Page) * numPages;
+
+    QHash<unsigned, unsigned> localIndex;
+    PageData pageData;
+    for (int pageNumber = 0; pageNumber < pages.size(); ++pageNumber) {
+        const quint64 first = quint64(pageNumber) * patchesPerPage;
+        const quint64 last = std::min(first + patchesPerPage, totalPatches);
+        localIndex.clear();
+        pageData.vertices.clear();
+        pageData.indices.clear();
+        pageData.quadIndices.clear();
+
+        for (quint64 i = first; i < last; ++i) {
+            const PatchRecord &patch = records[i];
+            QVector<unsigned> &pageIndices = patch.numPoints == BezierQuad::NUM_CONTROL_POINTS ?
+                        pageData.quadIndices : pageData.indices;
+            for (quint32 point = 0; point < patch.numPoints; ++point) {
+                auto it = localIndex.find(patch.indices[point]);
+                if (it == localIndex.end()) {
+                    it = localIndex.insert(patch.indices[point], pageData.vertices.size());
+                    pageData.vertices.push_back(vertices[patch.indices[point]]);
+                }
+                pageIndices.push_back(*it);
+            }
+            if (patch.numPoints == BezierTriangle::NUM_CONTROL_POINTS - 1) {
+                pageIndices.push_back(pageData.vertices.size());
+                pageData.vertices.push_back(patch.center);
+            }
+        }
+
+        // The box of the control points bounds the patches
+        Page &page = pages[pageNumber];
+        for (int axis = 0; axis < 3; ++axis) {
+            page.minValues[axis] = std::numeric_limits<float>::max();
+            page.maxValues[axis] = -std::numeric_limits<float>::max();
+        }
+        for (const QVector4D &point : pageData.vertices) {
+            const QVector3D position = point.toVector3D() / point.w();
+            for (int axis = 0; axis < 3; ++axis) {
+                page.minValues[axis] = std::min(page.minValues[axis], position[axis]);
+                page.maxValues[axis] = std::max(page.maxValues[axis], position[axis]);
+            }
+        }
+        if (!writePage(device, position, pageData, page, header)) {
+            return false;
+        }
+    }
+
+    const qint64 fileEnd = device.pos();
+    return writePageTable(device, header, pages) && device.seek(fileEnd);
+#endif
+}
+
+bool PagedSceneFormat::writeStreamed(const QString &fileName,
+                                     const QString &sourceName,
+                                     int patchesPerPage) {
+    QFile fin(sourceName);
+    if (!fin.open(QIODevice::ReadOnly)) {
+        qWarning() << "Could not open file:" << sourceName;
+        return false;
+    }
+    const qint64 size = fin.size();
+    uchar *mapped = size > 0 ? fin.map(0, size) : nullptr;
+    QByteArray bytes;
+    if (!mapped) {
+        bytes = fin.readAll();
+    }
+    const char *begin = mapped ? reinterpret_cast<const char *>(mapped) : bytes.constData();
+    const char *end = begin + (mapped ? size : bytes.size());
+
+    QSaveFile fout(fileName);
+    if (!fout.open(QIODevice::WriteOnly)) {
+        qWarning() << "Could not open file:" << fileName;
+        return false;
+    }
+    if (!writeStreamed(fout, begin, end, patchesPerPage)) {
+        qWarning() << "Could not write file:" << fileName << fout.errorString();
+        fout.cancelWriting();
+        return false;
+    }
+    return fout.commit();
+}
+
+bool PagedSceneFormat::readPageTable(QIODevice &device, PageTable &table) {
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    Q_UNUSED(device);
+    Q_UNUSED(table);
+    qWarning() << "Paged scenes are not supported on big endian systems";
+    return false;
+#else
+    const quint64 fileSize = device.size();
+    Header &header = table.header;
+    if (!readArray(device, 0, &header, sizeof(Header)) ||
+            !isPagedScene(header.magic, header.magic + MAGIC_SIZE)) {
+        return false;
+    }
+    if (header.version != VERSION || header.headerSize != sizeof(Header)) {
+        qWarning() << "Unsupported paged scene version:" << header.version;
+        return false;
+    }
+    if (header.pageTableOffset > fileSize ||
+            header.numPages > (fileSize - header.pageTableOffset) / sizeof(Page) ||
+            header.maxPageIndices % 10 != 0 ||
+            header.maxPageQuadIndices % 16 != 0) {
+        qWarning() << "Corrupt paged scene header";
+        return false;
+    }
+
+    table.pages.resize(static_cast<int>(header.numPages));
+    if (!readArray(device, header.pageTableOffset,
+                   table.pages.data(), sizeof(Page) * header.numPages)) {
+        return false;
+    }
+    for (const Page &page : table.pages) {
+        if (page.numVertices > header.maxPageVertices ||
+                page.numIndices > header.maxPageIndices ||
+                page.numQuadIndices > header.maxPageQuadIndices ||
+                page.numIndices % 10 != 0 ||
+                page.numQuadIndices % 16 != 0 ||
+                page.offset > fileSize ||
+                pageEnd(page) > fileSize) {
+            qWarning() << "Corrupt paged scene page table";
+            table.pages.clear();
+            return false;
+        }
+    }
+    return true;
+#endif
+}
+
+bool PagedSceneFormat::readPageTable(const QString &fileName, PageTable &table) {
+    QFile fin(fileName);
+    if (!fin.open(QIODevice::ReadOnly)) {
+        qWarning() << "Could not open file:" << fileName;
+        return false;
+    }
+    table.fileName = fileName;
+    return readPageTable(fin, table);
+}
+
+bool PagedSceneFormat::readPage(QIODevice &device, const Page &page, PageData &data) {
+    data.vertices.resize(page.numVertices);
+    data.indices.resize(page.numIndices);
+    data.quadIndices.resize(page.numQuadIndices);
+    if (!readArray(device, page.offset,
+                   data.vertices.data(), sizeof(QVector4D) * page.numVertices) ||
+            !readArray(device, indexOffset(page),
+                       data.indices.data(), sizeof(unsigned) * page.numIndices) ||
+            !readArray(device, quadIndexOffset(page),
+                       data.quadIndices.data(), sizeof(unsigned) * page.numQuadIndices)) {
+        return false;
+    }
+
+    // Pages go straight to the GPU, a corrupt index must not reach it
+    for (const unsigned index : data.indices) {
+        if (index >= page.numVertices) return false;
+    }
+    for (const unsigned index : data.quadIndices) {
+        if (index >= page.numVertices) return false;
+    }
+    return true;
+}
+
+// --- Private -----------------------------------------------------------------
+
+void PagedSceneFormat::initHeader(Header &header, quint64 numPages) {
+    std::memset(&header, 0, sizeof(Header));
+    std::memcpy(header.magic, MAGIC, MAGIC_SIZE);
+    header.version = VERSION;
+    header.headerSize = sizeof(Header);
+    header.numPages = numPages;
+    header.pageTableOffset = align(sizeof(Header));
+}
+
+bool PagedSceneFormat::writePage(QIODevice &device,
+                                 quint64 &position,
+                                 const PageData &data,
+                                 Page &page,
+                                 Header &header) {
+    page.numVertices = data.vertices.size();
+    page.numIndices = data.indices.size();
+    page.numQuadIndices = data.quadIndices.size();
+    page.offset = align(position);
+    header.maxPageVertices = std::max(header.maxPageVertices, page.numVertices);
+    header.maxPageIndices = std::max(header.maxPageIndices, page.numIndices);
+    header.maxPageQuadIndices = std::max(header.maxPageQuadIndices, page.numQuadIndices);
+
+    return writeArray(device, position, page.offset,
+                      data.vertices.constData(),
+                      sizeof(QVector4D) * page.numVertices) &&
+            writeArray(device, position, indexOffset(page),
+                       data.indices.constData(),
+                       sizeof(unsigned) * page.numIndices) &&
+            writeArray(device, position, quadIndexOffset(page),
+                       data.quadIndices.constData(),
+                       sizeof(unsigned) * page.numQuadIndices);
+}
+
+bool PagedSceneFormat::writePageTable(QIODevice &device,
+                                      const Header &header,
+                                      const QVector<Page> &pages) {
+    quint64 position = 0;
+    return device.seek(0) &&
+            writeArray(device, position, 0, &header, sizeof(Header)) &&
+            writeArray(device, position, header.pageTableOffset,
+                       pages.constData(), sizeof(Page) * quint64(pages.size()));
+}
+
+
+quint64 PagedSceneFormat::indexOffset(const Page &page) {
+    return align(page.offset + sizeof(QVector4D) * quint64(page.numVertices));
+}
+
+quint64 PagedSceneFormat::quadIndexOffset(const Page &page) {
+    return align(indexOffset(page) + sizeof(unsigned) * quint64(page.numIndices));
+}
+
+quint64 PagedSceneFormat::pageEnd(const Page &page) {
+    return quadIndexOffset(page) + sizeof(unsigned) * quint64(page.numQuadIndices);
+}
@@ -0,0 +1,159 @@
+#ifndef PAGEDSCENEFORMAT_H
+#define PAGEDSCENEFORMAT_H
+
+#include <QIODevice>
+#include <QString>
+#include <QVector>
+#include <QVector4D>
+
+struct BezierSceneData;
+
+/*!
+ * \brief The PagedSceneFormat class
+ *
+ * Out-of-core variant of the BinarySceneFormat for scenes larger than host
+ * and device memory. The patches are partitioned into pages of spatially
+ * close patches, in the Morton order of the BVH leaves. Every page has its
+ * own vertex and index arrays, so it can be read and uploaded on its own.
+ * Vertices shared by patches of different pages are stored in each page.
+ *
+ * The file starts with a fixed size header, followed by the page table and
+ * the pages. The arrays of a page follow each other, 16 byte aligned, in
+ * the same little endian layout as the binary scene format.
+ *
+ * writeStreamed() converts a .bezier text scene without importing it, for
+ * scenes that do not fit in memory at all. It orders the patches by the
+ * Morton code of their corners on a grid over the scene: one pass over the
+ * text counts the patches per cell, a second one scatters them into a
+ * temporary file in cell order, from which the pages are written. Only the
+ * cell counts and one page are held, the vertices are mapped from another
+ * temporary file.
+ */
+class PagedSceneFormat
+{
+
+    // =========================================================================
+    // -- Enums and types ------------------------------------------------------
+    // =========================================================================
+
+public:
+
+    enum {
+        MAGIC_SIZE = 8,
+        VERSION = 1,
+        ALIGNMENT = 16,
+        /// Patches per page if the writer is not told otherwise
+        DEFAULT_PAGE_PATCHES = 4096
+    };
+
+    struct Header {
+        char magic[MAGIC_SIZE];
+        quint32 version;
+        quint32 headerSize;
+        quint64 numPages;
+        quint64 pageTableOffset;
+        quint64 numPatches[2];
+        float minValues[3];
+        float maxValues[3];
+        /// Largest arrays of any page, the size of a slot of the GPU pool
+        quint32 maxPageVertices;
+        quint32 maxPageIndices;
+        quint32 maxPageQuadIndices;
+        quint32 padding;
+    };
+
+    /// Entry of the page table
+    struct Page {
+        /// Box of the control points of the page
+        float minValues[3];
+        float maxValues[3];
+        quint32 numVertices;
+        quint32 numIndices;
+        quint32 numQuadIndices;
+        quint32 padding;
+        /// Of the vertex array, the index arrays follow
+        quint64 offset;
+    };
+
+    /// The arrays of one page, indices refer to the vertices of the page
+    struct PageData {
+        QVector<QVector4D> vertices;
+        QVector<unsigned> indices;
+        QVector<unsigned> quadIndices;
+    };
+
+    /// What a scene needs to stream in its pages
+    struct PageTable {
+        QString fileName;
+        Header header;
+        QVector<Page> pages;
+
+        bool isEmpty() const {
+            return pages.isEmpty();
+        }
+    };
+
+    // =========================================================================
+    // -- Other methods --------------------------------------------------------
+    // =========================================================================
+
+public:
+
+    static bool isPagedScene(const char *begin, const char *end);
+
+    /// Pages of at most patchesPerPage patches, in the order of the leaves
+    /// of data.bvh if it covers all patches
+    static bool write(QIODevice &device,
+                      const BezierSceneData &data,
+                      int patchesPerPage = DEFAULT_PAGE_PATCHES);
+
+    static bool write(const QString &fileName,
+                      const BezierSceneData &data,
+                      int patchesPerPage = DEFAULT_PAGE_PATCHES);
+
+    /// Pages of the .bezier text in [begin, end), see the class description
+    static bool writeStreamed(QIODevice &device,
+                              const char *begin,
+                              const char *end,
+                              int patchesPerPage = DEFAULT_PAGE_PATCHES);
+
+    /// Converts a .bezier text file with writeStreamed()
+    static bool writeStreamed(const QString &fileName,
+                              const QString &sourceName,
+                              int patchesPerPage = DEFAULT_PAGE_PATCHES);
+
+    /// Reads the header and the page table, not the pages
+    static bool readPageTable(QIODevice &device, PageTable &table);
+
+    static bool readPageTable(const QString &fileName, PageTable &table);
+
+    /// Reads and checks the arrays of one page of the table
+    static bool readPage(QIODevice &device, const Page &page, PageData &data);
+
+private:
+
+    static void initHeader(Header &header, quint64 numPages);
+
+    /// Fills in the sizes and the offset of the page and writes its arrays
+    static bool writePage(QIODevice &device,
+                          quint64 &position,
+                          const PageData &data,
+                          Page &page,
+                          Header &header);
+
+    /// Writes the header and the page table over the placeholders at the
+    /// start of the device
+    static bool writePageTable(QIODevice &device,
+                               const Header &header,
+                               const QVector<Page> &pages);
+
+    /// Offsets of the index arrays of a page
+    static quint64 indexOffset(const Page &page);
+
+    static quint64 quadIndexOffset(const Page &page);
+
+    static quint64 pageEnd(const Page &page);
+
+};
+
+#endif // PAGEDSCENEFORMAT_H
@@ -0,0 +1,166 @@
+#include <util/profiler.h>
+
+#include <QByteArray>
+#include <QCoreApplication>
+#include <QHash>
+#include <QSaveFile>
+#include <QThread>
+#include <QtDebug>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+
+namespace {
+
+const quint64 SLOT_MASK = Profiler::EVENT_CAPACITY - 1;
+
+/// Nearest rank percentile of sorted samples
+double percentile(const QVector<double> &sorted, double fraction)
+{
+    const int rank = static_cast<int>(std::ceil(fraction * sorted.size()));
+    return sorted[std::max(0, std::min(rank, sorted.size()) - 1)];
+}
+
+} // namespace
+
+// -----------------------------------------------------------------------------
+// -- Constructors and destructor ----------------------------------------------
+// -----------------------------------------------------------------------------
+
+Profiler::Profiler() :
+    _slots(new Slot[EVENT_CAPACITY]),
+    _next(0)
+{
+    static_assert((EVENT_CAPACITY & (EVENT_CAPACITY - 1)) == 0,
+                  "EVENT_CAPACITY must be a power of two");
+    for (int i = 0; i < EVENT_CAPACITY; ++i) {
+        _slots[i].sequence.storeRelaxed(0);
+    }
+    _clock.start();
+}
+
+Profiler::~Profiler()
+{
+    delete[] _slots;
+}
+
+// -----------------------------------------------------------------------------
+// -- Other Methods ------------------------------------------------------------
+// -----------------------------------------------------------------------------
+
+Profiler &Profiler::instance()
+{
+    static Profiler profiler;
+    return profiler;
+}
+
+void Profiler::record(const char *name, qint64 begin, qint64 end)
+{
+    const quint64 index = _next.fetchAndAddOrdered(1);
+    Slot &slot = _slots[index & SLOT_MASK];
+    slot.sequence.storeRelease(0);
+    slot.event.name = name;
+    slot.event.thread = reinterpret_cast<quintptr>(QThread::currentThreadId());
+    slot.event.begin = begin;
+    slot.event.end = end;
+    slot.sequence.storeRelease(index + 1);
+}
+
+QVector<Profiler::Event> Profiler::events() const
+{
+    const quint64 next = _next.loadAcquire();
+    const quint64 first = next > quint64(EVENT_CAPACITY) ? next - EVENT_CAPACITY : 0;
+
+    QVector<Event> events;
+    events.reserve(static_cast<int>(next - first));
+    for (quint64 index = first; index < next; ++index) {
+        const Slot &slot = _slots[index & SLOT_MASK];
+        if (slot.sequence.loadAcquire() != index + 1) {
+            // Still being written, or already overwritten by a newer event
+            continue;
+        }
+        const Event event = slot.event;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.loadRelaxed() == index + 1) {
+            events.push_back(event);
+        }
+    }
+    return events;
+}
+
+QVector<Profiler::Summary> Profiler::summarize(int window) const
+{
+    const QVector<Event> allEvents = events();
+
+    // Newest events first, at most window samples per scope
+    QHash<QByteArray, QVector<double>> samples;
+    for (int i = allEvents.size() - 1; i >= 0; --i) {
+        QVector<double> &durations = samples[QByteArray(allEvents[i].name)];
+        if (durations.size() < window) {
+            durations.push_back((allEvents[i].end - allEvents[i].begin) * 1e-6);
+        }
+    }
+
+    QVector<Summary> summaries;
+    for (auto it = samples.constBegin(); it != samples.constEnd(); ++it) {
+        summaries.push_back(summarizeSamples(QString::fromLatin1(it.key()), it.value()));
+    }
+    std::sort(summaries.begin(), summaries.end(), [](const Summary &a, const Summary &b) {
+        return a.name < b.name;
+    });
+    return summaries;
+}
+
+Profiler::Summary Profiler::summarizeSamples(const QString &name, QVector<double> samples)
+{
+    std::sort(samples.begin(), samples.end());
+    Summary summary;
+    summary.name = name;
+    summary.count = samples.size();
+    summary.median = samples.isEmpty() ? 0.0 : percentile(samples, 0.5);
+    summary.p95 = samples.isEmpty() ? 0.0 : percentile(samples, 0.95);
+    summary.p99 = samples.isEmpty() ? 0.0 : percentile(samples, 0.99);
+    summary.max = samples.isEmpty() ? 0.0 : samples.last();
+    return summary;
+}
+
+bool Profiler::writeChromeTrace(const QString &fileName) const
+{
+    const QVector<Event> allEvents = events();
+
+    // Small thread ids in the order the threads first appear
+    QHash<quintptr, int> threadIds;
+    const qint64 pid = QCoreApplication::applicationPid();
+
+    QByteArray trace("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    char line[256];
+    for (int i = 0; i < allEvents.size(); ++i) {
+        const Event &event = allEvents[i];
+        if (!threadIds.contains(event.thread)) {
+            threadIds.insert(event.thread, threadIds.size());
+        }
+        // Names are literals from the source, they need no escaping
+        const int size = std::snprintf(
+                    line, sizeof(line),
+                    "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                    "\"pid\":%lld,\"tid\":%d}%s\n",
+                    event.name, event.begin * 1e-3, (event.end - event.begin) * 1e-3,
+                    static_cast<long long>(pid), threadIds.value(event.thread),
+                    i + 1 < allEvents.size() ? "," : "");
+        trace.append(line, std::min<int>(size, sizeof(line) - 1));
+    }
+    trace.append("]}\n");
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Could not open" << fileName << "for writing:" << file.errorString();
+        return false;
+    }
+    if (file.write(trace) != trace.size() || !file.commit()) {
+        qWarning() << "Could not write" << fileName << ":" << file.errorString();
+        return false;
+    }
+    return true;
+}
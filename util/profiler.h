@@ -0,0 +1,145 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+#include <QString>
+#include <QVector>
+
+/*!
+ * \brief The Profiler class
+ *
+ * Collects the CPU time of named scopes, see ScopedTimer, from any thread.
+ * Events go to a fixed ring of the last EVENT_CAPACITY scopes, recording
+ * never allocates or locks. Readers copy the ring and skip the slots that
+ * are overwritten while they read.
+ *
+ * Scope names must be string literals, only the pointer is stored.
+ */
+class Profiler
+{
+
+    // =========================================================================
+    // -- Enums and types ------------------------------------------------------
+    // =========================================================================
+
+public:
+
+    static const int EVENT_CAPACITY = 1 << 16;
+
+    /// One finished scope, times in nanoseconds since the profiler started
+    struct Event {
+        const char *name;
+        quintptr thread;
+        qint64 begin;
+        qint64 end;
+    };
+
+    /// Percentiles of the last samples of one scope, in milliseconds
+    struct Summary {
+        QString name;
+        int count;
+        double median;
+        double p95;
+        double p99;
+        double max;
+    };
+
+    // =========================================================================
+    // -- Constructors and destructor ------------------------------------------
+    // =========================================================================
+
+private:
+
+    Profiler();
+
+    ~Profiler();
+
+    Profiler(const Profiler &) = delete;
+
+    Profiler &operator=(const Profiler &) = delete;
+
+    // =========================================================================
+    // -- Other methods --------------------------------------------------------
+    // =========================================================================
+
+public:
+
+    static Profiler &instance();
+
+    /// Nanoseconds since the profiler started
+    qint64 now() const {
+        return _clock.nsecsElapsed();
+    }
+
+    void record(const char *name, qint64 begin, qint64 end);
+
+    /// Events still in the ring, oldest first
+    QVector<Event> events() const;
+
+    /// Rolling percentiles over the last window events of every scope,
+    /// sorted by name
+    QVector<Summary> summarize(int window = 256) const;
+
+    /// Percentiles of durations in milliseconds, also used for the GPU times
+    static Summary summarizeSamples(const QString &name, QVector<double> samples);
+
+    /// Writes the events in the ring in the Chrome trace event format, for
+    /// chrome://tracing and Perfetto
+    bool writeChromeTrace(const QString &fileName) const;
+
+    // =========================================================================
+    // -- Data members ---------------------------------------------------------
+    // =========================================================================
+
+private:
+
+    struct Slot {
+        /// Index of the event plus one, 0 while it is written
+        QAtomicInteger<quint64> sequence;
+        Event event;
+    };
+
+    Slot *_slots;
+
+    /// Index of the next event, the slot is the index modulo the capacity
+    QAtomicInteger<quint64> _next;
+
+    QElapsedTimer _clock;
+
+};
+
+/*!
+ * \brief The ScopedTimer class
+ *
+ * Records the time between its construction and destruction.
+ */
+class ScopedTimer
+{
+
+public:
+
+    explicit ScopedTimer(const char *name) :
+        _name(name),
+        _begin(Profiler::instance().now())
+    {
+    }
+
+    ~ScopedTimer() {
+        Profiler &profiler = Profiler::instance();
+        profiler.record(_name, _begin, profiler.now());
+    }
+
+private:
+
+    ScopedTimer(const ScopedTimer &) = delete;
+
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+    const char *_name;
+
+    qint64 _begin;
+
+};
+
+#endif // PROFILER_H